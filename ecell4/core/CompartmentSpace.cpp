@@ -37,7 +37,8 @@ void CompartmentSpaceVectorImpl::set_volume(const Real& volume)
     edge_lengths_ = Real3(L, L, L);
 }
 
-void CompartmentSpaceVectorImpl::reserve_species(const Species& sp)
+CompartmentSpaceVectorImpl::species_index_type
+CompartmentSpaceVectorImpl::reserve_species(const Species& sp)
 {
     species_map_type::const_iterator i(index_map_.find(sp));
     if (i != index_map_.end())
@@ -45,9 +46,22 @@ void CompartmentSpaceVectorImpl::reserve_species(const Species& sp)
         throw AlreadyExists("Species already exists");
     }
 
-    index_map_.insert(std::make_pair(sp, num_molecules_.size()));
+    const species_index_type idx(num_molecules_.size());
+    index_map_.insert(std::make_pair(sp, idx));
     species_.push_back(sp);
     num_molecules_.push_back(0);
+    return idx;
+}
+
+CompartmentSpaceVectorImpl::species_index_type
+CompartmentSpaceVectorImpl::get_species_index(const Species& sp)
+{
+    species_map_type::const_iterator i(index_map_.find(sp));
+    if (i == index_map_.end())
+    {
+        return reserve_species(sp);
+    }
+    return (*i).second;
 }
 
 void CompartmentSpaceVectorImpl::release_species(const Species& sp)
@@ -108,15 +122,7 @@ void CompartmentSpaceVectorImpl::add_molecules(
             "The number of molecules must be positive. [", sp.serial(), "]");
     }
 
-    species_map_type::const_iterator i(index_map_.find(sp));
-    if (i == index_map_.end())
-    {
-        // throw NotFound("Species not found");
-        reserve_species(sp);
-        i = index_map_.find(sp);
-    }
-
-    num_molecules_[(*i).second] += num;
+    num_molecules_[get_species_index(sp)] += num;
 }
 
 void CompartmentSpaceVectorImpl::remove_molecules(
@@ -143,4 +149,34 @@ void CompartmentSpaceVectorImpl::remove_molecules(
     num_molecules_[(*i).second] -= num;
 }
 
+void CompartmentSpaceVectorImpl::add_molecules_at(
+    const species_index_type idx, const Integer& num)
+{
+    if (num < 0)
+    {
+        throw_exception<std::invalid_argument>(
+            "The number of molecules must be positive. [", species_[idx].serial(), "]");
+    }
+
+    num_molecules_[idx] += num;
+}
+
+void CompartmentSpaceVectorImpl::remove_molecules_at(
+    const species_index_type idx, const Integer& num)
+{
+    if (num < 0)
+    {
+        throw_exception<std::invalid_argument>(
+            "The number of molecules must be positive. [", species_[idx].serial(), "]");
+    }
+
+    if (num_molecules_[idx] < num)
+    {
+        throw_exception<std::invalid_argument>(
+            "The number of molecules cannot be negative. [", species_[idx].serial(), "]");
+    }
+
+    num_molecules_[idx] -= num;
+}
+
 } // ecell4
@@ -17,6 +17,10 @@ namespace ecell4
 class CompartmentSpace
     // : public Space
 {
+public:
+
+    typedef std::size_t species_index_type;
+
 public:
 
     CompartmentSpace()
@@ -111,6 +115,43 @@ public:
         throw NotImplemented("has_species(const Species&) not implemented");
     }
 
+    /**
+     * get a dense integer index of the species.
+     * a new species is reserved with no molecules.
+     * the index stays valid until the space is reset or the species is released.
+     * @param sp a species
+     * @return an index species_index_type
+     */
+    virtual species_index_type get_species_index(const Species& sp)
+    {
+        throw NotImplemented("get_species_index(const Species&) not implemented");
+    }
+
+    virtual species_index_type num_species() const
+    {
+        throw NotImplemented("num_species() not implemented");
+    }
+
+    virtual const Species& species_at(const species_index_type idx) const
+    {
+        throw NotImplemented("species_at(const species_index_type) not implemented");
+    }
+
+    virtual Integer num_molecules_at(const species_index_type idx) const
+    {
+        throw NotImplemented("num_molecules_at(const species_index_type) not implemented");
+    }
+
+    virtual void add_molecules_at(const species_index_type idx, const Integer& num)
+    {
+        throw NotImplemented("add_molecules_at(const species_index_type, const Integer&) not implemented");
+    }
+
+    virtual void remove_molecules_at(const species_index_type idx, const Integer& num)
+    {
+        throw NotImplemented("remove_molecules_at(const species_index_type, const Integer&) not implemented");
+    }
+
     // CompartSpace member functions
 
     /**
@@ -170,8 +211,7 @@ protected:
     typedef CompartmentSpace base_type;
     typedef std::vector<Integer> num_molecules_container_type;
     typedef std::vector<Species> species_container_type;
-    typedef std::unordered_map<
-        Species, num_molecules_container_type::size_type> species_map_type;
+    typedef std::unordered_map<Species, species_index_type> species_map_type;
 
 public:
 
@@ -211,11 +251,30 @@ public:
     Integer num_molecules_exact(const Species& sp) const;
     bool has_species(const Species& sp) const;
 
+    species_index_type get_species_index(const Species& sp);
+
+    species_index_type num_species() const
+    {
+        return species_.size();
+    }
+
+    const Species& species_at(const species_index_type idx) const
+    {
+        return species_[idx];
+    }
+
+    Integer num_molecules_at(const species_index_type idx) const
+    {
+        return num_molecules_[idx];
+    }
+
     // CompartmentSpace member functions
 
     void set_volume(const Real& volume);
     void add_molecules(const Species& sp, const Integer& num);
     void remove_molecules(const Species& sp, const Integer& num);
+    void add_molecules_at(const species_index_type idx, const Integer& num);
+    void remove_molecules_at(const species_index_type idx, const Integer& num);
 
     // Optional members
 
@@ -243,7 +302,10 @@ public:
 
 protected:
 
-    void reserve_species(const Species& sp);
+    species_index_type reserve_species(const Species& sp);
+    /**
+     * release the species. this moves the last species to its index.
+     */
     void release_species(const Species& sp);
 
 protected:
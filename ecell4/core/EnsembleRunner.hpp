@@ -0,0 +1,379 @@
+#ifndef ECELL4_ENSEMBLE_RUNNER_HPP
+#define ECELL4_ENSEMBLE_RUNNER_HPP
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <limits>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <exception>
+
+#include "types.hpp"
+#include "exceptions.hpp"
+#include "Real3.hpp"
+#include "Species.hpp"
+#include "Model.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "observers.hpp"
+
+
+namespace ecell4
+{
+
+/**
+ * a block of FixedIntervalNumberObserver data of independent runs,
+ * which is allocated at once. A row of each run has the same layout
+ * as FixedIntervalNumberObserver::data: the time and then the value
+ * of each target species.
+ */
+class EnsembleResult
+{
+public:
+
+    typedef NumberLogger::data_container_type data_container_type;
+    typedef NumberLogger::species_container_type species_container_type;
+
+public:
+
+    EnsembleResult()
+        : num_runs_(0), num_times_(0), targets_(), values_()
+    {
+        ;
+    }
+
+    EnsembleResult(
+        const Integer num_runs, const Integer num_times,
+        const species_container_type& targets)
+        : num_runs_(num_runs), num_times_(num_times), targets_(targets),
+        values_(num_runs * num_times * (targets.size() + 1), 0.0)
+    {
+        ;
+    }
+
+    Integer num_runs() const
+    {
+        return num_runs_;
+    }
+
+    Integer num_times() const
+    {
+        return num_times_;
+    }
+
+    const species_container_type& targets() const
+    {
+        return targets_;
+    }
+
+    /**
+     * the number of columns of a row, the time and the targets.
+     */
+    Integer num_columns() const
+    {
+        return static_cast<Integer>(targets_.size() + 1);
+    }
+
+    Real* row(const Integer run, const Integer i)
+    {
+        return &values_[(run * num_times_ + i) * num_columns()];
+    }
+
+    const Real* row(const Integer run, const Integer i) const
+    {
+        return &values_[(run * num_times_ + i) * num_columns()];
+    }
+
+    Real value(const Integer run, const Integer i, const Integer j) const
+    {
+        return row(run, i)[j];
+    }
+
+    const std::vector<Real>& values() const
+    {
+        return values_;
+    }
+
+    /**
+     * return the data of a run in the format of FixedIntervalNumberObserver.
+     */
+    data_container_type data(const Integer run) const
+    {
+        if (run < 0 || run >= num_runs_)
+        {
+            throw_exception<NotFound>("No such run [", run, "].");
+        }
+
+        data_container_type retval;
+        retval.reserve(num_times_);
+        for (Integer i(0); i < num_times_; ++i)
+        {
+            retval.push_back(
+                data_container_type::value_type(row(run, i), row(run, i) + num_columns()));
+        }
+        return retval;
+    }
+
+    /**
+     * return the data averaged over the runs.
+     */
+    data_container_type mean() const
+    {
+        data_container_type retval(
+            num_times_, data_container_type::value_type(num_columns(), 0.0));
+        for (Integer run(0); run < num_runs_; ++run)
+        {
+            for (Integer i(0); i < num_times_; ++i)
+            {
+                const Real* values(row(run, i));
+                for (Integer j(0); j < num_columns(); ++j)
+                {
+                    retval[i][j] += values[j] / num_runs_;
+                }
+            }
+        }
+        return retval;
+    }
+
+protected:
+
+    Integer num_runs_, num_times_;
+    species_container_type targets_;
+    std::vector<Real> values_;
+};
+
+/**
+ * EnsembleState holds the molecules of the original world, and puts them
+ * into each replicate. By default, the number of molecules is copied
+ * by species. A world with a finer layout of molecules, e.g. subvolumes,
+ * specializes this class.
+ */
+template <typename Tworld_>
+class EnsembleState
+{
+public:
+
+    typedef Tworld_ world_type;
+
+public:
+
+    EnsembleState(const world_type& world)
+        : species_(world.list_species()), numbers_()
+    {
+        numbers_.reserve(species_.size());
+        for (std::vector<Species>::const_iterator i(species_.begin());
+            i != species_.end(); ++i)
+        {
+            numbers_.push_back(world.num_molecules_exact(*i));
+        }
+    }
+
+    const std::vector<Species>& species() const
+    {
+        return species_;
+    }
+
+    void restore(world_type& world) const
+    {
+        for (std::size_t i(0); i < species_.size(); ++i)
+        {
+            world.add_molecules(species_[i], numbers_[i]);
+        }
+    }
+
+protected:
+
+    std::vector<Species> species_;
+    std::vector<Integer> numbers_;
+};
+
+/**
+ * EnsembleRunner runs independent replicates of a world on a pool of threads.
+ * Each replicate is a world created by the factory with its own
+ * GSLRandomNumberGenerator, whose seed is drawn from a master stream
+ * seeded with the given seed, so that the results do not depend on the number
+ * of threads. The molecules of the original world are copied by
+ * EnsembleState. Structures and positions are not copied.
+ * The model is shared by the replicates, and must not be modified during a run.
+ */
+template <typename Tfactory_>
+class EnsembleRunner
+{
+public:
+
+    typedef Tfactory_ factory_type;
+    typedef typename factory_type::world_type world_type;
+    typedef typename factory_type::simulator_type simulator_type;
+    typedef EnsembleState<world_type> state_type;
+
+public:
+
+    EnsembleRunner(
+        const factory_type& factory,
+        const Integer num_threads = default_num_threads())
+        : factory_(factory), num_threads_(num_threads)
+    {
+        if (num_threads_ <= 0)
+        {
+            throw std::invalid_argument("The number of threads must be positive.");
+        }
+    }
+
+    static inline const Integer default_num_threads()
+    {
+        const unsigned int num_threads(std::thread::hardware_concurrency());
+        return (num_threads > 0 ? static_cast<Integer>(num_threads) : 1);
+    }
+
+    Integer num_threads() const
+    {
+        return num_threads_;
+    }
+
+    /**
+     * run num_runs replicates of the world for the duration and log
+     * the numbers of the species every dt.
+     * @param species a list of serials. All species of the world if empty.
+     */
+    EnsembleResult run(
+        const std::shared_ptr<world_type>& world,
+        const std::shared_ptr<Model>& model,
+        const Real duration, const Real dt, const Integer num_runs,
+        const std::vector<std::string>& species = std::vector<std::string>(),
+        const Integer seed = 0) const
+    {
+        if (num_runs < 0)
+        {
+            throw std::invalid_argument("The number of runs must not be negative.");
+        }
+        else if (dt <= 0.0)
+        {
+            throw std::invalid_argument("A step interval must be positive.");
+        }
+
+        const state_type initial(*world);
+
+        std::vector<std::string> targets(species);
+        if (targets.size() == 0)
+        {
+            for (std::vector<Species>::const_iterator i(initial.species().begin());
+                i != initial.species().end(); ++i)
+            {
+                targets.push_back((*i).serial());
+            }
+        }
+
+        // FixedIntervalObserver fires at t0 + dt * k as long as it is in the run.
+        const Real t0(world->t()), upto(t0 + duration);
+        Integer num_times(0);
+        while (t0 + dt * num_times <= upto)
+        {
+            ++num_times;
+        }
+
+        EnsembleResult result(
+            num_runs, num_times, NumberLogger(targets).targets);
+
+        GSLRandomNumberGenerator master(seed);
+        std::vector<Integer> seeds(num_runs);
+        for (Integer run(0); run < num_runs; ++run)
+        {
+            seeds[run] = master.uniform_int(0, std::numeric_limits<int>::max());
+        }
+
+        std::atomic<Integer> next_run(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        const auto work = [&]()
+            {
+                while (true)
+                {
+                    const Integer run(next_run++);
+                    if (run >= num_runs)
+                    {
+                        return;
+                    }
+
+                    try
+                    {
+                        run_once(
+                            world->edge_lengths(), t0, initial, model,
+                            duration, dt, targets, seeds[run], result, run);
+                    }
+                    catch (...)
+                    {
+                        std::lock_guard<std::mutex> lock(error_mutex);
+                        if (!error)
+                        {
+                            error = std::current_exception();
+                        }
+                        next_run = num_runs;  // stop the other workers
+                        return;
+                    }
+                }
+            };
+
+        std::vector<std::thread> workers;
+        const Integer num_workers(std::min(num_threads_, num_runs));
+        for (Integer i(1); i < num_workers; ++i)
+        {
+            workers.push_back(std::thread(work));
+        }
+        work();
+        for (std::vector<std::thread>::iterator i(workers.begin());
+            i != workers.end(); ++i)
+        {
+            (*i).join();
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return result;
+    }
+
+protected:
+
+    void run_once(
+        const Real3& edge_lengths, const Real t0,
+        const state_type& initial, const std::shared_ptr<Model>& model, const Real duration, const Real dt,
+        const std::vector<std::string>& targets, const Integer seed,
+        EnsembleResult& result, const Integer run) const
+    {
+        factory_type factory(factory_);
+        factory.rng(std::shared_ptr<RandomNumberGenerator>(
+            new GSLRandomNumberGenerator(seed)));
+
+        std::shared_ptr<world_type> world(factory.world(edge_lengths));
+        world->set_t(t0);
+        initial.restore(*world);
+
+        std::shared_ptr<simulator_type> sim(factory.simulator(world, model));
+        std::shared_ptr<FixedIntervalNumberObserver>
+            obs(new FixedIntervalNumberObserver(dt, targets));
+        sim->run(duration, obs);
+
+        const NumberLogger::data_container_type& data(obs->logger().data);
+        const Integer num_times(
+            std::min(result.num_times(), static_cast<Integer>(data.size())));
+        for (Integer i(0); i < num_times; ++i)
+        {
+            const std::size_t num_columns(
+                std::min(data[i].size(), static_cast<std::size_t>(result.num_columns())));
+            std::copy(data[i].begin(), data[i].begin() + num_columns, result.row(run, i));
+        }
+    }
+
+protected:
+
+    factory_type factory_;
+    Integer num_threads_;
+};
+
+} // ecell4
+
+#endif /* ECELL4_ENSEMBLE_RUNNER_HPP */
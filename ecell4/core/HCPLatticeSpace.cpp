@@ -49,6 +49,19 @@ void HCPLatticeSpace::set_lattice_properties(const Real3 &edge_lengths,
     row_size_ += 2;
     layer_size_ += 2;
     col_size_ += 2;
+
+    if (layout_ == BLOCKED_LAYOUT)
+    {
+        // voxels in the last blocks beyond borders are never used
+        block_rows_ = (row_size_ + 3) / 4;
+        block_cols_ = (col_size_ + 3) / 4;
+        num_voxels_ = 64 * block_rows_ * block_cols_ * ((layer_size_ + 3) / 4);
+    }
+    else
+    {
+        block_rows_ = block_cols_ = 0;
+        num_voxels_ = row_size_ * col_size_ * layer_size_;
+    }
 }
 
 } // namespace ecell4
@@ -11,10 +11,24 @@ class HCPLatticeSpace : public VoxelSpaceBase
 public:
     typedef VoxelSpaceBase base_type;
 
+    /**
+     * The order of voxels in coordinates. ROW_MAJOR_LAYOUT numbers voxels
+     * row by row, column by column and then layer by layer.
+     * BLOCKED_LAYOUT numbers blocks of 4x4x4 voxels in the same way, and
+     * voxels in a block in the Morton (Z-) order, so that most neighbors of
+     * a voxel are stored close to it.
+     */
+    enum layout_type
+    {
+        ROW_MAJOR_LAYOUT = 0,
+        BLOCKED_LAYOUT = 1
+    };
+
 public:
     HCPLatticeSpace(const Real3 &edge_lengths, const Real &voxel_radius,
-                    const bool is_periodic)
-        : base_type(voxel_radius)
+                    const bool is_periodic,
+                    const layout_type layout = ROW_MAJOR_LAYOUT)
+        : base_type(voxel_radius), layout_(layout)
     {
         set_lattice_properties(edge_lengths, is_periodic);
     }
@@ -47,17 +61,29 @@ public:
 
     virtual const Integer layer_size() const { return layer_size_ - 2; }
 
+    layout_type layout() const { return layout_; }
+
     /**
      Coordinate transformations
      */
     coordinate_type global2coordinate(const Integer3 &global) const
     {
         const Integer3 g(global.col + 1, global.row + 1, global.layer + 1);
+        if (layout_ == BLOCKED_LAYOUT)
+        {
+            return blocked_coordinate_(g);
+        }
         return g.row + row_size_ * (g.col + col_size_ * g.layer);
     }
 
     Integer3 coordinate2global(const coordinate_type &coord) const
     {
+        if (layout_ == BLOCKED_LAYOUT)
+        {
+            const Integer3 g(blocked_global_(coord));
+            return Integer3(g.col - 1, g.row - 1, g.layer - 1);
+        }
+
         const Integer NUM_COLROW(row_size_ * col_size_);
         const Integer LAYER(coord / NUM_COLROW);
         const Integer SURPLUS(coord - LAYER * NUM_COLROW);
@@ -123,6 +149,11 @@ protected:
     coordinate_type get_neighbor_(const coordinate_type &coord,
                                   const Integer &nrand) const
     {
+        if (layout_ == BLOCKED_LAYOUT)
+        {
+            return get_blocked_neighbor_(coord, nrand);
+        }
+
         const Integer NUM_COLROW(col_size_ * row_size_);
         const Integer NUM_ROW(row_size_);
         const bool odd_col(((coord % NUM_COLROW) / NUM_ROW) & 1);
@@ -161,10 +192,101 @@ protected:
         throw NotFound("Invalid argument: nrand");
     }
 
+    /**
+     * the same as get_neighbor_, but in BLOCKED_LAYOUT. The offsets of
+     * neighbors are applied to the global coordinate including borders.
+     */
+    coordinate_type get_blocked_neighbor_(const coordinate_type &coord,
+                                          const Integer &nrand) const
+    {
+        if (!is_inside(coord))
+            throw NotFound("There is no neighbor voxel.");
+
+        Integer3 g(blocked_global_(coord));
+        const Integer odd_col(g.col & 1);
+        const Integer shift((odd_col ^ (g.layer & 1)) - 1);
+
+        switch (nrand)
+        {
+        case 0:
+            g.row -= 1;
+            break;
+        case 1:
+            g.row += 1;
+            break;
+        case 2:
+        case 3:
+            g.col -= 1;
+            g.row += shift + (nrand - 2);
+            break;
+        case 4:
+        case 5:
+            g.col += 1;
+            g.row += shift + (nrand - 4);
+            break;
+        case 6:
+        case 7:
+            g.layer += 1 - 2 * odd_col;
+            g.col += 2 * (nrand - 6) - 1;
+            break;
+        case 8:
+        case 9:
+            g.layer -= 1;
+            g.row += shift + (nrand - 8);
+            break;
+        case 10:
+        case 11:
+            g.layer += 1;
+            g.row += shift + (nrand - 10);
+            break;
+        default:
+            throw NotFound("Invalid argument: nrand");
+        }
+        return blocked_coordinate_(g);
+    }
+
+    /**
+     * convert a global coordinate including borders into a coordinate in
+     * BLOCKED_LAYOUT, and vice versa.
+     */
+    coordinate_type blocked_coordinate_(const Integer3 &g) const
+    {
+        const Integer block(
+            (g.row >> 2) +
+            block_rows_ * ((g.col >> 2) + block_cols_ * (g.layer >> 2)));
+        return (block << 6) | (spread_bits_(g.row & 3)) |
+               (spread_bits_(g.col & 3) << 1) |
+               (spread_bits_(g.layer & 3) << 2);
+    }
+
+    Integer3 blocked_global_(const coordinate_type &coord) const
+    {
+        const Integer NUM_BLOCKS(block_rows_ * block_cols_);
+        const Integer block(coord >> 6);
+        const Integer layer(block / NUM_BLOCKS);
+        const Integer surplus(block - layer * NUM_BLOCKS);
+        const Integer col(surplus / block_rows_);
+        const Integer row(surplus - col * block_rows_);
+        return Integer3((col << 2) | compact_bits_(coord >> 1),
+                        (row << 2) | compact_bits_(coord),
+                        (layer << 2) | compact_bits_(coord >> 2));
+    }
+
+    // interleave two bits as 0b0a00b0 <-> 0bab
+    static Integer spread_bits_(const Integer bits)
+    {
+        return (bits & 1) | ((bits & 2) << 2);
+    }
+
+    static Integer compact_bits_(const Integer bits)
+    {
+        return (bits & 1) | ((bits >> 2) & 2);
+    }
+
 public:
     bool is_in_range(const coordinate_type &coord) const
     {
-        return coord >= 0 && coord < row_size_ * col_size_ * layer_size_;
+        return coord >= 0 && coord < num_voxels_;
     }
 
     virtual bool is_inside(const coordinate_type &coord) const
@@ -175,7 +297,7 @@ public:
                global.layer < layer_size();
     }
 
-    virtual Integer size() const { return row_size_ * col_size_ * layer_size_; }
+    virtual Integer size() const { return num_voxels_; }
 
     virtual Integer3 shape() const
     {
@@ -191,6 +313,12 @@ protected:
     Real3 edge_lengths_;
     Real HCP_L, HCP_X, HCP_Y;
     Integer row_size_, layer_size_, col_size_;
+
+    layout_type layout_;
+    // the number of blocks in a layer of blocks for BLOCKED_LAYOUT
+    Integer block_rows_, block_cols_;
+    // the number of coordinates including unused ones in BLOCKED_LAYOUT
+    Integer num_voxels_;
 };
 
 } // namespace ecell4
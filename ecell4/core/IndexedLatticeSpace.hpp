@@ -0,0 +1,588 @@
+#ifndef ECELL4_INDEXED_LATTICE_SPACE_HPP
+#define ECELL4_INDEXED_LATTICE_SPACE_HPP
+
+#include "HCPLatticeSpace.hpp"
+#include "MoleculePool.hpp"
+#include "VoxelPoolTable.hpp"
+
+namespace ecell4
+{
+
+/**
+ * IndexedLatticeSpace stores the pool occupying each voxel as an index
+ * into a VoxelPoolTable, and implements the voxel manipulation on top of
+ * the storage of the indices, which is given by the derived class Tderived_
+ * as the following members:
+ *
+ *   pool_index_type index_at(const coordinate_type& coord) const;
+ *   void set_index_at(const coordinate_type& coord, pool_index_type index);
+ *   // list the coordinates of the index in ascending order
+ *   void coords_of(pool_index_type index,
+ *                  std::vector<coordinate_type>& coords) const;
+ *   // store the vacant, border and periodic voxels
+ *   void initialize_voxels();
+ *
+ * They are called without a virtual function call.
+ */
+template <typename Tderived_>
+class IndexedLatticeSpace : public HCPLatticeSpace
+{
+public:
+    typedef HCPLatticeSpace base_type;
+    typedef VoxelPoolTable::index_type pool_index_type;
+
+public:
+    IndexedLatticeSpace(const Real3 &edge_lengths, const Real &voxel_radius,
+                        const bool is_periodic,
+                        const layout_type layout = ROW_MAJOR_LAYOUT)
+        : base_type(edge_lengths, voxel_radius, is_periodic, layout),
+          is_periodic_(is_periodic)
+    {
+        border_ = std::shared_ptr<VoxelPool>(
+            new MoleculePool(Species("Border", voxel_radius_, 0), vacant_));
+        periodic_ = std::shared_ptr<VoxelPool>(
+            new MoleculePool(Species("Periodic", voxel_radius, 0), vacant_));
+    }
+
+    virtual ~IndexedLatticeSpace() {}
+
+    /*
+     * Space APIs
+     *
+     * using ParticleID, Species and Posision3
+     */
+
+    Integer num_species() const
+    {
+        return voxel_pools_.size() + molecule_pools_.size();
+    }
+
+    bool remove_voxel(const ParticleID &pid);
+    bool remove_voxel(const coordinate_type &coord);
+
+    bool update_structure(const Particle &p)
+    {
+        return update_voxel(ParticleID(), p.species(),
+                            position2coordinate(p.position()));
+    }
+
+    /*
+     * for Simulator
+     *
+     * using Species and coordinate_type
+     */
+    std::vector<VoxelView> list_voxels() const;
+    std::vector<VoxelView> list_voxels(const Species &sp) const;
+    std::vector<VoxelView> list_voxels_exact(const Species &sp) const;
+
+    bool update_voxel(const ParticleID &pid, const Species &species,
+                      const coordinate_type coordinate);
+    bool add_voxel(const Species &species, const ParticleID &pid,
+                   const coordinate_type &coord);
+
+    bool add_voxels(const Species &species,
+                    std::vector<std::pair<ParticleID, coordinate_type>> voxels);
+
+    const Species &find_species(std::string name) const;
+    std::vector<coordinate_type> list_coords(const Species &sp) const;
+    std::vector<coordinate_type> list_coords_exact(const Species &sp) const;
+
+    std::shared_ptr<VoxelPool>
+    get_voxel_pool_at(const coordinate_type &coord) const
+    {
+        return pools_[derived().index_at(coord)];
+    }
+
+    bool find_pool_index_at(const coordinate_type &coord,
+                            std::size_t &index) const
+    {
+        index = derived().index_at(coord);
+        return true;
+    }
+
+    bool move(const coordinate_type &src, const coordinate_type &dest,
+              const std::size_t candidate = 0);
+    bool can_move(const coordinate_type &src,
+                  const coordinate_type &dest) const;
+
+    coordinate_type get_neighbor(const coordinate_type &coord,
+                                 const Integer &nrand) const
+    {
+        coordinate_type const dest = get_neighbor_(coord, nrand);
+
+        if (derived().index_at(dest) != PERIODIC_INDEX)
+        {
+            return dest;
+        }
+        else
+        {
+            return periodic_transpose(dest);
+        }
+    }
+
+    bool is_periodic() const { return is_periodic_; }
+
+    void reset(const Real3 &edge_lengths, const Real &voxel_radius,
+               const bool is_periodic)
+    {
+        base_type::reset(edge_lengths, voxel_radius, is_periodic);
+
+        is_periodic_ = is_periodic;
+        initialize_pools();
+        derived().initialize_voxels();
+    }
+
+protected:
+    // the fixed entries of pools_
+    enum
+    {
+        VACANT_INDEX = 0,
+        BORDER_INDEX = 1,
+        PERIODIC_INDEX = 2
+    };
+
+    const Tderived_ &derived() const
+    {
+        return *static_cast<const Tderived_ *>(this);
+    }
+
+    Tderived_ &derived() { return *static_cast<Tderived_ *>(this); }
+
+    /**
+     * forget all pools, and register the fixed ones.
+     */
+    void initialize_pools()
+    {
+        voxel_pools_.clear();
+        molecule_pools_.clear();
+
+        pools_.clear();
+        pools_.index(vacant_);   // VACANT_INDEX
+        pools_.index(border_);   // BORDER_INDEX
+        pools_.index(periodic_); // PERIODIC_INDEX
+    }
+
+    /**
+     * append the voxels occupied by the pool, which has no ParticleID.
+     */
+    void push_voxels_of(const std::shared_ptr<VoxelPool> &pool,
+                        std::vector<VoxelView> &retval) const;
+
+    coordinate_type get_coord(const ParticleID &pid) const;
+
+protected:
+    bool is_periodic_;
+
+    VoxelPoolTable pools_;
+
+    std::shared_ptr<VoxelPool> border_;
+    std::shared_ptr<VoxelPool> periodic_;
+};
+
+template <typename Tderived_>
+void IndexedLatticeSpace<Tderived_>::push_voxels_of(
+    const std::shared_ptr<VoxelPool> &pool,
+    std::vector<VoxelView> &retval) const
+{
+    pool_index_type index;
+    if (!pools_.find(pool, index))
+    {
+        return; // no voxel has been occupied by the pool
+    }
+
+    std::vector<coordinate_type> coords;
+    derived().coords_of(index, coords);
+
+    const Species &sp(pool->species());
+    for (const auto &coord : coords)
+    {
+        retval.push_back(VoxelView(ParticleID(), sp, coord));
+    }
+}
+
+/*
+ * original methods
+ */
+
+template <typename Tderived_>
+const Species &
+IndexedLatticeSpace<Tderived_>::find_species(std::string name) const
+{
+    for (const auto &pool : voxel_pools_)
+    {
+        if (pool.first.serial() == name)
+        {
+            return pool.first;
+        }
+    }
+
+    for (const auto &pool : molecule_pools_)
+    {
+        if (pool.first.serial() == name)
+        {
+            return pool.first;
+        }
+    }
+    throw NotFound(name);
+}
+
+template <typename Tderived_>
+std::vector<VoxelSpaceBase::coordinate_type>
+IndexedLatticeSpace<Tderived_>::list_coords_exact(const Species &sp) const
+{
+    std::vector<coordinate_type> retval;
+
+    molecule_pool_map_type::const_iterator itr(molecule_pools_.find(sp));
+    if (itr == molecule_pools_.end())
+    {
+        return retval;
+    }
+
+    const std::shared_ptr<MoleculePool> &vp((*itr).second);
+
+    for (const auto &voxel : *vp)
+    {
+        retval.push_back(voxel.coordinate);
+    }
+    return retval;
+}
+
+template <typename Tderived_>
+std::vector<VoxelSpaceBase::coordinate_type>
+IndexedLatticeSpace<Tderived_>::list_coords(const Species &sp) const
+{
+    std::vector<coordinate_type> retval;
+    for (const auto &pool : molecule_pools_)
+    {
+        if (!SpeciesExpressionMatcher(sp).match(pool.first))
+        {
+            continue;
+        }
+
+        const std::shared_ptr<MoleculePool> &vp(pool.second);
+
+        for (const auto &voxel : *vp)
+        {
+            retval.push_back(voxel.coordinate);
+        }
+    }
+    return retval;
+}
+
+template <typename Tderived_>
+std::vector<VoxelView> IndexedLatticeSpace<Tderived_>::list_voxels() const
+{
+    std::vector<VoxelView> retval;
+
+    for (const auto &pool : molecule_pools_)
+    {
+        const std::shared_ptr<MoleculePool> &vp(pool.second);
+        const Species &sp(vp->species());
+
+        for (const auto &voxel : *vp)
+        {
+            retval.push_back(VoxelView(voxel.pid, sp, voxel.coordinate));
+        }
+    }
+
+    for (const auto &pool : voxel_pools_)
+    {
+        push_voxels_of(pool.second, retval);
+    }
+    return retval;
+}
+
+template <typename Tderived_>
+std::vector<VoxelView>
+IndexedLatticeSpace<Tderived_>::list_voxels_exact(const Species &sp) const
+{
+    std::vector<VoxelView> retval;
+
+    {
+        voxel_pool_map_type::const_iterator itr(voxel_pools_.find(sp));
+        if (itr != voxel_pools_.end())
+        {
+            push_voxels_of((*itr).second, retval);
+            return retval;
+        }
+    }
+
+    {
+        molecule_pool_map_type::const_iterator itr(molecule_pools_.find(sp));
+        if (itr != molecule_pools_.end())
+        {
+            const std::shared_ptr<MoleculePool> &vp((*itr).second);
+            for (const auto &voxel : *vp)
+            {
+                retval.push_back(VoxelView(voxel.pid, sp, voxel.coordinate));
+            }
+            return retval;
+        }
+    }
+    return retval; // an empty vector
+}
+
+template <typename Tderived_>
+std::vector<VoxelView>
+IndexedLatticeSpace<Tderived_>::list_voxels(const Species &sp) const
+{
+    std::vector<VoxelView> retval;
+    SpeciesExpressionMatcher sexp(sp);
+
+    for (const auto &pool : voxel_pools_)
+    {
+        if (!sexp.match(pool.first))
+        {
+            continue;
+        }
+
+        push_voxels_of(pool.second, retval);
+    }
+
+    for (const auto &pool : molecule_pools_)
+    {
+        if (!sexp.match(pool.first))
+        {
+            continue;
+        }
+
+        const std::shared_ptr<MoleculePool> &vp(pool.second);
+        const Species &sp(vp->species());
+        for (const auto &voxel : *vp)
+        {
+            retval.push_back(VoxelView(voxel.pid, sp, voxel.coordinate));
+        }
+    }
+
+    return retval;
+}
+
+/*
+ * Protected functions
+ */
+
+template <typename Tderived_>
+VoxelSpaceBase::coordinate_type
+IndexedLatticeSpace<Tderived_>::get_coord(const ParticleID &pid) const
+{
+    for (const auto &pool : molecule_pools_)
+    {
+        const std::shared_ptr<MoleculePool> &vp(pool.second);
+        for (const auto &voxel : *vp)
+        {
+            if (voxel.pid == pid)
+            {
+                return voxel.coordinate;
+            }
+        }
+    }
+    return -1; // XXX: a bit dirty way
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::remove_voxel(const ParticleID &pid)
+{
+    for (const auto &pool : molecule_pools_)
+    {
+        const std::shared_ptr<MoleculePool> &vp(pool.second);
+        MoleculePool::const_iterator j(vp->find(pid));
+        if (j != vp->end())
+        {
+            const coordinate_type coord((*j).coordinate);
+            if (!vp->remove_voxel_if_exists(coord))
+            {
+                return false;
+            }
+
+            const std::shared_ptr<VoxelPool> location(vp->location());
+            derived().set_index_at(coord, pools_.index(location));
+            location->add_voxel(coordinate_id_pair_type(ParticleID(), coord));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::remove_voxel(const coordinate_type &coord)
+{
+    const std::shared_ptr<VoxelPool> &vp(pools_[derived().index_at(coord)]);
+    if (auto location_ptr = vp->location())
+    {
+        if (vp->remove_voxel_if_exists(coord))
+        {
+            derived().set_index_at(coord, pools_.index(location_ptr));
+            location_ptr->add_voxel(
+                coordinate_id_pair_type(ParticleID(), coord));
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::can_move(
+    const coordinate_type &src, const coordinate_type &dest) const
+{
+    if (src == dest)
+        return false;
+
+    const pool_index_type src_index(derived().index_at(src));
+    if (pools_[src_index]->is_vacant())
+        return false;
+
+    pool_index_type dest_index(derived().index_at(dest));
+
+    if (dest_index == BORDER_INDEX)
+        return false;
+
+    if (dest_index == PERIODIC_INDEX)
+        dest_index = derived().index_at(periodic_transpose(dest));
+
+    return (dest_index == pools_.location_index(src_index));
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::move(const coordinate_type &src,
+                                          const coordinate_type &dest,
+                                          const std::size_t candidate)
+{
+    if (src == dest)
+    {
+        return false;
+    }
+
+    const pool_index_type from_index(derived().index_at(src));
+    VoxelPool *from_vp(pools_[from_index].get());
+    if (from_vp->is_vacant())
+    {
+        return true;
+    }
+
+    coordinate_type to(dest);
+    pool_index_type to_index(derived().index_at(to));
+
+    if (to_index == BORDER_INDEX)
+    {
+        return false;
+    }
+    else if (to_index == PERIODIC_INDEX)
+    {
+        to = periodic_transpose(to);
+        to_index = derived().index_at(to);
+    }
+
+    if (to_index != pools_.location_index(from_index))
+    {
+        return false;
+    }
+
+    VoxelPool *to_vp(pools_[to_index].get());
+
+    from_vp->replace_voxel(src, to, candidate);
+    derived().set_index_at(src, to_index);
+
+    to_vp->replace_voxel(to, src);
+    derived().set_index_at(to, from_index);
+
+    return true;
+}
+
+/*
+ * Change the Species and coordinate of a Voxel with ParticleID, pid, to
+ * species and coordinate respectively and return false.
+ * If no Voxel with pid is found, create a new Voxel at
+ * coordiante() and return true.
+ */
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::update_voxel(
+    const ParticleID &pid, const Species &species,
+    const coordinate_type to_coord)
+{
+    if (!is_in_range(to_coord))
+    {
+        throw NotSupported("Out of bounds");
+    }
+
+    std::shared_ptr<VoxelPool> new_vp(
+        find_voxel_pool(species)); // XXX: need MoleculeInfo
+    std::shared_ptr<VoxelPool> dest_vp(get_voxel_pool_at(to_coord));
+
+    if (dest_vp != new_vp->location())
+    {
+        throw NotSupported("Mismatch in the location. Failed to place '" +
+                           new_vp->species().serial() + "' to '" +
+                           dest_vp->species().serial() + "'.");
+    }
+
+    const coordinate_type from_coord(pid != ParticleID() ? get_coord(pid) : -1);
+    if (from_coord != -1)
+    {
+        // move
+        get_voxel_pool_at(from_coord)->remove_voxel_if_exists(from_coord);
+
+        // XXX: use location?
+        dest_vp->replace_voxel(to_coord, from_coord);
+        derived().set_index_at(from_coord, derived().index_at(to_coord));
+
+        new_vp->add_voxel(coordinate_id_pair_type(pid, to_coord));
+        derived().set_index_at(to_coord, pools_.index(new_vp));
+        return false;
+    }
+
+    // new
+    dest_vp->remove_voxel_if_exists(to_coord);
+
+    new_vp->add_voxel(coordinate_id_pair_type(pid, to_coord));
+    derived().set_index_at(to_coord, pools_.index(new_vp));
+    return true;
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::add_voxel(
+    const Species &sp, const ParticleID &pid, const coordinate_type &coordinate)
+{
+    std::shared_ptr<VoxelPool> vpool(find_voxel_pool(sp));
+    std::shared_ptr<VoxelPool> location(get_voxel_pool_at(coordinate));
+
+    if (vpool->location() != location)
+        return false;
+
+    location->remove_voxel_if_exists(coordinate);
+    vpool->add_voxel(coordinate_id_pair_type(pid, coordinate));
+    derived().set_index_at(coordinate, pools_.index(vpool));
+
+    return true;
+}
+
+template <typename Tderived_>
+bool IndexedLatticeSpace<Tderived_>::add_voxels(
+    const Species &sp,
+    std::vector<std::pair<ParticleID, coordinate_type>> voxels)
+{
+    // this function doesn't check location.
+    std::shared_ptr<VoxelPool> mtb;
+    try
+    {
+        mtb = find_voxel_pool(sp);
+    }
+    catch (NotFound &e)
+    {
+        return false;
+    }
+
+    const pool_index_type index(pools_.index(mtb));
+    for (const auto &voxel : voxels)
+    {
+        const ParticleID pid(voxel.first);
+        const coordinate_type coord(voxel.second);
+        get_voxel_pool_at(coord)->remove_voxel_if_exists(coord);
+        mtb->add_voxel(coordinate_id_pair_type(pid, coord));
+        derived().set_index_at(coord, index);
+    }
+    return true;
+}
+
+} // namespace ecell4
+
+#endif /* ECELL4_INDEXED_LATTICE_SPACE_HPP */
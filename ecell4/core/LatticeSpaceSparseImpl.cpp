@@ -0,0 +1,48 @@
+#include <algorithm>
+
+#include "Context.hpp"
+#include "LatticeSpaceSparseImpl.hpp"
+#include "MoleculePool.hpp"
+#include "StructureType.hpp"
+#include "VacantType.hpp"
+
+namespace ecell4
+{
+
+typedef LatticeSpaceSparseImpl::coordinate_type coordinate_type;
+
+LatticeSpaceSparseImpl::LatticeSpaceSparseImpl(const Real3 &edge_lengths,
+                                               const Real &voxel_radius,
+                                               const bool is_periodic)
+    : base_type(edge_lengths, voxel_radius, is_periodic)
+{
+    initialize_pools();
+    initialize_voxels();
+}
+
+LatticeSpaceSparseImpl::~LatticeSpaceSparseImpl() {}
+
+void LatticeSpaceSparseImpl::initialize_voxels()
+{
+    // neither vacant voxels nor borders are stored, and only counted.
+    // vacant_ is always a VacantType.
+    voxels_.clear();
+    std::static_pointer_cast<StructureType>(vacant_)->set_size(actual_size());
+}
+
+void LatticeSpaceSparseImpl::coords_of(
+    const pool_index_type index, std::vector<coordinate_type> &coords) const
+{
+    // the order of a hash table is not fixed, but of coordinates
+    const std::size_t offset(coords.size());
+    for (const auto &voxel : voxels_)
+    {
+        if (voxel.second == index)
+        {
+            coords.push_back(voxel.first);
+        }
+    }
+    std::sort(coords.begin() + offset, coords.end());
+}
+
+} // namespace ecell4
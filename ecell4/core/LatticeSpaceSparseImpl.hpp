@@ -0,0 +1,92 @@
+#ifndef ECELL4_LATTICE_SPACE_SPARSE_IMPL_HPP
+#define ECELL4_LATTICE_SPACE_SPARSE_IMPL_HPP
+
+#include <unordered_map>
+
+#include "IndexedLatticeSpace.hpp"
+
+namespace ecell4
+{
+
+/**
+ * LatticeSpaceSparseImpl stores only voxels occupied by molecules or
+ * structures, as a hash table from a coordinate to the index of a pool.
+ * Any other voxel inside the lattice is vacant, and any voxel outside is a
+ * border or periodic one. Thus the memory scales with the number of
+ * non-vacant voxels, not with the volume, at the cost of a hash lookup for
+ * each access. Coordinates are the same as in LatticeSpaceVectorImpl.
+ */
+class LatticeSpaceSparseImpl
+    : public IndexedLatticeSpace<LatticeSpaceSparseImpl>
+{
+public:
+    typedef IndexedLatticeSpace<LatticeSpaceSparseImpl> base_type;
+    typedef base_type::pool_index_type pool_index_type;
+    typedef std::unordered_map<coordinate_type, pool_index_type>
+        voxel_container;
+
+public:
+    LatticeSpaceSparseImpl(const Real3 &edge_lengths, const Real &voxel_radius,
+                           const bool is_periodic = true);
+    ~LatticeSpaceSparseImpl();
+
+    /**
+     * return the number of voxels stored, i.e. non-vacant voxels inside.
+     */
+    std::size_t num_stored_voxels() const { return voxels_.size(); }
+
+#ifdef WITH_HDF5
+    /*
+     * HDF5 Save
+     */
+    void save_hdf5(H5::Group *root) const
+    {
+        save_lattice_space(*this, root, "LatticeSpaceSparseImpl");
+    }
+
+    void load_hdf5(const H5::Group &root) { load_lattice_space(root, this); }
+#endif
+
+protected:
+    friend class IndexedLatticeSpace<LatticeSpaceSparseImpl>;
+
+    pool_index_type index_at(const coordinate_type &coord) const
+    {
+        const voxel_container::const_iterator itr(voxels_.find(coord));
+        if (itr != voxels_.end())
+        {
+            return (*itr).second;
+        }
+
+        if (!is_inside(coord))
+        {
+            return is_periodic_ ? PERIODIC_INDEX : BORDER_INDEX;
+        }
+        return VACANT_INDEX;
+    }
+
+    void set_index_at(const coordinate_type &coord,
+                      const pool_index_type index)
+    {
+        if (index == VACANT_INDEX)
+        {
+            voxels_.erase(coord);
+        }
+        else
+        {
+            voxels_[coord] = index;
+        }
+    }
+
+    void coords_of(const pool_index_type index,
+                   std::vector<coordinate_type> &coords) const;
+
+    void initialize_voxels();
+
+protected:
+    voxel_container voxels_;
+};
+
+} // namespace ecell4
+
+#endif /* ECELL4_LATTICE_SPACE_SPARSE_IMPL_HPP */
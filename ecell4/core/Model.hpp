@@ -57,6 +57,16 @@ public:
         return false;
     }
 
+    /**
+     * a counter incremented at every modification of the species
+     * attributes or the reaction rules, e.g. for a simulator to tell if
+     * the model changed since it was compiled.
+     */
+    virtual Integer revision() const
+    {
+        return 0;
+    }
+
     virtual bool update_species_attribute(const Species& sp)
     {
         throw NotSupported(
@@ -17,7 +17,8 @@ public:
 
 public:
     MoleculePool(const Species &species, std::weak_ptr<VoxelPool> location)
-        : base_type(species, location)
+        : base_type(species, location), sweeping_(false), sweep_visited_(0),
+          sweep_end_(0)
     {
         ;
     }
@@ -70,11 +71,84 @@ public:
 public:
     void remove_voxel(const container_type::iterator &position)
     {
+        if (sweeping_)
+        {
+            // keep the visited, unvisited and added voxels partitioned by
+            // moving the hole across the boundaries to the back.
+            std::size_t hole(std::distance(voxels_.begin(), position));
+            if (hole < sweep_visited_)
+            {
+                --sweep_visited_;
+                voxels_[hole] = voxels_[sweep_visited_];
+                hole = sweep_visited_;
+            }
+            if (hole < sweep_end_)
+            {
+                --sweep_end_;
+                voxels_[hole] = voxels_[sweep_end_];
+                hole = sweep_end_;
+            }
+            voxels_[hole] = voxels_.back();
+            voxels_.pop_back();
+            return;
+        }
+
         // voxels_.erase(position);
         (*position) = voxels_.back();
         voxels_.pop_back();
     }
 
+    /**
+     * Start a sweep, which visits every voxel in the pool at this moment
+     * exactly once with next_in_sweep(). Voxels can be moved, added and
+     * removed during the sweep without copying the pool. A voxel added is
+     * not visited, and a voxel removed before its turn is not visited either.
+     */
+    void begin_sweep()
+    {
+        sweeping_ = true;
+        sweep_visited_ = 0;
+        sweep_end_ = voxels_.size();
+    }
+
+    /**
+     * Give the index of the next voxel in the sweep, or return false when
+     * the sweep is over. The index is valid until the next removal.
+     */
+    bool next_in_sweep(std::size_t &index)
+    {
+        if (sweep_visited_ >= sweep_end_)
+        {
+            end_sweep();
+            return false;
+        }
+        index = sweep_visited_++;
+        return true;
+    }
+
+    void end_sweep() { sweeping_ = false; }
+
+    bool is_sweeping() const { return sweeping_; }
+
+    /**
+     * sweep_guard begins a sweep, and ends it when going out of scope, so
+     * that an exception thrown during the sweep does not leave the pool
+     * sweeping.
+     */
+    class sweep_guard
+    {
+    public:
+        sweep_guard(MoleculePool &pool) : pool_(pool) { pool_.begin_sweep(); }
+
+        ~sweep_guard() { pool_.end_sweep(); }
+
+    private:
+        sweep_guard(const sweep_guard &);
+        sweep_guard &operator=(const sweep_guard &);
+
+        MoleculePool &pool_;
+    };
+
     coordinate_id_pair_type pop(const coordinate_type &coord)
     {
         container_type::iterator position(this->find(coord));
@@ -206,6 +280,11 @@ protected:
 
 protected:
     container_type voxels_;
+
+    // voxels_[0, sweep_visited_) are visited in the current sweep, and
+    // voxels_[sweep_end_, size) are added during it.
+    bool sweeping_;
+    std::size_t sweep_visited_, sweep_end_;
 };
 
 } // namespace ecell4
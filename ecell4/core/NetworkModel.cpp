@@ -16,6 +16,7 @@ bool NetworkModel::update_species_attribute(const Species& sp)
         return true;
     }
     (*i).overwrite_attributes(sp);
+    ++revision_;
     return false;
 }
 
@@ -23,6 +24,7 @@ void NetworkModel::add_species_attribute(const Species& sp, const bool proceed)
 {
     species_attributes_.push_back(sp);
     species_attributes_proceed_.push_back(proceed);
+    ++revision_;
 }
 
 void NetworkModel::remove_species_attribute(const Species& sp)
@@ -35,6 +37,7 @@ void NetworkModel::remove_species_attribute(const Species& sp)
     species_attributes_proceed_.erase(
         species_attributes_proceed_.begin() + std::distance(species_attributes_.begin(), i));
     species_attributes_.erase(i);
+    ++revision_;
 }
 
 bool NetworkModel::has_species_attribute(const Species& sp) const
@@ -133,6 +136,8 @@ std::vector<ReactionRule> NetworkModel::apply(
 
 void NetworkModel::add_reaction_rule(const ReactionRule& rr)
 {
+    ++revision_;
+
     if (rr.has_descriptor())
     {
         reaction_rules_.push_back(rr);
@@ -278,6 +283,7 @@ void NetworkModel::remove_reaction_rule(const NetworkModel::reaction_rule_contai
     }
 
     reaction_rules_.pop_back();
+    ++revision_;
 }
 
 bool NetworkModel::has_reaction_rule(const ReactionRule& rr) const
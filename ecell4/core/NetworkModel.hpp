@@ -40,7 +40,7 @@ public:
 
     NetworkModel()
         : base_type(), species_attributes_(), species_attributes_proceed_(), reaction_rules_(),
-        first_order_reaction_rules_map_(), second_order_reaction_rules_map_()
+        first_order_reaction_rules_map_(), second_order_reaction_rules_map_(), revision_(0)
     {
         ;
     }
@@ -88,6 +88,11 @@ public:
         return true;
     }
 
+    Integer revision() const
+    {
+        return revision_;
+    }
+
     bool update_species_attribute(const Species& sp);
     void add_species_attribute(const Species& sp, const bool proceed = false);
     bool has_species_attribute(const Species& sp) const;
@@ -124,6 +129,8 @@ protected:
 
     first_order_reaction_rules_map_type first_order_reaction_rules_map_;
     second_order_reaction_rules_map_type second_order_reaction_rules_map_;
+
+    Integer revision_;
 };
 
 } // ecell4
@@ -1,18 +1,23 @@
 #include "Context.hpp"
 #include "MoleculePool.hpp"
 #include "OffLatticeSpace.hpp"
+#include "Polygon.hpp"
 #include "VacantType.hpp"
 #include <algorithm>
+#include <cmath>
+#include <numeric>
 
 namespace ecell4
 {
 
 OffLatticeSpace::OffLatticeSpace(const Real &voxel_radius,
                                  const Species &species)
-    : base_type(voxel_radius), voxels_(), positions_(), adjoinings_()
+    : base_type(voxel_radius), voxels_(), positions_(),
+      adjoining_offsets_(1, 0), adjoinings_()
 {
     vacant_ = std::shared_ptr<VoxelPool>(
         new StructureType(species, std::weak_ptr<VoxelPool>()));
+    initialize_voxels(0);
 }
 
 OffLatticeSpace::OffLatticeSpace(
@@ -26,44 +31,182 @@ OffLatticeSpace::OffLatticeSpace(
     reset(positions, adjoining_pairs);
 }
 
+OffLatticeSpace::OffLatticeSpace(const Real &voxel_radius,
+                                 const Species &species,
+                                 const Polygon &polygon)
+    : base_type(voxel_radius), voxels_(), positions_(), adjoinings_(),
+      edge_lengths_(polygon.edge_lengths())
+{
+    vacant_ = std::shared_ptr<VoxelPool>(
+        new StructureType(species, std::weak_ptr<VoxelPool>()));
+
+    const std::vector<VertexID> vids(polygon.list_vertex_ids());
+    std::unordered_map<VertexID, coordinate_type> coords;
+    position_container positions;
+    positions.reserve(vids.size());
+    for (const auto &vid : vids)
+    {
+        coords.insert(std::make_pair(vid, positions.size()));
+        positions.push_back(polygon.position_at(vid));
+    }
+
+    // each edge is listed in both directions
+    coordinate_pair_list_type adjoining_pairs;
+    adjoining_pairs.reserve(polygon.edge_size() / 2);
+    for (const auto &eid : polygon.list_edge_ids())
+    {
+        const coordinate_type from(
+            coords.at(polygon.target_of(polygon.opposite_of(eid))));
+        const coordinate_type to(coords.at(polygon.target_of(eid)));
+        if (from < to)
+        {
+            adjoining_pairs.push_back(std::make_pair(from, to));
+        }
+    }
+
+    reset(positions, adjoining_pairs);
+}
+
 OffLatticeSpace::~OffLatticeSpace() {}
 
+void OffLatticeSpace::initialize_voxels(const std::size_t size)
+{
+    pools_.clear();
+    pools_.index(vacant_); // VACANT_INDEX
+
+    voxels_.assign(size, VACANT_INDEX);
+    for (coordinate_type coord(0); coord < static_cast<Integer>(size); ++coord)
+    {
+        vacant_->add_voxel(coordinate_id_pair_type(ParticleID(), coord));
+    }
+}
+
 void OffLatticeSpace::reset(const position_container &positions,
                             const coordinate_pair_list_type &adjoining_pairs)
 {
-    voxels_.clear();
-    positions_.clear();
-    adjoinings_.clear();
-
     const std::size_t size(positions.size());
 
-    voxels_.resize(size, vacant_);
-    positions_.resize(size);
-    adjoinings_.resize(size);
+    initialize_voxels(size);
+    positions_.assign(positions.begin(), positions.end());
 
-    for (coordinate_type coord(0); coord < static_cast<Integer>(size); ++coord)
+    // count the neighbors of each voxel first to fill rows in place
+    adjoining_offsets_.assign(size + 1, 0);
+    for (const auto &pair : adjoining_pairs)
     {
-        vacant_->add_voxel(coordinate_id_pair_type(ParticleID(), coord));
+        if (!is_in_range(pair.first) || !is_in_range(pair.second))
+        {
+            throw IllegalState("A given pair is invalid.");
+        }
+
+        ++adjoining_offsets_[pair.first + 1];
+        ++adjoining_offsets_[pair.second + 1];
+    }
+    std::partial_sum(adjoining_offsets_.begin(), adjoining_offsets_.end(),
+                     adjoining_offsets_.begin());
+
+    adjoinings_.resize(adjoining_offsets_.back());
+    std::vector<std::size_t> ends(adjoining_offsets_.begin(),
+                                  adjoining_offsets_.end() - 1);
+    for (const auto &pair : adjoining_pairs)
+    {
+        adjoinings_[ends[pair.first]++] = pair.second;
+        adjoinings_[ends[pair.second]++] = pair.first;
     }
+}
 
-    std::copy(positions.begin(), positions.end(), positions_.begin());
+OffLatticeSpace::coordinate_pair_list_type
+OffLatticeSpace::find_adjoining_pairs(const position_container &positions,
+                                      const Real &distance)
+{
+    coordinate_pair_list_type retval;
+    if (positions.empty())
+    {
+        return retval;
+    }
+
+    if (!(distance > 0))
+    {
+        throw IllegalArgument("The distance must be positive.");
+    }
 
-    for (coordinate_pair_list_type::const_iterator itr(adjoining_pairs.begin());
-         itr != adjoining_pairs.end(); ++itr)
+    Real3 lower(positions.front());
+    for (const auto &position : positions)
     {
-        const coordinate_type coord0((*itr).first);
-        const coordinate_type coord1((*itr).second);
+        for (std::size_t i(0); i < 3; ++i)
+        {
+            lower[i] = std::min(lower[i], position[i]);
+        }
+    }
 
-        if (is_in_range(coord0) && is_in_range(coord1))
+    // a cell is packed into 21 bits for each axis
+    const Integer MAX_CELL((1 << 21) - 1);
+    const auto cell_of = [&](const Real3 &position) {
+        Integer3 cell;
+        for (std::size_t i(0); i < 3; ++i)
         {
-            adjoinings_.at(coord0).push_back(coord1);
-            adjoinings_.at(coord1).push_back(coord0);
+            cell[i] = static_cast<Integer>(
+                std::floor((position[i] - lower[i]) / distance));
+            if (cell[i] >= MAX_CELL)
+            {
+                throw NotSupported(
+                    "Too many cells to find adjoining pairs of positions.");
+            }
         }
-        else
+        return cell;
+    };
+    const auto key_of = [](const Integer3 &cell) {
+        return (static_cast<std::uint64_t>(cell[0]) << 42) |
+               (static_cast<std::uint64_t>(cell[1]) << 21) |
+               static_cast<std::uint64_t>(cell[2]);
+    };
+
+    const std::size_t size(positions.size());
+    std::vector<std::pair<std::uint64_t, coordinate_type>> cells;
+    cells.reserve(size);
+    for (std::size_t i(0); i < size; ++i)
+    {
+        cells.push_back(std::make_pair(key_of(cell_of(positions[i])), i));
+    }
+    std::sort(cells.begin(), cells.end());
+
+    std::vector<coordinate_type> neighbors;
+    for (std::size_t i(0); i < size; ++i)
+    {
+        neighbors.clear();
+
+        const Integer3 cell(cell_of(positions[i]));
+        for (Integer dx(-1); dx <= 1; ++dx)
+            for (Integer dy(-1); dy <= 1; ++dy)
+                for (Integer dz(-1); dz <= 1; ++dz)
+                {
+                    const Integer3 other(cell[0] + dx, cell[1] + dy,
+                                         cell[2] + dz);
+                    if (other[0] < 0 || other[1] < 0 || other[2] < 0)
+                    {
+                        continue;
+                    }
+
+                    const std::uint64_t key(key_of(other));
+                    for (auto itr(std::lower_bound(
+                             cells.begin(), cells.end(),
+                             std::make_pair(key, coordinate_type(i + 1))));
+                         itr != cells.end() && (*itr).first == key; ++itr)
+                    {
+                        const coordinate_type j((*itr).second);
+                        if (length(positions[j] - positions[i]) <= distance)
+                        {
+                            neighbors.push_back(j);
+                        }
+                    }
+                }
+
+        std::sort(neighbors.begin(), neighbors.end());
+        for (const auto &j : neighbors)
         {
-            throw IllegalState("A given pair is invalid.");
+            retval.push_back(std::make_pair(i, j));
         }
     }
+    return retval;
 }
 
 boost::optional<OffLatticeSpace::coordinate_type>
@@ -114,14 +257,14 @@ bool OffLatticeSpace::update_voxel(const ParticleID &pid,
     if (boost::optional<coordinate_type> from_coord = get_coord(pid))
     {
         // move
-        voxels_.at(*from_coord)->remove_voxel_if_exists(*from_coord);
+        get_voxel_pool_at(*from_coord)->remove_voxel_if_exists(*from_coord);
 
         // XXX: use location?
         dest_vp->replace_voxel(to_coord, *from_coord);
-        voxels_.at(*from_coord) = dest_vp;
+        voxels_.at(*from_coord) = voxels_.at(to_coord);
 
         new_vp->add_voxel(coordinate_id_pair_type(pid, to_coord));
-        voxels_.at(to_coord) = new_vp;
+        voxels_.at(to_coord) = pools_.index(new_vp);
 
         return false;
     }
@@ -130,7 +273,7 @@ bool OffLatticeSpace::update_voxel(const ParticleID &pid,
     dest_vp->remove_voxel_if_exists(to_coord);
 
     new_vp->add_voxel(coordinate_id_pair_type(pid, to_coord));
-    voxels_.at(to_coord) = new_vp;
+    voxels_.at(to_coord) = pools_.index(new_vp);
 
     return true;
 }
@@ -146,7 +289,7 @@ bool OffLatticeSpace::add_voxel(const Species &species, const ParticleID &pid,
 
     location->remove_voxel_if_exists(coord);
     vpool->add_voxel(coordinate_id_pair_type(pid, coord));
-    voxels_.at(coord) = vpool;
+    voxels_.at(coord) = pools_.index(vpool);
 
     return true;
 }
@@ -167,7 +310,7 @@ bool OffLatticeSpace::remove_voxel(const ParticleID &pid)
                 return false;
             }
 
-            voxels_.at(coord) = vp->location();
+            voxels_.at(coord) = pools_.index(vp->location());
 
             vp->location()->add_voxel(
                 coordinate_id_pair_type(ParticleID(), coord));
@@ -180,12 +323,12 @@ bool OffLatticeSpace::remove_voxel(const ParticleID &pid)
 // Same as LatticeSpaceVectorImpl
 bool OffLatticeSpace::remove_voxel(const coordinate_type &coord)
 {
-    std::shared_ptr<VoxelPool> vp(voxels_.at(coord));
+    std::shared_ptr<VoxelPool> vp(get_voxel_pool_at(coord));
     if (auto location_ptr = vp->location())
     {
         if (vp->remove_voxel_if_exists(coord))
         {
-            voxels_.at(coord) = location_ptr;
+            voxels_.at(coord) = pools_.index(location_ptr);
             location_ptr->add_voxel(
                 coordinate_id_pair_type(ParticleID(), coord));
             return true;
@@ -200,13 +343,11 @@ bool OffLatticeSpace::can_move(const coordinate_type &src,
     if (src == dest)
         return false;
 
-    std::shared_ptr<const VoxelPool> src_vp(voxels_.at(src));
-    if (src_vp->is_vacant())
+    const pool_index_type src_index(voxels_.at(src));
+    if (pools_[src_index]->is_vacant())
         return false;
 
-    std::shared_ptr<VoxelPool> dest_vp(voxels_.at(dest));
-
-    return (voxels_.at(dest) == src_vp->location());
+    return (voxels_.at(dest) == pools_.location_index(src_index));
 }
 
 bool OffLatticeSpace::move(const coordinate_type &src,
@@ -216,19 +357,20 @@ bool OffLatticeSpace::move(const coordinate_type &src,
     if (src == dest)
         return false;
 
-    std::shared_ptr<VoxelPool> src_vp(voxels_.at(src));
+    const pool_index_type src_index(voxels_.at(src));
+    VoxelPool *src_vp(pools_[src_index].get());
     if (src_vp->is_vacant())
         return true;
 
-    std::shared_ptr<VoxelPool> dest_vp(voxels_.at(dest));
-    if (dest_vp != src_vp->location())
+    const pool_index_type dest_index(voxels_.at(dest));
+    if (dest_index != pools_.location_index(src_index))
         return false;
 
     src_vp->replace_voxel(src, dest, candidate);
-    voxels_.at(src) = dest_vp;
+    voxels_.at(src) = dest_index;
 
-    dest_vp->replace_voxel(dest, src);
-    voxels_.at(dest) = src_vp;
+    pools_[dest_index]->replace_voxel(dest, src);
+    voxels_.at(dest) = src_index;
 
     return true;
 }
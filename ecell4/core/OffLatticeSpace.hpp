@@ -1,18 +1,29 @@
 #ifndef ECELL4_OFFLATTICE_SPACE_HPP
 #define ECELL4_OFFLATTICE_SPACE_HPP
 
+#include "VoxelPoolTable.hpp"
 #include "VoxelSpaceBase.hpp"
 #include <boost/optional.hpp>
 
 namespace ecell4
 {
 
+class Polygon;
+
+/**
+ * OffLatticeSpace stores the pool occupying each voxel as a small index into
+ * a table of pools, and the neighbors of all voxels in a compressed sparse
+ * row (CSR) format, i.e. the neighbors of a voxel are
+ * adjoinings_[adjoining_offsets_[coord]] to
+ * adjoinings_[adjoining_offsets_[coord + 1] - 1].
+ */
 class OffLatticeSpace : public VoxelSpaceBase
 {
 protected:
     typedef VoxelSpaceBase base_type;
-    typedef std::vector<std::shared_ptr<VoxelPool>> voxel_container;
-    typedef std::vector<std::vector<coordinate_type>> adjoining_container;
+    typedef VoxelPoolTable::index_type pool_index_type;
+    typedef std::vector<pool_index_type> voxel_container;
+    typedef std::vector<coordinate_type> adjoining_container;
 
 public:
     typedef std::pair<coordinate_type, coordinate_type> coordinate_pair_type;
@@ -26,8 +37,24 @@ public:
     OffLatticeSpace(const Real &voxel_radius, const Species &species,
                     const position_container &positions,
                     const coordinate_pair_list_type &adjoining_pairs);
+
+    /**
+     * build a space of the vertices of a polygon, which adjoin each other
+     * along the edges.
+     */
+    OffLatticeSpace(const Real &voxel_radius, const Species &species,
+                    const Polygon &polygon);
     ~OffLatticeSpace();
 
+    /**
+     * list pairs of positions within the distance given in the order of
+     * the first and then the second coordinates. Positions are sorted into
+     * cells as large as the distance, instead of comparing all pairs.
+     */
+    static coordinate_pair_list_type
+    find_adjoining_pairs(const position_container &positions,
+                         const Real &distance);
+
     /*
      * Space Traits
      */
@@ -60,7 +87,14 @@ public:
     std::shared_ptr<VoxelPool>
     get_voxel_pool_at(const coordinate_type &coord) const
     {
-        return voxels_.at(coord);
+        return pools_[voxels_.at(coord)];
+    }
+
+    bool find_pool_index_at(const coordinate_type &coord,
+                            std::size_t &index) const
+    {
+        index = voxels_.at(coord);
+        return true;
     }
 
     /*
@@ -78,13 +112,17 @@ public:
      */
     Integer num_neighbors(const coordinate_type &coord) const
     {
-        return adjoinings_.at(coord).size();
+        return adjoining_offsets_.at(coord + 1) - adjoining_offsets_.at(coord);
     }
 
     coordinate_type get_neighbor(const coordinate_type &coord,
                                  const Integer &nrand) const
     {
-        return adjoinings_.at(coord).at(nrand);
+        if (nrand < 0 || nrand >= num_neighbors(coord))
+        {
+            throw NotFound("Invalid argument: nrand");
+        }
+        return adjoinings_[adjoining_offsets_[coord] + nrand];
     }
 
     /*
@@ -122,9 +160,20 @@ protected:
                const coordinate_pair_list_type &adjoining_pairs);
     boost::optional<coordinate_type> get_coord(const ParticleID &pid) const;
 
+    void initialize_voxels(const std::size_t size);
+
 protected:
+    // the fixed entries of pools_
+    enum
+    {
+        VACANT_INDEX = 0
+    };
+
     voxel_container voxels_;
+    VoxelPoolTable pools_;
+
     position_container positions_;
+    std::vector<std::size_t> adjoining_offsets_;
     adjoining_container adjoinings_;
 
     Real3 edge_lengths_;
@@ -100,6 +100,11 @@ Integer GSLRandomNumberGenerator::binomial(Real p, Integer n)
     return gsl_ran_binomial(rng_.get(), p, n);
 }
 
+Integer GSLRandomNumberGenerator::poisson(Real mean)
+{
+    return gsl_ran_poisson(rng_.get(), mean);
+}
+
 Real3 GSLRandomNumberGenerator::direction3d(Real length)
 {
     double x, y, z;
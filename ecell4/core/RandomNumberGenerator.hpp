@@ -33,6 +33,7 @@ public:
     virtual Integer uniform_int(Integer min, Integer max) = 0;
     virtual Real gaussian(Real sigma, Real mean = 0.0) = 0;
     virtual Integer binomial(Real p, Integer n) = 0;
+    virtual Integer poisson(Real mean) = 0;
     virtual Real3 direction3d(Real length = 1.0) = 0;
 
     virtual void seed(Integer val) = 0;
@@ -86,6 +87,7 @@ public:
     Integer uniform_int(Integer min, Integer max);
     Real gaussian(Real sigma, Real mean = 0.0);
     Integer binomial(Real p, Integer n);
+    Integer poisson(Real mean);
     Real3 direction3d(Real length);
     void seed(Integer val);
     void seed();
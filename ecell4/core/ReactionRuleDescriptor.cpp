@@ -0,0 +1,526 @@
+#include "ReactionRuleDescriptor.hpp"
+
+#include <cctype>
+#include <cstdlib>
+#include <sstream>
+
+
+namespace ecell4
+{
+
+namespace
+{
+
+typedef ReactionRuleDescriptorExpression::instruction_type instruction_type;
+typedef ReactionRuleDescriptorExpression::code_container_type code_container_type;
+
+/**
+ * A recursive descent parser of an expression, which emits the bytecode in
+ * the reverse Polish notation. The precedence of operators follows Python.
+ */
+class expression_parser
+{
+public:
+
+    expression_parser(const std::string& expression)
+        : expression_(expression), pos_(0), depth_(0), max_depth_(0),
+        num_reactants_(0), num_products_(0),
+        num_reactant_coefficients_(0), num_product_coefficients_(0)
+    {
+        ;
+    }
+
+    void parse(code_container_type& code)
+    {
+        parse_sum();
+        skip_spaces();
+        if (pos_ != expression_.size())
+        {
+            error("unexpected character");
+        }
+        code.swap(code_);
+    }
+
+    std::size_t max_depth() const { return max_depth_; }
+    std::size_t num_reactants() const { return num_reactants_; }
+    std::size_t num_products() const { return num_products_; }
+    std::size_t num_reactant_coefficients() const { return num_reactant_coefficients_; }
+    std::size_t num_product_coefficients() const { return num_product_coefficients_; }
+
+protected:
+
+    void error(const std::string& message) const
+    {
+        std::ostringstream oss;
+        oss << "Failed to parse the expression [" << expression_ << "]: "
+            << message << " at " << pos_ << ".";
+        throw IllegalArgument(oss.str());
+    }
+
+    void skip_spaces()
+    {
+        while (pos_ < expression_.size() && std::isspace(expression_[pos_]))
+        {
+            ++pos_;
+        }
+    }
+
+    bool accept(const std::string& token)
+    {
+        skip_spaces();
+        if (expression_.compare(pos_, token.size(), token) == 0)
+        {
+            pos_ += token.size();
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const std::string& token)
+    {
+        if (!accept(token))
+        {
+            error("'" + token + "' expected");
+        }
+    }
+
+    /**
+     * emit an instruction which pops num_operands values and pushes one.
+     */
+    void emit(const instruction_type::opcode_type opcode, const std::size_t num_operands,
+              const std::size_t index = 0, const Real value = 0.0)
+    {
+        const instruction_type inst = {opcode, index, value};
+        code_.push_back(inst);
+        depth_ = depth_ + 1 - num_operands;
+        max_depth_ = std::max(max_depth_, depth_);
+    }
+
+    void parse_sum()
+    {
+        parse_product();
+        while (true)
+        {
+            if (accept("+"))
+            {
+                parse_product();
+                emit(instruction_type::ADD, 2);
+            }
+            else if (accept("-"))
+            {
+                parse_product();
+                emit(instruction_type::SUBTRACT, 2);
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    void parse_product()
+    {
+        parse_unary();
+        while (true)
+        {
+            if (accept("*"))
+            {
+                parse_unary();
+                emit(instruction_type::MULTIPLY, 2);
+            }
+            else if (accept("/"))
+            {
+                parse_unary();
+                emit(instruction_type::DIVIDE, 2);
+            }
+            else
+            {
+                break;
+            }
+        }
+    }
+
+    void parse_unary()
+    {
+        if (accept("-"))
+        {
+            parse_unary();
+            emit(instruction_type::NEGATE, 1);
+        }
+        else if (accept("+"))
+        {
+            parse_unary();
+        }
+        else
+        {
+            parse_power();
+        }
+    }
+
+    void parse_power()
+    {
+        parse_primary();
+        if (accept("**"))
+        {
+            // right associative, and binds less tightly than a unary operator on its right
+            parse_unary();
+            emit(instruction_type::POWER, 2);
+        }
+    }
+
+    std::string parse_name()
+    {
+        skip_spaces();
+        const std::size_t begin(pos_);
+        while (pos_ < expression_.size()
+               && (std::isalnum(expression_[pos_]) || expression_[pos_] == '_'))
+        {
+            ++pos_;
+        }
+        return expression_.substr(begin, pos_ - begin);
+    }
+
+    std::size_t parse_index()
+    {
+        expect("[");
+        skip_spaces();
+        const std::size_t begin(pos_);
+        while (pos_ < expression_.size() && std::isdigit(expression_[pos_]))
+        {
+            ++pos_;
+        }
+        if (begin == pos_)
+        {
+            error("an index expected");
+        }
+        const std::size_t index(std::strtoul(expression_.c_str() + begin, NULL, 10));
+        expect("]");
+        return index;
+    }
+
+    void parse_arguments(const std::size_t num_arguments)
+    {
+        expect("(");
+        for (std::size_t i(0); i < num_arguments; ++i)
+        {
+            if (i > 0)
+            {
+                expect(",");
+            }
+            parse_sum();
+        }
+        expect(")");
+    }
+
+    void parse_primary()
+    {
+        skip_spaces();
+        if (pos_ >= expression_.size())
+        {
+            error("unexpected end");
+        }
+
+        if (accept("("))
+        {
+            parse_sum();
+            expect(")");
+            return;
+        }
+
+        const char c(expression_[pos_]);
+        if (std::isdigit(c) || c == '.')
+        {
+            const char* begin(expression_.c_str() + pos_);
+            char* end;
+            const Real value(std::strtod(begin, &end));
+            if (end == begin)
+            {
+                error("a number expected");
+            }
+            pos_ += end - begin;
+            emit(instruction_type::CONSTANT, 0, 0, value);
+            return;
+        }
+
+        const std::string name(parse_name());
+        if (name == "r")
+        {
+            const std::size_t index(parse_index());
+            num_reactants_ = std::max(num_reactants_, index + 1);
+            emit(instruction_type::REACTANT, 0, index);
+        }
+        else if (name == "p")
+        {
+            const std::size_t index(parse_index());
+            num_products_ = std::max(num_products_, index + 1);
+            emit(instruction_type::PRODUCT, 0, index);
+        }
+        else if (name == "rc")
+        {
+            const std::size_t index(parse_index());
+            num_reactant_coefficients_ = std::max(num_reactant_coefficients_, index + 1);
+            emit(instruction_type::REACTANT_COEFFICIENT, 0, index);
+        }
+        else if (name == "pc")
+        {
+            const std::size_t index(parse_index());
+            num_product_coefficients_ = std::max(num_product_coefficients_, index + 1);
+            emit(instruction_type::PRODUCT_COEFFICIENT, 0, index);
+        }
+        else if (name == "v")
+        {
+            emit(instruction_type::VOLUME, 0);
+        }
+        else if (name == "t")
+        {
+            emit(instruction_type::TIME, 0);
+        }
+        else if (name == "pow" || name == "min" || name == "max")
+        {
+            parse_arguments(2);
+            emit(name == "pow" ? instruction_type::POWER
+                 : (name == "min" ? instruction_type::MINIMUM : instruction_type::MAXIMUM), 2);
+        }
+        else
+        {
+            instruction_type::opcode_type opcode;
+            if (name == "exp") opcode = instruction_type::EXP;
+            else if (name == "log") opcode = instruction_type::LOG;
+            else if (name == "log10") opcode = instruction_type::LOG10;
+            else if (name == "sqrt") opcode = instruction_type::SQRT;
+            else if (name == "abs") opcode = instruction_type::ABS;
+            else if (name == "sin") opcode = instruction_type::SIN;
+            else if (name == "cos") opcode = instruction_type::COS;
+            else if (name == "tan") opcode = instruction_type::TAN;
+            else
+            {
+                error(name.empty() ? "unexpected character" : "unknown name '" + name + "'");
+                return;
+            }
+            parse_arguments(1);
+            emit(opcode, 1);
+        }
+    }
+
+protected:
+
+    const std::string& expression_;
+    std::size_t pos_;
+    code_container_type code_;
+    std::size_t depth_, max_depth_;
+    std::size_t num_reactants_, num_products_;
+    std::size_t num_reactant_coefficients_, num_product_coefficients_;
+};
+
+/**
+ * A value with its derivative with respect to one variable.
+ */
+struct dual_number
+{
+    Real value;
+    Real derivative;
+};
+
+inline void make_variable(Real& x, const Real value, const bool) { x = value; }
+inline void make_variable(dual_number& x, const Real value, const bool seed)
+{
+    x.value = value;
+    x.derivative = (seed ? 1.0 : 0.0);
+}
+
+inline Real apply(const instruction_type::opcode_type opcode, const Real a, const Real b)
+{
+    switch (opcode)
+    {
+    case instruction_type::NEGATE: return -a;
+    case instruction_type::ADD: return a + b;
+    case instruction_type::SUBTRACT: return a - b;
+    case instruction_type::MULTIPLY: return a * b;
+    case instruction_type::DIVIDE: return a / b;
+    case instruction_type::POWER: return std::pow(a, b);
+    case instruction_type::MINIMUM: return std::min(a, b);
+    case instruction_type::MAXIMUM: return std::max(a, b);
+    case instruction_type::EXP: return std::exp(a);
+    case instruction_type::LOG: return std::log(a);
+    case instruction_type::LOG10: return std::log10(a);
+    case instruction_type::SQRT: return std::sqrt(a);
+    case instruction_type::ABS: return std::abs(a);
+    case instruction_type::SIN: return std::sin(a);
+    case instruction_type::COS: return std::cos(a);
+    case instruction_type::TAN: return std::tan(a);
+    default: throw IllegalState("Unknown opcode.");
+    }
+}
+
+inline dual_number apply(
+    const instruction_type::opcode_type opcode, const dual_number& a, const dual_number& b)
+{
+    const Real value(apply(opcode, a.value, b.value));
+    Real d(0.0);
+    switch (opcode)
+    {
+    case instruction_type::NEGATE: d = -a.derivative; break;
+    case instruction_type::ADD: d = a.derivative + b.derivative; break;
+    case instruction_type::SUBTRACT: d = a.derivative - b.derivative; break;
+    case instruction_type::MULTIPLY: d = a.derivative * b.value + a.value * b.derivative; break;
+    case instruction_type::DIVIDE:
+        d = (a.derivative * b.value - a.value * b.derivative) / (b.value * b.value);
+        break;
+    case instruction_type::POWER:
+        // the terms are separated to avoid log(a) for a constant exponent
+        if (a.derivative != 0.0)
+        {
+            d += b.value * std::pow(a.value, b.value - 1) * a.derivative;
+        }
+        if (b.derivative != 0.0)
+        {
+            d += value * std::log(a.value) * b.derivative;
+        }
+        break;
+    case instruction_type::MINIMUM: d = (a.value <= b.value ? a.derivative : b.derivative); break;
+    case instruction_type::MAXIMUM: d = (a.value >= b.value ? a.derivative : b.derivative); break;
+    case instruction_type::EXP: d = value * a.derivative; break;
+    case instruction_type::LOG: d = a.derivative / a.value; break;
+    case instruction_type::LOG10: d = a.derivative / (a.value * std::log(10.0)); break;
+    case instruction_type::SQRT: d = a.derivative / (2 * value); break;
+    case instruction_type::ABS: d = (a.value < 0 ? -a.derivative : a.derivative); break;
+    case instruction_type::SIN: d = std::cos(a.value) * a.derivative; break;
+    case instruction_type::COS: d = -std::sin(a.value) * a.derivative; break;
+    case instruction_type::TAN: d = a.derivative / std::pow(std::cos(a.value), 2); break;
+    default: throw IllegalState("Unknown opcode.");
+    }
+    const dual_number ret = {value, d};
+    return ret;
+}
+
+/**
+ * evaluate the code on a stack of the given depth. With dual_number, the
+ * derivative is taken with respect to the seed-th participant, i.e.
+ * reactants followed by products.
+ */
+template <typename T>
+T evaluate(
+    const code_container_type& code, const std::size_t depth,
+    const ReactionRuleDescriptor::state_container_type& reactants,
+    const ReactionRuleDescriptor::state_container_type& products,
+    const ReactionRuleDescriptor::coefficient_container_type& reactant_coefficients,
+    const ReactionRuleDescriptor::coefficient_container_type& product_coefficients,
+    const Real volume, const Real t, const std::size_t seed = 0)
+{
+    // no allocation for a usual expression
+    T buffer[32] = {};
+    std::vector<T> heap;
+    T* stack(buffer);
+    if (depth > 32)
+    {
+        heap.resize(depth);
+        stack = heap.data();
+    }
+
+    std::size_t top(0);
+    for (code_container_type::const_iterator i(code.begin()); i != code.end(); ++i)
+    {
+        switch ((*i).opcode)
+        {
+        case instruction_type::CONSTANT:
+            make_variable(stack[top++], (*i).value, false);
+            break;
+        case instruction_type::REACTANT:
+            make_variable(stack[top++], reactants[(*i).index], (*i).index == seed);
+            break;
+        case instruction_type::PRODUCT:
+            make_variable(stack[top++], products[(*i).index], reactants.size() + (*i).index == seed);
+            break;
+        case instruction_type::REACTANT_COEFFICIENT:
+            make_variable(stack[top++], reactant_coefficients[(*i).index], false);
+            break;
+        case instruction_type::PRODUCT_COEFFICIENT:
+            make_variable(stack[top++], product_coefficients[(*i).index], false);
+            break;
+        case instruction_type::VOLUME:
+            make_variable(stack[top++], volume, false);
+            break;
+        case instruction_type::TIME:
+            make_variable(stack[top++], t, false);
+            break;
+        case instruction_type::NEGATE:
+        case instruction_type::EXP:
+        case instruction_type::LOG:
+        case instruction_type::LOG10:
+        case instruction_type::SQRT:
+        case instruction_type::ABS:
+        case instruction_type::SIN:
+        case instruction_type::COS:
+        case instruction_type::TAN:
+            stack[top - 1] = apply((*i).opcode, stack[top - 1], stack[top - 1]);
+            break;
+        default:
+            --top;
+            stack[top - 1] = apply((*i).opcode, stack[top - 1], stack[top]);
+            break;
+        }
+    }
+    return stack[0];
+}
+
+} // anonymous
+
+void ReactionRuleDescriptorExpression::compile()
+{
+    expression_parser parser(expression_);
+    parser.parse(code_);
+    depth_ = parser.max_depth();
+    num_reactants_ = parser.num_reactants();
+    num_products_ = parser.num_products();
+    num_reactant_coefficients_ = parser.num_reactant_coefficients();
+    num_product_coefficients_ = parser.num_product_coefficients();
+}
+
+void ReactionRuleDescriptorExpression::check_sizes(
+    const state_container_type& reactants, const state_container_type& products) const
+{
+    if (reactants.size() < num_reactants_ || products.size() < num_products_
+        || reactant_coefficients().size() < num_reactant_coefficients_
+        || product_coefficients().size() < num_product_coefficients_)
+    {
+        throw IllegalArgument(
+            "The expression [" + expression_ + "] refers to a missing reactant or product.");
+    }
+}
+
+Real ReactionRuleDescriptorExpression::propensity(
+    const state_container_type& reactants, const state_container_type& products,
+    Real volume, Real t) const
+{
+    check_sizes(reactants, products);
+    return evaluate<Real>(
+        code_, depth_, reactants, products, reactant_coefficients(), product_coefficients(),
+        volume, t);
+}
+
+std::pair<ReactionRuleDescriptor::state_container_type, ReactionRuleDescriptor::state_container_type>
+ReactionRuleDescriptorExpression::derivatives(
+    const state_container_type& reactants, const state_container_type& products,
+    Real volume, Real t) const
+{
+    check_sizes(reactants, products);
+    std::pair<state_container_type, state_container_type> ret(
+        state_container_type(reactants.size(), 0.0), state_container_type(products.size(), 0.0));
+
+    // only the participants referred can have a nonzero derivative
+    for (std::size_t j(0); j < num_reactants_; ++j)
+    {
+        ret.first[j] = evaluate<dual_number>(
+            code_, depth_, reactants, products, reactant_coefficients(),
+            product_coefficients(), volume, t, j).derivative;
+    }
+    for (std::size_t j(0); j < num_products_; ++j)
+    {
+        ret.second[j] = evaluate<dual_number>(
+            code_, depth_, reactants, products, reactant_coefficients(),
+            product_coefficients(), volume, t, reactants.size() + j).derivative;
+    }
+    return ret;
+}
+
+} // ecell4
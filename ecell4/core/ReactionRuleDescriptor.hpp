@@ -4,9 +4,14 @@
 #include <stdexcept>
 #include <memory>
 #include <cmath>
+#include <algorithm>
+#include <utility>
+#include <string>
+#include <vector>
 
 #include "types.hpp"
 #include "Species.hpp"
+#include "exceptions.hpp"
 
 #include "boost/tuple/tuple.hpp"
 #include "boost/tuple/tuple_io.hpp"
@@ -31,12 +36,14 @@ public:
 public:
 
     ReactionRuleDescriptor(const coefficient_container_type &reactant_coefficients, const coefficient_container_type &product_coefficients)
-        : reactant_coefficients_(reactant_coefficients), product_coefficients_(product_coefficients)
+        : reactant_coefficients_(reactant_coefficients), product_coefficients_(product_coefficients),
+        revision_(0)
     {
         ;
     }
 
     ReactionRuleDescriptor()
+        : revision_(0)
     {
         ;
     }
@@ -59,6 +66,22 @@ public:
 
     virtual Real propensity(const state_container_type& r, const state_container_type& p, Real volume, Real time) const = 0;
 
+    /**
+     * The partial derivatives of the propensity with respect to each
+     * reactant and product. Override both of them to give an exact Jacobian
+     * to stiff solvers, which approximate it by finite differences otherwise.
+     */
+    virtual bool has_derivatives() const
+    {
+        return false;
+    }
+
+    virtual std::pair<state_container_type, state_container_type> derivatives(
+        const state_container_type& r, const state_container_type& p, Real volume, Real time) const
+    {
+        throw NotImplemented("derivatives() is not supported by this descriptor.");
+    }
+
     virtual ReactionRuleDescriptor* clone() const
     {
         return 0;
@@ -78,11 +101,13 @@ public:
     void resize_reactants(const std::size_t size)
     {
         this->reactant_coefficients_.resize(size, 1.0);
+        ++revision_;
     }
 
     void resize_products(const std::size_t size)
     {
         this->product_coefficients_.resize(size, 1.0);
+        ++revision_;
     }
 
     void set_reactant_coefficient(const std::size_t num, const Real new_coeff)
@@ -92,6 +117,7 @@ public:
             this->resize_reactants(num + 1);
         }
         this->reactant_coefficients_[num] = new_coeff;
+        ++revision_;
     }
 
     void set_product_coefficient(const std::size_t num, const Real new_coeff)
@@ -101,6 +127,7 @@ public:
             this->resize_products(num + 1);
         }
         this->product_coefficients_[num] = new_coeff;
+        ++revision_;
     }
 
     void set_reactant_coefficients(const coefficient_container_type &new_reactant_coefficients)
@@ -110,6 +137,7 @@ public:
         {
             this->reactant_coefficients_.push_back(new_reactant_coefficients[i]);
         }
+        ++revision_;
     }
 
     void set_product_coefficients(const coefficient_container_type &new_product_coefficients)
@@ -119,6 +147,7 @@ public:
         {
             this->product_coefficients_.push_back(new_product_coefficients[i]);
         }
+        ++revision_;
     }
 
     bool has_coefficients(void) const
@@ -126,10 +155,19 @@ public:
         return !(this->reactant_coefficients_.empty() && this->product_coefficients_.empty());
     }
 
+    /**
+     * a counter incremented whenever the coefficients are modified.
+     */
+    Integer revision() const
+    {
+        return revision_;
+    }
+
 private:
 
     coefficient_container_type reactant_coefficients_;
     coefficient_container_type product_coefficients_;
+    Integer revision_;
 };
 
 class ReactionRuleDescriptorMassAction
@@ -203,6 +241,52 @@ public:
         return ret;
     }
 
+    virtual bool has_derivatives() const
+    {
+        return true;
+    }
+
+    virtual std::pair<state_container_type, state_container_type> derivatives(
+        const state_container_type& reactants, const state_container_type& products, Real volume, Real time) const
+    {
+        const coefficient_container_type& coefficients(reactant_coefficients());
+        const std::size_t n(std::min(reactants.size(), coefficients.size()));
+        std::pair<state_container_type, state_container_type> ret(
+            state_container_type(reactants.size(), 0.0), state_container_type(products.size(), 0.0));
+        for (std::size_t j(0); j < n; ++j)
+        {
+            Real d = k_.magnitude;
+            for (std::size_t i(0); i < n; ++i)
+            {
+                d *= (i == j ? power_derivative(reactants[i] / volume, coefficients[i])
+                             : std::pow(reactants[i] / volume, coefficients[i]));
+            }
+            ret.first[j] = d;
+        }
+        return ret;
+    }
+
+    /**
+     * return d/dx x^c = c x^(c-1) without evaluating 0^(c-1), which is
+     * infinite for c < 1. The derivative is taken as zero there.
+     */
+    static Real power_derivative(const Real x, const Real c)
+    {
+        if (c == 0.0)
+        {
+            return 0.0;
+        }
+        else if (c == 1.0)
+        {
+            return 1.0;
+        }
+        else if (x == 0.0)
+        {
+            return 0.0;
+        }
+        return c * std::pow(x, c - 1);
+    }
+
 private:
 
     Quantity<Real> k_;
@@ -264,6 +348,200 @@ private:
     func_type pf_;
 };
 
+/**
+ * ReactionRuleDescriptorExpression gives the propensity by an arithmetic
+ * expression in the form of the body of a rate law function in Python,
+ * e.g. "0.1 * r[0] * r[1] / (v * (2.0 + r[1] / v))". r[i] and p[i] are the
+ * states of the i-th reactant and product, rc[i] and pc[i] are their
+ * coefficients, and v and t are the volume and the time. The operators are
+ * +, -, *, / and **, and the functions are exp, log, log10, sqrt, abs, sin,
+ * cos, tan, pow, min and max.
+ *
+ * The expression is parsed once into a bytecode for a stack machine, which
+ * is evaluated without any callback, and thus without the GIL in Python.
+ * The derivatives are exact by the forward-mode differentiation.
+ */
+class ReactionRuleDescriptorExpression
+    : public ReactionRuleDescriptor
+{
+public:
+
+    typedef ReactionRuleDescriptor base_type;
+    typedef base_type::state_container_type state_container_type;
+
+    struct instruction_type
+    {
+        enum opcode_type
+        {
+            CONSTANT, REACTANT, PRODUCT, REACTANT_COEFFICIENT, PRODUCT_COEFFICIENT,
+            VOLUME, TIME,
+            NEGATE, ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, MINIMUM, MAXIMUM,
+            EXP, LOG, LOG10, SQRT, ABS, SIN, COS, TAN
+        };
+
+        opcode_type opcode;
+        std::size_t index;
+        Real value;
+    };
+
+    typedef std::vector<instruction_type> code_container_type;
+
+public:
+
+    ReactionRuleDescriptorExpression(const std::string& expression)
+        : base_type(), expression_(expression)
+    {
+        compile();
+    }
+
+    ReactionRuleDescriptorExpression(const std::string& expression, const coefficient_container_type &reactant_coefficients, const coefficient_container_type &product_coefficients)
+        : base_type(reactant_coefficients, product_coefficients), expression_(expression)
+    {
+        compile();
+    }
+
+    virtual ReactionRuleDescriptor* clone() const
+    {
+        return new ReactionRuleDescriptorExpression(expression_, reactant_coefficients(), product_coefficients());
+    }
+
+    const std::string& as_string() const
+    {
+        return expression_;
+    }
+
+    const code_container_type& code() const
+    {
+        return code_;
+    }
+
+    virtual Real propensity(const state_container_type& reactants, const state_container_type& products, Real volume, Real t) const;
+
+    virtual bool has_derivatives() const
+    {
+        return true;
+    }
+
+    virtual std::pair<state_container_type, state_container_type> derivatives(
+        const state_container_type& reactants, const state_container_type& products, Real volume, Real t) const;
+
+protected:
+
+    void compile();
+    void check_sizes(const state_container_type& reactants, const state_container_type& products) const;
+
+private:
+
+    std::string expression_;
+    code_container_type code_;
+
+    // the depth of the stack needed, and the numbers of the states and
+    // coefficients referred
+    std::size_t depth_;
+    std::size_t num_reactants_, num_products_;
+    std::size_t num_reactant_coefficients_, num_product_coefficients_;
+};
+
+/**
+ * ReactionRuleDescriptorBatch evaluates the propensities of many reactions
+ * sharing one rate law in one call. All of them have the same numbers of
+ * reactants and products, and the states of the i-th reaction are the i-th
+ * rows of the row-major matrices given.
+ */
+class ReactionRuleDescriptorBatch
+{
+public:
+
+    ReactionRuleDescriptorBatch(const std::size_t num_reactants, const std::size_t num_products)
+        : num_reactants_(num_reactants), num_products_(num_products)
+    {
+        ;
+    }
+
+    virtual ~ReactionRuleDescriptorBatch()
+    {
+        ;
+    }
+
+    std::size_t num_reactants() const
+    {
+        return num_reactants_;
+    }
+
+    std::size_t num_products() const
+    {
+        return num_products_;
+    }
+
+    virtual void propensities(
+        const Real* reactants, const Real* products, const std::size_t num_reactions,
+        const Real volume, const Real t, Real* ret) const = 0;
+
+private:
+
+    std::size_t num_reactants_, num_products_;
+};
+
+/**
+ * ReactionRuleDescriptorBatched is a member of a batch. A simulator may
+ * collect the members sharing a batch to evaluate them at once, and
+ * propensity() evaluates the member alone otherwise.
+ */
+class ReactionRuleDescriptorBatched
+    : public ReactionRuleDescriptor
+{
+public:
+
+    typedef ReactionRuleDescriptor base_type;
+    typedef base_type::state_container_type state_container_type;
+    typedef ReactionRuleDescriptorBatch batch_type;
+
+public:
+
+    ReactionRuleDescriptorBatched(const std::shared_ptr<batch_type>& batch)
+        : base_type(), batch_(batch)
+    {
+        ;
+    }
+
+    ReactionRuleDescriptorBatched(const std::shared_ptr<batch_type>& batch, const coefficient_container_type &reactant_coefficients, const coefficient_container_type &product_coefficients)
+        : base_type(reactant_coefficients, product_coefficients), batch_(batch)
+    {
+        ;
+    }
+
+    virtual ReactionRuleDescriptor* clone() const
+    {
+        return new ReactionRuleDescriptorBatched(batch_, reactant_coefficients(), product_coefficients());
+    }
+
+    bool is_available() const
+    {
+        return static_cast<bool>(batch_);
+    }
+
+    const std::shared_ptr<batch_type>& batch() const
+    {
+        return batch_;
+    }
+
+    virtual Real propensity(const state_container_type& reactants, const state_container_type& products, Real volume, Real t) const
+    {
+        if (reactants.size() != batch_->num_reactants() || products.size() != batch_->num_products())
+        {
+            throw IllegalArgument("The numbers of reactants and products differ from the batch.");
+        }
+
+        Real ret(0.0);
+        batch_->propensities(reactants.data(), products.data(), 1, volume, t, &ret);
+        return ret;
+    }
+
+private:
+
+    std::shared_ptr<batch_type> batch_;
+};
+
 } // ecell4
 
 #endif /* ECELL4_REACTION_RULE_DESCRIPTOR_HPP */
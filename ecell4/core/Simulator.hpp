@@ -76,6 +76,15 @@ public:
     {
         return false;
     }
+
+    /**
+     * @return if the world is at an internal step of the solver within
+     * a step, e.g. while a step observer is fired, or not
+     */
+    virtual bool check_internal_step() const
+    {
+        return false;
+    }
 };
 
 }
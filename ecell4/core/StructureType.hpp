@@ -24,6 +24,12 @@ public:
 
     const Integer size() const { return size_; }
 
+    /**
+     * set the number of voxels at once, e.g. for a space which does not
+     * store its vacant voxels.
+     */
+    void set_size(const Integer size) { size_ = size; }
+
     void add_voxel(const coordinate_id_pair_type &info)
     {
         if (info.pid != ParticleID())
@@ -0,0 +1,183 @@
+#ifndef ECELL4_THREAD_POOL_HPP
+#define ECELL4_THREAD_POOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+
+
+namespace ecell4
+{
+
+/**
+ * ThreadPool keeps worker threads alive between runs, for simulators
+ * running many short parallel sections, e.g. one at every step.
+ * The calling thread takes part in each run, so that a pool of
+ * num_threads starts num_threads - 1 workers.
+ */
+class ThreadPool
+{
+public:
+
+    typedef std::function<void(const std::size_t)> task_type;
+
+public:
+
+    ThreadPool(const std::size_t num_threads)
+        : workers_(), task_(NULL), num_tasks_(0), next_(0),
+        generation_(0), num_running_(0), stopped_(false), error_()
+    {
+        if (num_threads == 0)
+        {
+            throw std::invalid_argument("The number of threads must be positive.");
+        }
+
+        for (std::size_t i(1); i < num_threads; ++i)
+        {
+            workers_.push_back(std::thread(&ThreadPool::loop, this));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_ = true;
+        }
+        start_.notify_all();
+
+        for (std::vector<std::thread>::iterator i(workers_.begin());
+            i != workers_.end(); ++i)
+        {
+            (*i).join();
+        }
+    }
+
+    std::size_t num_threads() const
+    {
+        return workers_.size() + 1;
+    }
+
+    /**
+     * call task(i) for each i in [0, num_tasks) on the threads, and wait
+     * for all of them. The first exception thrown by a task is rethrown
+     * after all tasks finish.
+     */
+    void run(const std::size_t num_tasks, const task_type& task)
+    {
+        if (workers_.size() == 0 || num_tasks <= 1)
+        {
+            for (std::size_t i(0); i < num_tasks; ++i)
+            {
+                task(i);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            task_ = &task;
+            num_tasks_ = num_tasks;
+            next_ = 0;
+            error_ = std::exception_ptr();
+            num_running_ = workers_.size();
+            ++generation_;
+        }
+        start_.notify_all();
+
+        work();
+
+        std::exception_ptr error;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this]() { return num_running_ == 0; });
+            task_ = NULL;
+            error = error_;
+        }
+
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+protected:
+
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void work()
+    {
+        while (true)
+        {
+            const std::size_t i(next_++);
+            if (i >= num_tasks_)
+            {
+                return;
+            }
+
+            try
+            {
+                (*task_)(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!error_)
+                {
+                    error_ = std::current_exception();
+                }
+            }
+        }
+    }
+
+    void loop()
+    {
+        std::size_t generation(0);
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                start_.wait(lock,
+                    [&]() { return stopped_ || generation_ != generation; });
+                if (stopped_)
+                {
+                    return;
+                }
+                generation = generation_;
+            }
+
+            work();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (--num_running_ == 0)
+                {
+                    done_.notify_one();
+                }
+            }
+        }
+    }
+
+protected:
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable start_, done_;
+
+    const task_type* task_;
+    std::size_t num_tasks_;
+    std::atomic<std::size_t> next_;
+    std::size_t generation_, num_running_;
+    bool stopped_;
+    std::exception_ptr error_;
+};
+
+} // ecell4
+
+#endif /* ECELL4_THREAD_POOL_HPP */
@@ -0,0 +1,35 @@
+#include "VoxelPoolTable.hpp"
+#include "exceptions.hpp"
+
+namespace ecell4
+{
+
+VoxelPoolTable::index_type
+VoxelPoolTable::index(const std::shared_ptr<VoxelPool> &pool)
+{
+    const auto itr(indices_.find(pool.get()));
+    if (itr != indices_.end())
+    {
+        return (*itr).second;
+    }
+
+    // the location is registered first, which may take the last index
+    index_type location_index(NO_LOCATION);
+    if (auto location = pool->location())
+    {
+        location_index = index(location);
+    }
+
+    if (pools_.size() >= static_cast<std::size_t>(NO_LOCATION))
+    {
+        throw IllegalState("Too many voxel pools in a space.");
+    }
+
+    const index_type retval(static_cast<index_type>(pools_.size()));
+    pools_.push_back(pool);
+    location_indices_.push_back(location_index);
+    indices_.insert(std::make_pair(pool.get(), retval));
+    return retval;
+}
+
+} // namespace ecell4
@@ -0,0 +1,83 @@
+#ifndef ECELL4_VOXEL_POOL_TABLE_HPP
+#define ECELL4_VOXEL_POOL_TABLE_HPP
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "VoxelPool.hpp"
+
+namespace ecell4
+{
+
+/**
+ * VoxelPoolTable numbers voxel pools by small indices, so that a space
+ * stores the pool occupying each voxel in 2 bytes instead of a shared_ptr.
+ * The location of each pool is numbered as well, and thus whether a voxel
+ * can be occupied by a pool is a comparison of indices.
+ */
+class VoxelPoolTable
+{
+public:
+    typedef std::uint16_t index_type;
+    typedef std::vector<std::shared_ptr<VoxelPool>> pool_container_type;
+
+    // the location index of a pool without a location
+    enum
+    {
+        NO_LOCATION = 0xffff
+    };
+
+public:
+    void clear()
+    {
+        pools_.clear();
+        indices_.clear();
+        location_indices_.clear();
+    }
+
+    /**
+     * return the index of the pool, which is registered if new.
+     */
+    index_type index(const std::shared_ptr<VoxelPool> &pool);
+
+    /**
+     * find the index of the pool, or return false if it is not registered.
+     */
+    bool find(const std::shared_ptr<const VoxelPool> &pool,
+              index_type &index) const
+    {
+        const auto itr(indices_.find(pool.get()));
+        if (itr == indices_.end())
+        {
+            return false;
+        }
+        index = (*itr).second;
+        return true;
+    }
+
+    const std::shared_ptr<VoxelPool> &operator[](const index_type index) const
+    {
+        return pools_[index];
+    }
+
+    /**
+     * return the index of the location of the pool, or NO_LOCATION.
+     */
+    index_type location_index(const index_type index) const
+    {
+        return location_indices_[index];
+    }
+
+    std::size_t size() const { return pools_.size(); }
+
+protected:
+    pool_container_type pools_;
+    std::unordered_map<const VoxelPool *, index_type> indices_;
+    std::vector<index_type> location_indices_;
+};
+
+} // namespace ecell4
+
+#endif /* ECELL4_VOXEL_POOL_TABLE_HPP */
@@ -259,6 +259,17 @@ public:
     virtual std::shared_ptr<VoxelPool>
     get_voxel_pool_at(const coordinate_type &coord) const = 0;
 
+    /**
+     * give the index of the pool at the coordinate, which is fixed for the
+     * pool until the space is reset, or return false if the space does not
+     * number its pools.
+     */
+    virtual bool find_pool_index_at(const coordinate_type &coord,
+                                    std::size_t &index) const
+    {
+        return false;
+    }
+
     /*
      * Coordinate Transformation
      */
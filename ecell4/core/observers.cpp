@@ -225,7 +225,7 @@ void NumberObserver::finalize(const std::shared_ptr<WorldInterface>& world)
 
 bool NumberObserver::fire(const Simulator* sim, const std::shared_ptr<WorldInterface>& world)
 {
-    if (sim->check_reaction())
+    if (sim->check_reaction() || sim->check_internal_step())
     {
         logger_.log(world);
         return base_type::fire(sim, world);
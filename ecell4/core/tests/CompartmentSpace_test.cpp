@@ -64,3 +64,39 @@ BOOST_AUTO_TEST_CASE(CompartmentSpace_test_species)
 {
     CompartmentSpace_test_species_template<CompartmentSpaceVectorImpl>();
 }
+
+template<typename Timpl_>
+void CompartmentSpace_test_species_index_template()
+{
+    const Real L(1e-6);
+    const Real3 edge_lengths(L, L, L);
+    Timpl_ target(edge_lengths);
+
+    Species sp1("A"), sp2("B");
+    target.add_molecules(sp1, 30);
+
+    const CompartmentSpace::species_index_type idx1(target.get_species_index(sp1));
+    BOOST_CHECK_EQUAL(target.get_species_index(sp1), idx1);
+    BOOST_CHECK_EQUAL(target.species_at(idx1), sp1);
+    BOOST_CHECK_EQUAL(target.num_molecules_at(idx1), 30);
+
+    const CompartmentSpace::species_index_type idx2(target.get_species_index(sp2));
+    BOOST_CHECK(idx2 != idx1);
+    BOOST_CHECK_EQUAL(target.num_species(), 2);
+    BOOST_CHECK_EQUAL(target.num_molecules_at(idx2), 0);
+    BOOST_CHECK(target.has_species(sp2));
+
+    target.add_molecules_at(idx2, 5);
+    target.remove_molecules_at(idx1, 10);
+    BOOST_CHECK_EQUAL(target.num_molecules_exact(sp1), 20);
+    BOOST_CHECK_EQUAL(target.num_molecules_exact(sp2), 5);
+    BOOST_CHECK_THROW(target.remove_molecules_at(idx2, 6), std::invalid_argument);
+
+    target.reset(edge_lengths);
+    BOOST_CHECK_EQUAL(target.num_species(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CompartmentSpace_test_species_index)
+{
+    CompartmentSpace_test_species_index_template<CompartmentSpaceVectorImpl>();
+}
@@ -0,0 +1,246 @@
+#define BOOST_TEST_MODULE "EnsembleRunner_test"
+
+#ifdef UNITTEST_FRAMEWORK_LIBRARY_EXIST
+#   include <boost/test/unit_test.hpp>
+#else
+#   define BOOST_TEST_NO_LIB
+#   include <boost/test/included/unit_test.hpp>
+#endif
+
+#include <cmath>
+#include <map>
+#include <limits>
+
+#include <ecell4/core/types.hpp>
+#include <ecell4/core/NetworkModel.hpp>
+#include <ecell4/core/WorldInterface.hpp>
+#include <ecell4/core/SimulatorBase.hpp>
+#include <ecell4/core/EnsembleRunner.hpp>
+
+using namespace ecell4;
+
+/**
+ * a well-mixed world just enough to be run by EnsembleRunner.
+ */
+class DecayWorld
+    : public WorldInterface
+{
+public:
+
+    DecayWorld(const Real3& edge_lengths)
+        : t_(0.0), edge_lengths_(edge_lengths)
+    {
+        ;
+    }
+
+    const Real t() const
+    {
+        return t_;
+    }
+
+    void set_t(const Real& t)
+    {
+        t_ = t;
+    }
+
+    void save(const std::string& filename) const
+    {
+        throw NotSupported("save(const std::string) is not supported.");
+    }
+
+    const Real3& edge_lengths() const
+    {
+        return edge_lengths_;
+    }
+
+    std::vector<Species> list_species() const
+    {
+        std::vector<Species> retval;
+        for (std::map<Species, Integer>::const_iterator i(numbers_.begin());
+            i != numbers_.end(); ++i)
+        {
+            retval.push_back((*i).first);
+        }
+        return retval;
+    }
+
+    Integer num_molecules_exact(const Species& sp) const
+    {
+        std::map<Species, Integer>::const_iterator i(numbers_.find(sp));
+        return (i != numbers_.end() ? (*i).second : 0);
+    }
+
+    Integer num_molecules(const Species& sp) const
+    {
+        return num_molecules_exact(sp);
+    }
+
+    Real get_value(const Species& sp) const
+    {
+        return static_cast<Real>(num_molecules_exact(sp));
+    }
+
+    void add_molecules(const Species& sp, const Integer& num)
+    {
+        numbers_[sp] += num;
+    }
+
+    std::map<Species, Integer>& numbers()
+    {
+        return numbers_;
+    }
+
+    void bind_to(std::shared_ptr<Model> model)
+    {
+        ;
+    }
+
+protected:
+
+    Real t_;
+    Real3 edge_lengths_;
+    std::map<Species, Integer> numbers_;
+};
+
+/**
+ * every molecule decays at the unit rate.
+ */
+class DecaySimulator
+    : public SimulatorBase<DecayWorld>
+{
+public:
+
+    typedef SimulatorBase<DecayWorld> base_type;
+
+public:
+
+    DecaySimulator(
+        const std::shared_ptr<DecayWorld>& world, const std::shared_ptr<Model>& model,
+        const std::shared_ptr<RandomNumberGenerator>& rng)
+        : base_type(world, model), rng_(rng), total_(0), dt_(0.0)
+    {
+        initialize();
+    }
+
+    void initialize()
+    {
+        total_ = 0;
+        for (std::map<Species, Integer>::const_iterator i(world_->numbers().begin());
+            i != world_->numbers().end(); ++i)
+        {
+            total_ += (*i).second;
+        }
+        dt_ = (total_ > 0 ? -std::log(1.0 - rng_->uniform(0.0, 1.0)) / total_
+                          : std::numeric_limits<Real>::infinity());
+    }
+
+    Real dt() const
+    {
+        return dt_;
+    }
+
+    void step()
+    {
+        set_t(t() + dt_);
+        Integer i(rng_->uniform_int(0, total_ - 1));
+        for (std::map<Species, Integer>::iterator j(world_->numbers().begin());
+            j != world_->numbers().end(); ++j)
+        {
+            if (i < (*j).second)
+            {
+                --(*j).second;
+                break;
+            }
+            i -= (*j).second;
+        }
+        ++num_steps_;
+        initialize();
+    }
+
+    bool step(const Real& upto)
+    {
+        if (upto <= t())
+        {
+            return false;
+        }
+        else if (t() + dt_ <= upto)
+        {
+            step();
+            return true;
+        }
+        set_t(upto);
+        initialize();
+        return false;
+    }
+
+protected:
+
+    std::shared_ptr<RandomNumberGenerator> rng_;
+    Integer total_;
+    Real dt_;
+};
+
+class DecayFactory
+{
+public:
+
+    typedef DecayWorld world_type;
+    typedef DecaySimulator simulator_type;
+
+public:
+
+    DecayFactory& rng(const std::shared_ptr<RandomNumberGenerator>& rng)
+    {
+        rng_ = rng;
+        return (*this);
+    }
+
+    world_type* world(const Real3& edge_lengths) const
+    {
+        return new world_type(edge_lengths);
+    }
+
+    simulator_type* simulator(
+        const std::shared_ptr<world_type>& w, const std::shared_ptr<Model>& m) const
+    {
+        return new simulator_type(w, m, rng_);
+    }
+
+protected:
+
+    std::shared_ptr<RandomNumberGenerator> rng_;
+};
+
+BOOST_AUTO_TEST_CASE(EnsembleRunner_test_run)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+
+    std::shared_ptr<DecayWorld> world(new DecayWorld(Real3(1, 1, 1)));
+    world->add_molecules(Species("A"), 100);
+
+    const Integer num_runs(40);
+    const EnsembleResult result(
+        EnsembleRunner<DecayFactory>(DecayFactory(), 4).run(
+            world, model, 1.0, 0.1, num_runs, std::vector<std::string>(1, "A"), 1));
+    BOOST_CHECK_EQUAL(result.num_runs(), num_runs);
+    BOOST_CHECK_EQUAL(result.num_times(), 11);
+    BOOST_CHECK_EQUAL(result.num_columns(), 2);
+
+    // the original world must be left as it was.
+    BOOST_CHECK_EQUAL(world->num_molecules(Species("A")), 100);
+
+    for (Integer run(0); run < num_runs; ++run)
+    {
+        BOOST_CHECK_EQUAL(result.value(run, 0, 1), 100);
+    }
+
+    // results must not depend on the number of threads.
+    const EnsembleResult serial(
+        EnsembleRunner<DecayFactory>(DecayFactory(), 1).run(
+            world, model, 1.0, 0.1, num_runs, std::vector<std::string>(1, "A"), 1));
+    BOOST_CHECK(result.values() == serial.values());
+
+    const EnsembleResult::data_container_type mean(result.mean());
+    BOOST_CHECK_CLOSE(mean.back()[0], 1.0, 1e-6);
+    BOOST_CHECK(std::abs(mean.back()[1] - 100 * std::exp(-1.0)) < 10);
+}
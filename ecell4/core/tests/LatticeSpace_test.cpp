@@ -9,6 +9,7 @@
 
 #include <boost/test/tools/floating_point_comparison.hpp>
 
+#include <ecell4/core/LatticeSpaceSparseImpl.hpp>
 #include <ecell4/core/LatticeSpaceVectorImpl.hpp>
 #include <ecell4/core/MoleculePool.hpp>
 #include <ecell4/core/SerialIDGenerator.hpp>
@@ -322,6 +323,168 @@ BOOST_AUTO_TEST_CASE(LatticeSpace_test_neighbor)
     }
 }
 
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_sparse)
+{
+    LatticeSpaceSparseImpl sparse(edge_lengths, voxel_radius, false);
+    sparse.make_molecular_type(sp, "");
+    BOOST_CHECK_EQUAL(sparse.size(), space.size());
+    BOOST_CHECK_EQUAL(sparse.num_stored_voxels(), 0);
+    BOOST_CHECK_EQUAL(sparse.vacant()->size(), space.vacant()->size());
+
+    const VoxelSpaceBase::coordinate_type coord(
+        sparse.global2coordinate(Integer3(2, 3, 4)));
+    BOOST_CHECK(sparse.get_voxel_pool_at(coord)->is_vacant());
+    for (Integer i(0); i < 12; ++i)
+    {
+        BOOST_CHECK_EQUAL(sparse.get_neighbor(coord, i),
+                          space.get_neighbor(coord, i));
+    }
+
+    const ParticleID pid(sidgen());
+    BOOST_CHECK(sparse.update_voxel(pid, sp, coord));
+    BOOST_CHECK_EQUAL(sparse.num_stored_voxels(), 1);
+    BOOST_CHECK_EQUAL(sparse.num_voxels_exact(sp), 1);
+
+    const VoxelSpaceBase::coordinate_type neighbor(
+        sparse.get_neighbor(coord, 0));
+    BOOST_CHECK(sparse.can_move(coord, neighbor));
+    BOOST_CHECK(sparse.move(coord, neighbor));
+    BOOST_CHECK(sparse.get_voxel_pool_at(coord)->is_vacant());
+    BOOST_CHECK_EQUAL(sparse.get_voxel_pool_at(neighbor)->species(), sp);
+    BOOST_CHECK_EQUAL(sparse.num_stored_voxels(), 1);
+    BOOST_CHECK_EQUAL(sparse.list_voxels_exact(sp).at(0).voxel, neighbor);
+
+    // voxels outside are borders
+    const VoxelSpaceBase::coordinate_type border(
+        sparse.global2coordinate(Integer3(-1, 3, 4)));
+    BOOST_CHECK(!sparse.is_inside(border));
+    BOOST_CHECK(!sparse.can_move(neighbor, border));
+
+    BOOST_CHECK(sparse.remove_voxel(pid));
+    BOOST_CHECK_EQUAL(sparse.num_stored_voxels(), 0);
+    BOOST_CHECK_EQUAL(sparse.num_voxels_exact(sp), 0);
+    BOOST_CHECK_EQUAL(sparse.vacant()->size(), space.vacant()->size());
+
+    // the vacant voxels are counted again, not added
+    sparse.reset(edge_lengths, voxel_radius, false);
+    BOOST_CHECK_EQUAL(sparse.vacant()->size(), sparse.actual_size());
+}
+
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_pool_index)
+{
+    LatticeSpaceSparseImpl sparse(edge_lengths, voxel_radius, false);
+    sparse.make_molecular_type(sp, "");
+    const Species sp2("B", 2.5e-9, 1e-12);
+    VoxelSpaceBase *spaces[] = {&space, &sparse};
+    for (VoxelSpaceBase *target : spaces)
+    {
+        target->make_molecular_type(sp2, "");
+        const Integer center(
+            target->position2coordinate(Real3(1.25e-8, 1.25e-8, 1.25e-8)));
+        const Integer coords[] = {
+            center, target->get_neighbor(center, 0),
+            target->get_neighbor(center, 1), target->get_neighbor(center, 2)};
+        BOOST_CHECK(target->update_voxel(sidgen(), sp, coords[0]));
+        BOOST_CHECK(target->update_voxel(sidgen(), sp, coords[1]));
+        BOOST_CHECK(target->update_voxel(sidgen(), sp2, coords[2]));
+
+        std::size_t vacant, a1, a2, b;
+        BOOST_CHECK(target->find_pool_index_at(coords[3], vacant));
+        BOOST_CHECK(target->find_pool_index_at(coords[0], a1));
+        BOOST_CHECK(target->find_pool_index_at(coords[1], a2));
+        BOOST_CHECK(target->find_pool_index_at(coords[2], b));
+        BOOST_CHECK_EQUAL(a1, a2);
+        BOOST_CHECK(a1 != b);
+        BOOST_CHECK(a1 != vacant);
+
+        // the index is kept when the pool has no voxel for a while
+        BOOST_CHECK(target->remove_voxel(coords[0]));
+        BOOST_CHECK(target->remove_voxel(coords[1]));
+        BOOST_CHECK(target->update_voxel(sidgen(), sp, coords[3]));
+        BOOST_CHECK(target->find_pool_index_at(coords[3], a2));
+        BOOST_CHECK_EQUAL(a1, a2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_molecule_pool_sweep)
+{
+    MoleculePool pool(sp, space.vacant());
+    for (Integer coord(0); coord < 8; ++coord)
+    {
+        pool.add_voxel(VoxelPool::coordinate_id_pair_type(sidgen(), coord));
+    }
+
+    std::vector<Integer> visited;
+    std::size_t idx;
+    pool.begin_sweep();
+    while (pool.next_in_sweep(idx))
+    {
+        const Integer coord(pool[idx].coordinate);
+        visited.push_back(coord);
+
+        if (coord == 2)
+        {
+            pool.remove_voxel_if_exists(0); // visited
+            pool.remove_voxel_if_exists(5); // not visited yet
+            pool.add_voxel(VoxelPool::coordinate_id_pair_type(sidgen(), 100));
+        }
+        else if (coord == 3)
+        {
+            pool.remove_voxel_if_exists(3); // itself
+        }
+        else if (coord == 4)
+        {
+            pool.replace_voxel(4, 104, idx);
+        }
+    }
+
+    std::sort(visited.begin(), visited.end());
+    const Integer expected[] = {0, 1, 2, 3, 4, 6, 7};
+    BOOST_CHECK_EQUAL_COLLECTIONS(visited.begin(), visited.end(), expected,
+                                  expected + 7);
+
+    std::vector<Integer> remaining;
+    for (const auto &info : pool)
+    {
+        remaining.push_back(info.coordinate);
+    }
+    std::sort(remaining.begin(), remaining.end());
+    const Integer expected_remaining[] = {1, 2, 6, 7, 100, 104};
+    BOOST_CHECK_EQUAL_COLLECTIONS(remaining.begin(), remaining.end(),
+                                  expected_remaining, expected_remaining + 6);
+}
+
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_molecule_pool_sweep_guard)
+{
+    MoleculePool pool(sp, space.vacant());
+    for (Integer coord(0); coord < 4; ++coord)
+    {
+        pool.add_voxel(VoxelPool::coordinate_id_pair_type(sidgen(), coord));
+    }
+
+    try
+    {
+        std::size_t idx;
+        const MoleculePool::sweep_guard sweep(pool);
+        while (pool.next_in_sweep(idx))
+        {
+            if (pool[idx].coordinate == 1)
+            {
+                throw IllegalState("an error during the sweep");
+            }
+        }
+    }
+    catch (const IllegalState &)
+    {
+        ;
+    }
+    BOOST_CHECK(!pool.is_sweeping());
+
+    // a removal out of a sweep must not be confused by the last one
+    pool.remove_voxel_if_exists(0);
+    BOOST_CHECK_EQUAL(pool.size(), 3);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 struct PeriodicFixture
@@ -495,6 +658,45 @@ BOOST_AUTO_TEST_CASE(LatticeSpace_test_coordinates2)
     BOOST_CHECK_EQUAL(pc1, space.position2coordinate(p2));
 }
 
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_blocked_layout)
+{
+    LatticeSpaceVectorImpl blocked(edge_lengths, voxel_radius, true,
+                                   LatticeSpaceVectorImpl::BLOCKED_LAYOUT);
+    BOOST_CHECK_EQUAL(blocked.actual_size(), space.actual_size());
+    BOOST_CHECK(blocked.size() >= space.size());
+
+    Integer num_inside(0);
+    for (VoxelSpaceBase::coordinate_type coord(0); coord < blocked.size();
+         ++coord)
+    {
+        if (blocked.is_inside(coord))
+        {
+            ++num_inside;
+        }
+    }
+    BOOST_CHECK_EQUAL(num_inside, blocked.actual_size());
+
+    for (Integer col(0); col < space.col_size(); ++col)
+        for (Integer row(0); row < space.row_size(); ++row)
+            for (Integer layer(0); layer < space.layer_size(); ++layer)
+            {
+                const Integer3 global(col, row, layer);
+                const VoxelSpaceBase::coordinate_type coord(
+                    space.global2coordinate(global)),
+                    blocked_coord(blocked.global2coordinate(global));
+                BOOST_CHECK_EQUAL(blocked.coordinate2global(blocked_coord),
+                                  global);
+
+                for (Integer i(0); i < 12; ++i)
+                {
+                    BOOST_CHECK_EQUAL(
+                        blocked.coordinate2global(
+                            blocked.get_neighbor(blocked_coord, i)),
+                        space.coordinate2global(space.get_neighbor(coord, i)));
+                }
+            }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 struct StructureFixture
@@ -570,6 +772,34 @@ BOOST_AUTO_TEST_CASE(LatticeSpace_test_structure_move)
     BOOST_CHECK_EQUAL(space.list_voxels().size(), 2); // TODO -> 1
 }
 
+BOOST_AUTO_TEST_CASE(LatticeSpace_test_structure_location)
+{
+    const Real3 pos1(2.7e-9, 1.3e-8, 2.0e-8);
+    const Real3 pos2(1.2e-8, 1.5e-8, 1.8e-8);
+    const VoxelSpaceBase::coordinate_type coord1(
+        space.position2coordinate(pos1)),
+        coord2(space.position2coordinate(pos2));
+
+    BOOST_CHECK(space.update_structure(Particle(structure, pos1, radius, D)));
+    BOOST_CHECK(space.update_voxel(sidgen(), sp, coord1));
+
+    // sp can move only onto the structure
+    BOOST_CHECK(!space.can_move(coord1, coord2));
+    BOOST_CHECK(!space.move(coord1, coord2));
+    BOOST_CHECK_EQUAL(space.get_voxel_pool_at(coord2), space.vacant());
+
+    BOOST_CHECK(space.update_structure(Particle(structure, pos2, radius, D)));
+    BOOST_CHECK(space.can_move(coord1, coord2));
+    BOOST_CHECK(space.move(coord1, coord2));
+    BOOST_CHECK_EQUAL(space.get_voxel_pool_at(coord1)->species(), structure);
+    BOOST_CHECK_EQUAL(space.get_voxel_pool_at(coord2)->species(), sp);
+
+    BOOST_CHECK(space.remove_voxel(coord2));
+    BOOST_CHECK_EQUAL(space.get_voxel_pool_at(coord2)->species(), structure);
+    BOOST_CHECK_EQUAL(space.list_voxels_exact(structure).size(), 2);
+    BOOST_CHECK_EQUAL(space.list_voxels_exact(sp).size(), 0);
+}
+
 #ifdef WITH_HDF5
 BOOST_AUTO_TEST_CASE(LatticeSpace_test_save_and_load)
 {
@@ -10,6 +10,7 @@
 #include <boost/test/tools/floating_point_comparison.hpp>
 
 #include <ecell4/core/OffLatticeSpace.hpp>
+#include <ecell4/core/Polygon.hpp>
 #include <ecell4/core/SerialIDGenerator.hpp>
 
 using namespace ecell4;
@@ -168,4 +169,42 @@ BOOST_AUTO_TEST_CASE(OffLatticeSpace_test_neighbor)
     BOOST_CHECK_EQUAL(space.get_neighbor(9, 0), 8);
 }
 
+BOOST_AUTO_TEST_CASE(OffLatticeSpace_test_find_adjoining_pairs)
+{
+    OffLatticeSpace::position_container positions;
+    const Real unit(voxel_radius / sqrt(3.0));
+    for (int i(9); i >= 0; --i)
+        positions.push_back(Real3(unit * i, unit * i, unit * i));
+    positions.push_back(Real3(0, 0, unit * 9));
+
+    const OffLatticeSpace::coordinate_pair_list_type pairs(
+        OffLatticeSpace::find_adjoining_pairs(positions, voxel_radius * 1.01));
+    BOOST_CHECK_EQUAL(pairs.size(), 9);
+    for (std::size_t i(0); i < pairs.size(); ++i)
+    {
+        BOOST_CHECK_EQUAL(pairs.at(i).first, i);
+        BOOST_CHECK_EQUAL(pairs.at(i).second, i + 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(OffLatticeSpace_test_polygon)
+{
+    const Polygon polygon(Real3(1e-7, 1e-7, 1e-7), Integer3(3, 3, 3));
+    const OffLatticeSpace polygon_space(voxel_radius, base, polygon);
+
+    BOOST_CHECK_EQUAL(polygon_space.size(), polygon.vertex_size());
+    BOOST_CHECK_EQUAL(polygon_space.vacant()->size(), polygon.vertex_size());
+    for (OffLatticeSpace::coordinate_type coord(0);
+         coord < polygon_space.size(); ++coord)
+    {
+        // a vertex of the periodic triangulated square has six edges
+        BOOST_CHECK_EQUAL(polygon_space.num_neighbors(coord), 6);
+        for (Integer i(0); i < polygon_space.num_neighbors(coord); ++i)
+        {
+            BOOST_CHECK(polygon_space.get_neighbor(coord, i) != coord);
+        }
+    }
+    BOOST_CHECK_THROW(polygon_space.get_neighbor(0, 6), NotFound);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
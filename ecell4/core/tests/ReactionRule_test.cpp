@@ -472,3 +472,78 @@ BOOST_AUTO_TEST_CASE(ReactionRule_test_generate6)
 }
 
 #undef ECELL4_TEST_REACTION_RULE_GENERATION
+
+BOOST_AUTO_TEST_CASE(ReactionRule_test_descriptor_expression)
+{
+    const Real V(2.0), t(0.5);
+    std::vector<Real> r(2), p(1);
+    r[0] = 3.0;
+    r[1] = 4.0;
+    p[0] = 5.0;
+
+    {
+        ReactionRuleDescriptorExpression desc("0.1 * r[0] * r[1] / (v * (2.0 + p[0] / v))");
+        BOOST_CHECK_CLOSE(desc.propensity(r, p, V, t), 0.1 * 3 * 4 / (V * (2.0 + 5 / V)), 1e-12);
+
+        const std::pair<std::vector<Real>, std::vector<Real> > derivs(desc.derivatives(r, p, V, t));
+        BOOST_CHECK_CLOSE(derivs.first[0], 0.1 * 4 / (V * (2.0 + 5 / V)), 1e-12);
+        BOOST_CHECK_CLOSE(derivs.first[1], 0.1 * 3 / (V * (2.0 + 5 / V)), 1e-12);
+        BOOST_CHECK_CLOSE(derivs.second[0], -0.1 * 3 * 4 / (V * V * std::pow(2.0 + 5 / V, 2)), 1e-12);
+    }
+
+    {
+        // the precedence of operators follows Python
+        ReactionRuleDescriptorExpression desc("-r[0] ** 2 ** 0.5 + 2 * -exp(t) - max(r[1], 1e+1) / 2");
+        BOOST_CHECK_CLOSE(
+            desc.propensity(r, p, V, t),
+            -std::pow(3.0, std::pow(2.0, 0.5)) + 2 * -std::exp(t) - 10.0 / 2, 1e-12);
+        BOOST_CHECK_CLOSE(
+            desc.derivatives(r, p, V, t).first[0],
+            -std::pow(2.0, 0.5) * std::pow(3.0, std::pow(2.0, 0.5) - 1), 1e-10);
+        BOOST_CHECK_EQUAL(desc.derivatives(r, p, V, t).first[1], 0.0);
+    }
+
+    {
+        ReactionRuleDescriptorExpression desc("r[0] ** rc[0]");
+        desc.set_reactant_coefficient(0, 2.0);
+        BOOST_CHECK_CLOSE(desc.propensity(r, p, V, t), 9.0, 1e-12);
+        BOOST_CHECK_THROW(desc.propensity(std::vector<Real>(), p, V, t), IllegalArgument);
+
+        std::unique_ptr<ReactionRuleDescriptor> clone(desc.clone());
+        BOOST_CHECK_CLOSE(clone->propensity(r, p, V, t), 9.0, 1e-12);
+    }
+
+    BOOST_CHECK_THROW(ReactionRuleDescriptorExpression("r[0] *"), IllegalArgument);
+    BOOST_CHECK_THROW(ReactionRuleDescriptorExpression("k * r[0]"), IllegalArgument);
+    BOOST_CHECK_THROW(ReactionRuleDescriptorExpression("(r[0]"), IllegalArgument);
+    BOOST_CHECK_THROW(ReactionRuleDescriptorExpression("r[0] r[1]"), IllegalArgument);
+}
+
+BOOST_AUTO_TEST_CASE(ReactionRule_test_descriptor_mass_action)
+{
+    const Real V(2.0), t(0.0);
+    std::vector<Real> coefficients(2);
+    coefficients[0] = 1.0;
+    coefficients[1] = 0.5;
+    ReactionRuleDescriptorMassAction desc(3.0, coefficients, std::vector<Real>());
+
+    std::vector<Real> r(2), p;
+    r[0] = 4.0;
+    r[1] = 8.0;
+    std::pair<std::vector<Real>, std::vector<Real> > derivs(desc.derivatives(r, p, V, t));
+    BOOST_CHECK_CLOSE(desc.propensity(r, p, V, t), 3.0 * V * (4.0 / V) * std::sqrt(8.0 / V), 1e-12);
+    BOOST_CHECK_CLOSE(derivs.first[0], 3.0 * std::sqrt(8.0 / V), 1e-12);
+    BOOST_CHECK_CLOSE(derivs.first[1], 3.0 * (4.0 / V) * 0.5 / std::sqrt(8.0 / V), 1e-12);
+
+    // no NaN nor infinity at zero
+    r[0] = 0.0;
+    r[1] = 0.0;
+    derivs = desc.derivatives(r, p, V, t);
+    BOOST_CHECK_EQUAL(derivs.first[0], 0.0);
+    BOOST_CHECK_EQUAL(derivs.first[1], 0.0);
+
+    r[1] = 8.0;
+    derivs = desc.derivatives(r, p, V, t);
+    BOOST_CHECK_CLOSE(derivs.first[0], 3.0 * std::sqrt(8.0 / V), 1e-12);
+    BOOST_CHECK_EQUAL(derivs.first[1], 0.0);
+}
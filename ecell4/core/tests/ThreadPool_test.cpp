@@ -0,0 +1,54 @@
+#define BOOST_TEST_MODULE "ThreadPool_test"
+
+#ifdef UNITTEST_FRAMEWORK_LIBRARY_EXIST
+#   include <boost/test/unit_test.hpp>
+#else
+#   define BOOST_TEST_NO_LIB
+#   include <boost/test/included/unit_test.hpp>
+#endif
+
+#include <stdexcept>
+#include <algorithm>
+
+#include <ecell4/core/types.hpp>
+#include <ecell4/core/ThreadPool.hpp>
+
+using namespace ecell4;
+
+BOOST_AUTO_TEST_CASE(ThreadPool_test_run)
+{
+    ThreadPool pool(4);
+    BOOST_CHECK_EQUAL(pool.num_threads(), 4);
+
+    std::vector<Integer> counts(100, 0);
+    for (Integer i(0); i < 50; ++i)
+    {
+        // each task must be called once in each run.
+        pool.run(counts.size(), [&](const std::size_t j) { ++counts[j]; });
+    }
+
+    for (std::vector<Integer>::const_iterator i(counts.begin()); i != counts.end(); ++i)
+    {
+        BOOST_CHECK_EQUAL(*i, 50);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPool_test_exception)
+{
+    ThreadPool pool(3);
+    BOOST_CHECK_THROW(
+        pool.run(10,
+            [](const std::size_t j)
+            {
+                if (j == 5)
+                {
+                    throw std::runtime_error("failed");
+                }
+            }),
+        std::runtime_error);
+
+    // the pool must be still available.
+    std::vector<Integer> counts(10, 0);
+    pool.run(counts.size(), [&](const std::size_t j) { ++counts[j]; });
+    BOOST_CHECK_EQUAL(std::count(counts.begin(), counts.end(), 1), 10);
+}
@@ -27,8 +27,8 @@ public:
 
 public:
 
-    GillespieFactory()
-        : base_type(), rng_()
+    GillespieFactory(const GillespieSelectionMethod method = default_selection_method())
+        : base_type(), rng_(), method_(method)
     {
         ; // do nothing
     }
@@ -38,6 +38,11 @@ public:
         ; // do nothing
     }
 
+    static inline const GillespieSelectionMethod default_selection_method()
+    {
+        return DIRECT_METHOD;
+    }
+
     this_type& rng(const std::shared_ptr<RandomNumberGenerator>& rng)
     {
         rng_ = rng;
@@ -63,9 +68,16 @@ protected:
         }
     }
 
+    virtual simulator_type* create_simulator(
+        const std::shared_ptr<world_type>& w, const std::shared_ptr<Model>& m) const
+    {
+        return new simulator_type(w, m, method_);
+    }
+
 protected:
 
     std::shared_ptr<RandomNumberGenerator> rng_;
+    GillespieSelectionMethod method_;
 };
 
 } // gillespie
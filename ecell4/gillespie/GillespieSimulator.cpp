@@ -15,30 +15,109 @@ namespace ecell4
 namespace gillespie
 {
 
-void GillespieSimulator::increment_molecules(const Species& sp)
+const GillespieSimulator::event_index_container_type&
+GillespieSimulator::dependent_events(const species_index_type idx)
 {
-    world_->add_molecules(sp, 1);
+    if (idx >= dependencies_.size())
+    {
+        dependencies_.resize(idx + 1);
+        has_dependencies_.resize(idx + 1, false);
+    }
+    else if (has_dependencies_[idx])
+    {
+        return dependencies_[idx];
+    }
+
+    event_index_container_type& events(dependencies_[idx]);
+    for (std::size_t i(0); i < events_.size(); ++i)
+    {
+        if (events_[i].depends_on(idx))
+        {
+            events.push_back(i);
+        }
+    }
+    has_dependencies_[idx] = true;
+    return events;
+}
+
+void GillespieSimulator::mark_dirty(const event_index_container_type& events)
+{
+    for (event_index_container_type::const_iterator i(events.begin());
+        i != events.end(); ++i)
+    {
+        if (!is_dirty_[*i])
+        {
+            is_dirty_[*i] = true;
+            dirty_events_.push_back(*i);
+        }
+    }
+}
 
-    for (boost::ptr_vector<ReactionRuleEvent>::iterator i(events_.begin());
-        i != events_.end(); ++i)
+void GillespieSimulator::increment_molecules(const Species& sp, const Integer num)
+{
+    const species_index_type idx(world_->get_species_index(sp));
+    world_->add_molecules_at(idx, num);
+
+    const event_index_container_type& events(dependent_events(idx));
+    for (event_index_container_type::const_iterator i(events.begin());
+        i != events.end(); ++i)
     {
-        (*i).inc(sp);
+        events_[*i].inc(idx, num);
     }
+    mark_dirty(events);
 }
 
 
-void GillespieSimulator::decrement_molecules(const Species& sp)
+void GillespieSimulator::decrement_molecules(const Species& sp, const Integer num)
 {
-    world_->remove_molecules(sp, 1);
+    const species_index_type idx(world_->get_species_index(sp));
+    world_->remove_molecules_at(idx, num);
 
-    for (boost::ptr_vector<ReactionRuleEvent>::iterator i(events_.begin());
-        i != events_.end(); ++i)
+    const event_index_container_type& events(dependent_events(idx));
+    for (event_index_container_type::const_iterator i(events.begin());
+        i != events.end(); ++i)
     {
-        (*i).dec(sp);
+        events_[*i].inc(idx, -num);
     }
+    mark_dirty(events);
 }
 
-bool GillespieSimulator::__draw_next_reaction(void)
+Real GillespieSimulator::draw_waiting_time(const Real a)
+{
+    if (a <= 0.0)
+    {
+        return std::numeric_limits<Real>::infinity();
+    }
+    else if (a == std::numeric_limits<Real>::infinity())
+    {
+        return 0.0;
+    }
+
+    const double rnd(rng()->uniform(0, 1));
+    return gsl_sf_log(1.0 / rnd) / a;
+}
+
+bool GillespieSimulator::select_infinite(std::size_t& idx)
+{
+    std::vector<std::size_t> selected;
+    for (std::size_t i(0); i < events_.size(); ++i)
+    {
+        if (events_[i].propensity() == std::numeric_limits<Real>::infinity())
+        {
+            selected.push_back(i);
+        }
+    }
+
+    if (selected.size() == 0)
+    {
+        return false;
+    }
+
+    idx = selected[(selected.size() == 1 ? 0 : rng()->uniform_int(0, selected.size() - 1))];
+    return true;
+}
+
+bool GillespieSimulator::select_direct(Real& dt, std::size_t& idx)
 {
     std::vector<double> a(events_.size());
     for (unsigned int i(0); i < events_.size(); ++i)
@@ -51,59 +130,295 @@ bool GillespieSimulator::__draw_next_reaction(void)
 
     if (atot == 0.0)
     {
-        // no reaction occurs
-        this->dt_ = std::numeric_limits<Real>::infinity();
-        return true;
+        return false;
     }
 
-    double dt = 0.0;
-    unsigned int idx = 0;
-
     if (atot == std::numeric_limits<double>::infinity())
     {
-        std::vector<unsigned int> selected;
-        for (unsigned int i(0); i < a.size(); ++i)
+        dt = 0.0;
+        return select_infinite(idx);
+    }
+
+    const double rnd1(rng()->uniform(0, 1));
+    const double rnd2(rng()->uniform(0, atot));
+
+    dt = gsl_sf_log(1.0 / rnd1) / double(atot);
+
+    double acc(0.0);
+
+    for (idx = 0; idx < a.size(); ++idx)
+    {
+        acc += a[idx];
+        if (acc >= rnd2)
         {
-            if (a[i] == std::numeric_limits<double>::infinity())
-            {
-                selected.push_back(i);
-            }
+            break;
         }
+    }
+    return true;
+}
 
-        dt = 0.0;
-        idx = selected[(selected.size() == 1 ? 0 : rng()->uniform_int(0, selected.size() - 1))];
+bool GillespieSimulator::select_next_reaction(Real& dt, std::size_t& idx)
+{
+    const firing_time_queue_type::value_type& top(firing_times_.top());
+    if (top.second == std::numeric_limits<Real>::infinity())
+    {
+        return false;
     }
-    else
+
+    idx = top.first;
+    dt = top.second - (t() + this->dt_);
+    return true;
+}
+
+bool GillespieSimulator::select_sum_tree(Real& dt, std::size_t& idx)
+{
+    const Real atot(sum_tree_[1]);
+
+    if (atot == 0.0)
     {
-        const double rnd1(rng()->uniform(0, 1));
-        const double rnd2(rng()->uniform(0, atot));
+        return false;
+    }
 
-        dt = gsl_sf_log(1.0 / rnd1) / double(atot);
+    if (atot == std::numeric_limits<Real>::infinity())
+    {
+        dt = 0.0;
+        return select_infinite(idx);
+    }
 
-        double acc(0.0);
+    const double rnd1(rng()->uniform(0, 1));
+    Real rnd2(rng()->uniform(0, atot));
 
-        for (idx = 0; idx < a.size(); ++idx)
+    dt = gsl_sf_log(1.0 / rnd1) / double(atot);
+
+    // Descend the tree. A child with zero weight is never chosen, so that
+    // the rounding error of partial sums cannot lead to an empty leaf.
+    std::size_t node(1);
+    while (node < num_leaves_)
+    {
+        const std::size_t left(2 * node), right(2 * node + 1);
+        if (sum_tree_[right] <= 0.0 || (rnd2 < sum_tree_[left] && sum_tree_[left] > 0.0))
         {
-            acc += a[idx];
-            if (acc >= rnd2)
-            {
-                break;
-            }
+            node = left;
+        }
+        else
+        {
+            rnd2 -= sum_tree_[left];
+            node = right;
         }
     }
 
+    idx = node - num_leaves_;
+    assert(idx < events_.size());
+    return true;
+}
+
+bool GillespieSimulator::__draw_next_reaction(void)
+{
+    Real dt(0.0);
+    std::size_t idx(0);
+    bool selected(false);
+
+    switch (method_)
+    {
+    case NEXT_REACTION_METHOD:
+        selected = select_next_reaction(dt, idx);
+        break;
+    case SUM_TREE_METHOD:
+        selected = select_sum_tree(dt, idx);
+        break;
+    case DIRECT_METHOD:
+    default:
+        selected = select_direct(dt, idx);
+        break;
+    }
+
+    if (!selected)
+    {
+        // no reaction occurs
+        this->dt_ = std::numeric_limits<Real>::infinity();
+        return true;
+    }
+
+    next_event_ = idx;
     next_reaction_rule_ = events_[idx].reaction_rule();
     boost::optional<ReactionRule> r = events_[idx].draw();
     this->dt_ += dt;
 
     if (!r)
     {
+        if (method_ == NEXT_REACTION_METHOD)
+        {
+            // A rejected trial changes nothing but the clock of its own.
+            firing_times_.replace(firing_time_queue_type::value_type(
+                idx, t() + this->dt_ + draw_waiting_time(propensities_[idx])));
+        }
         return false;
     }
     next_reaction_ = r.get();
     return true;
 }
 
+void GillespieSimulator::update_sum_tree(const std::size_t idx)
+{
+    std::size_t node(num_leaves_ + idx);
+    sum_tree_[node] = propensities_[idx];
+    for (node /= 2; node > 0; node /= 2)
+    {
+        // Recompute instead of adding the difference to avoid drift.
+        sum_tree_[node] = sum_tree_[2 * node] + sum_tree_[2 * node + 1];
+    }
+}
+
+void GillespieSimulator::update_propensity(const std::size_t idx, const bool fired)
+{
+    const Real a_old(propensities_[idx]);
+    const Real a_new(events_[idx].propensity());
+
+    if (!fired && a_new == a_old)
+    {
+        return;
+    }
+
+    propensities_[idx] = a_new;
+
+    switch (method_)
+    {
+    case NEXT_REACTION_METHOD:
+        {
+            const Real t0(t());
+            const Real tau(firing_times_.get(idx));
+            Real next_time;
+            if (!fired && a_new > 0.0 && a_old > 0.0
+                && a_old != std::numeric_limits<Real>::infinity()
+                && a_new != std::numeric_limits<Real>::infinity()
+                && tau != std::numeric_limits<Real>::infinity())
+            {
+                // Reuse the waiting time by rescaling (Gibson & Bruck, 2000).
+                next_time = t0 + (a_old / a_new) * (tau - t0);
+            }
+            else
+            {
+                next_time = t0 + draw_waiting_time(a_new);
+            }
+            firing_times_.replace(firing_time_queue_type::value_type(idx, next_time));
+        }
+        break;
+    case SUM_TREE_METHOD:
+        update_sum_tree(idx);
+        break;
+    case DIRECT_METHOD:
+    default:
+        break;
+    }
+}
+
+void GillespieSimulator::update_propensities(void)
+{
+    if (method_ != DIRECT_METHOD)
+    {
+        update_propensity(next_event_, true);
+
+        for (event_index_container_type::const_iterator i(dirty_events_.begin());
+            i != dirty_events_.end(); ++i)
+        {
+            if (*i != next_event_)
+            {
+                update_propensity(*i, false);
+            }
+        }
+
+        for (event_index_container_type::const_iterator i(time_dependent_events_.begin());
+            i != time_dependent_events_.end(); ++i)
+        {
+            if (*i != next_event_ && !is_dirty_[*i])
+            {
+                update_propensity(*i, false);
+            }
+        }
+    }
+
+    for (event_index_container_type::const_iterator i(dirty_events_.begin());
+        i != dirty_events_.end(); ++i)
+    {
+        is_dirty_[*i] = false;
+    }
+    dirty_events_.clear();
+}
+
+void GillespieSimulator::update_time_dependent_propensities(void)
+{
+    // The direct method evaluates all propensities at every draw.
+    if (method_ == DIRECT_METHOD)
+    {
+        return;
+    }
+
+    for (event_index_container_type::const_iterator i(time_dependent_events_.begin());
+        i != time_dependent_events_.end(); ++i)
+    {
+        update_propensity(*i, false);
+    }
+}
+
+void GillespieSimulator::initialize_selection(void)
+{
+    dependencies_.clear();
+    has_dependencies_.clear();
+    dirty_events_.clear();
+    is_dirty_.assign(events_.size(), false);
+    time_dependent_events_.clear();
+    for (std::size_t i(0); i < events_.size(); ++i)
+    {
+        if (events_[i].is_time_dependent())
+        {
+            time_dependent_events_.push_back(i);
+        }
+    }
+
+    propensities_.clear();
+    sum_tree_.clear();
+    num_leaves_ = 0;
+    firing_times_.clear();
+
+    if (method_ == DIRECT_METHOD)
+    {
+        return;
+    }
+
+    propensities_.resize(events_.size());
+    for (std::size_t i(0); i < events_.size(); ++i)
+    {
+        propensities_[i] = events_[i].propensity();
+    }
+
+    switch (method_)
+    {
+    case NEXT_REACTION_METHOD:
+        for (std::size_t i(0); i < events_.size(); ++i)
+        {
+            firing_times_.push(t() + draw_waiting_time(propensities_[i]));
+        }
+        break;
+    case SUM_TREE_METHOD:
+        num_leaves_ = 1;
+        while (num_leaves_ < events_.size())
+        {
+            num_leaves_ *= 2;
+        }
+        sum_tree_.resize(2 * num_leaves_, 0.0);
+        std::copy(propensities_.begin(), propensities_.end(),
+            sum_tree_.begin() + num_leaves_);
+        for (std::size_t node(num_leaves_ - 1); node > 0; --node)
+        {
+            sum_tree_[node] = sum_tree_[2 * node] + sum_tree_[2 * node + 1];
+        }
+        break;
+    case DIRECT_METHOD:
+    default:
+        break;
+    }
+}
+
 void GillespieSimulator::draw_next_reaction(void)
 {
     if (events_.size() == 0)
@@ -191,6 +506,8 @@ void GillespieSimulator::step(void)
     this->set_t(t0 + dt0);
     num_steps_++;
 
+    update_propensities();
+
     last_reactions_.push_back(
         std::make_pair(
             next_reaction_rule_,
@@ -217,6 +534,7 @@ bool GillespieSimulator::step(const Real &upto)
         // set_dt(next_time() - upto);
         set_t(upto);
         last_reactions_.clear();
+        update_time_dependent_propensities();
         draw_next_reaction();
         return false;
     }
@@ -309,6 +627,7 @@ void GillespieSimulator::initialize(void)
         events_.back().initialize();
     }
 
+    initialize_selection();
     this->draw_next_reaction();
 }
 
@@ -4,6 +4,8 @@
 #include <limits>
 #include <stdexcept>
 #include <memory>
+#include <map>
+#include <algorithm>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <boost/optional.hpp>
 
@@ -11,6 +13,7 @@
 #include <ecell4/core/Model.hpp>
 #include <ecell4/core/NetworkModel.hpp>
 #include <ecell4/core/SimulatorBase.hpp>
+#include <ecell4/core/DynamicPriorityQueue.hpp>
 
 #include "GillespieWorld.hpp"
 
@@ -21,6 +24,20 @@ namespace ecell4
 namespace gillespie
 {
 
+/**
+ * A strategy to select the next reaction.
+ * DIRECT_METHOD scans all propensities every step (O(R)).
+ * NEXT_REACTION_METHOD keeps the putative firing time of each reaction
+ * in a priority queue (Gibson & Bruck, O(log R)).
+ * SUM_TREE_METHOD keeps propensities in a binary sum tree and draws
+ * the reaction by a tree descent (O(log R)).
+ */
+enum GillespieSelectionMethod {
+    DIRECT_METHOD = 0,
+    NEXT_REACTION_METHOD = 1,
+    SUM_TREE_METHOD = 2,
+};
+
 class ReactionInfo
 {
 public:
@@ -82,18 +99,30 @@ public:
 
 protected:
 
+    typedef DynamicPriorityQueue<Real, std::less_equal<Real>, volatile_id_policy<> >
+        firing_time_queue_type;
+    typedef GillespieWorld::species_index_type species_index_type;
+    typedef std::vector<std::size_t> event_index_container_type;
+    typedef std::vector<event_index_container_type> dependency_container_type;
+    typedef std::vector<species_index_type> species_index_container_type;
+
     class ReactionRuleEvent
     {
     public:
 
+        typedef std::map<species_index_container_type, std::vector<ReactionRule> >
+            reaction_cache_type;
+
         ReactionRuleEvent()
-            : sim_(), rr_()
+            : sim_(), rr_(), coefficients_(), reactions_()
         {
             ;
         }
 
         ReactionRuleEvent(GillespieSimulator* sim, const ReactionRule& rr)
-            : sim_(sim), rr_(rr)
+            : sim_(sim), rr_(rr),
+            coefficients_(rr.reactants().size() + rr.products().size()),
+            reactions_()
         {
             ;
         }
@@ -108,36 +137,102 @@ protected:
             return rr_;
         }
 
-        inline const Integer get_coef(const Species& pttrn, const Species& sp) const
+        /**
+         * return the number of matches of the k-th pattern of the rule,
+         * which counts reactants first and then products, with the species
+         * at idx of the world. The result is memoized.
+         */
+        inline const Integer get_coef(const std::size_t k, const species_index_type idx) const
         {
-            return sim_->model()->apply(pttrn, sp);
+            std::vector<Integer>& coefs(coefficients_[k]);
+            if (idx >= coefs.size())
+            {
+                coefs.resize(std::max(idx + 1, world().num_species()), -1);
+            }
+            if (coefs[idx] < 0)
+            {
+                const Species& pttrn(
+                    k < rr_.reactants().size() ? rr_.reactants()[k]
+                        : rr_.products()[k - rr_.reactants().size()]);
+                coefs[idx] = sim_->model()->apply(pttrn, world().species_at(idx));
+            }
+            return coefs[idx];
         }
 
-        inline const std::vector<ReactionRule> generate(
-            const ReactionRule::reactant_container_type& reactants) const
+        /**
+         * return the reactions generated from the rule with the reactants
+         * at the given indices of the world. The result is memoized up to
+         * max_reaction_cache_size() combinations of reactants.
+         */
+        const std::vector<ReactionRule>& generate(
+            const species_index_container_type& reactants) const
         {
-            return sim_->model()->apply(rr_, reactants);
+            reaction_cache_type::const_iterator it(reactions_.find(reactants));
+            if (it != reactions_.end())
+            {
+                return (*it).second;
+            }
+
+            if (reactions_.size() >= max_reaction_cache_size())
+            {
+                reactions_.clear();
+            }
+
+            ReactionRule::reactant_container_type species;
+            species.reserve(reactants.size());
+            for (species_index_container_type::const_iterator i(reactants.begin());
+                i != reactants.end(); ++i)
+            {
+                species.push_back(world().species_at(*i));
+            }
+            return (*reactions_.insert(
+                std::make_pair(reactants, sim_->model()->apply(rr_, species))).first).second;
         }
 
         virtual void initialize() = 0;
-        virtual void inc(const Species& sp, const Integer val = +1) = 0;
+        virtual void inc(const species_index_type idx, const Integer val = +1) = 0;
         virtual const Real propensity() const = 0;
 
-        inline void dec(const Species& sp)
+        /**
+         * return true if the propensity may change with the number of
+         * the species at idx.
+         */
+        virtual bool depends_on(const species_index_type idx) const
+        {
+            for (std::size_t k(0); k < rr_.reactants().size(); ++k)
+            {
+                if (get_coef(k, idx) > 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /**
+         * return true if the propensity must be re-evaluated at every step
+         * regardless of the change in the number of molecules.
+         */
+        virtual bool is_time_dependent() const
+        {
+            return false;
+        }
+
+        inline void dec(const species_index_type idx)
         {
-            inc(sp, -1);
+            inc(idx, -1);
         }
 
         boost::optional<ReactionRule> draw()
         {
-            const std::pair<ReactionRule::reactant_container_type, Integer>
+            const std::pair<species_index_container_type, Integer>
                 retval(__draw());
             if (retval.second == 0)
             {
                 return boost::none;
             }
 
-            const std::vector<ReactionRule> reactions(generate(retval.first));
+            const std::vector<ReactionRule>& reactions(generate(retval.first));
 
             assert(retval.second > 0);
             assert(retval.second >= static_cast<Integer>(reactions.size()));
@@ -176,13 +271,20 @@ protected:
             return (*sim_->world());
         }
 
-        virtual std::pair<ReactionRule::reactant_container_type, Integer>
+        /**
+         * draw reactants and return their indices in the world with
+         * the number of possible ways to react, or zero if not found.
+         */
+        virtual std::pair<species_index_container_type, Integer>
             __draw() = 0;
 
     protected:
 
         GillespieSimulator* sim_;
         ReactionRule rr_;
+
+        mutable std::vector<std::vector<Integer> > coefficients_;
+        mutable reaction_cache_type reactions_;
     };
 
     class ZerothOrderReactionRuleEvent
@@ -204,7 +306,7 @@ protected:
             ;
         }
 
-        void inc(const Species& sp, const Integer val = +1)
+        void inc(const species_index_type idx, const Integer val = +1)
         {
             ; // do nothing
         }
@@ -214,9 +316,14 @@ protected:
             ; // do nothing
         }
 
-        std::pair<ReactionRule::reactant_container_type, Integer> __draw()
+        bool depends_on(const species_index_type idx) const
+        {
+            return false;
+        }
+
+        std::pair<species_index_container_type, Integer> __draw()
         {
-            return std::make_pair(ReactionRule::reactant_container_type(), 1);
+            return std::make_pair(species_index_container_type(), 1);
         }
 
         const Real propensity() const
@@ -244,10 +351,9 @@ protected:
             ;
         }
 
-        void inc(const Species& sp, const Integer val = +1)
+        void inc(const species_index_type idx, const Integer val = +1)
         {
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-            const Integer coef(get_coef(reactants[0], sp));
+            const Integer coef(get_coef(0, idx));
             if (coef > 0)
             {
                 num_tot1_ += coef * val;
@@ -256,45 +362,37 @@ protected:
 
         void initialize()
         {
-            const std::vector<Species>& species(world().list_species());
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-
             num_tot1_ = 0;
-            for (std::vector<Species>::const_iterator i(species.begin());
-                i != species.end(); ++i)
+            for (species_index_type i(0); i < world().num_species(); ++i)
             {
-                const Integer coef(get_coef(reactants[0], *i));
+                const Integer coef(get_coef(0, i));
                 if (coef > 0)
                 {
-                    num_tot1_ += coef * world().num_molecules_exact(*i);
+                    num_tot1_ += coef * world().num_molecules_at(i);
                 }
             }
         }
 
-        std::pair<ReactionRule::reactant_container_type, Integer> __draw()
+        std::pair<species_index_container_type, Integer> __draw()
         {
-            const std::vector<Species>& species(world().list_species());
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-
             const Real rnd1(rng()->uniform(0.0, num_tot1_));
 
             Integer num_tot(0);
-            for (std::vector<Species>::const_iterator i(species.begin());
-                i != species.end(); ++i)
+            for (species_index_type i(0); i < world().num_species(); ++i)
             {
-                const Integer coef(get_coef(reactants[0], *i));
+                const Integer coef(get_coef(0, i));
                 if (coef > 0)
                 {
-                    num_tot += coef * world().num_molecules_exact(*i);
+                    num_tot += coef * world().num_molecules_at(i);
                     if (num_tot >= rnd1)
                     {
                         return std::make_pair(
-                            ReactionRule::reactant_container_type(1, *i), coef);
+                            species_index_container_type(1, i), coef);
                     }
                 }
             }
 
-            return std::make_pair(ReactionRule::reactant_container_type(), 0);
+            return std::make_pair(species_index_container_type(), 0);
         }
 
         const Real propensity() const
@@ -326,11 +424,10 @@ protected:
             ;
         }
 
-        void inc(const Species& sp, const Integer val = +1)
+        void inc(const species_index_type idx, const Integer val = +1)
         {
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-            const Integer coef1(get_coef(reactants[0], sp));
-            const Integer coef2(get_coef(reactants[1], sp));
+            const Integer coef1(get_coef(0, idx));
+            const Integer coef2(get_coef(1, idx));
             if (coef1 > 0 || coef2 > 0)
             {
                 const Integer tmp(coef1 * val);
@@ -342,20 +439,16 @@ protected:
 
         void initialize()
         {
-            const std::vector<Species>& species(world().list_species());
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-
             num_tot1_ = 0;
             num_tot2_ = 0;
             num_tot12_ = 0;
-            for (std::vector<Species>::const_iterator i(species.begin());
-                i != species.end(); ++i)
+            for (species_index_type i(0); i < world().num_species(); ++i)
             {
-                const Integer coef1(get_coef(reactants[0], *i));
-                const Integer coef2(get_coef(reactants[1], *i));
+                const Integer coef1(get_coef(0, i));
+                const Integer coef2(get_coef(1, i));
                 if (coef1 > 0 || coef2 > 0)
                 {
-                    const Integer num(world().num_molecules_exact(*i));
+                    const Integer num(world().num_molecules_at(i));
                     const Integer tmp(coef1 * num);
                     num_tot1_ += tmp;
                     num_tot2_ += coef2 * num;
@@ -364,21 +457,20 @@ protected:
             }
         }
 
-        std::pair<ReactionRule::reactant_container_type, Integer> __draw()
+        std::pair<species_index_container_type, Integer> __draw()
         {
-            const std::vector<Species>& species(world().list_species());
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
+            const species_index_type num_species(world().num_species());
 
             const Real rnd1(rng()->uniform(0.0, num_tot1_));
 
             Integer num_tot(0), coef1(0);
-            std::vector<Species>::const_iterator itr1(species.begin());
-            for (; itr1 != species.end(); ++itr1)
+            species_index_type idx1(0);
+            for (; idx1 < num_species; ++idx1)
             {
-                const Integer coef(get_coef(reactants[0], *itr1));
+                const Integer coef(get_coef(0, idx1));
                 if (coef > 0)
                 {
-                    num_tot += coef * world().num_molecules_exact(*itr1);
+                    num_tot += coef * world().num_molecules_at(idx1);
                     if (num_tot >= rnd1)
                     {
                         coef1 = coef;
@@ -387,29 +479,33 @@ protected:
                 }
             }
 
+            if (idx1 == num_species)
+            {
+                return std::make_pair(species_index_container_type(), 0);
+            }
+
             const Real rnd2(
-                rng()->uniform(0.0, num_tot2_ - get_coef(reactants[0], *itr1)));
+                rng()->uniform(0.0, num_tot2_ - get_coef(0, idx1)));
 
             num_tot = 0;
-            for (std::vector<Species>::const_iterator i(species.begin());
-                i != species.end(); ++i)
+            for (species_index_type i(0); i < num_species; ++i)
             {
-                const Integer coef(get_coef(reactants[1], *i));
+                const Integer coef(get_coef(1, i));
                 if (coef > 0)
                 {
-                    const Integer num(world().num_molecules_exact(*i));
-                    num_tot += coef * (i == itr1 ? num - 1 : num);
+                    const Integer num(world().num_molecules_at(i));
+                    num_tot += coef * (i == idx1 ? num - 1 : num);
                     if (num_tot >= rnd2)
                     {
-                        ReactionRule::reactant_container_type exact_reactants(2);
-                        exact_reactants[0] = *itr1;
-                        exact_reactants[1] = *i;
+                        species_index_container_type exact_reactants(2);
+                        exact_reactants[0] = idx1;
+                        exact_reactants[1] = i;
                         return std::make_pair(exact_reactants, coef1 * coef);
                     }
                 }
             }
 
-            return std::make_pair(ReactionRule::reactant_container_type(), 0);
+            return std::make_pair(species_index_container_type(), 0);
         }
 
         const Real propensity() const
@@ -443,22 +539,21 @@ protected:
             ;
         }
 
-        void inc(const Species& sp, const Integer val = +1)
+        void inc(const species_index_type idx, const Integer val = +1)
         {
-            const ReactionRule::reactant_container_type& reactants(rr_.reactants());
-            for (std::size_t i = 0; i < reactants.size(); ++i)
+            const std::size_t num_reactants(rr_.reactants().size());
+            for (std::size_t i = 0; i < num_reactants; ++i)
             {
-                const Integer coef(get_coef(reactants[i], sp));
+                const Integer coef(get_coef(i, idx));
                 if (coef > 0)
                 {
                     num_reactants_[i] += coef * val;
                 }
             }
 
-            const ReactionRule::product_container_type& products(rr_.products());
-            for (std::size_t i = 0; i < products.size(); ++i)
+            for (std::size_t i = 0; i < rr_.products().size(); ++i)
             {
-                const Integer coef(get_coef(products[i], sp));
+                const Integer coef(get_coef(num_reactants + i, idx));
                 if (coef > 0)
                 {
                     num_products_[i] += coef * val;
@@ -466,47 +561,66 @@ protected:
             }
         }
 
-        void initialize()
+        bool depends_on(const species_index_type idx) const
+        {
+            if (base_type::depends_on(idx))
+            {
+                return true;
+            }
+
+            const std::size_t num_reactants(rr_.reactants().size());
+            for (std::size_t i = 0; i < rr_.products().size(); ++i)
+            {
+                if (get_coef(num_reactants + i, idx) > 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool is_time_dependent() const
         {
-            const std::vector<Species>& species(world().list_species());
+            return true;
+        }
 
+        void initialize()
+        {
             const ReactionRule::reactant_container_type& reactants(rr_.reactants());
             std::fill(num_reactants_.begin(), num_reactants_.end(), 0);
             num_reactants_.resize(reactants.size(), 0);
             const ReactionRule::product_container_type& products(rr_.products());
             std::fill(num_products_.begin(), num_products_.end(), 0);
             num_products_.resize(products.size(), 0);
-            for (std::vector<Species>::const_iterator it(species.begin());
-                it != species.end(); ++it)
+            for (species_index_type idx(0); idx < world().num_species(); ++idx)
             {
-                const Species& sp(*it);
+                const Integer num(world().num_molecules_at(idx));
 
                 for (std::size_t i = 0; i < reactants.size(); ++i)
                 {
-                    const Integer coef(get_coef(reactants[i], sp));
+                    const Integer coef(get_coef(i, idx));
                     if (coef > 0)
                     {
-                        num_reactants_[i] += coef * world().num_molecules_exact(sp);
+                        num_reactants_[i] += coef * num;
                     }
                 }
 
                 for (std::size_t i = 0; i < products.size(); ++i)
                 {
-                    const Integer coef(get_coef(products[i], sp));
+                    const Integer coef(get_coef(reactants.size() + i, idx));
                     if (coef > 0)
                     {
-                        num_products_[i] += coef * world().num_molecules_exact(sp);
+                        num_products_[i] += coef * num;
                     }
                 }
             }
         }
 
-        std::pair<ReactionRule::reactant_container_type, Integer> __draw()
+        std::pair<species_index_container_type, Integer> __draw()
         {
-            const std::vector<Species>& species(world().list_species());
             const ReactionRule::reactant_container_type& reactants(rr_.reactants());
 
-            std::pair<ReactionRule::reactant_container_type, Integer> ret;
+            std::pair<species_index_container_type, Integer> ret;
             ret.second = 1;
 
             for (std::size_t i = 0; i < reactants.size(); ++i)
@@ -514,17 +628,15 @@ protected:
                 assert(num_reactants_[i] > 0);
                 const Real rnd(rng()->uniform(0.0, num_reactants_[i]));
                 Integer num_tot(0);
-                for (std::vector<Species>::const_iterator it(species.begin());
-                    it != species.end(); ++it)
+                for (species_index_type idx(0); idx < world().num_species(); ++idx)
                 {
-                    const Species& sp(*it);
-                    const Integer coef(get_coef(reactants[i], sp));
+                    const Integer coef(get_coef(i, idx));
                     if (coef > 0)
                     {
-                        num_tot += coef * world().num_molecules_exact(sp);
+                        num_tot += coef * world().num_molecules_at(idx);
                         if (num_tot >= rnd)
                         {
-                            ret.first.push_back(sp);
+                            ret.first.push_back(idx);
                             ret.second *= coef;
                             break;
                         }
@@ -554,14 +666,17 @@ public:
 
     GillespieSimulator(
         std::shared_ptr<GillespieWorld> world,
-        std::shared_ptr<Model> model)
-        : base_type(world, model)
+        std::shared_ptr<Model> model,
+        const GillespieSelectionMethod method = DIRECT_METHOD)
+        : base_type(world, model), method_(method), next_event_(0)
     {
         initialize();
     }
 
-    GillespieSimulator(std::shared_ptr<GillespieWorld> world)
-        : base_type(world)
+    GillespieSimulator(
+        std::shared_ptr<GillespieWorld> world,
+        const GillespieSelectionMethod method = DIRECT_METHOD)
+        : base_type(world), method_(method), next_event_(0)
     {
         initialize();
     }
@@ -594,21 +709,77 @@ public:
         return (*world_).rng();
     }
 
+    GillespieSelectionMethod selection_method() const
+    {
+        return method_;
+    }
+
+    /**
+     * the maximum number of combinations of reactants, for which
+     * the reactions generated from a rule are kept.
+     */
+    static inline const std::size_t max_reaction_cache_size()
+    {
+        return 1024;
+    }
+
 protected:
 
     bool __draw_next_reaction(void);
     void draw_next_reaction(void);
-    void increment_molecules(const Species& sp);
-    void decrement_molecules(const Species& sp);
+    void increment_molecules(const Species& sp, const Integer num = 1);
+    void decrement_molecules(const Species& sp, const Integer num = 1);
     void check_model(void);
 
+    bool select_direct(Real& dt, std::size_t& idx);
+    bool select_next_reaction(Real& dt, std::size_t& idx);
+    bool select_sum_tree(Real& dt, std::size_t& idx);
+    bool select_infinite(std::size_t& idx);
+
+    const event_index_container_type& dependent_events(const species_index_type idx);
+    void mark_dirty(const event_index_container_type& events);
+
+    void initialize_selection(void);
+    void update_propensity(const std::size_t idx, const bool fired);
+    void update_propensities(void);
+    void update_time_dependent_propensities(void);
+    void update_sum_tree(const std::size_t idx);
+    Real draw_waiting_time(const Real a);
+
 protected:
 
+    GillespieSelectionMethod method_;
+
     Real dt_;
     ReactionRule next_reaction_rule_, next_reaction_;
+    std::size_t next_event_;
     std::vector<std::pair<ReactionRule, reaction_info_type> > last_reactions_;
 
     boost::ptr_vector<ReactionRuleEvent> events_;
+
+    /**
+     * dependencies_ lists the events whose propensity depends on a species
+     * for each species index of the world. It is filled lazily as species
+     * appear during the simulation, and has_dependencies_ tells if filled.
+     * dirty_events_ lists the events touched since the last reaction, and
+     * time_dependent_events_ those to be re-evaluated at every step.
+     */
+    dependency_container_type dependencies_;
+    std::vector<bool> has_dependencies_;
+    event_index_container_type dirty_events_, time_dependent_events_;
+    std::vector<bool> is_dirty_;
+
+    /**
+     * caches for NEXT_REACTION_METHOD and SUM_TREE_METHOD.
+     * propensities_ holds the last propensity evaluated for each event.
+     * sum_tree_ is a complete binary tree whose leaves start at num_leaves_.
+     * firing_times_ holds the absolute putative firing time of each event,
+     * whose identifier is the index of the event.
+     */
+    std::vector<Real> propensities_;
+    std::vector<Real> sum_tree_;
+    std::size_t num_leaves_;
+    firing_time_queue_type firing_times_;
 };
 
 }
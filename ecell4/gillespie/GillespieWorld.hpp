@@ -28,6 +28,10 @@ namespace gillespie
 class GillespieWorld
     : public WorldInterface
 {
+public:
+
+    typedef CompartmentSpace::species_index_type species_index_type;
+
 public:
 
     GillespieWorld(const Real3& edge_lengths,
@@ -87,6 +91,40 @@ public:
     void add_molecules(const Species& sp, const Integer& num);
     void remove_molecules(const Species& sp, const Integer& num);
 
+    /**
+     * the interned species-index API. a species resolves once to a dense
+     * index, which stays valid until the world is reset or loaded.
+     */
+    species_index_type get_species_index(const Species& sp)
+    {
+        return cs_->get_species_index(sp);
+    }
+
+    species_index_type num_species() const
+    {
+        return cs_->num_species();
+    }
+
+    const Species& species_at(const species_index_type idx) const
+    {
+        return cs_->species_at(idx);
+    }
+
+    Integer num_molecules_at(const species_index_type idx) const
+    {
+        return cs_->num_molecules_at(idx);
+    }
+
+    void add_molecules_at(const species_index_type idx, const Integer& num)
+    {
+        cs_->add_molecules_at(idx, num);
+    }
+
+    void remove_molecules_at(const species_index_type idx, const Integer& num)
+    {
+        cs_->remove_molecules_at(idx, num);
+    }
+
     inline const std::shared_ptr<RandomNumberGenerator>& rng()
     {
         return rng_;
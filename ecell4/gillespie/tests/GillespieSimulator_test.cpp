@@ -7,12 +7,16 @@
 #   include <boost/test/included/unit_test.hpp>
 #endif
 
+#include <cmath>
+
 #include <ecell4/core/RandomNumberGenerator.hpp>
 #include <ecell4/core/Model.hpp>
 #include <ecell4/core/NetworkModel.hpp>
+#include <ecell4/core/NetfreeModel.hpp>
 
 #include <ecell4/gillespie/GillespieWorld.cpp>
 #include <ecell4/gillespie/GillespieSimulator.hpp>
+#include <ecell4/gillespie/GillespieFactory.hpp>
 
 using namespace ecell4;
 using namespace ecell4::gillespie;
@@ -47,3 +51,148 @@ BOOST_AUTO_TEST_CASE(GillespieSimulator_test_step)
     BOOST_CHECK(world->num_molecules(sp1) == 9);
 
 }
+
+void check_selection_method(const GillespieSelectionMethod method)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    Species sp3("C");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+    model->add_reaction_rule(create_binding_reaction_rule(sp2, sp2, sp3, 0.0));
+    model->add_reaction_rule(create_degradation_reaction_rule(sp3, 0.0));
+
+    const Real L(1.0);
+    const Real3 edge_lengths(L, L, L);
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(edge_lengths, rng));
+
+    const Integer N(1000);
+    world->add_molecules(sp1, N);
+
+    GillespieSimulator sim(world, model, method);
+    BOOST_CHECK_EQUAL(sim.selection_method(), method);
+
+    sim.run(1.0);
+
+    BOOST_CHECK_EQUAL(world->num_molecules(sp1) + world->num_molecules(sp2), N);
+    BOOST_CHECK_EQUAL(world->num_molecules(sp3), 0);
+
+    // the mean is N exp(-1) and the standard deviation is about 15.
+    const Real expected(N * std::exp(-1.0));
+    BOOST_CHECK(std::abs(world->num_molecules(sp1) - expected) < 6 * 15.3);
+}
+
+BOOST_AUTO_TEST_CASE(GillespieSimulator_test_selection_method)
+{
+    check_selection_method(DIRECT_METHOD);
+    check_selection_method(NEXT_REACTION_METHOD);
+    check_selection_method(SUM_TREE_METHOD);
+}
+
+Real switched_propensity(
+    const ReactionRuleDescriptor::state_container_type& r,
+    const ReactionRuleDescriptor::state_container_type& p,
+    Real volume, Real t, const ReactionRuleDescriptorCPPfunc& rd)
+{
+    // no reaction before t = 1
+    return (t < 1.0 ? 0.0 : 1e+6 * r[0]);
+}
+
+void check_step_upto(const GillespieSelectionMethod method)
+{
+    ReactionRule rr1;
+    rr1.add_reactant(Species("A"));
+    rr1.add_product(Species("B"));
+    rr1.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+        new ReactionRuleDescriptorCPPfunc(
+            switched_propensity, std::vector<Real>(1, 1.0), std::vector<Real>(1, 1.0))));
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(rr1);
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+    world->add_molecules(Species("A"), 10);
+
+    GillespieSimulator sim(world, model, method);
+    BOOST_CHECK(!sim.step(1.0));
+    BOOST_CHECK_EQUAL(sim.t(), 1.0);
+
+    // the propensity must be re-evaluated at t = 1.
+    BOOST_CHECK(sim.next_time() < 1.1);
+    sim.run(0.1);
+    BOOST_CHECK_EQUAL(world->num_molecules(Species("A")), 0);
+    BOOST_CHECK_EQUAL(world->num_molecules(Species("B")), 10);
+}
+
+BOOST_AUTO_TEST_CASE(GillespieSimulator_test_step_upto)
+{
+    check_step_upto(DIRECT_METHOD);
+    check_step_upto(NEXT_REACTION_METHOD);
+    check_step_upto(SUM_TREE_METHOD);
+}
+
+BOOST_AUTO_TEST_CASE(GillespieSimulator_test_netfree_model)
+{
+    std::shared_ptr<NetfreeModel> model(new NetfreeModel());
+    model->add_reaction_rule(
+        create_unimolecular_reaction_rule(Species("X(q=a)"), Species("X(q=b)"), 1.0));
+    model->add_reaction_rule(
+        create_binding_reaction_rule(
+            Species("X(p)"), Species("X(p)"), Species("X(p^1).X(p^1)"), 1.0));
+    model->add_reaction_rule(
+        create_unbinding_reaction_rule(
+            Species("X(p^1).X(p^1)"), Species("X(p)"), Species("X(p)"), 1.0));
+
+    const GillespieSelectionMethod methods[] = {
+        DIRECT_METHOD, NEXT_REACTION_METHOD, SUM_TREE_METHOD};
+
+    for (std::size_t i(0); i < 3; ++i)
+    {
+        std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+        rng->seed(0);
+        std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+        world->add_molecules(Species("X(p,q=a)"), 20);
+
+        GillespieSimulator sim(world, model, methods[i]);
+        sim.run(0.5);
+
+        // species generated during the run must be tracked as well.
+        BOOST_CHECK(world->list_species().size() > 1);
+
+        Integer num_units(0);
+        const std::vector<Species> species(world->list_species());
+        for (std::vector<Species>::const_iterator it(species.begin());
+            it != species.end(); ++it)
+        {
+            num_units += world->num_molecules_exact(*it) * (*it).units().size();
+        }
+        BOOST_CHECK_EQUAL(num_units, 20);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(GillespieSimulator_test_model_change)
+{
+    std::shared_ptr<NetfreeModel> model(new NetfreeModel());
+    model->add_reaction_rule(
+        create_unimolecular_reaction_rule(Species("X(q=a)"), Species("X(q=b)"), 1e+6));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+    world->add_molecules(Species("X(q=a)"), 10);
+
+    GillespieSimulator sim(world, model);
+    sim.run(1.0);
+    BOOST_CHECK_EQUAL(world->num_molecules_exact(Species("X(q=b)")), 10);
+
+    // rules added to the model must be effective after initialize.
+    model->add_reaction_rule(
+        create_unimolecular_reaction_rule(Species("X(q=b)"), Species("X(q=c)"), 1e+6));
+    sim.run(1.0);
+    BOOST_CHECK_EQUAL(world->num_molecules_exact(Species("X(q=b)")), 0);
+    BOOST_CHECK_EQUAL(world->num_molecules_exact(Species("X(q=c)")), 10);
+}
@@ -0,0 +1,86 @@
+#ifndef ECELL4_HYBRID_HYBRID_FACTORY_HPP
+#define ECELL4_HYBRID_HYBRID_FACTORY_HPP
+
+#include <ecell4/core/SimulatorFactory.hpp>
+#include <ecell4/core/RandomNumberGenerator.hpp>
+
+#include <ecell4/core/extras.hpp>
+#include <ecell4/ode/ODEWorld.hpp>
+#include "HybridSimulator.hpp"
+
+
+namespace ecell4
+{
+
+namespace hybrid
+{
+
+class HybridFactory:
+    public SimulatorFactory<ode::ODEWorld, HybridSimulator>
+{
+public:
+
+    typedef SimulatorFactory<ode::ODEWorld, HybridSimulator> base_type;
+    typedef base_type::world_type world_type;
+    typedef base_type::simulator_type simulator_type;
+    typedef HybridFactory this_type;
+
+public:
+
+    HybridFactory(
+        const Real threshold_population = default_threshold_population(),
+        const Real dt = default_dt())
+        : base_type(), rng_(), threshold_population_(threshold_population), dt_(dt)
+    {
+        ; // do nothing
+    }
+
+    virtual ~HybridFactory()
+    {
+        ; // do nothing
+    }
+
+    static inline const Real default_threshold_population()
+    {
+        return simulator_type::default_threshold_population();
+    }
+
+    static inline const Real default_dt()
+    {
+        return std::numeric_limits<Real>::infinity();
+    }
+
+    this_type& rng(const std::shared_ptr<RandomNumberGenerator>& rng)
+    {
+        rng_ = rng;
+        return (*this);
+    }
+
+    inline this_type* rng_ptr(const std::shared_ptr<RandomNumberGenerator>& rng)
+    {
+        return &(this->rng(rng));  //XXX: == this
+    }
+
+protected:
+
+    virtual simulator_type* create_simulator(
+        const std::shared_ptr<world_type>& w, const std::shared_ptr<Model>& m) const
+    {
+        simulator_type* sim = (rng_
+            ? new simulator_type(w, m, rng_) : new simulator_type(w, m));
+        sim->set_threshold_population(threshold_population_);
+        sim->set_dt(dt_);
+        return sim;
+    }
+
+protected:
+
+    std::shared_ptr<RandomNumberGenerator> rng_;
+    Real threshold_population_, dt_;
+};
+
+} // hybrid
+
+} // ecell4
+
+#endif /* ECELL4_HYBRID_HYBRID_FACTORY_HPP */
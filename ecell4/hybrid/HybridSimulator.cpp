@@ -0,0 +1,449 @@
+#include "HybridSimulator.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+#include <boost/numeric/odeint.hpp>
+#include <gsl/gsl_sf_log.h>
+
+namespace odeint = boost::numeric::odeint;
+
+namespace ecell4
+{
+
+namespace hybrid
+{
+
+void HybridSimulator::check_static_model(void) const
+{
+    if (!model_->is_static())
+    {
+        throw NotSupported(
+            "Only a NetworkModel is accepted. Use expand.");
+    }
+}
+
+void HybridSimulator::initialize(void)
+{
+    check_static_model();
+
+    const std::vector<Species> species(model_->list_species());
+    for (std::vector<Species>::const_iterator it(species.begin());
+        it != species.end(); ++it)
+    {
+        if (!world_->has_species(*it))
+        {
+            world_->reserve_species(*it);
+        }
+    }
+
+    convert_reactions();
+
+    const Model::reaction_rule_container_type& reaction_rules(model_->reaction_rules());
+    partitions_.assign(reaction_rules.size(), AUTOMATIC_PARTITION);
+    for (std::size_t j(0); j < reaction_rules.size(); ++j)
+    {
+        partitions_[j] = partition(reaction_rules[j]);
+    }
+
+    last_reactions_.clear();
+}
+
+void HybridSimulator::convert_reactions(void)
+{
+    species_ = world_->list_species();
+    const Model::reaction_rule_container_type& reaction_rules(model_->reaction_rules());
+
+    typedef std::unordered_map<Species, state_type::size_type> species_map_type;
+    species_map_type index_map;
+    for (state_type::size_type i(0); i < species_.size(); ++i)
+    {
+        index_map[species_[i]] = i;
+    }
+
+    reactions_.clear();
+    reactions_.reserve(reaction_rules.size());
+    for (Model::reaction_rule_container_type::const_iterator
+        i(reaction_rules.begin()); i != reaction_rules.end(); ++i)
+    {
+        const ReactionRule& rr(*i);
+        const ReactionRule::reactant_container_type& reactants(rr.reactants());
+        const ReactionRule::product_container_type& products(rr.products());
+
+        reaction_type r;
+        r.k = rr.k();
+
+        r.reactants.reserve(reactants.size());
+        for (ReactionRule::reactant_container_type::const_iterator j(reactants.begin());
+            j != reactants.end(); ++j)
+        {
+            r.reactants.push_back(index_map[*j]);
+        }
+
+        r.products.reserve(products.size());
+        for (ReactionRule::product_container_type::const_iterator j(products.begin());
+            j != products.end(); ++j)
+        {
+            r.products.push_back(index_map[*j]);
+        }
+
+        if (rr.has_descriptor() && rr.get_descriptor()->has_coefficients())
+        {
+            const std::shared_ptr<ReactionRuleDescriptor>& rrd(rr.get_descriptor());
+            r.ratelaw = rrd;
+            r.reactant_coefficients = rrd->reactant_coefficients();
+            r.product_coefficients = rrd->product_coefficients();
+        }
+        else
+        {
+            r.reactant_coefficients.resize(reactants.size(), 1.0);
+            r.product_coefficients.resize(products.size(), 1.0);
+        }
+
+        reactions_.push_back(r);
+    }
+}
+
+void HybridSimulator::set_partition(
+    const ReactionRule& rr, const HybridPartition partition)
+{
+    for (std::vector<std::pair<ReactionRule, HybridPartition> >::iterator
+        i(hints_.begin()); i != hints_.end(); ++i)
+    {
+        if ((*i).first == rr)
+        {
+            (*i).second = partition;
+            return;
+        }
+    }
+    hints_.push_back(std::make_pair(rr, partition));
+}
+
+HybridPartition HybridSimulator::partition(const ReactionRule& rr) const
+{
+    for (std::vector<std::pair<ReactionRule, HybridPartition> >::const_iterator
+        i(hints_.begin()); i != hints_.end(); ++i)
+    {
+        if ((*i).first == rr)
+        {
+            return (*i).second;
+        }
+    }
+    return AUTOMATIC_PARTITION;
+}
+
+bool HybridSimulator::is_fast(const std::size_t i, const state_type& x) const
+{
+    switch (partitions_[i])
+    {
+    case FAST_PARTITION:
+        return true;
+    case SLOW_PARTITION:
+        return false;
+    default:
+        break;
+    }
+
+    // Products do not matter, e.g. a fast production from a large pool.
+    const reaction_type& r(reactions_[i]);
+    for (std::size_t j(0); j < r.reactants.size(); ++j)
+    {
+        if (x[r.reactants[j]] < threshold_population_)
+        {
+            return false;
+        }
+    }
+    return (propensity(r, x, world_->volume(), t()) >= threshold_propensity_);
+}
+
+void HybridSimulator::partition_reactions(
+    const state_type& x, reaction_container_type& fast,
+    reaction_container_type& slow, std::vector<std::size_t>& slow_indices) const
+{
+    for (std::size_t i(0); i < reactions_.size(); ++i)
+    {
+        if (is_fast(i, x))
+        {
+            fast.push_back(reactions_[i]);
+        }
+        else
+        {
+            slow.push_back(reactions_[i]);
+            slow_indices.push_back(i);
+        }
+    }
+}
+
+std::vector<ReactionRule> HybridSimulator::list_fast_reaction_rules() const
+{
+    state_type x(species_.size());
+    for (state_type::size_type i(0); i < species_.size(); ++i)
+    {
+        x[i] = world_->get_value_exact(species_[i]);
+    }
+
+    const Model::reaction_rule_container_type& reaction_rules(model_->reaction_rules());
+    std::vector<ReactionRule> retval;
+    for (std::size_t i(0); i < reactions_.size(); ++i)
+    {
+        if (is_fast(i, x))
+        {
+            retval.push_back(reaction_rules[i]);
+        }
+    }
+    return retval;
+}
+
+Real HybridSimulator::propensity(
+    const reaction_type& r, const state_type& x, const Real volume, const Real t)
+{
+    if (!r.ratelaw.expired())
+    {
+        ReactionRuleDescriptor::state_container_type
+            reactants_states(r.reactants.size()), products_states(r.products.size());
+        for (std::size_t j(0); j < r.reactants.size(); ++j)
+        {
+            reactants_states[j] = x[r.reactants[j]];
+        }
+        for (std::size_t j(0); j < r.products.size(); ++j)
+        {
+            products_states[j] = x[r.products[j]];
+        }
+        return r.ratelaw.lock()->propensity(reactants_states, products_states, volume, t);
+    }
+
+    // The combinatorics of GillespieSimulator, e.g. k * n * (n - 1) / V for 2A.
+    Real a(r.k * volume);
+    for (std::size_t j(0); j < r.reactants.size(); ++j)
+    {
+        Real num(x[r.reactants[j]]);
+        for (std::size_t l(0); l < j; ++l)
+        {
+            if (r.reactants[l] == r.reactants[j])
+            {
+                num -= r.reactant_coefficients[l];
+            }
+        }
+
+        const Integer coef(static_cast<Integer>(round(r.reactant_coefficients[j])));
+        for (Integer l(0); l < coef; ++l)
+        {
+            a *= std::max(num - l, 0.0) / volume;
+        }
+    }
+    return a;
+}
+
+Real HybridSimulator::total_propensity(
+    const reaction_container_type& reactions, const state_type& x,
+    const Real volume, const Real t)
+{
+    Real atot(0.0);
+    for (reaction_container_type::const_iterator i(reactions.begin());
+        i != reactions.end(); ++i)
+    {
+        atot += propensity(*i, x, volume, t);
+    }
+    return atot;
+}
+
+bool HybridSimulator::fire_slow_reaction(
+    const reaction_container_type& slow, const std::vector<std::size_t>& indices,
+    state_type& x, const Real t)
+{
+    const Real volume(world_->volume());
+    std::vector<Real> a(slow.size());
+    Real atot(0.0);
+    for (std::size_t i(0); i < slow.size(); ++i)
+    {
+        a[i] = propensity(slow[i], x, volume, t);
+        atot += a[i];
+    }
+
+    if (atot <= 0.0)
+    {
+        return false;
+    }
+
+    const Real rnd(rng_->uniform(0, atot));
+    std::size_t i(0);
+    Real acc(a[0]);
+    while (acc < rnd && i + 1 < slow.size())
+    {
+        acc += a[++i];
+    }
+
+    // Fast reactions may leave less than a molecule of a reactant.
+    // Such an event is rejected rather than making the value negative.
+    const reaction_type& r(slow[i]);
+    state_type::value_type required(0.0);
+    for (std::size_t j(0); j < r.reactants.size(); ++j)
+    {
+        required = r.reactant_coefficients[j];
+        for (std::size_t l(0); l < j; ++l)
+        {
+            if (r.reactants[l] == r.reactants[j])
+            {
+                required += r.reactant_coefficients[l];
+            }
+        }
+
+        if (x[r.reactants[j]] < required)
+        {
+            return false;
+        }
+    }
+
+    for (std::size_t j(0); j < r.reactants.size(); ++j)
+    {
+        x[r.reactants[j]] -= r.reactant_coefficients[j];
+    }
+    for (std::size_t j(0); j < r.products.size(); ++j)
+    {
+        x[r.products[j]] += r.product_coefficients[j];
+    }
+
+    const ReactionRule& rr(model_->reaction_rules()[indices[i]]);
+    last_reactions_.push_back(
+        std::make_pair(rr, reaction_info_type(t, rr.reactants(), rr.products())));
+    return true;
+}
+
+void HybridSimulator::step(void)
+{
+    if (!std::isinf(dt_))
+    {
+        step(next_time());
+        return;
+    }
+
+    // Advance to the next slow reaction. Each window is as long as the mean
+    // waiting time at its beginning. This is exact because the waiting time
+    // is memoryless, and a new threshold is drawn for each window.
+    bool advanced(false);
+    while (true)
+    {
+        state_type x(species_.size());
+        for (state_type::size_type i(0); i < species_.size(); ++i)
+        {
+            x[i] = world_->get_value_exact(species_[i]);
+        }
+
+        reaction_container_type fast, slow;
+        std::vector<std::size_t> slow_indices;
+        partition_reactions(x, fast, slow, slow_indices);
+
+        const Real atot(total_propensity(slow, x, world_->volume(), t()));
+        if (atot <= 0.0)
+        {
+            if (advanced)
+            {
+                return;
+            }
+            throw IllegalState(
+                "No slow reaction can occur. Give a finite step interval with set_dt.");
+        }
+
+        const Real upto(t() + 1.0 / atot);
+        if (step(upto) || check_reaction())
+        {
+            return;
+        }
+        advanced = true;
+    }
+}
+
+bool HybridSimulator::step(const Real& upto)
+{
+    if (upto <= t())
+    {
+        return false;
+    }
+
+    // The last element accumulates the propensities of slow reactions.
+    const std::size_t n(species_.size());
+    state_type x(n + 1);
+    for (state_type::size_type i(0); i < n; ++i)
+    {
+        x[i] = world_->get_value_exact(species_[i]);
+    }
+    x[n] = 0.0;
+
+    reaction_container_type fast, slow;
+    std::vector<std::size_t> slow_indices;
+    partition_reactions(x, fast, slow, slow_indices);
+
+    // Without a step interval, the partition is kept only within the mean
+    // waiting time of slow reactions as in step(), and not over the whole
+    // interval to upto.
+    Real tend(std::min(upto, t() + dt_));
+    if (std::isinf(dt_))
+    {
+        const Real atot(total_propensity(slow, x, world_->volume(), t()));
+        if (atot > 0.0)
+        {
+            tend = std::min(tend, t() + 1.0 / atot);
+        }
+    }
+    if (std::isinf(tend))
+    {
+        throw IllegalState(
+            "The step interval is not bounded. Give a finite step interval with set_dt.");
+    }
+
+    last_reactions_.clear();
+
+    const Real threshold(slow.size() > 0
+        ? gsl_sf_log(1.0 / rng_->uniform(0, 1)) : std::numeric_limits<Real>::infinity());
+
+    hybrid_func system(fast, slow, world_->volume());
+    typedef odeint::runge_kutta_dopri5<state_type> error_stepper_type;
+    odeint::result_of::make_dense_output<error_stepper_type>::type
+        stepper(odeint::make_dense_output(abs_tol_, rel_tol_, error_stepper_type()));
+    stepper.initialize(x, t(), tend - t());
+
+    Real tnext(tend);
+    bool fired(false);
+    while (stepper.current_time() < tend)
+    {
+        const std::pair<Real, Real> interval(stepper.do_step(system));
+        if (stepper.current_state()[n] < threshold)
+        {
+            continue;
+        }
+
+        // The next slow reaction occurs within the last step.
+        Real lo(interval.first), hi(std::min(interval.second, tend));
+        stepper.calc_state(hi, x);
+        if (x[n] >= threshold)
+        {
+            while (hi - lo > std::numeric_limits<Real>::epsilon() * std::max(1.0, std::abs(hi)) * 4)
+            {
+                const Real mid(0.5 * (lo + hi));
+                stepper.calc_state(mid, x);
+                (x[n] < threshold ? lo : hi) = mid;
+            }
+            tnext = hi;
+            fired = true;
+        }
+        break;
+    }
+
+    stepper.calc_state(tnext, x);
+    if (fired)
+    {
+        fire_slow_reaction(slow, slow_indices, x, tnext);
+    }
+
+    for (state_type::size_type i(0); i < n; ++i)
+    {
+        world_->set_value(species_[i], static_cast<Real>(x[i]));
+    }
+    set_t(tnext);
+    num_steps_++;
+    return (tnext < upto);
+}
+
+} // hybrid
+
+} // ecell4
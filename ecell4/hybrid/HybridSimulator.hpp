@@ -0,0 +1,304 @@
+#ifndef ECELL4_HYBRID_HYBRID_SIMULATOR_HPP
+#define ECELL4_HYBRID_HYBRID_SIMULATOR_HPP
+
+#include <vector>
+#include <utility>
+#include <limits>
+#include <memory>
+
+#include <ecell4/core/types.hpp>
+#include <ecell4/core/exceptions.hpp>
+#include <ecell4/core/Model.hpp>
+#include <ecell4/core/RandomNumberGenerator.hpp>
+#include <ecell4/core/SimulatorBase.hpp>
+
+#include <ecell4/ode/ODEWorld.hpp>
+#include <ecell4/ode/ODESimulator.hpp>
+#include <ecell4/gillespie/GillespieSimulator.hpp>
+
+
+namespace ecell4
+{
+
+namespace hybrid
+{
+
+/**
+ * A hint to classify a reaction.
+ * AUTOMATIC_PARTITION lets the simulator decide from the numbers of
+ * molecules involved at every step.
+ */
+enum HybridPartition {
+    AUTOMATIC_PARTITION = 0,
+    FAST_PARTITION = 1,
+    SLOW_PARTITION = 2,
+};
+
+/**
+ * A hybrid simulator partitioning reactions into fast and slow subsets
+ * (Haseltine & Rawlings, J. Chem. Phys. 117, 6959, 2002).
+ * Fast reactions are integrated as ODEs in the same way as ODESimulator,
+ * together with the integral of the total propensity of slow reactions.
+ * A slow reaction fires when the integral reaches an exponential random
+ * number (Salis & Kaznessis, J. Chem. Phys. 122, 054103, 2005), and
+ * its propensity follows GillespieSimulator.
+ * Both subsets share the values of an ODEWorld.
+ * Unless a step interval is given, step() advances to the next slow reaction.
+ * Only a static model (NetworkModel) is accepted.
+ */
+class HybridSimulator
+    : public SimulatorBase<ode::ODEWorld>
+{
+public:
+
+    typedef SimulatorBase<ode::ODEWorld> base_type;
+    typedef ode::ODEWorld world_type;
+    typedef gillespie::ReactionInfo reaction_info_type;
+
+    typedef ode::ODESimulator::state_type state_type;
+    typedef ode::ODESimulator::reaction_type reaction_type;
+    typedef ode::ODESimulator::reaction_container_type reaction_container_type;
+
+protected:
+
+    class hybrid_func
+    {
+    public:
+
+        hybrid_func(
+            const reaction_container_type& fast, const reaction_container_type& slow,
+            const Real& volume)
+            : deriv_(fast, volume), slow_(slow), volume_(volume)
+        {
+            ;
+        }
+
+        void operator()(const state_type& x, state_type& dxdt, const double& t)
+        {
+            // The last element is the integral of slow propensities.
+            deriv_(x, dxdt, t);
+            dxdt[dxdt.size() - 1] = total_propensity(slow_, x, volume_, t);
+        }
+
+    protected:
+
+        ode::ODESimulator::deriv_func deriv_;
+        const reaction_container_type slow_;
+        const Real volume_;
+    };
+
+public:
+
+    HybridSimulator(
+        std::shared_ptr<world_type> world,
+        std::shared_ptr<Model> model,
+        std::shared_ptr<RandomNumberGenerator> rng)
+        : base_type(world, model), rng_(rng),
+        dt_(std::numeric_limits<Real>::infinity()), abs_tol_(1e-6), rel_tol_(1e-6),
+        threshold_population_(default_threshold_population()),
+        threshold_propensity_(default_threshold_propensity())
+    {
+        initialize();
+    }
+
+    HybridSimulator(
+        std::shared_ptr<world_type> world,
+        std::shared_ptr<Model> model)
+        : base_type(world, model), rng_(new GSLRandomNumberGenerator()),
+        dt_(std::numeric_limits<Real>::infinity()), abs_tol_(1e-6), rel_tol_(1e-6),
+        threshold_population_(default_threshold_population()),
+        threshold_propensity_(default_threshold_propensity())
+    {
+        rng_->seed();
+        initialize();
+    }
+
+    HybridSimulator(std::shared_ptr<world_type> world)
+        : base_type(world), rng_(new GSLRandomNumberGenerator()),
+        dt_(std::numeric_limits<Real>::infinity()), abs_tol_(1e-6), rel_tol_(1e-6),
+        threshold_population_(default_threshold_population()),
+        threshold_propensity_(default_threshold_propensity())
+    {
+        rng_->seed();
+        initialize();
+    }
+
+    static inline const Real default_threshold_population()
+    {
+        return 100.0;
+    }
+
+    static inline const Real default_threshold_propensity()
+    {
+        return 0.0;
+    }
+
+    /**
+     * recalculate the partition of reactions.
+     */
+    void initialize();
+
+    // SimulatorTraits
+
+    Real t(void) const
+    {
+        return world_->t();
+    }
+
+    void set_t(const Real& t)
+    {
+        world_->set_t(t);
+    }
+
+    Real dt(void) const
+    {
+        return dt_;
+    }
+
+    void set_dt(const Real& dt)
+    {
+        if (dt <= 0)
+        {
+            throw std::invalid_argument("The step size must be positive.");
+        }
+        dt_ = dt;
+    }
+
+    void step(void);
+
+    bool step(const Real& upto);
+
+    // Optional members
+
+    virtual bool check_reaction() const
+    {
+        return last_reactions_.size() > 0;
+    }
+
+    std::vector<std::pair<ReactionRule, reaction_info_type> > last_reactions() const
+    {
+        return last_reactions_;
+    }
+
+    inline std::shared_ptr<RandomNumberGenerator> rng()
+    {
+        return rng_;
+    }
+
+    Real absolute_tolerance() const
+    {
+        return abs_tol_;
+    }
+
+    void set_absolute_tolerance(const Real abs_tol)
+    {
+        if (abs_tol < 0)
+        {
+            throw std::invalid_argument("A tolerance must be positive or zero.");
+        }
+        abs_tol_ = abs_tol;
+    }
+
+    Real relative_tolerance() const
+    {
+        return rel_tol_;
+    }
+
+    void set_relative_tolerance(const Real rel_tol)
+    {
+        if (rel_tol < 0)
+        {
+            throw std::invalid_argument("A tolerance must be positive or zero.");
+        }
+        rel_tol_ = rel_tol;
+    }
+
+    /**
+     * a reaction is classified as fast automatically when the numbers of
+     * all its reactants are at least this threshold, and its propensity
+     * is at least threshold_propensity.
+     */
+    Real threshold_population() const
+    {
+        return threshold_population_;
+    }
+
+    void set_threshold_population(const Real threshold)
+    {
+        if (threshold < 0)
+        {
+            throw std::invalid_argument("A threshold must be positive or zero.");
+        }
+        threshold_population_ = threshold;
+    }
+
+    Real threshold_propensity() const
+    {
+        return threshold_propensity_;
+    }
+
+    void set_threshold_propensity(const Real threshold)
+    {
+        if (threshold < 0)
+        {
+            throw std::invalid_argument("A threshold must be positive or zero.");
+        }
+        threshold_propensity_ = threshold;
+    }
+
+    /**
+     * give a hint to classify the reaction rule.
+     */
+    void set_partition(const ReactionRule& rr, const HybridPartition partition);
+    HybridPartition partition(const ReactionRule& rr) const;
+
+    /**
+     * return reaction rules classified as fast for the current state.
+     */
+    std::vector<ReactionRule> list_fast_reaction_rules() const;
+
+    static Real propensity(
+        const reaction_type& r, const state_type& x, const Real volume, const Real t);
+    static Real total_propensity(
+        const reaction_container_type& reactions, const state_type& x,
+        const Real volume, const Real t);
+
+protected:
+
+    void check_static_model(void) const;
+    void convert_reactions(void);
+    bool is_fast(const std::size_t i, const state_type& x) const;
+    void partition_reactions(
+        const state_type& x, reaction_container_type& fast,
+        reaction_container_type& slow, std::vector<std::size_t>& slow_indices) const;
+    bool fire_slow_reaction(
+        const reaction_container_type& slow, const std::vector<std::size_t>& indices,
+        state_type& x, const Real t);
+
+protected:
+
+    std::shared_ptr<RandomNumberGenerator> rng_;
+
+    Real dt_;
+    Real abs_tol_, rel_tol_;
+    Real threshold_population_, threshold_propensity_;
+
+    /**
+     * species_ is a list of the species in the world, and reactions_
+     * refers to them by index like ODESimulator.
+     * hints_ is a list of partitions given by set_partition, and
+     * partitions_ is the hint resolved for each reaction.
+     */
+    std::vector<Species> species_;
+    reaction_container_type reactions_;
+    std::vector<std::pair<ReactionRule, HybridPartition> > hints_;
+    std::vector<HybridPartition> partitions_;
+
+    std::vector<std::pair<ReactionRule, reaction_info_type> > last_reactions_;
+};
+
+} // hybrid
+
+} // ecell4
+
+#endif /* ECELL4_HYBRID_HYBRID_SIMULATOR_HPP */
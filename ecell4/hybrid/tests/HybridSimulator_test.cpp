@@ -0,0 +1,184 @@
+#define BOOST_TEST_MODULE "HybridSimulator_test"
+
+#ifdef UNITTEST_FRAMEWORK_LIBRARY_EXIST
+#   include <boost/test/unit_test.hpp>
+#else
+#   define BOOST_TEST_NO_LIB
+#   include <boost/test/included/unit_test.hpp>
+#endif
+
+#include <cmath>
+
+#include <ecell4/core/RandomNumberGenerator.hpp>
+#include <ecell4/core/Model.hpp>
+#include <ecell4/core/NetworkModel.hpp>
+#include <ecell4/core/NetfreeModel.hpp>
+
+#include <ecell4/hybrid/HybridSimulator.hpp>
+
+using namespace ecell4;
+using namespace ecell4::ode;
+using namespace ecell4::hybrid;
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_slow)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->add_molecules(sp1, 10);
+
+    HybridSimulator sim(world, model, rng);
+    BOOST_CHECK_EQUAL(sim.list_fast_reaction_rules().size(), 0);
+
+    sim.run(1.0);
+
+    BOOST_CHECK_EQUAL(sim.t(), 1.0);
+    BOOST_CHECK(sim.num_steps() > 0);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp1) + world->get_value_exact(sp2), 10.0);
+    BOOST_CHECK_EQUAL(
+        world->get_value_exact(sp1), std::floor(world->get_value_exact(sp1)));
+}
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_step)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->add_molecules(sp1, 10);
+
+    // Without a step interval, step() advances to the next slow reaction.
+    HybridSimulator sim(world, model, rng);
+    sim.step();
+    BOOST_CHECK(sim.t() > 0.0);
+    BOOST_CHECK(sim.check_reaction());
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp1), 9.0);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp2), 1.0);
+
+    // No slow reaction can occur any more.
+    world->set_value(sp1, 0.0);
+    sim.initialize();
+    BOOST_CHECK_THROW(sim.step(), IllegalState);
+}
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_window)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->add_molecules(sp1, 10);
+
+    // Without a step interval, step(upto) stops within the mean waiting time
+    // of slow reactions, i.e. 1 / (1.0 * 10), to partition them again.
+    HybridSimulator sim(world, model, rng);
+    BOOST_CHECK(sim.step(10.0));
+    BOOST_CHECK(sim.t() > 0.0);
+    BOOST_CHECK(sim.t() <= 0.1 * (1 + 1e-12));
+
+    while (sim.step(10.0))
+    {
+        BOOST_CHECK(sim.t() < 10.0);
+    }
+    BOOST_CHECK_EQUAL(sim.t(), 10.0);
+}
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_nonnegative)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->set_value(sp1, 0.5);
+
+    // Less than a molecule left by fast reactions never fires.
+    HybridSimulator sim(world, model, rng);
+    sim.run(10.0);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp1), 0.5);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp2), 0.0);
+}
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_fast)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    const Real N(100000);
+    world->add_molecules(sp1, N);
+    world->add_molecules(sp2, N);
+
+    HybridSimulator sim(world, model);
+    BOOST_CHECK_EQUAL(sim.list_fast_reaction_rules().size(), 1);
+
+    sim.run(1.0);
+
+    BOOST_CHECK_EQUAL(sim.t(), 1.0);
+    BOOST_CHECK(!sim.check_reaction());
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), N * std::exp(-1.0), 1e-3);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1) + world->get_value_exact(sp2), 2 * N, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(HybridSimulator_test_partition)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    Species sp3("C");
+    const ReactionRule rr1(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+    const ReactionRule rr2(create_unimolecular_reaction_rule(sp2, sp3, 0.1));
+    model->add_reaction_rule(rr1);
+    model->add_reaction_rule(rr2);
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->add_molecules(sp1, 1000);
+
+    HybridSimulator sim(world, model, rng);
+    BOOST_CHECK_EQUAL(sim.partition(rr1), AUTOMATIC_PARTITION);
+
+    // rr1 is fast even with no product, and rr2 has no reactant yet.
+    const std::vector<ReactionRule> automatic(sim.list_fast_reaction_rules());
+    BOOST_CHECK_EQUAL(automatic.size(), 1);
+    BOOST_CHECK(automatic[0] == rr1);
+
+    sim.set_partition(rr1, FAST_PARTITION);
+    sim.set_partition(rr2, SLOW_PARTITION);
+    sim.initialize();
+    BOOST_CHECK_EQUAL(sim.partition(rr1), FAST_PARTITION);
+    BOOST_CHECK_EQUAL(sim.partition(rr2), SLOW_PARTITION);
+
+    const std::vector<ReactionRule> fast(sim.list_fast_reaction_rules());
+    BOOST_CHECK_EQUAL(fast.size(), 1);
+    BOOST_CHECK(fast[0] == rr1);
+
+    sim.run(1.0);
+
+    BOOST_CHECK_EQUAL(sim.t(), 1.0);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 1000 * std::exp(-1.0), 1e-3);
+    BOOST_CHECK_CLOSE(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + world->get_value_exact(sp3), 1000.0, 1e-6);
+    BOOST_CHECK_EQUAL(
+        world->get_value_exact(sp3), std::floor(world->get_value_exact(sp3)));
+}
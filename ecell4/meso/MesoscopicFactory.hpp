@@ -4,6 +4,7 @@
 #include <ecell4/core/SimulatorFactory.hpp>
 #include <ecell4/core/RandomNumberGenerator.hpp>
 #include <ecell4/core/extras.hpp>
+#include <ecell4/core/EnsembleRunner.hpp>
 
 #include "MesoscopicWorld.hpp"
 #include "MesoscopicSimulator.hpp"
@@ -29,8 +30,11 @@ public:
 
     MesoscopicFactory(
         const Integer3& matrix_sizes = default_matrix_sizes(),
-        const Real subvolume_length = default_subvolume_length())
-        : base_type(), rng_(), matrix_sizes_(matrix_sizes), subvolume_length_(subvolume_length)
+        const Real subvolume_length = default_subvolume_length(),
+        const Integer num_threads = default_num_threads(),
+        const Real synchronization_interval = default_synchronization_interval())
+        : base_type(), rng_(), matrix_sizes_(matrix_sizes), subvolume_length_(subvolume_length),
+        num_threads_(num_threads), synchronization_interval_(synchronization_interval)
     {
         ; // do nothing
     }
@@ -50,6 +54,16 @@ public:
         return 0.0;
     }
 
+    static inline const Integer default_num_threads()
+    {
+        return simulator_type::default_num_threads();
+    }
+
+    static inline const Real default_synchronization_interval()
+    {
+        return simulator_type::default_synchronization_interval();
+    }
+
     this_type& rng(const std::shared_ptr<RandomNumberGenerator>& rng)
     {
         rng_ = rng;
@@ -92,15 +106,85 @@ protected:
         return new world_type(edge_lengths);
     }
 
+    virtual simulator_type* create_simulator(
+        const std::shared_ptr<world_type>& w, const std::shared_ptr<Model>& m) const
+    {
+        return new simulator_type(w, m, num_threads_, synchronization_interval_);
+    }
+
 protected:
 
     std::shared_ptr<RandomNumberGenerator> rng_;
     Integer3 matrix_sizes_;
     Real subvolume_length_;
+    Integer num_threads_;
+    Real synchronization_interval_;
 };
 
 } // meso
 
+/**
+ * EnsembleState for MesoscopicWorld copies the number of molecules
+ * of each species in each subvolume. Replicates must be divided into
+ * the same number of subvolumes as the original world.
+ */
+template <>
+class EnsembleState<meso::MesoscopicWorld>
+{
+public:
+
+    typedef meso::MesoscopicWorld world_type;
+    typedef world_type::coordinate_type coordinate_type;
+
+public:
+
+    EnsembleState(const world_type& world)
+        : species_(world.list_species()), num_subvolumes_(world.num_subvolumes()),
+        numbers_(species_.size() * num_subvolumes_, 0)
+    {
+        for (std::size_t i(0); i < species_.size(); ++i)
+        {
+            for (coordinate_type c(0); c < num_subvolumes_; ++c)
+            {
+                numbers_[i * num_subvolumes_ + c] = world.num_molecules_exact(species_[i], c);
+            }
+        }
+    }
+
+    const std::vector<Species>& species() const
+    {
+        return species_;
+    }
+
+    void restore(world_type& world) const
+    {
+        if (world.num_subvolumes() != num_subvolumes_)
+        {
+            throw_exception<IllegalArgument>(
+                "The number of subvolumes [", world.num_subvolumes(),
+                "] differs from the original [", num_subvolumes_, "].");
+        }
+
+        for (std::size_t i(0); i < species_.size(); ++i)
+        {
+            for (coordinate_type c(0); c < num_subvolumes_; ++c)
+            {
+                const Integer num(numbers_[i * num_subvolumes_ + c]);
+                if (num > 0)
+                {
+                    world.add_molecules(species_[i], num, c);
+                }
+            }
+        }
+    }
+
+protected:
+
+    std::vector<Species> species_;
+    Integer num_subvolumes_;
+    std::vector<Integer> numbers_;
+};
+
 } // ecell4
 
 #endif /* ECELL4_MESO_MESOSCOPIC_FACTORY_HPP */
@@ -1,4 +1,5 @@
 #include <numeric>
+#include <algorithm>
 #include <vector>
 #include <gsl/gsl_sf_log.h>
 
@@ -19,22 +20,75 @@ namespace meso
 void MesoscopicSimulator::increment(const std::shared_ptr<MesoscopicWorld::PoolBase>& pool, const coordinate_type& c)
 {
     pool->add_molecules(1, c);
+    update_dependencies(diffusion_proxies_.at(pool->species()), c, +1);
+}
 
-    for (boost::ptr_vector<ReactionRuleProxyBase>::iterator i(proxies_.begin());
-        i != proxies_.end(); ++i)
+void MesoscopicSimulator::decrement(const std::shared_ptr<MesoscopicWorld::PoolBase>& pool, const coordinate_type& c)
+{
+    pool->remove_molecules(1, c);
+    update_dependencies(diffusion_proxies_.at(pool->species()), c, -1);
+}
+
+void MesoscopicSimulator::update_propensity(
+    const proxy_index_type i, const coordinate_type& c)
+{
+    propensity_container_type& a(propensities_[c]);
+    const Real newa(proxies_[i].propensity(c));
+
+    propensity_container_type::iterator
+        itr(std::lower_bound(a.begin(), a.end(), i, propensity_index_less()));
+    if (itr != a.end() && (*itr).first == i)
     {
-        (*i).inc(pool->species(), c);
+        total_propensities_[c] += newa - (*itr).second;
+        if (newa == 0.0)
+        {
+            a.erase(itr);
+        }
+        else
+        {
+            (*itr).second = newa;
+        }
+    }
+    else if (newa != 0.0)
+    {
+        total_propensities_[c] += newa;
+        a.insert(itr, std::make_pair(i, newa));
     }
 }
 
-void MesoscopicSimulator::decrement(const std::shared_ptr<MesoscopicWorld::PoolBase>& pool, const coordinate_type& c)
+void MesoscopicSimulator::update_dependencies(
+    const proxy_index_type i, const coordinate_type& c, const Integer val)
 {
-    pool->remove_molecules(1, c);
+    const DiffusionProxy::dependency_container_type&
+        dependencies(static_cast<const DiffusionProxy&>(proxies_[i]).dependencies());
+    for (DiffusionProxy::dependency_container_type::const_iterator
+        j(dependencies.begin()); j != dependencies.end(); ++j)
+    {
+        static_cast<ReactionRuleProxy&>(proxies_[(*j).first]).inc_with_coefs(
+            (*j).second, c, val);
+        update_propensity((*j).first, c);
+    }
+    update_propensity(i, c);
+}
 
-    for (boost::ptr_vector<ReactionRuleProxyBase>::iterator i(proxies_.begin());
-        i != proxies_.end(); ++i)
+void MesoscopicSimulator::extend_propensities(const proxy_index_type first)
+{
+    // The proxies from first are appended after all cached ones,
+    // and thus their propensities are too.
+    const std::size_t num_subvolumes(world_->num_subvolumes());
+    propensities_.resize(num_subvolumes);
+    total_propensities_.resize(num_subvolumes, 0.0);
+    for (coordinate_type c(0); c < world_->num_subvolumes(); ++c)
     {
-        (*i).dec(pool->species(), c);
+        for (proxy_index_type i(first); i < proxies_.size(); ++i)
+        {
+            const Real a(proxies_[i].propensity(c));
+            if (a != 0.0)
+            {
+                propensities_[c].push_back(std::make_pair(i, a));
+                total_propensities_[c] += a;
+            }
+        }
     }
 }
 
@@ -49,6 +103,7 @@ void MesoscopicSimulator::increment_molecules(const Species& sp, const coordinat
 
         const std::shared_ptr<MesoscopicWorld::PoolBase> pool = world_->reserve_pool(sp);
         proxies_.push_back(create_diffusion_proxy(sp));
+        extend_propensities(proxies_.size() - 1);
         increment(pool, c);
     }
     else
@@ -73,13 +128,28 @@ std::pair<Real, MesoscopicSimulator::ReactionRuleProxyBase*>
 MesoscopicSimulator::draw_next_reaction(const coordinate_type& c)
 {
     constexpr Real inf = std::numeric_limits<Real>::infinity();
-    std::vector<double> a(proxies_.size());
-    for (unsigned int idx(0); idx < proxies_.size(); ++idx)
+
+    for (std::vector<proxy_index_type>::const_iterator i(descriptor_proxies_.begin());
+        i != descriptor_proxies_.end(); ++i)
     {
-        a[idx] = proxies_[idx].propensity(c);
+        update_propensity(*i, c);
+    }
+
+    const propensity_container_type& a(propensities_[c]);
+
+    Real atot(total_propensities_[c]);
+    if (!(atot > 0.0 && atot < inf))
+    {
+        // Resynchronize the running total, which may have drifted or
+        // become undefined through an infinite propensity.
+        atot = 0.0;
+        for (propensity_container_type::const_iterator i(a.begin()); i != a.end(); ++i)
+        {
+            atot += (*i).second;
+        }
+        total_propensities_[c] = atot;
     }
 
-    const double atot(std::accumulate(a.begin(), a.end(), double(0.0)));
     if (atot == 0.0)
     {
         return std::make_pair(inf, (ReactionRuleProxyBase*)NULL);
@@ -87,38 +157,51 @@ MesoscopicSimulator::draw_next_reaction(const coordinate_type& c)
 
     if (atot == inf)
     {
-        std::vector<unsigned int> selected;
-        for (unsigned int i(0); i < a.size(); ++i)
+        std::vector<proxy_index_type> selected;
+        for (propensity_container_type::const_iterator i(a.begin()); i != a.end(); ++i)
         {
-            if (a[i] == inf)
+            if ((*i).second == inf)
             {
-                selected.push_back(i);
+                selected.push_back((*i).first);
             }
         }
 
-        const unsigned int idx = selected[(selected.size() == 1 ? 0 : rng()->uniform_int(0, selected.size() - 1))];
+        const proxy_index_type idx = selected[(selected.size() == 1 ? 0 : rng(c)->uniform_int(0, selected.size() - 1))];
         return std::make_pair(0.0, &proxies_[idx]);
     }
 
-    const double rnd1(rng()->uniform(0, 1));
+    const double rnd1(rng(c)->uniform(0, 1));
     const double dt(gsl_sf_log(1.0 / rnd1) / double(atot));
-    const double rnd2(rng()->uniform(0, atot));
+    const double rnd2(rng(c)->uniform(0, atot));
 
-    int u(-1);
+    // Entries are sorted by the index of proxies, as the order of draws.
+    std::size_t u(0), last(a.size());
     double acc(0.0);
-    const int len_a(a.size());
-    do
+    for (; u < a.size(); ++u)
     {
-        u++;
-        acc += a[u];
-    } while (acc < rnd2 && u < len_a - 1);
+        if (a[u].second > 0.0)
+        {
+            last = u;
+            acc += a[u].second;
+            if (acc >= rnd2)
+            {
+                break;
+            }
+        }
+    }
 
-    if (len_a == u)
+    if (u == a.size())
     {
-        return std::make_pair(inf, (ReactionRuleProxyBase*)NULL);
+        // The running total exceeded the exact sum by rounding errors.
+        total_propensities_[c] = acc;
+        if (last == a.size())
+        {
+            return std::make_pair(inf, (ReactionRuleProxyBase*)NULL);
+        }
+        u = last;
     }
 
-    return std::make_pair(dt, &proxies_[u]);
+    return std::make_pair(dt, &proxies_[a[u].first]);
 }
 
 void MesoscopicSimulator::interrupt_all(const Real& t)
@@ -132,6 +215,73 @@ void MesoscopicSimulator::interrupt_all(const Real& t)
     }
 }
 
+void MesoscopicSimulator::fire_block(Block& block, const Real upto)
+{
+    const coordinate_type num_subvolumes(world_->num_subvolumes());
+    while (block.scheduler.next_time() <= upto)
+    {
+        block.interrupted = num_subvolumes;
+        EventScheduler::value_type const& top(block.scheduler.top());
+        const Real tnext(top.second->time());
+        top.second->fire(); // top.second->time_ is updated in fire()
+        block.scheduler.update(top);
+
+        if (block.interrupted < num_subvolumes)
+        {
+            EventScheduler::identifier_type evid(event_ids_[block.interrupted]);
+            std::shared_ptr<Event> ev(block.scheduler.get(evid));
+            ev->interrupt(tnext);
+            block.scheduler.update(std::make_pair(evid, ev));
+        }
+    }
+}
+
+void MesoscopicSimulator::step_blocks(const Real upto)
+{
+    for (boost::ptr_vector<Block>::iterator i(blocks_.begin()); i != blocks_.end(); ++i)
+    {
+        (*i).last_reactions.clear();
+        (*i).outbox.clear();
+    }
+
+    pool_->run(blocks_.size(),
+        [&](const std::size_t i)
+        {
+            fire_block(blocks_[i], upto);
+        });
+
+    // Deliver molecules between blocks in a fixed order for reproducibility.
+    std::vector<coordinate_type> arrived;
+    last_reactions_.clear();
+    for (boost::ptr_vector<Block>::iterator i(blocks_.begin()); i != blocks_.end(); ++i)
+    {
+        for (std::vector<std::pair<proxy_index_type, coordinate_type> >::const_iterator
+            j((*i).outbox.begin()); j != (*i).outbox.end(); ++j)
+        {
+            static_cast<DiffusionProxy&>(proxies_[(*j).first]).arrive((*j).second);
+            arrived.push_back((*j).second);
+        }
+
+        last_reactions_.insert(
+            last_reactions_.end(), (*i).last_reactions.begin(), (*i).last_reactions.end());
+    }
+
+    std::sort(arrived.begin(), arrived.end());
+    arrived.erase(std::unique(arrived.begin(), arrived.end()), arrived.end());
+    for (std::vector<coordinate_type>::const_iterator i(arrived.begin());
+        i != arrived.end(); ++i)
+    {
+        Block& block(blocks_[block_index(*i)]);
+        EventScheduler::identifier_type evid(event_ids_[*i]);
+        std::shared_ptr<Event> ev(block.scheduler.get(evid));
+        ev->interrupt(upto);
+        block.scheduler.update(std::make_pair(evid, ev));
+    }
+
+    this->set_t(upto);
+    num_steps_++;
+}
+
 void MesoscopicSimulator::step(void)
 {
     if (this->dt() == std::numeric_limits<Real>::infinity())
@@ -140,6 +290,12 @@ void MesoscopicSimulator::step(void)
         return;
     }
 
+    if (is_parallel())
+    {
+        step_blocks(next_time());
+        return;
+    }
+
     interrupted_ = event_ids_.size();
     EventScheduler::value_type const& top(scheduler_.top());
     const Real tnext(top.second->time());
@@ -178,6 +334,22 @@ bool MesoscopicSimulator::step(const Real &upto)
         return false;
     }
 
+    if (is_parallel())
+    {
+        // Without diffusion, blocks are independent and run up to upto at once.
+        const Real tnext(
+            window_ < std::numeric_limits<Real>::infinity()
+                ? next_time() : std::numeric_limits<Real>::infinity());
+        if (upto >= tnext)
+        {
+            step_blocks(tnext);
+            return true;
+        }
+
+        step_blocks(upto);
+        return false;
+    }
+
     if (upto >= next_time())
     {
         step();
@@ -197,14 +369,16 @@ bool MesoscopicSimulator::step(const Real &upto)
 MesoscopicSimulator::DiffusionProxy*
 MesoscopicSimulator::create_diffusion_proxy(const Species& sp)
 {
-    DiffusionProxy* proxy = new DiffusionProxy(this, sp);
+    // The proxy is always appended to proxies_.
+    const proxy_index_type idx(proxies_.size());
+    DiffusionProxy* proxy = new DiffusionProxy(this, sp, idx);
     proxy->initialize();
-    for (boost::ptr_vector<ReactionRuleProxyBase>::size_type i = 0;
-         i < diffusion_proxy_offset_; ++i)
+    for (proxy_index_type i = 0; i < diffusion_proxy_offset_; ++i)
     {
         proxy->set_dependency(
-            dynamic_cast<ReactionRuleProxy*>(&proxies_[i]));
+            i, dynamic_cast<const ReactionRuleProxy&>(proxies_[i]));
     }
+    diffusion_proxies_[sp] = idx;
     return proxy;
 }
 
@@ -213,6 +387,31 @@ void MesoscopicSimulator::check_model(void)
     const Model::reaction_rule_container_type&
         reaction_rules(model_->reaction_rules());
 
+    if (num_threads_ <= 0)
+    {
+        throw std::invalid_argument("The number of threads must be positive.");
+    }
+    else if (num_threads_ > 1)
+    {
+        // No species can be added to the world while blocks run in parallel.
+        if (!model_->is_static())
+        {
+            throw NotSupported(
+                "Only a NetworkModel is accepted in parallel. Use expand.");
+        }
+
+        for (Model::reaction_rule_container_type::const_iterator
+            i(reaction_rules.begin()); i != reaction_rules.end(); ++i)
+        {
+            if ((*i).has_descriptor() && !dynamic_cast<const ReactionRuleDescriptorMassAction*>(
+                    (*i).get_descriptor().get()))
+            {
+                throw NotSupported(
+                    "Only a mass action descriptor is accepted in parallel.");
+            }
+        }
+    }
+
     for (Model::reaction_rule_container_type::const_iterator
         i(reaction_rules.begin()); i != reaction_rules.end(); ++i)
     {
@@ -265,6 +464,8 @@ void MesoscopicSimulator::initialize(void)
     check_model();
 
     proxies_.clear();
+    descriptor_proxies_.clear();
+    diffusion_proxies_.clear();
     for (Model::reaction_rule_container_type::const_iterator
         i(reaction_rules.begin()); i != reaction_rules.end(); ++i)
     {
@@ -272,6 +473,7 @@ void MesoscopicSimulator::initialize(void)
 
         if (rr.has_descriptor())
         {
+            descriptor_proxies_.push_back(proxies_.size());
             proxies_.push_back(new DescriptorReactionRuleProxy(this, rr));
         }
         else if (rr.reactants().size() == 0)
@@ -306,6 +508,19 @@ void MesoscopicSimulator::initialize(void)
     }
     diffusion_proxy_offset_ = proxies_.size();
 
+    if (num_threads_ > 1)
+    {
+        const std::vector<Species> model_species(model_->list_species());
+        for (std::vector<Species>::const_iterator i(model_species.begin());
+            i != model_species.end(); ++i)
+        {
+            if (!world_->has_species(*i) && !world_->has_structure(*i))
+            {
+                world_->reserve_pool(*i);
+            }
+        }
+    }
+
     // const std::vector<Species>& species(model_->species_attributes());
     const std::vector<Species>& species(world_->species());
     for (std::vector<Species>::const_iterator i(species.begin());
@@ -319,8 +534,21 @@ void MesoscopicSimulator::initialize(void)
         proxies_.push_back(create_diffusion_proxy(*i));
     }
 
+    propensities_.clear();
+    total_propensities_.clear();
+    extend_propensities(0);
+
     scheduler_.clear();
     event_ids_.resize(world_->num_subvolumes());
+    if (num_threads_ > 1)
+    {
+        initialize_blocks();
+        return;
+    }
+
+    blocks_.clear();
+    block_offsets_.clear();
+    window_ = std::numeric_limits<Real>::infinity();
     for (Integer i(0); i < world_->num_subvolumes(); ++i)
     {
         event_ids_[i] =
@@ -329,6 +557,64 @@ void MesoscopicSimulator::initialize(void)
     }
 }
 
+void MesoscopicSimulator::initialize_blocks(void)
+{
+    const Integer3 matrix_sizes(world_->matrix_sizes());
+    const Integer num_layers(matrix_sizes.layer);
+    const Integer layer_size(matrix_sizes.col * matrix_sizes.row);
+    const Integer num_blocks(std::min(num_threads_, num_layers));
+
+    blocks_.clear();
+    block_offsets_.resize(num_blocks + 1);
+    for (Integer i(0); i <= num_blocks; ++i)
+    {
+        block_offsets_[i] = layer_size * (num_layers * i / num_blocks);
+    }
+
+    if (!pool_ || pool_->num_threads() != static_cast<std::size_t>(num_blocks))
+    {
+        pool_.reset(new ThreadPool(num_blocks));
+    }
+
+    for (Integer i(0); i < num_blocks; ++i)
+    {
+        Block* block(new Block());
+        block->rng = std::shared_ptr<RandomNumberGenerator>(
+            new GSLRandomNumberGenerator(
+                world_->rng()->uniform_int(0, std::numeric_limits<int>::max())));
+        blocks_.push_back(block);
+    }
+
+    if (synchronization_interval_ > 0)
+    {
+        window_ = synchronization_interval_;
+    }
+    else
+    {
+        const Real3 lengths(world_->subvolume_edge_lengths());
+        const Real p(
+            1.0 / (lengths[0] * lengths[0]) + 1.0 / (lengths[1] * lengths[1])
+            + 1.0 / (lengths[2] * lengths[2]));
+
+        Real kmax(0.0);
+        const std::vector<Species>& species(world_->species());
+        for (std::vector<Species>::const_iterator i(species.begin());
+            i != species.end(); ++i)
+        {
+            kmax = std::max(kmax, 2 * world_->get_pool(*i)->D() * p);
+        }
+        window_ = (kmax > 0 ? synchronization_factor() / kmax
+                   : std::numeric_limits<Real>::infinity());
+    }
+
+    for (Integer i(0); i < world_->num_subvolumes(); ++i)
+    {
+        event_ids_[i] =
+            blocks_[block_index(i)].scheduler.add(std::shared_ptr<Event>(
+                new SubvolumeEvent(this, i, t())));
+    }
+}
+
 Real MesoscopicSimulator::dt(void) const
 {
     return next_time() - t();
@@ -336,7 +622,24 @@ Real MesoscopicSimulator::dt(void) const
 
 Real MesoscopicSimulator::next_time(void) const
 {
-    return scheduler_.next_time();
+    if (!is_parallel())
+    {
+        return scheduler_.next_time();
+    }
+
+    Real tnext(std::numeric_limits<Real>::infinity());
+    for (boost::ptr_vector<Block>::const_iterator i(blocks_.begin()); i != blocks_.end(); ++i)
+    {
+        tnext = std::min(tnext, (*i).scheduler.next_time());
+    }
+
+    if (tnext == std::numeric_limits<Real>::infinity()
+        || window_ == std::numeric_limits<Real>::infinity())
+    {
+        return tnext;
+    }
+    // Skip windows in which nothing happens.
+    return std::max(t() + window_, tnext);
 }
 
 } // meso
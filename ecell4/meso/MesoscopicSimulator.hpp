@@ -2,11 +2,14 @@
 #define ECELL4_MESO_MESOSCOPIC_SIMULATOR_HPP
 
 #include <memory>
+#include <unordered_map>
+#include <algorithm>
 #include <boost/ptr_container/ptr_vector.hpp>
 #include <ecell4/core/types.hpp>
 #include <ecell4/core/Model.hpp>
 #include <ecell4/core/SimulatorBase.hpp>
 #include <ecell4/core/EventScheduler.hpp>
+#include <ecell4/core/ThreadPool.hpp>
 
 #include "MesoscopicWorld.hpp"
 
@@ -128,9 +131,9 @@ protected:
 
     protected:
 
-        inline const std::shared_ptr<RandomNumberGenerator>& rng() const
+        inline const std::shared_ptr<RandomNumberGenerator>& rng(const coordinate_type& c) const
         {
-            return sim_->world()->rng();
+            return sim_->rng(c);
         }
 
         inline const MesoscopicWorld& world() const
@@ -213,7 +216,7 @@ protected:
             {
                 const std::vector<ReactionRule>::size_type
                     rnd2(static_cast<std::vector<ReactionRule>::size_type>(
-                        rng()->uniform_int(0, retval.second - 1)));
+                        rng(c)->uniform_int(0, retval.second - 1)));
                 if (rnd2 >= reactions.size())
                 {
                     return std::make_pair(ReactionRule(), c);
@@ -378,7 +381,7 @@ protected:
             const std::vector<Species>& species(world().list_species());
             const ReactionRule::reactant_container_type& reactants(rr_.reactants());
 
-            const Real rnd1(rng()->uniform(0.0, num_tot1_[c]));
+            const Real rnd1(rng(c)->uniform(0.0, num_tot1_[c]));
 
             Integer num_tot(0);
             for (std::vector<Species>::const_iterator i(species.begin());
@@ -485,7 +488,7 @@ protected:
             const std::vector<Species>& species(world().list_species());
             const ReactionRule::reactant_container_type& reactants(rr_.reactants());
 
-            const Real rnd1(rng()->uniform(0.0, num_tot1_[c]));
+            const Real rnd1(rng(c)->uniform(0.0, num_tot1_[c]));
 
             Integer num_tot(0), coef1(0);
             std::vector<Species>::const_iterator itr1(species.begin());
@@ -504,7 +507,7 @@ protected:
             }
 
             const Real rnd2(
-                rng()->uniform(0.0, num_tot2_[c] - get_coef(reactants[0], *itr1)));
+                rng(c)->uniform(0.0, num_tot2_[c] - get_coef(reactants[0], *itr1)));
 
             num_tot = 0;
             for (std::vector<Species>::const_iterator i(species.begin());
@@ -614,7 +617,7 @@ protected:
             const std::vector<Species>& species(world().list_species());
             const ReactionRule::reactant_container_type& reactants(rr_.reactants());
 
-            const Real rnd1(rng()->uniform(0.0, num_tot_[c]));
+            const Real rnd1(rng(c)->uniform(0.0, num_tot_[c]));
 
             Integer tot(0);
             for (std::vector<Species>::const_iterator i(species.begin());
@@ -787,7 +790,7 @@ protected:
             for (std::size_t i = 0; i < reactants.size(); ++i)
             {
                 assert(num_reactants_[c][i] > 0);
-                const Real rnd(rng()->uniform(0.0, num_reactants_[c][i]));
+                const Real rnd(rng(c)->uniform(0.0, num_reactants_[c][i]));
                 Integer num_tot(0);
                 for (std::vector<Species>::const_iterator it(species.begin());
                     it != species.end(); ++it)
@@ -880,6 +883,20 @@ protected:
         std::vector<state_container_type> num_reactants_, num_products_;
     };
 
+    typedef boost::ptr_vector<ReactionRuleProxyBase> proxy_container_type;
+    typedef proxy_container_type::size_type proxy_index_type;
+    typedef std::vector<std::pair<proxy_index_type, Real> > propensity_container_type;
+
+    struct propensity_index_less
+    {
+        bool operator()(
+            const propensity_container_type::value_type& lhs,
+            const proxy_index_type rhs) const
+        {
+            return lhs.first < rhs;
+        }
+    };
+
     class DiffusionProxy
         : public ReactionRuleProxyBase
     {
@@ -887,22 +904,26 @@ protected:
 
         typedef ReactionRuleProxyBase base_type;
 
-    protected:
-
-        typedef std::pair<ReactionRuleProxy*, std::vector<Integer> >
+        /**
+         * a pair of the index of a ReactionRuleProxy depending on the species
+         * and the coefficients returned by check_dependency.
+         */
+        typedef std::pair<proxy_index_type, std::vector<Integer> >
             dependency_type;
         typedef std::vector<dependency_type> dependency_container_type;
 
     public:
 
         DiffusionProxy()
-            : base_type(), pool_(), dependencies_()
+            : base_type(), pool_(), index_(0), dependencies_()
         {
             ;
         }
 
-        DiffusionProxy(MesoscopicSimulator* sim, const Species& sp)
-            : base_type(sim), pool_(sim->world()->get_pool(sp)), dependencies_()
+        DiffusionProxy(
+            MesoscopicSimulator* sim, const Species& sp, const proxy_index_type index)
+            : base_type(sim), pool_(sim->world()->get_pool(sp)), index_(index),
+            dependencies_()
         {
             ;
         }
@@ -919,7 +940,7 @@ protected:
                 py(1.0 / (lengths[1] * lengths[1])),
                 pz(1.0 / (lengths[2] * lengths[2]));
 
-            const Real rnd1(sim_->world()->rng()->uniform(0.0, px + py + pz));
+            const Real rnd1(sim_->rng(c)->uniform(0.0, px + py + pz));
 
             if (rnd1 < px * 0.5)
             {
@@ -985,33 +1006,51 @@ protected:
                 // sim_->increment(pool_, dst);
 
                 pool_->remove_molecules(1, src);
-                pool_->add_molecules(1, dst);
+                sim_->update_dependencies(index_, src, -1);
 
-                for (dependency_container_type::const_iterator i(dependencies_.begin());
-                     i != dependencies_.end(); ++i)
+                if (!sim_->in_same_block(src, dst))
                 {
-                    (*i).first->inc_with_coefs((*i).second, src, -1);
-                    (*i).first->inc_with_coefs((*i).second, dst, +1);
+                    // The molecule arrives at the end of the time window.
+                    sim_->post_molecule(index_, src, dst);
+                    return;
                 }
+
+                pool_->add_molecules(1, dst);
+                sim_->update_dependencies(index_, dst, +1);
             }
 
             sim_->interrupt(dst);
         }
 
-        void set_dependency(ReactionRuleProxy* proxy)
+        void set_dependency(const proxy_index_type idx, const ReactionRuleProxy& proxy)
         {
-            const std::vector<Integer> coefs = proxy->check_dependency(pool_->species());
+            const std::vector<Integer> coefs = proxy.check_dependency(pool_->species());
             if (std::count(coefs.begin(), coefs.end(), 0) < std::distance(coefs.begin(), coefs.end()))
             {
-                dependencies_.push_back(std::make_pair(proxy, coefs));
+                dependencies_.push_back(std::make_pair(idx, coefs));
             }
         }
 
+        const dependency_container_type& dependencies() const
+        {
+            return dependencies_;
+        }
+
+        /**
+         * add a molecule which diffused from another block.
+         */
+        void arrive(const coordinate_type& dst)
+        {
+            pool_->add_molecules(1, dst);
+            sim_->update_dependencies(index_, dst, +1);
+        }
+
     protected:
 
         const std::shared_ptr<MesoscopicWorld::PoolBase> pool_;
         Real k_;
 
+        proxy_index_type index_;
         dependency_container_type dependencies_;
     };
 
@@ -1034,7 +1073,11 @@ protected:
         virtual void fire()
         {
             assert(proxy_ != NULL);
-            sim_->reset_last_reactions();
+            if (!sim_->is_parallel())
+            {
+                // Reactions are accumulated over a time window in parallel.
+                sim_->reset_last_reactions();
+            }
             proxy_->fire(time_, coord_);
             update();
         }
@@ -1061,22 +1104,104 @@ protected:
         ReactionRuleProxyBase* proxy_;
     };
 
+    /**
+     * a slab of layers of subvolumes simulated by a thread in the parallel
+     * mode. A molecule diffusing out of the block is held
+     * in outbox until the end of the time window. Thus, it cannot react
+     * in the destination within the window, which is an approximation.
+     */
+    struct Block
+    {
+        EventScheduler scheduler;
+        std::shared_ptr<RandomNumberGenerator> rng;
+        std::vector<std::pair<ReactionRule, reaction_info_type> > last_reactions;
+        std::vector<std::pair<proxy_index_type, coordinate_type> > outbox;
+        coordinate_type interrupted;
+    };
+
 public:
 
     MesoscopicSimulator(
         std::shared_ptr<MesoscopicWorld> world,
-        std::shared_ptr<Model> model)
-        : base_type(world, model)
+        std::shared_ptr<Model> model,
+        const Integer num_threads = default_num_threads(),
+        const Real synchronization_interval = default_synchronization_interval())
+        : base_type(world, model), num_threads_(num_threads),
+        synchronization_interval_(synchronization_interval)
     {
         initialize();
     }
 
-    MesoscopicSimulator(std::shared_ptr<MesoscopicWorld> world)
-        : base_type(world)
+    MesoscopicSimulator(
+        std::shared_ptr<MesoscopicWorld> world,
+        const Integer num_threads = default_num_threads(),
+        const Real synchronization_interval = default_synchronization_interval())
+        : base_type(world), num_threads_(num_threads),
+        synchronization_interval_(synchronization_interval)
     {
         initialize();
     }
 
+    static inline const Integer default_num_threads()
+    {
+        return 1;
+    }
+
+    /**
+     * zero means that the interval is chosen from the diffusion
+     * coefficients at initialize().
+     */
+    static inline const Real default_synchronization_interval()
+    {
+        return 0.0;
+    }
+
+    /**
+     * the automatic interval is this fraction of the mean residence time
+     * of the fastest diffusing species in a subvolume.
+     */
+    static inline const Real synchronization_factor()
+    {
+        return 0.1;
+    }
+
+    Integer num_threads() const
+    {
+        return num_threads_;
+    }
+
+    /**
+     * return true if subvolumes are split into blocks simulated in parallel.
+     * The number of blocks is that of threads, or that of layers if smaller.
+     * Diffusion between blocks is exchanged at the end of each time window,
+     * whose length is synchronization_interval. This is approximate:
+     * a molecule crossing blocks arrives late by up to one window, and
+     * the error grows with the window. The result is reproducible
+     * for a given seed of the world and number of threads.
+     */
+    bool is_parallel() const
+    {
+        return blocks_.size() > 0;
+    }
+
+    Real synchronization_interval() const
+    {
+        return window_;
+    }
+
+    /**
+     * set the length of a time window in the parallel mode. Call initialize()
+     * after this.
+     */
+    void set_synchronization_interval(const Real interval)
+    {
+        if (interval < 0)
+        {
+            throw std::invalid_argument("An interval must be positive or zero.");
+        }
+        synchronization_interval_ = interval;
+    }
+
     // SimulatorTraits
     Real dt(void) const;
     Real next_time(void) const;
@@ -1097,6 +1222,12 @@ public:
 
     void add_last_reaction(const ReactionRule& rr, const reaction_info_type& ri)
     {
+        if (is_parallel())
+        {
+            blocks_[block_index(ri.coordinate())].last_reactions.push_back(
+                std::make_pair(rr, ri));
+            return;
+        }
         last_reactions_.push_back(std::make_pair(rr, ri));
     }
 
@@ -1117,17 +1248,53 @@ public:
 
     void interrupt(const coordinate_type& coord)
     {
+        if (is_parallel())
+        {
+            blocks_[block_index(coord)].interrupted = coord;
+            return;
+        }
         interrupted_ = coord;
     }
 
 protected:
 
+    inline const std::shared_ptr<RandomNumberGenerator>& rng(const coordinate_type& c) const
+    {
+        return (is_parallel() ? blocks_[block_index(c)].rng : (*world_).rng());
+    }
+
+    inline std::size_t block_index(const coordinate_type& c) const
+    {
+        return std::upper_bound(
+            block_offsets_.begin() + 1, block_offsets_.end(), c) - (block_offsets_.begin() + 1);
+    }
+
+    inline bool in_same_block(const coordinate_type& c1, const coordinate_type& c2) const
+    {
+        return (!is_parallel() || block_index(c1) == block_index(c2));
+    }
+
+    void post_molecule(
+        const proxy_index_type i, const coordinate_type& src, const coordinate_type& dst)
+    {
+        blocks_[block_index(src)].outbox.push_back(std::make_pair(i, dst));
+    }
+
+    void initialize_blocks(void);
+    void fire_block(Block& block, const Real upto);
+    void step_blocks(const Real upto);
+
     DiffusionProxy* create_diffusion_proxy(const Species& sp);
 
     void interrupt_all(const Real& t);
     std::pair<Real, ReactionRuleProxyBase*>
         draw_next_reaction(const coordinate_type& c);
 
+    void extend_propensities(const proxy_index_type first);
+    void update_propensity(const proxy_index_type i, const coordinate_type& c);
+    void update_dependencies(
+        const proxy_index_type i, const coordinate_type& c, const Integer val);
+
     void increment_molecules(const Species& sp, const coordinate_type& c);
     void decrement_molecules(const Species& sp, const coordinate_type& c);
     void increment(const std::shared_ptr<MesoscopicWorld::PoolBase>& pool, const coordinate_type& c);
@@ -1138,12 +1305,39 @@ protected:
 
     std::vector<std::pair<ReactionRule, reaction_info_type> > last_reactions_;
 
-    boost::ptr_vector<ReactionRuleProxyBase> proxies_;
-    boost::ptr_vector<ReactionRuleProxyBase>::size_type diffusion_proxy_offset_;
+    proxy_container_type proxies_;
+    proxy_index_type diffusion_proxy_offset_;
+
+    /**
+     * propensities_ caches the propensities of proxies in each subvolume
+     * as pairs of the index of a proxy and its propensity, sorted by the
+     * index. Proxies with no propensity are not stored, so the cache grows
+     * with the number of possible events, not with the number of proxies.
+     * total_propensities_ holds their running sum for each subvolume.
+     * diffusion_proxies_ maps a species to its DiffusionProxy, which lists
+     * the ReactionRuleProxies depending on the species.
+     * The propensities of descriptor_proxies_ may depend on time, and are
+     * re-evaluated whenever the subvolume is rescheduled.
+     */
+    std::vector<propensity_container_type> propensities_;
+    std::vector<Real> total_propensities_;
+    std::unordered_map<Species, proxy_index_type> diffusion_proxies_;
+    std::vector<proxy_index_type> descriptor_proxies_;
 
     EventScheduler scheduler_;
     std::vector<EventScheduler::identifier_type> event_ids_;
     coordinate_type interrupted_;
+
+    /**
+     * blocks_ is empty unless the simulator runs in parallel, and
+     * block_offsets_ holds the first subvolume of each block followed by
+     * the number of subvolumes. window_ is the actual synchronization interval.
+     */
+    Integer num_threads_;
+    Real synchronization_interval_, window_;
+    boost::ptr_vector<Block> blocks_;
+    std::vector<coordinate_type> block_offsets_;
+    std::shared_ptr<ThreadPool> pool_;
 };
 
 } // meso
@@ -13,6 +13,7 @@
 
 #include <ecell4/meso/MesoscopicWorld.cpp>
 #include <ecell4/meso/MesoscopicSimulator.hpp>
+#include <ecell4/meso/MesoscopicFactory.hpp>
 
 using namespace ecell4;
 using namespace ecell4::meso;
@@ -49,3 +50,257 @@ BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_step)
     BOOST_CHECK(world->num_molecules(sp1, 0) == 9);
     BOOST_CHECK(world->num_molecules(sp2, 0) == 1);
 }
+
+BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_binding)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A", 0.0, 1.0);
+    Species sp2("B", 0.0, 1.0);
+    Species sp3("C", 0.0, 1.0);
+    model->add_species_attribute(sp1);
+    model->add_species_attribute(sp2);
+    model->add_species_attribute(sp3);
+    model->add_reaction_rule(create_binding_reaction_rule(sp1, sp2, sp3, 1.0));
+    model->add_reaction_rule(create_unbinding_reaction_rule(sp3, sp1, sp2, 1.0));
+
+    const Real L(1.0);
+    const Real3 edge_lengths(L, L, L);
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<MesoscopicWorld> world(
+        new MesoscopicWorld(edge_lengths, Integer3(4, 4, 4), rng));
+
+    // C is not in the world until the first binding reaction.
+    world->add_molecules(sp1, 100);
+    world->add_molecules(sp2, 100);
+
+    MesoscopicSimulator sim(world, model);
+    sim.run(1.0);
+
+    BOOST_CHECK(sim.num_steps() > 0);
+    BOOST_CHECK(world->num_molecules_exact(sp3) > 0);
+    BOOST_CHECK_EQUAL(
+        world->num_molecules_exact(sp1) + world->num_molecules_exact(sp3), 100);
+    BOOST_CHECK_EQUAL(
+        world->num_molecules_exact(sp2) + world->num_molecules_exact(sp3), 100);
+
+    Integer num_molecules(0);
+    for (Integer i(0); i < world->num_subvolumes(); ++i)
+    {
+        num_molecules += world->num_molecules_exact(sp1, i);
+    }
+    BOOST_CHECK_EQUAL(num_molecules, world->num_molecules_exact(sp1));
+}
+
+BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_parallel)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A", 0.0, 1.0);
+    Species sp2("B", 0.0, 1.0);
+    Species sp3("C", 0.0, 1.0);
+    model->add_species_attribute(sp1);
+    model->add_species_attribute(sp2);
+    model->add_species_attribute(sp3);
+    model->add_reaction_rule(create_binding_reaction_rule(sp1, sp2, sp3, 1.0));
+    model->add_reaction_rule(create_unbinding_reaction_rule(sp3, sp1, sp2, 1.0));
+
+    const Real L(1.0);
+    const Real3 edge_lengths(L, L, L);
+    std::vector<Integer> results;
+    for (unsigned int i(0); i < 2; ++i)
+    {
+        std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+        rng->seed(0);
+        std::shared_ptr<MesoscopicWorld> world(
+            new MesoscopicWorld(edge_lengths, Integer3(4, 4, 4), rng));
+        world->add_molecules(sp1, 100);
+        world->add_molecules(sp2, 100);
+
+        MesoscopicSimulator sim(world, model, 3);
+        BOOST_CHECK(sim.is_parallel());
+        BOOST_CHECK(sim.synchronization_interval() > 0);
+        BOOST_CHECK(sim.synchronization_interval() < std::numeric_limits<Real>::infinity());
+
+        sim.run(1.0);
+
+        BOOST_CHECK_EQUAL(sim.t(), 1.0);
+        BOOST_CHECK_EQUAL(
+            world->num_molecules_exact(sp1) + world->num_molecules_exact(sp3), 100);
+        BOOST_CHECK_EQUAL(
+            world->num_molecules_exact(sp2) + world->num_molecules_exact(sp3), 100);
+
+        for (Integer j(0); j < world->num_subvolumes(); ++j)
+        {
+            results.push_back(world->num_molecules_exact(sp3, j));
+        }
+    }
+
+    // The same seed and number of threads give the same result.
+    BOOST_CHECK(std::equal(
+        results.begin(), results.begin() + results.size() / 2,
+        results.begin() + results.size() / 2));
+}
+
+Real mean_far_molecules(const Integer num_threads)
+{
+    // The number of molecules in the far half of a periodic column.
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A", 0.0, 1.0);
+    model->add_species_attribute(sp1);
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(num_threads);
+
+    const Integer num_runs(20);
+    Real mean(0.0);
+    for (Integer run(0); run < num_runs; ++run)
+    {
+        std::shared_ptr<MesoscopicWorld> world(
+            new MesoscopicWorld(Real3(1, 1, 8), Integer3(1, 1, 8), rng));
+        world->add_molecules(sp1, 200, Integer3(0, 0, 0));
+
+        MesoscopicSimulator sim(world, model, num_threads);
+        BOOST_CHECK_EQUAL(sim.is_parallel(), num_threads > 1);
+        sim.run(2.0);
+
+        for (Integer layer(2); layer < 7; ++layer)
+        {
+            mean += world->num_molecules_exact(sp1, Integer3(0, 0, layer)) / num_runs;
+        }
+    }
+    return mean;
+}
+
+BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_parallel_accuracy)
+{
+    // Molecules crossing blocks arrive late. The bias must be small
+    // compared to the standard error of the difference, about 1.7.
+    const Real serial(mean_far_molecules(1));
+    const Real parallel(mean_far_molecules(4));
+    BOOST_TEST_MESSAGE("serial: " << serial << ", parallel: " << parallel);
+    BOOST_CHECK(serial > 10.0);
+    BOOST_CHECK(std::abs(serial - parallel) < 8.0);
+}
+
+/**
+ * compares the cached propensities with those evaluated by proxies.
+ */
+class CheckedMesoscopicSimulator
+    : public MesoscopicSimulator
+{
+public:
+
+    CheckedMesoscopicSimulator(
+        std::shared_ptr<MesoscopicWorld> world, std::shared_ptr<Model> model)
+        : MesoscopicSimulator(world, model, 1)
+    {
+        ;
+    }
+
+    bool check_propensities() const
+    {
+        for (coordinate_type c(0); c < world_->num_subvolumes(); ++c)
+        {
+            propensity_container_type::const_iterator j(propensities_[c].begin());
+            for (proxy_index_type i(0); i < proxies_.size(); ++i)
+            {
+                const Real a(proxies_[i].propensity(c));
+                if (j != propensities_[c].end() && (*j).first == i)
+                {
+                    if ((*j).second != a)
+                    {
+                        return false;
+                    }
+                    ++j;
+                }
+                else if (a != 0.0)
+                {
+                    return false;
+                }
+            }
+            if (j != propensities_[c].end())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_propensities)
+{
+    // A birth-death process, whose stationary distribution is Poisson.
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A", 0.0, 0.01);
+    model->add_species_attribute(sp1);
+    model->add_reaction_rule(create_synthesis_reaction_rule(sp1, 50.0));
+    model->add_reaction_rule(create_degradation_reaction_rule(sp1, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<MesoscopicWorld> world(
+        new MesoscopicWorld(Real3(1, 1, 1), Integer3(3, 3, 3), rng));
+
+    CheckedMesoscopicSimulator sim(world, model);
+    sim.run(10.0);
+    BOOST_CHECK(sim.check_propensities());
+
+    const Integer num_samples(1000);
+    Real mean(0.0), var(0.0);
+    for (Integer i(0); i < num_samples; ++i)
+    {
+        sim.run(1.0);
+        const Real num(world->num_molecules_exact(sp1));
+        mean += num / num_samples;
+        var += num * num / num_samples;
+    }
+    var -= mean * mean;
+    BOOST_CHECK(sim.check_propensities());
+
+    // The mean and the variance are 50 with the standard error about 0.3.
+    BOOST_CHECK(std::abs(mean - 50.0) < 2.0);
+    BOOST_CHECK(std::abs(var - 50.0) < 10.0);
+}
+
+BOOST_AUTO_TEST_CASE(MesoscopicSimulator_test_ensemble)
+{
+    // A and B never meet unless replicates move them to other subvolumes.
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A", 0.0, 0.0);
+    Species sp2("B", 0.0, 0.0);
+    Species sp3("C", 0.0, 0.0);
+    model->add_species_attribute(sp1);
+    model->add_species_attribute(sp2);
+    model->add_species_attribute(sp3);
+    model->add_reaction_rule(create_binding_reaction_rule(sp1, sp2, sp3, 1e+3));
+
+    const Integer3 matrix_sizes(2, 1, 1);
+    std::shared_ptr<MesoscopicWorld> world(
+        new MesoscopicWorld(Real3(1, 1, 1), matrix_sizes));
+    world->add_molecules(sp1, 50, 0);
+    world->add_molecules(sp2, 50, 1);
+
+    const Integer num_runs(8);
+    std::vector<std::string> targets;
+    targets.push_back("A");
+    targets.push_back("C");
+    const EnsembleResult result(
+        EnsembleRunner<MesoscopicFactory>(MesoscopicFactory(matrix_sizes, 0.0, 1), 2).run(
+            world, model, 1.0, 0.5, num_runs, targets, 1));
+    BOOST_CHECK_EQUAL(result.num_times(), 3);
+
+    for (Integer run(0); run < num_runs; ++run)
+    {
+        for (Integer i(0); i < result.num_times(); ++i)
+        {
+            BOOST_CHECK_EQUAL(result.value(run, i, 1), 50);
+            BOOST_CHECK_EQUAL(result.value(run, i, 2), 0);
+        }
+    }
+
+    // replicates must have as many subvolumes as the original.
+    BOOST_CHECK_THROW(
+        EnsembleRunner<MesoscopicFactory>(MesoscopicFactory(Integer3(3, 1, 1), 0.0, 1), 1).run(
+            world, model, 1.0, 0.5, 1, targets, 1),
+        IllegalArgument);
+}
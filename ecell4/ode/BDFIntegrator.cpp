@@ -0,0 +1,639 @@
+#include "BDFIntegrator.hpp"
+
+#include <set>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <ecell4/core/exceptions.hpp>
+
+namespace ecell4
+{
+
+namespace ode
+{
+
+SparseLU::SparseLU(const matrix_type& pattern)
+    : size_(pattern.size), perm_(pattern.size), iperm_(pattern.size)
+{
+    const std::size_t n(size_);
+
+    std::vector<std::size_t> degrees(n, 0);
+    for (std::size_t i(0); i < n; ++i)
+    {
+        for (std::size_t p(pattern.offsets[i]); p < pattern.offsets[i + 1]; ++p)
+        {
+            if (pattern.indices[p] != i)
+            {
+                ++degrees[i];
+                ++degrees[pattern.indices[p]];
+            }
+        }
+    }
+
+    for (std::size_t i(0); i < n; ++i)
+    {
+        perm_[i] = i;
+    }
+    std::stable_sort(perm_.begin(), perm_.end(),
+        [&degrees](const std::size_t lhs, const std::size_t rhs)
+        {
+            return degrees[lhs] < degrees[rhs];
+        });
+    for (std::size_t k(0); k < n; ++k)
+    {
+        iperm_[perm_[k]] = k;
+    }
+
+    // The symbolic elimination. The row k of U is merged into any later
+    // row which has an element at the column k.
+    offsets_.assign(1, 0);
+    diagonals_.resize(n);
+    for (std::size_t k(0); k < n; ++k)
+    {
+        const std::size_t i(perm_[k]);
+        std::set<std::size_t> columns;
+        columns.insert(k);
+        for (std::size_t p(pattern.offsets[i]); p < pattern.offsets[i + 1]; ++p)
+        {
+            columns.insert(iperm_[pattern.indices[p]]);
+        }
+
+        for (std::set<std::size_t>::const_iterator it(columns.begin());
+            *it < k; ++it)
+        {
+            const std::size_t l(*it);
+            columns.insert(
+                indices_.begin() + diagonals_[l] + 1, indices_.begin() + offsets_[l + 1]);
+        }
+
+        for (std::set<std::size_t>::const_iterator it(columns.begin());
+            it != columns.end(); ++it)
+        {
+            if (*it == k)
+            {
+                diagonals_[k] = indices_.size();
+            }
+            indices_.push_back(*it);
+        }
+        offsets_.push_back(indices_.size());
+    }
+    values_.resize(indices_.size());
+    work_.resize(n);
+
+    slots_.reserve(pattern.indices.size());
+    for (std::size_t i(0); i < n; ++i)
+    {
+        const std::size_t k(iperm_[i]);
+        for (std::size_t p(pattern.offsets[i]); p < pattern.offsets[i + 1]; ++p)
+        {
+            slots_.push_back(
+                std::lower_bound(
+                    indices_.begin() + offsets_[k], indices_.begin() + offsets_[k + 1],
+                    iperm_[pattern.indices[p]])
+                - indices_.begin());
+        }
+    }
+}
+
+bool SparseLU::factorize(const matrix_type& jacobi, const Real c)
+{
+    std::fill(values_.begin(), values_.end(), 0.0);
+    for (std::size_t p(0); p < jacobi.values.size(); ++p)
+    {
+        values_[slots_[p]] -= c * jacobi.values[p];
+    }
+    for (std::size_t k(0); k < size_; ++k)
+    {
+        values_[diagonals_[k]] += 1.0;
+    }
+
+    std::fill(work_.begin(), work_.end(), 0.0);
+    for (std::size_t k(0); k < size_; ++k)
+    {
+        for (std::size_t p(offsets_[k]); p < offsets_[k + 1]; ++p)
+        {
+            work_[indices_[p]] = values_[p];
+        }
+
+        for (std::size_t p(offsets_[k]); p < diagonals_[k]; ++p)
+        {
+            const std::size_t l(indices_[p]);
+            const Real factor(work_[l] / values_[diagonals_[l]]);
+            work_[l] = factor;
+            for (std::size_t q(diagonals_[l] + 1); q < offsets_[l + 1]; ++q)
+            {
+                work_[indices_[q]] -= factor * values_[q];
+            }
+        }
+
+        for (std::size_t p(offsets_[k]); p < offsets_[k + 1]; ++p)
+        {
+            values_[p] = work_[indices_[p]];
+            work_[indices_[p]] = 0.0;
+        }
+
+        if (!(std::abs(values_[diagonals_[k]]) > std::numeric_limits<Real>::min()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SparseLU::solve(state_type& b, const std::size_t offset)
+{
+    for (std::size_t k(0); k < size_; ++k)
+    {
+        Real v(b[offset + perm_[k]]);
+        for (std::size_t p(offsets_[k]); p < diagonals_[k]; ++p)
+        {
+            v -= values_[p] * work_[indices_[p]];
+        }
+        work_[k] = v;
+    }
+
+    for (std::size_t k(size_); k > 0; --k)
+    {
+        const std::size_t l(k - 1);
+        Real v(work_[l]);
+        for (std::size_t p(diagonals_[l] + 1); p < offsets_[l + 1]; ++p)
+        {
+            v -= values_[p] * work_[indices_[p]];
+        }
+        work_[l] = v / values_[diagonals_[l]];
+    }
+
+    for (std::size_t k(0); k < size_; ++k)
+    {
+        b[offset + perm_[k]] = work_[k];
+        work_[k] = 0.0;
+    }
+}
+
+namespace
+{
+
+const std::size_t NEWTON_MAXITER = 4;
+const Real MIN_FACTOR = 0.2;
+const Real MAX_FACTOR = 10.0;
+
+// gamma_k = sum_{j=1}^k 1/j, which is also alpha_k of BDF.
+inline Real bdf_gamma(const std::size_t k)
+{
+    Real retval(0.0);
+    for (std::size_t j(1); j <= k; ++j)
+    {
+        retval += 1.0 / j;
+    }
+    return retval;
+}
+
+inline Real bdf_error_const(const std::size_t k)
+{
+    return 1.0 / (k + 1);
+}
+
+/**
+ * the matrix to rescale the backward differences of the given order by
+ * factor, which is stored in the row-major order.
+ */
+std::vector<Real> compute_R(const std::size_t order, const Real factor)
+{
+    const std::size_t m(order + 1);
+    std::vector<Real> R(m * m, 0.0);
+    for (std::size_t j(0); j < m; ++j)
+    {
+        R[j] = 1.0;
+    }
+    for (std::size_t i(1); i < m; ++i)
+    {
+        for (std::size_t j(1); j < m; ++j)
+        {
+            R[i * m + j] = R[(i - 1) * m + j] * (i - 1 - factor * j) / i;
+        }
+    }
+    return R;
+}
+
+} // anonymous
+
+const std::size_t BDFIntegrator::MAX_ORDER;
+
+BDFIntegrator::BDFIntegrator(const matrix_type& pattern)
+    : lu_(pattern), jacobi_(pattern), initialized_(false),
+    t_(0.0), h_abs_(0.0), abs_tol_(0.0), rel_tol_(0.0),
+    order_(1), num_equal_steps_(0), lu_available_(false),
+    num_jacobians_(0), num_factorizations_(0), interpolated_(false), t_out_(0.0)
+{
+    ;
+}
+
+Real BDFIntegrator::norm(const state_type& v, const state_type& scale) const
+{
+    if (v.size() == 0)
+    {
+        return 0.0;
+    }
+
+    Real retval(0.0);
+    for (std::size_t i(0); i < v.size(); ++i)
+    {
+        const Real r(v[i] / scale[i]);
+        retval += r * r;
+    }
+    return std::sqrt(retval / v.size());
+}
+
+bool BDFIntegrator::is_continuous(const state_type& x, const Real t) const
+{
+    if (!initialized_ || t != t_ || x.size() != D_[0].size())
+    {
+        return false;
+    }
+    return std::equal(x.begin(), x.end(), D_[0].begin());
+}
+
+void BDFIntegrator::evaluate_jacobian(
+    const jacobian_type& jacobian, const state_type& y, const Real t)
+{
+    jacobian(y, jacobi_, t, dfdt_);
+    lu_available_ = false;
+    ++num_jacobians_;
+}
+
+bool BDFIntegrator::factorize(const Real c)
+{
+    ++num_factorizations_;
+    lu_available_ = lu_.factorize(jacobi_, c);
+    return lu_available_;
+}
+
+void BDFIntegrator::change_differences(const Real factor)
+{
+    const std::size_t m(order_ + 1);
+    const std::vector<Real> R(compute_R(order_, factor)), U(compute_R(order_, 1.0));
+
+    // D[:m] = (R U)^T D[:m]
+    std::vector<Real> RU(m * m, 0.0);
+    for (std::size_t i(0); i < m; ++i)
+    {
+        for (std::size_t l(0); l < m; ++l)
+        {
+            for (std::size_t j(0); j < m; ++j)
+            {
+                RU[i * m + j] += R[i * m + l] * U[l * m + j];
+            }
+        }
+    }
+
+    const std::vector<state_type> D(D_.begin(), D_.begin() + m);
+    for (std::size_t j(0); j < m; ++j)
+    {
+        state_type& Dj(D_[j]);
+        std::fill(Dj.begin(), Dj.end(), 0.0);
+        for (std::size_t i(0); i < m; ++i)
+        {
+            Dj += RU[i * m + j] * D[i];
+        }
+    }
+}
+
+void BDFIntegrator::reset(
+    const function_type& f, const jacobian_type& jacobian, const state_type& x, const Real t,
+    const Real tend, const Real max_step)
+{
+    const std::size_t n(x.size());
+    t_ = t;
+    order_ = 1;
+    num_equal_steps_ = 0;
+    D_.assign(MAX_ORDER + 3, state_type(n));
+    for (std::size_t i(0); i < D_.size(); ++i)
+    {
+        std::fill(D_[i].begin(), D_[i].end(), 0.0);
+    }
+    D_[0] = x;
+    fx_.resize(n, false);
+    dfdt_.resize(n, false);
+
+    // The initial step size by Hairer, Norsett and Wanner.
+    state_type f0(n), scale(n);
+    f(x, f0, t);
+    for (std::size_t i(0); i < n; ++i)
+    {
+        scale[i] = abs_tol_ + rel_tol_ * std::abs(x[i]);
+    }
+    const Real d0(norm(x, scale)), d1(norm(f0, scale));
+    const Real h0((d0 < 1e-5 || d1 < 1e-5) ? 1e-6 : 0.01 * d0 / d1);
+
+    state_type x1(x + h0 * f0), f1(n);
+    f(x1, f1, t + h0);
+    const Real d2(norm(f1 - f0, scale) / h0);
+    const Real h1((d1 <= 1e-15 && d2 <= 1e-15)
+        ? std::max(1e-6, h0 * 1e-3) : std::pow(0.01 / std::max(d1, d2), 0.5));
+
+    h_abs_ = std::min(std::min(100 * h0, h1), tend - t);
+    if (max_step > 0)
+    {
+        h_abs_ = std::min(h_abs_, max_step);
+    }
+    D_[1] = f0 * h_abs_;
+
+    evaluate_jacobian(jacobian, x, t);
+    initialized_ = true;
+    interpolated_ = false;
+}
+
+bool BDFIntegrator::solve_bdf_system(
+    const function_type& f, const Real tnew, const state_type& ypredict, const Real c,
+    const state_type& psi, const state_type& scale, const Real tol,
+    state_type& y, state_type& d, std::size_t& num_iterations)
+{
+    const std::size_t n(ypredict.size());
+    y = ypredict;
+    std::fill(d.begin(), d.end(), 0.0);
+
+    state_type dy(n);
+    Real dy_norm_old(-1.0);
+    for (num_iterations = 1; num_iterations <= NEWTON_MAXITER; ++num_iterations)
+    {
+        f(y, fx_, tnew);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            if (!std::isfinite(fx_[i]))
+            {
+                return false;
+            }
+            dy[i] = c * fx_[i] - psi[i] - d[i];
+        }
+        for (std::size_t offset(0); offset < n; offset += lu_.size())
+        {
+            lu_.solve(dy, offset);
+        }
+
+        const Real dy_norm(norm(dy, scale));
+        const Real rate(dy_norm_old > 0 ? dy_norm / dy_norm_old : -1.0);
+        if (rate >= 0
+            && (rate >= 1
+                || std::pow(rate, static_cast<Real>(NEWTON_MAXITER - num_iterations + 1))
+                    / (1 - rate) * dy_norm > tol))
+        {
+            return false;
+        }
+
+        y += dy;
+        d += dy;
+
+        if (dy_norm == 0 || (rate >= 0 && rate / (1 - rate) * dy_norm < tol))
+        {
+            return true;
+        }
+        dy_norm_old = dy_norm;
+    }
+    num_iterations = NEWTON_MAXITER;
+    return false;
+}
+
+void BDFIntegrator::step(
+    const function_type& f, const jacobian_type& jacobian, const Real tend, const Real max_step)
+{
+    const std::size_t n(D_[0].size());
+    const Real min_step(
+        10 * std::abs(std::nextafter(t_, std::numeric_limits<Real>::infinity()) - t_));
+
+    if (max_step > 0 && h_abs_ > max_step)
+    {
+        change_differences(max_step / h_abs_);
+        h_abs_ = max_step;
+        num_equal_steps_ = 0;
+    }
+    else if (h_abs_ < min_step)
+    {
+        change_differences(min_step / h_abs_);
+        h_abs_ = min_step;
+        num_equal_steps_ = 0;
+    }
+
+    const Real newton_tol(rel_tol_ > 0
+        ? std::max(10 * std::numeric_limits<Real>::epsilon() / rel_tol_,
+                   std::min(0.03, std::sqrt(rel_tol_)))
+        : 0.03);
+
+    state_type ypredict(n), psi(n), scale(n), ynew(n), d(n);
+    std::size_t num_iterations(0);
+    Real error_norm(0.0), safety(0.0), tnew(t_);
+    bool current_jacobian(false);
+
+    while (true)
+    {
+        if (h_abs_ < min_step)
+        {
+            throw IllegalState("The step size of BDF became too small.");
+        }
+
+        Real h(h_abs_);
+        tnew = t_ + h;
+        if (tnew >= tend)
+        {
+            tnew = tend;
+            change_differences((tnew - t_) / h_abs_);
+            num_equal_steps_ = 0;
+            lu_available_ = false;
+        }
+        h = tnew - t_;
+        h_abs_ = h;
+
+        const Real alpha(bdf_gamma(order_));
+        std::fill(ypredict.begin(), ypredict.end(), 0.0);
+        std::fill(psi.begin(), psi.end(), 0.0);
+        for (std::size_t j(0); j <= order_; ++j)
+        {
+            ypredict += D_[j];
+        }
+        for (std::size_t j(1); j <= order_; ++j)
+        {
+            psi += (bdf_gamma(j) / alpha) * D_[j];
+        }
+        for (std::size_t i(0); i < n; ++i)
+        {
+            scale[i] = abs_tol_ + rel_tol_ * std::abs(ypredict[i]);
+        }
+
+        const Real c(h / alpha);
+        bool converged(false);
+        while (true)
+        {
+            if (!lu_available_ && !factorize(c))
+            {
+                break;
+            }
+
+            converged = solve_bdf_system(
+                f, tnew, ypredict, c, psi, scale, newton_tol, ynew, d, num_iterations);
+            if (converged || current_jacobian)
+            {
+                break;
+            }
+
+            evaluate_jacobian(jacobian, ypredict, tnew);
+            current_jacobian = true;
+        }
+
+        if (!converged)
+        {
+            const Real factor(0.5);
+            h_abs_ *= factor;
+            change_differences(factor);
+            num_equal_steps_ = 0;
+            lu_available_ = false;
+            continue;
+        }
+
+        safety = 0.9 * (2 * NEWTON_MAXITER + 1) / (2 * NEWTON_MAXITER + num_iterations);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            scale[i] = abs_tol_ + rel_tol_ * std::abs(ynew[i]);
+        }
+        error_norm = bdf_error_const(order_) * norm(d, scale);
+
+        if (error_norm > 1)
+        {
+            const Real factor(std::max(
+                MIN_FACTOR, safety * std::pow(error_norm, -1.0 / (order_ + 1))));
+            h_abs_ *= factor;
+            change_differences(factor);
+            num_equal_steps_ = 0;
+            // The iteration converged, and the factorization is still usable.
+            continue;
+        }
+        break;
+    }
+
+    ++num_equal_steps_;
+    t_ = tnew;
+
+    D_[order_ + 2] = d - D_[order_ + 1];
+    D_[order_ + 1] = d;
+    for (std::size_t i(order_ + 1); i > 0; --i)
+    {
+        D_[i - 1] += D_[i];
+    }
+
+    if (num_equal_steps_ < order_ + 1)
+    {
+        return;
+    }
+
+    const Real inf(std::numeric_limits<Real>::infinity());
+    const Real error_m_norm(order_ > 1
+        ? bdf_error_const(order_ - 1) * norm(D_[order_], scale) : inf);
+    const Real error_p_norm(order_ < MAX_ORDER
+        ? bdf_error_const(order_ + 1) * norm(D_[order_ + 2], scale) : inf);
+
+    const Real factors[3] = {
+        std::pow(error_m_norm, -1.0 / order_),
+        std::pow(error_norm, -1.0 / (order_ + 1)),
+        std::pow(error_p_norm, -1.0 / (order_ + 2))};
+    const std::size_t best(std::max_element(factors, factors + 3) - factors);
+    order_ = order_ + best - 1;
+
+    const Real factor(std::min(MAX_FACTOR, safety * factors[best]));
+    h_abs_ *= factor;
+    change_differences(factor);
+    num_equal_steps_ = 0;
+    lu_available_ = false;
+}
+
+std::size_t BDFIntegrator::integrate(
+    const function_type& f, const jacobian_type& jacobian, state_type& x,
+    const Real t, const Real tend,
+    const Real abs_tol, const Real rel_tol, const Real max_step,
+    const step_observer_type& observer)
+{
+    abs_tol_ = abs_tol;
+    rel_tol_ = rel_tol;
+
+    if (x.size() == 0 || tend <= t)
+    {
+        return 0;
+    }
+
+    if (!is_continuous(x, t))
+    {
+        reset(f, jacobian, x, t, tend, max_step);
+    }
+
+    std::size_t steps(0);
+    while (t_ < tend)
+    {
+        step(f, jacobian, tend, max_step);
+        ++steps;
+
+        if (observer)
+        {
+            observer(D_[0], t_);
+        }
+    }
+
+    x = D_[0];
+    interpolated_ = false;
+    return steps;
+}
+
+std::size_t BDFIntegrator::integrate_dense(
+    const function_type& f, const jacobian_type& jacobian, state_type& x,
+    const Real t, const Real tend,
+    const Real abs_tol, const Real rel_tol, const Real max_step,
+    const step_observer_type& observer)
+{
+    abs_tol_ = abs_tol;
+    rel_tol_ = rel_tol;
+
+    if (x.size() == 0 || tend <= t)
+    {
+        return 0;
+    }
+
+    const bool is_interpolated(
+        interpolated_ && t == t_out_ && x.size() == x_out_.size()
+        && std::equal(x.begin(), x.end(), x_out_.begin()));
+    if (!is_interpolated && !is_continuous(x, t))
+    {
+        reset(f, jacobian, x, t, tend, max_step);
+    }
+
+    const Real inf(std::numeric_limits<Real>::infinity());
+    std::size_t steps(0);
+    while (t_ < tend)
+    {
+        step(f, jacobian, inf, max_step);
+        ++steps;
+
+        if (observer)
+        {
+            observer(D_[0], t_);
+        }
+    }
+
+    interpolate(tend, x);
+    interpolated_ = true;
+    t_out_ = tend;
+    x_out_ = x;
+    return steps;
+}
+
+void BDFIntegrator::interpolate(const Real t, state_type& x) const
+{
+    // y(t) = D[0] + sum_k D[k] prod_{j<k} (t - t_ + j h) / ((j + 1) h)
+    x = D_[0];
+    Real p(1.0);
+    for (std::size_t j(0); j < order_; ++j)
+    {
+        p *= (t - (t_ - j * h_abs_)) / ((j + 1) * h_abs_);
+        x += p * D_[j + 1];
+    }
+}
+
+} // ode
+
+} // ecell4
@@ -0,0 +1,196 @@
+#ifndef ECELL4_ODE_BDF_INTEGRATOR_HPP
+#define ECELL4_ODE_BDF_INTEGRATOR_HPP
+
+#include <vector>
+#include <functional>
+
+#include <ecell4/core/types.hpp>
+
+#include "ODESimulator.hpp"
+
+namespace ecell4
+{
+
+namespace ode
+{
+
+/**
+ * SparseLU factorizes I - c J for a sparse J with a fixed sparsity
+ * pattern. The symbolic factorization, i.e. the ordering and the fill-in,
+ * is computed once at construction, and factorize() only updates values.
+ * The rows and columns are ordered by their degrees so that hub species,
+ * like ATP in metabolic networks, come last and make little fill-in.
+ * No pivoting is done.
+ */
+class SparseLU
+{
+public:
+
+    typedef ODESimulator::sparse_matrix_type matrix_type;
+    typedef ODESimulator::state_type state_type;
+
+public:
+
+    SparseLU(const matrix_type& pattern);
+
+    /**
+     * factorize I - c J. J must have the pattern given at construction.
+     * return false if a pivot vanishes.
+     */
+    bool factorize(const matrix_type& jacobi, const Real c);
+
+    /**
+     * solve (I - c J) x = b in place for the block of b from offset.
+     */
+    void solve(state_type& b, const std::size_t offset = 0);
+
+    std::size_t size() const
+    {
+        return size_;
+    }
+
+    std::size_t num_nonzeros() const
+    {
+        return indices_.size();
+    }
+
+protected:
+
+    std::size_t size_;
+    std::vector<std::size_t> perm_, iperm_;
+
+    // the filled pattern of the permuted matrix in CSR. L is strictly
+    // lower and unit diagonal, and U is the rest.
+    std::vector<std::size_t> offsets_, diagonals_, indices_;
+    std::vector<Real> values_;
+
+    // the position in values_ of each element of J
+    std::vector<std::size_t> slots_;
+
+    std::vector<Real> work_;
+};
+
+/**
+ * BDFIntegrator is a variable-order (1 to 5), variable-step BDF method in
+ * the quasi-constant step size form, i.e. the backward differences of the
+ * solution are kept and rescaled whenever the step size changes. The
+ * implicit equation is solved by a simplified Newton iteration with
+ * SparseLU. The Jacobian is kept across steps, and is re-evaluated only
+ * when the iteration fails to converge.
+ *
+ * The system can be larger than the Jacobian given, e.g. a state augmented
+ * with its sensitivities. Then the Newton matrix is approximated by the
+ * block diagonal matrix of the Jacobian, which is factorized only once.
+ *
+ * The integrator keeps its history between successive calls of
+ * integrate() as far as the state and time given are where the last call
+ * ended. Otherwise, it restarts from the first order.
+ */
+class BDFIntegrator
+{
+public:
+
+    typedef ODESimulator::state_type state_type;
+    typedef ODESimulator::sparse_matrix_type matrix_type;
+    typedef std::function<void (const state_type&, state_type&, const double&)> function_type;
+    typedef std::function<void (const state_type&, matrix_type&, const double&, state_type&)> jacobian_type;
+    typedef ODESimulator::step_observer_type step_observer_type;
+
+    static const std::size_t MAX_ORDER = 5;
+
+public:
+
+    BDFIntegrator(const matrix_type& pattern);
+
+    /**
+     * integrate x from t to tend. observer, if any, is called after
+     * every accepted step.
+     * return the number of steps.
+     */
+    std::size_t integrate(
+        const function_type& f, const jacobian_type& jacobian, state_type& x,
+        const Real t, const Real tend,
+        const Real abs_tol, const Real rel_tol, const Real max_step,
+        const step_observer_type& observer = step_observer_type());
+
+    /**
+     * integrate x from t to tend as integrate(), but without truncating the
+     * last step at tend. The state at tend is interpolated, and the history
+     * is kept to continue from there.
+     * return the number of steps.
+     */
+    std::size_t integrate_dense(
+        const function_type& f, const jacobian_type& jacobian, state_type& x,
+        const Real t, const Real tend,
+        const Real abs_tol, const Real rel_tol, const Real max_step,
+        const step_observer_type& observer = step_observer_type());
+
+    /**
+     * interpolate the state at t within the last step.
+     */
+    void interpolate(const Real t, state_type& x) const;
+
+    Integer order() const
+    {
+        return order_;
+    }
+
+    Real step_interval() const
+    {
+        return h_abs_;
+    }
+
+    Integer num_jacobian_evaluations() const
+    {
+        return num_jacobians_;
+    }
+
+    Integer num_factorizations() const
+    {
+        return num_factorizations_;
+    }
+
+protected:
+
+    bool is_continuous(const state_type& x, const Real t) const;
+    void reset(const function_type& f, const jacobian_type& jacobian, const state_type& x, const Real t,
+        const Real tend, const Real max_step);
+    void step(const function_type& f, const jacobian_type& jacobian, const Real tend, const Real max_step);
+
+    bool solve_bdf_system(
+        const function_type& f, const Real tnew, const state_type& ypredict, const Real c,
+        const state_type& psi, const state_type& scale, const Real tol,
+        state_type& y, state_type& d, std::size_t& num_iterations);
+
+    void change_differences(const Real factor);
+    bool factorize(const Real c);
+    void evaluate_jacobian(const jacobian_type& jacobian, const state_type& y, const Real t);
+
+    Real norm(const state_type& v, const state_type& scale) const;
+
+protected:
+
+    SparseLU lu_;
+    matrix_type jacobi_;
+
+    bool initialized_;
+    Real t_, h_abs_, abs_tol_, rel_tol_;
+    std::size_t order_, num_equal_steps_;
+    bool lu_available_;
+    Integer num_jacobians_, num_factorizations_;
+
+    // the backward differences of the solution. D_[0] is the current state.
+    std::vector<state_type> D_;
+    state_type dfdt_, fx_;
+
+    // the state last interpolated by integrate_dense()
+    bool interpolated_;
+    Real t_out_;
+    state_type x_out_;
+};
+
+} // ode
+
+} // ecell4
+
+#endif /* ECELL4_ODE_BDF_INTEGRATOR_HPP */
@@ -1,7 +1,10 @@
 #include "ODESimulator.hpp"
+#include "BDFIntegrator.hpp"
 
 #include <boost/numeric/odeint.hpp>
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 namespace odeint = boost::numeric::odeint;
 
@@ -11,6 +14,259 @@ namespace ecell4
 namespace ode
 {
 
+/**
+ * SparseRosenbrock4 is odeint's rosenbrock4 with the sparse Jacobian of
+ * jacobi_func, so that a step costs the sparse LU factorization of
+ * I - gamma dt J instead of the dense one. The linear systems of
+ * rosenbrock4, (I / (gamma dt) - J) g = b, are solved as
+ * (I - gamma dt J) g = gamma dt b. It has the interface required by
+ * odeint's rosenbrock4_controller and rosenbrock4_dense_output.
+ */
+class SparseRosenbrock4
+{
+public:
+
+    typedef ODESimulator::state_type state_type;
+    typedef ODESimulator::sparse_matrix_type sparse_matrix_type;
+    typedef state_type::value_type value_type;
+    typedef state_type deriv_type;
+    typedef value_type time_type;
+    typedef odeint::initially_resizer resizer_type;
+    typedef odeint::stepper_tag stepper_category;
+    typedef unsigned short order_type;
+    typedef odeint::state_wrapper<state_type> wrapped_state_type;
+    typedef odeint::state_wrapper<deriv_type> wrapped_deriv_type;
+    typedef odeint::default_rosenbrock_coefficients<value_type> rosenbrock_coefficients;
+
+    static const order_type stepper_order = rosenbrock_coefficients::stepper_order;
+    static const order_type error_order = rosenbrock_coefficients::error_order;
+
+public:
+
+    SparseRosenbrock4()
+        : lu_(), coef_()
+    {
+        ;
+    }
+
+    order_type order() const
+    {
+        return stepper_order;
+    }
+
+    template <typename System>
+    void do_step(
+        System system, const state_type& x, const time_type t, state_type& xout,
+        const time_type dt, state_type& xerr)
+    {
+        typedef typename odeint::unwrap_reference<System>::type system_type;
+        system_type& sys = system;
+        const std::size_t n(x.size());
+        adjust_size(x);
+
+        if (!lu_ || jacobi_.size != n)
+        {
+            jacobi_ = sys.second.pattern().matrix();
+            lu_.reset(new SparseLU(jacobi_));
+        }
+
+        sys.first(x, dxdt_, t);
+        sys.second(x, jacobi_, t, dfdt_);
+
+        const Real c(coef_.gamma * dt);
+        if (!lu_->factorize(jacobi_, c))
+        {
+            // reject the step and let the controller shrink it
+            std::fill(xerr.begin(), xerr.end(), std::numeric_limits<Real>::infinity());
+            return;
+        }
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            g1_[i] = c * (dxdt_[i] + dt * coef_.d1 * dfdt_[i]);
+        }
+        lu_->solve(g1_);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xtmp_[i] = x[i] + coef_.a21 * g1_[i];
+        }
+        sys.first(xtmp_, dxdtnew_, t + coef_.c2 * dt);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            g2_[i] = c * (dxdtnew_[i] + dt * coef_.d2 * dfdt_[i] + coef_.c21 * g1_[i] / dt);
+        }
+        lu_->solve(g2_);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xtmp_[i] = x[i] + coef_.a31 * g1_[i] + coef_.a32 * g2_[i];
+        }
+        sys.first(xtmp_, dxdtnew_, t + coef_.c3 * dt);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            g3_[i] = c * (dxdtnew_[i] + dt * coef_.d3 * dfdt_[i]
+                          + (coef_.c31 * g1_[i] + coef_.c32 * g2_[i]) / dt);
+        }
+        lu_->solve(g3_);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xtmp_[i] = x[i] + coef_.a41 * g1_[i] + coef_.a42 * g2_[i] + coef_.a43 * g3_[i];
+        }
+        sys.first(xtmp_, dxdtnew_, t + coef_.c4 * dt);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            g4_[i] = c * (dxdtnew_[i] + dt * coef_.d4 * dfdt_[i]
+                          + (coef_.c41 * g1_[i] + coef_.c42 * g2_[i] + coef_.c43 * g3_[i]) / dt);
+        }
+        lu_->solve(g4_);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xtmp_[i] = x[i] + coef_.a51 * g1_[i] + coef_.a52 * g2_[i]
+                + coef_.a53 * g3_[i] + coef_.a54 * g4_[i];
+        }
+        sys.first(xtmp_, dxdtnew_, t + dt);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            g5_[i] = c * (dxdtnew_[i] + (coef_.c51 * g1_[i] + coef_.c52 * g2_[i]
+                                         + coef_.c53 * g3_[i] + coef_.c54 * g4_[i]) / dt);
+        }
+        lu_->solve(g5_);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xtmp_[i] += g5_[i];
+        }
+        sys.first(xtmp_, dxdtnew_, t + dt);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xerr[i] = c * (dxdtnew_[i] + (coef_.c61 * g1_[i] + coef_.c62 * g2_[i] + coef_.c63 * g3_[i]
+                                          + coef_.c64 * g4_[i] + coef_.c65 * g5_[i]) / dt);
+        }
+        lu_->solve(xerr);
+
+        for (std::size_t i(0); i < n; ++i)
+        {
+            xout[i] = xtmp_[i] + xerr[i];
+        }
+    }
+
+    template <typename System>
+    void do_step(System system, state_type& x, const time_type t, const time_type dt, state_type& xerr)
+    {
+        do_step(system, x, t, x, dt, xerr);
+    }
+
+    void prepare_dense_output()
+    {
+        const std::size_t n(g1_.size());
+        for (std::size_t i(0); i < n; ++i)
+        {
+            cont3_[i] = coef_.d21 * g1_[i] + coef_.d22 * g2_[i] + coef_.d23 * g3_[i]
+                + coef_.d24 * g4_[i] + coef_.d25 * g5_[i];
+            cont4_[i] = coef_.d31 * g1_[i] + coef_.d32 * g2_[i] + coef_.d33 * g3_[i]
+                + coef_.d34 * g4_[i] + coef_.d35 * g5_[i];
+        }
+    }
+
+    void calc_state(
+        const time_type t, state_type& x,
+        const state_type& x_old, const time_type t_old,
+        const state_type& x_new, const time_type t_new)
+    {
+        const std::size_t n(g1_.size());
+        const time_type s((t - t_old) / (t_new - t_old));
+        const time_type s1(1.0 - s);
+        for (std::size_t i(0); i < n; ++i)
+        {
+            x[i] = x_old[i] * s1 + s * (x_new[i] + s1 * (cont3_[i] + s * cont4_[i]));
+        }
+    }
+
+    template <typename StateType>
+    void adjust_size(const StateType& x)
+    {
+        const std::size_t n(x.size());
+        if (g1_.size() == n)
+        {
+            return;
+        }
+
+        state_type* const buffers[] = {
+            &dxdt_, &dfdt_, &dxdtnew_, &xtmp_, &g1_, &g2_, &g3_, &g4_, &g5_, &cont3_, &cont4_};
+        for (std::size_t i(0); i < sizeof(buffers) / sizeof(buffers[0]); ++i)
+        {
+            buffers[i]->resize(n, false);
+        }
+    }
+
+protected:
+
+    std::shared_ptr<SparseLU> lu_;
+    sparse_matrix_type jacobi_;
+    state_type dxdt_, dfdt_, dxdtnew_, xtmp_;
+    state_type g1_, g2_, g3_, g4_, g5_, cont3_, cont4_;
+    const rosenbrock_coefficients coef_;
+};
+
+/**
+ * RosenbrockDenseOutput keeps the dense output stepper of
+ * SparseRosenbrock4 across calls of ODESimulator::step. The stepper is restarted
+ * unless the state and time given are those interpolated last.
+ */
+class RosenbrockDenseOutput
+{
+public:
+
+    typedef ODESimulator::state_type state_type;
+    typedef odeint::rosenbrock4_controller<SparseRosenbrock4> controlled_stepper_type;
+    typedef odeint::rosenbrock4_dense_output<controlled_stepper_type> dense_output_type;
+
+public:
+
+    RosenbrockDenseOutput(const Real abs_tol, const Real rel_tol, const Real max_dt)
+        : stepper_(controlled_stepper_type(abs_tol, rel_tol, max_dt)),
+        initialized_(false), t_out_(0.0)
+    {
+        ;
+    }
+
+    template <typename System, typename Observer>
+    std::size_t integrate(
+        System system, state_type& x, const Real t, const Real tend, const Real dt,
+        Observer observer)
+    {
+        if (!(initialized_ && t == t_out_ && x.size() == x_out_.size()
+              && std::equal(x.begin(), x.end(), x_out_.begin())))
+        {
+            stepper_.initialize(x, t, dt);
+            initialized_ = true;
+        }
+
+        std::size_t steps(0);
+        while (stepper_.current_time() < tend)
+        {
+            stepper_.do_step(system);
+            ++steps;
+            observer(stepper_.current_state(), stepper_.current_time());
+        }
+
+        stepper_.calc_state(tend, x);
+        t_out_ = tend;
+        x_out_ = x;
+        return steps;
+    }
+
+protected:
+
+    dense_output_type stepper_;
+    bool initialized_;
+    Real t_out_;
+    state_type x_out_;
+};
+
 ODESimulator::reaction_container_type ODESimulator::convert_reactions() const
 {
     const std::vector<Species> species(world_->list_species());
@@ -78,89 +334,672 @@ ODESimulator::reaction_container_type ODESimulator::convert_reactions() const
     return reactions;
 }
 
-std::pair<ODESimulator::deriv_func, ODESimulator::jacobi_func>
-ODESimulator::generate_system() const
+void ODESimulator::mass_action_kernel::stoichiometry_type::push_back(
+    const reaction_type& r)
 {
-    const reaction_container_type reactions(convert_reactions());
-    return std::make_pair(
-            deriv_func(reactions, world_->volume()),
-            jacobi_func(reactions, world_->volume(), abs_tol_, rel_tol_));
+    for (std::size_t j(0); j < r.reactants.size(); ++j)
+    {
+        indices.push_back(r.reactants[j]);
+        coefficients.push_back(-r.reactant_coefficients[j]);
+    }
+    for (std::size_t j(0); j < r.products.size(); ++j)
+    {
+        indices.push_back(r.products[j]);
+        coefficients.push_back(r.product_coefficients[j]);
+    }
+    offsets.push_back(indices.size());
 }
 
-bool ODESimulator::step(const Real &upto)
+ODESimulator::mass_action_kernel::mass_action_kernel(
+    const reaction_container_type& reactions)
 {
-    if (upto <= t())
+    for (std::size_t i(0); i < reactions.size(); ++i)
+    {
+        const reaction_type& r(reactions[i]);
+        if (!r.ratelaw.expired())
+        {
+            const std::shared_ptr<ReactionRuleDescriptor> ratelaw(r.ratelaw.lock());
+            const ReactionRuleDescriptorBatched* batched(
+                dynamic_cast<const ReactionRuleDescriptorBatched*>(ratelaw.get()));
+            if (batched == NULL || !batched->is_available()
+                || r.reactants.size() != batched->batch()->num_reactants()
+                || r.products.size() != batched->batch()->num_products())
+            {
+                generic_.push_back(i);
+                continue;
+            }
+
+            std::vector<batch_type>::iterator j(batches_.begin());
+            for (; j != batches_.end(); ++j)
+            {
+                if ((*j).batch == batched->batch())
+                {
+                    break;
+                }
+            }
+            if (j == batches_.end())
+            {
+                batch_type batch;
+                batch.batch = batched->batch();
+                j = batches_.insert(batches_.end(), batch);
+            }
+            (*j).reactions.push_back(i);
+            continue;
+        }
+
+        const bool is_elementary(
+            std::find_if(r.reactant_coefficients.begin(), r.reactant_coefficients.end(),
+                [](const Real coef) { return coef != 1.0; })
+            == r.reactant_coefficients.end());
+
+        if (r.reactants.size() == 0)
+        {
+            k0_.push_back(r.k);
+            stoichiometry0_.push_back(r);
+        }
+        else if (is_elementary && r.reactants.size() == 1)
+        {
+            k1_.push_back(r.k);
+            reactants1_.push_back(r.reactants[0]);
+            stoichiometry1_.push_back(r);
+        }
+        else if (is_elementary && r.reactants.size() == 2)
+        {
+            k2_.push_back(r.k);
+            reactants2_.push_back(r.reactants[0]);
+            reactants2_.push_back(r.reactants[1]);
+            stoichiometry2_.push_back(r);
+        }
+        else
+        {
+            kn_.push_back(r.k);
+            reactantsn_.indices.insert(
+                reactantsn_.indices.end(), r.reactants.begin(), r.reactants.end());
+            reactantsn_.coefficients.insert(
+                reactantsn_.coefficients.end(),
+                r.reactant_coefficients.begin(), r.reactant_coefficients.end());
+            reactantsn_.offsets.push_back(reactantsn_.indices.size());
+            stoichiometryn_.push_back(r);
+        }
+    }
+}
+
+void ODESimulator::mass_action_kernel::operator()(
+    const state_type& x, state_type& dxdt, const Real volume) const
+{
+    const Real vinv(1.0 / volume);
+
+    for (std::size_t r(0); r < k0_.size(); ++r)
+    {
+        stoichiometry0_.apply(r, k0_[r] * volume, dxdt);
+    }
+
+    for (std::size_t r(0); r < k1_.size(); ++r)
+    {
+        stoichiometry1_.apply(r, k1_[r] * x[reactants1_[r]], dxdt);
+    }
+
+    for (std::size_t r(0); r < k2_.size(); ++r)
+    {
+        stoichiometry2_.apply(
+            r, k2_[r] * x[reactants2_[2 * r]] * x[reactants2_[2 * r + 1]] * vinv, dxdt);
+    }
+
+    for (std::size_t r(0); r < kn_.size(); ++r)
+    {
+        Real flux(kn_[r] * volume);
+        for (std::size_t j(reactantsn_.offsets[r]); j < reactantsn_.offsets[r + 1]; ++j)
+        {
+            flux *= std::pow(x[reactantsn_.indices[j]] * vinv, reactantsn_.coefficients[j]);
+        }
+        stoichiometryn_.apply(r, flux, dxdt);
+    }
+}
+
+ODESimulator::jacobian_pattern::jacobian_pattern(
+    const reaction_container_type& reactions, const std::size_t size)
+{
+    typedef std::pair<std::size_t, std::size_t> element_type;
+
+    std::vector<element_type> elements;
+    num_participants_.reserve(reactions.size());
+    for (reaction_container_type::const_iterator i(reactions.begin());
+        i != reactions.end(); ++i)
+    {
+        index_container_type participants((*i).reactants);
+        participants.insert(participants.end(), (*i).products.begin(), (*i).products.end());
+        const std::size_t num_columns(
+            (*i).ratelaw.expired() ? (*i).reactants.size() : participants.size());
+
+        for (std::size_t j(0); j < num_columns; ++j)
+        {
+            for (std::size_t k(0); k < participants.size(); ++k)
+            {
+                elements.push_back(std::make_pair(participants[k], participants[j]));
+            }
+        }
+        num_participants_.push_back(participants.size());
+    }
+
+    std::vector<element_type> unique_elements(elements);
+    std::sort(unique_elements.begin(), unique_elements.end());
+    unique_elements.erase(
+        std::unique(unique_elements.begin(), unique_elements.end()), unique_elements.end());
+
+    matrix_.size = size;
+    matrix_.offsets.assign(size + 1, 0);
+    matrix_.indices.reserve(unique_elements.size());
+    for (std::vector<element_type>::const_iterator i(unique_elements.begin());
+        i != unique_elements.end(); ++i)
+    {
+        ++matrix_.offsets[(*i).first + 1];
+        matrix_.indices.push_back((*i).second);
+    }
+    for (std::size_t i(0); i < size; ++i)
+    {
+        matrix_.offsets[i + 1] += matrix_.offsets[i];
+    }
+    matrix_.values.assign(unique_elements.size(), 0.0);
+
+    // elements are listed in the order of slot(r, j, i).
+    slot_offsets_.reserve(reactions.size());
+    slots_.reserve(elements.size());
+    std::size_t pos(0);
+    for (std::size_t r(0); r < reactions.size(); ++r)
+    {
+        slot_offsets_.push_back(slots_.size());
+        const std::size_t num_columns(
+            reactions[r].ratelaw.expired() ? reactions[r].reactants.size() : num_participants_[r]);
+        for (std::size_t k(0); k < num_columns * num_participants_[r]; ++k, ++pos)
+        {
+            const element_type& elem(elements[pos]);
+            const index_container_type::const_iterator
+                first(matrix_.indices.begin() + matrix_.offsets[elem.first]),
+                last(matrix_.indices.begin() + matrix_.offsets[elem.first + 1]);
+            slots_.push_back(std::lower_bound(first, last, elem.second) - matrix_.indices.begin());
+        }
+    }
+}
+
+std::size_t ODESimulator::jacobi_func::num_species(const reaction_container_type& reactions)
+{
+    std::size_t size(0);
+    for (reaction_container_type::const_iterator i(reactions.begin());
+        i != reactions.end(); ++i)
+    {
+        for (index_container_type::const_iterator j((*i).reactants.begin());
+            j != (*i).reactants.end(); ++j)
+        {
+            size = std::max(size, *j + 1);
+        }
+        for (index_container_type::const_iterator j((*i).products.begin());
+            j != (*i).products.end(); ++j)
+        {
+            size = std::max(size, *j + 1);
+        }
+    }
+    return size;
+}
+
+void ODESimulator::jacobi_func::operator()(
+    const state_type& x, sparse_matrix_type& jacobi, const double &t, state_type &dfdt) const
+{
+    std::fill(dfdt.begin(), dfdt.end(), 0.0);
+    std::fill(jacobi.values.begin(), jacobi.values.end(), 0.0);
+
+    const Real SQRTETA(1.4901161193847656e-08);
+    const Real r0(1.0);
+    const Real ht(1.0e-10);
+
+    for (std::size_t r(0); r < reactions_.size(); ++r)
+    {
+        const reaction_type& reaction(reactions_[r]);
+        const std::size_t num_reactants(reaction.reactants.size());
+
+        if (reaction.ratelaw.expired())
+        {
+            // d/dx_j k V prod_i (x_i / V) ^ c_i
+            for (std::size_t j(0); j < num_reactants; ++j)
+            {
+                Real d(reaction.k);
+                for (std::size_t i(0); i < num_reactants; ++i)
+                {
+                    const Real coef(reaction.reactant_coefficients[i]);
+                    const Real xi(x[reaction.reactants[i]] * vinv_);
+                    d *= (i == j ? ReactionRuleDescriptorMassAction::power_derivative(xi, coef)
+                                 : std::pow(xi, coef));
+                }
+                accumulate(r, j, d, jacobi);
+            }
+            continue;
+        }
+
+        ReactionRuleDescriptor::state_container_type reactants_states(num_reactants);
+        ReactionRuleDescriptor::state_container_type products_states(reaction.products.size());
+        for (std::size_t j(0); j < num_reactants; ++j)
+        {
+            reactants_states[j] = x[reaction.reactants[j]];
+        }
+        for (std::size_t j(0); j < reaction.products.size(); ++j)
+        {
+            products_states[j] = x[reaction.products[j]];
+        }
+
+        std::shared_ptr<ReactionRuleDescriptor> ratelaw = reaction.ratelaw.lock();
+        assert(ratelaw->is_available());
+        const Real flux_0 = ratelaw->propensity(reactants_states, products_states, volume_, t);
+
+        // Differentiate by time
+        {
+            const Real flux = ratelaw->propensity(reactants_states, products_states, volume_, t + ht);
+            const Real flux_deriv = (flux - flux_0) / ht;
+            if (flux_deriv != 0.0)
+            {
+                for (std::size_t k(0); k < num_reactants; ++k)
+                {
+                    dfdt[reaction.reactants[k]] -= reaction.reactant_coefficients[k] * flux_deriv;
+                }
+                for (std::size_t k(0); k < reaction.products.size(); ++k)
+                {
+                    dfdt[reaction.products[k]] += reaction.product_coefficients[k] * flux_deriv;
+                }
+            }
+        }
+
+        if (ratelaw->has_derivatives())
+        {
+            const std::pair<ReactionRuleDescriptor::state_container_type,
+                ReactionRuleDescriptor::state_container_type>
+                    derivs(ratelaw->derivatives(reactants_states, products_states, volume_, t));
+            for (std::size_t j(0); j < num_reactants; ++j)
+            {
+                accumulate(r, j, derivs.first[j], jacobi);
+            }
+            for (std::size_t j(0); j < reaction.products.size(); ++j)
+            {
+                accumulate(r, num_reactants + j, derivs.second[j], jacobi);
+            }
+            continue;
+        }
+
+        // Differentiate by each Reactants
+        for (std::size_t j(0); j < num_reactants; ++j)
+        {
+            const Real ewt = abs_tol_ + rel_tol_ * std::abs(reactants_states[j]);
+            const Real h = std::max(SQRTETA * std::abs(reactants_states[j]), r0 * ewt);
+            ReactionRuleDescriptor::state_container_type h_shift(reactants_states);
+            h_shift[j] += h;
+            const Real flux = ratelaw->propensity(h_shift, products_states, volume_, t);
+            accumulate(r, j, (flux - flux_0) / h, jacobi);
+        }
+        // Differentiate by Products
+        for (std::size_t j(0); j < reaction.products.size(); ++j)
+        {
+            const Real ewt = abs_tol_ + rel_tol_ * std::abs(products_states[j]);
+            const Real h = std::max(SQRTETA * std::abs(products_states[j]), r0 * ewt);
+            ReactionRuleDescriptor::state_container_type h_shift(products_states);
+            h_shift[j] += h;
+            const Real flux = ratelaw->propensity(reactants_states, h_shift, volume_, t);
+            accumulate(r, num_reactants + j, (flux - flux_0) / h, jacobi);
+        }
+    }
+}
+
+bool ODESimulator::is_compiled() const
+{
+    if (model_->revision() != model_revision_ || world_->revision() != world_revision_)
     {
         return false;
     }
-    const Real dt(std::min(dt_, upto - t()));
 
-    const Real ntime(std::min(upto, t() + dt_));
+    // The coefficients of a descriptor may be modified in place.
+    for (descriptor_revision_container_type::const_iterator i(descriptor_revisions_.begin());
+        i != descriptor_revisions_.end(); ++i)
+    {
+        if ((*i).first->revision() != (*i).second)
+        {
+            return false;
+        }
+    }
+    return true;
+}
 
-    //initialize();
-    const std::vector<Species> species(world_->list_species());
+void ODESimulator::compile()
+{
+    if (sensitivities_.size() > 0)
+    {
+        // The sensitivities follow the species to their new indices.
+        const std::vector<Species> species(world_->list_species());
+        const std::size_t num_parameters(sensitivity_parameters_.size());
+        state_type sensitivities(species.size() * num_parameters);
+        std::fill(sensitivities.begin(), sensitivities.end(), 0.0);
+        for (std::size_t i(0); i < species_.size(); ++i)
+        {
+            const std::vector<Species>::const_iterator it(
+                std::find(species.begin(), species.end(), species_[i]));
+            if (it == species.end())
+            {
+                continue;
+            }
+            const std::size_t j(it - species.begin());
+            for (std::size_t k(0); k < num_parameters; ++k)
+            {
+                sensitivities[k * species.size() + j] = sensitivities_[k * species_.size() + i];
+            }
+        }
+        sensitivities_.swap(sensitivities);
+    }
 
-    state_type x(species.size());
-    state_type::size_type i(0);
-    for(Model::species_container_type::const_iterator it(species.begin());
-        it != species.end(); it++)
+    species_ = world_->list_species();
+    model_revision_ = model_->revision();
+    world_revision_ = world_->revision();
+    descriptor_revisions_.clear();
+    const Model::reaction_rule_container_type& reaction_rules(model_->reaction_rules());
+    for (Model::reaction_rule_container_type::const_iterator i(reaction_rules.begin());
+        i != reaction_rules.end(); ++i)
     {
-        x[i] = static_cast<double>(world_->get_value_exact(*it));
-        i++;
+        if ((*i).has_descriptor())
+        {
+            descriptor_revisions_.push_back(
+                std::make_pair((*i).get_descriptor(), (*i).get_descriptor()->revision()));
+        }
     }
-    std::pair<deriv_func, jacobi_func> system(generate_system());
-    StateAndTimeBackInserter::state_container_type x_vec;
-    StateAndTimeBackInserter::time_container_type times;
+    reactions_ = convert_reactions();
+    kernel_.reset(new mass_action_kernel(reactions_));
+    pattern_.reset(new jacobian_pattern(reactions_, species_.size()));
+    bdf_.reset();
+    rosenbrock_.reset();
+}
+
+std::pair<ODESimulator::deriv_func, ODESimulator::jacobi_func>
+ODESimulator::generate_system(const reaction_container_type& reactions) const
+{
+    return std::make_pair(
+            deriv_func(reactions, world_->volume()),
+            jacobi_func(reactions, world_->volume(), abs_tol_, rel_tol_));
+}
+
+void ODESimulator::set_step_observer(const std::shared_ptr<Observer>& observer)
+{
+    observer->initialize(world_, model_);
+    step_observer_ = [this, observer](const state_type& x, const Real t)
+        {
+            for (state_type::size_type i(0); i < x.size(); ++i)
+            {
+                world_->set_value_at(i, static_cast<Real>(x[i]));
+            }
+            world_->set_t(t);
+            within_step_observer_ = true;
+            observer->fire(this, world_);
+            within_step_observer_ = false;
+        };
+}
+
+void ODESimulator::integrate(
+    std::pair<deriv_func, jacobi_func>& system, state_type& x, const Real ntime, const Real dt)
+{
+    const step_observer_adapter observer(step_observer_, t());
 
-    size_t steps;
     switch (this->solver_type_) {
         case ecell4::ode::RUNGE_KUTTA_CASH_KARP54:
             {
                 /* This solver doesn't need the jacobian */
                 typedef odeint::runge_kutta_cash_karp54<state_type> error_stepper_type;
-                steps = (
-                    odeint::integrate_adaptive(
-                        odeint::make_controlled<error_stepper_type>(abs_tol_, rel_tol_, max_dt_),
-                        system.first, x, t(), ntime, dt,
-                        StateAndTimeBackInserter(x_vec, times)));
+                odeint::integrate_adaptive(
+                    odeint::make_controlled<error_stepper_type>(abs_tol_, rel_tol_, max_dt_),
+                    system.first, x, t(), ntime, dt, observer);
             }
             break;
         case ecell4::ode::ROSENBROCK4_CONTROLLER:
+            if (dense_output_)
+            {
+                if (!rosenbrock_)
+                {
+                    rosenbrock_.reset(new RosenbrockDenseOutput(abs_tol_, rel_tol_, max_dt_));
+                }
+                rosenbrock_->integrate(system, x, t(), ntime, dt, observer);
+            }
+            else
             {
-                typedef odeint::rosenbrock4<state_type::value_type> error_stepper_type;
-                steps = (
-                    odeint::integrate_adaptive(
-                        odeint::make_controlled<error_stepper_type>(abs_tol_, rel_tol_, max_dt_),
-                        system, x, t(), ntime, dt,
-                        StateAndTimeBackInserter(x_vec, times)));
+                odeint::integrate_adaptive(
+                    odeint::rosenbrock4_controller<SparseRosenbrock4>(abs_tol_, rel_tol_, max_dt_),
+                    system, x, t(), ntime, dt, observer);
             }
             break;
         case ecell4::ode::EULER:
             {
                 typedef odeint::euler<state_type> stepper_type;
-                steps = (
-                    odeint::integrate_const(
-                        stepper_type(), system.first, x, t(), ntime, dt,
-                        StateAndTimeBackInserter(x_vec, times)));
+                odeint::integrate_const(
+                    stepper_type(), system.first, x, t(), ntime, dt, observer);
+            }
+            break;
+        case ecell4::ode::BDF:
+            {
+                if (!bdf_)
+                {
+                    bdf_.reset(new BDFIntegrator(pattern_->matrix()));
+                }
+                if (dense_output_)
+                {
+                    bdf_->integrate_dense(
+                        system.first, system.second, x, t(), ntime, abs_tol_, rel_tol_, max_dt_,
+                        step_observer_);
+                }
+                else
+                {
+                    bdf_->integrate(
+                        system.first, system.second, x, t(), ntime, abs_tol_, rel_tol_, max_dt_,
+                        step_observer_);
+                }
             }
             break;
         default:
             throw IllegalState("Solver is not specified\n");
     };
+}
 
-    // const double a_x(1.0), a_dxdt(1.0);
-    // const size_t steps(
-    //     odeint::integrate_adaptive(
-    //         controlled_stepper, system, x, t(), upto, dt_,
-    //         StateAndTimeBackInserter(x_vec, times)));
+void ODESimulator::integrate_sensitivities(
+    std::pair<deriv_func, jacobi_func>& system, state_type& x, const Real ntime, const Real dt)
+{
+    const std::size_t n(x.size());
+    const std::size_t num_parameters(sensitivity_parameters_.size());
+    for (std::vector<std::size_t>::const_iterator i(sensitivity_parameters_.begin());
+        i != sensitivity_parameters_.end(); ++i)
+    {
+        if (*i >= reactions_.size())
+        {
+            throw NotFound("No such reaction rule for the sensitivity analysis.");
+        }
+        else if (!reactions_[*i].ratelaw.expired())
+        {
+            throw NotSupported(
+                "The sensitivity analysis only supports the rate constant of a mass action.");
+        }
+    }
+
+    if (sensitivities_.size() != n * num_parameters)
+    {
+        sensitivities_.resize(n * num_parameters, false);
+        std::fill(sensitivities_.begin(), sensitivities_.end(), 0.0);
+    }
+
+    state_type y(n * (num_parameters + 1));
+    std::copy(x.begin(), x.end(), y.begin());
+    std::copy(sensitivities_.begin(), sensitivities_.end(), y.begin() + n);
+
+    sensitivity_func f(
+        reactions_, sensitivity_parameters_, system.first, system.second, world_->volume());
+
+    // only the state is given to the step observer
+    const Real t0(t());
+    state_type xi;
+    const std::function<void (const state_type&, const Real)> observer(
+        [this, t0, n, &xi](const state_type& yi, const Real ti)
+        {
+            if (step_observer_ && ti > t0)
+            {
+                xi.resize(n, false);
+                std::copy(yi.begin(), yi.begin() + n, xi.begin());
+                step_observer_(xi, ti);
+            }
+        });
+
+    switch (this->solver_type_) {
+        case ecell4::ode::RUNGE_KUTTA_CASH_KARP54:
+            {
+                typedef odeint::runge_kutta_cash_karp54<state_type> error_stepper_type;
+                odeint::integrate_adaptive(
+                    odeint::make_controlled<error_stepper_type>(abs_tol_, rel_tol_, max_dt_),
+                    f, y, t(), ntime, dt, observer);
+            }
+            break;
+        case ecell4::ode::EULER:
+            {
+                typedef odeint::euler<state_type> stepper_type;
+                odeint::integrate_const(
+                    stepper_type(), f, y, t(), ntime, dt, observer);
+            }
+            break;
+        case ecell4::ode::BDF:
+            {
+                if (!bdf_)
+                {
+                    bdf_.reset(new BDFIntegrator(pattern_->matrix()));
+                }
+                const BDFIntegrator::function_type g(f);
+                const BDFIntegrator::jacobian_type jacobian(
+                    [&f](const state_type& yi, sparse_matrix_type& jacobi, const double& ti, state_type& dfdt)
+                    {
+                        f.jacobian(yi, jacobi, ti, dfdt);
+                    });
+                if (dense_output_)
+                {
+                    bdf_->integrate_dense(
+                        g, jacobian, y, t(), ntime, abs_tol_, rel_tol_, max_dt_, observer);
+                }
+                else
+                {
+                    bdf_->integrate(
+                        g, jacobian, y, t(), ntime, abs_tol_, rel_tol_, max_dt_, observer);
+                }
+            }
+            break;
+        default:
+            throw NotSupported("The solver does not support the sensitivity analysis.");
+    };
+
+    std::copy(y.begin(), y.begin() + n, x.begin());
+    std::copy(y.begin() + n, y.end(), sensitivities_.begin());
+}
+
+std::vector<std::vector<Real> > ODESimulator::sensitivities() const
+{
+    const std::size_t n(world_->num_species());
+    const std::size_t num_parameters(sensitivity_parameters_.size());
+    std::vector<std::vector<Real> > ret(n, std::vector<Real>(num_parameters, 0.0));
+    if (sensitivities_.size() != species_.size() * num_parameters)
+    {
+        return ret;
+    }
+
+    for (std::size_t i(0); i < std::min(n, species_.size()); ++i)
+    {
+        for (std::size_t k(0); k < num_parameters; ++k)
+        {
+            ret[i][k] = sensitivities_[k * species_.size() + i];
+        }
+    }
+    return ret;
+}
+
+void ODESimulator::sensitivity_func::operator()(
+    const state_type& y, state_type& dydt, const double& t)
+{
+    const std::size_t n(x_.size());
+    std::copy(y.begin(), y.begin() + n, x_.begin());
+    f_(x_, fx_, t);
+    std::copy(fx_.begin(), fx_.end(), dydt.begin());
+    if (!has_jacobi_ || t != t_jacobi_
+        || !std::equal(x_.begin(), x_.end(), x_jacobi_.begin()))
     {
-        state_type::size_type i(0);
-        for(Model::species_container_type::const_iterator
-            it(species.begin()); it != species.end(); it++)
+        jacobian_(x_, jacobi_, t, dfdt_);
+        x_jacobi_ = x_;
+        has_jacobi_ = true;
+        t_jacobi_ = t;
+    }
+
+    const Real vinv(1.0 / volume_);
+    for (std::size_t k(0); k < parameters_.size(); ++k)
+    {
+        const std::size_t offset((k + 1) * n);
+
+        // J S_k
+        for (std::size_t i(0); i < n; ++i)
         {
-            world_->set_value(*it, static_cast<Real>(x_vec[steps](i)));
-            i++;
+            Real v(0.0);
+            for (std::size_t p(jacobi_.offsets[i]); p < jacobi_.offsets[i + 1]; ++p)
+            {
+                v += jacobi_.values[p] * y[offset + jacobi_.indices[p]];
+            }
+            dydt[offset + i] = v;
         }
+
+        // df/dk = V prod_i (x_i / V) ^ c_i for the stoichiometry
+        const reaction_type& r(reactions_[parameters_[k]]);
+        Real dflux(volume_);
+        for (std::size_t j(0); j < r.reactants.size(); ++j)
+        {
+            dflux *= std::pow(x_[r.reactants[j]] * vinv, r.reactant_coefficients[j]);
+        }
+        for (std::size_t j(0); j < r.reactants.size(); ++j)
+        {
+            dydt[offset + r.reactants[j]] -= r.reactant_coefficients[j] * dflux;
+        }
+        for (std::size_t j(0); j < r.products.size(); ++j)
+        {
+            dydt[offset + r.products[j]] += r.product_coefficients[j] * dflux;
+        }
+    }
+}
+
+bool ODESimulator::step(const Real &upto)
+{
+    if (upto <= t())
+    {
+        return false;
+    }
+    const Real dt(std::min(dt_, upto - t()));
+
+    const Real ntime(std::min(upto, t() + dt_));
+
+    if (!is_compiled())
+    {
+        compile();
+    }
+
+    // The indices of species_ are those of the world after compile().
+    state_type& x(x_);
+    x.resize(species_.size(), false);
+    for (state_type::size_type i(0); i < x.size(); ++i)
+    {
+        x[i] = static_cast<double>(world_->get_value_at(i));
+    }
+    std::pair<deriv_func, jacobi_func> system(
+        deriv_func(reactions_, kernel_, world_->volume()),
+        jacobi_func(reactions_, pattern_, world_->volume(), abs_tol_, rel_tol_));
+    if (sensitivity_parameters_.empty())
+    {
+        integrate(system, x, ntime, dt);
+    }
+    else
+    {
+        integrate_sensitivities(system, x, ntime, dt);
+    }
+
+    // x is updated in place, and only the final state is kept.
+    for (state_type::size_type i(0); i < x.size(); ++i)
+    {
+        world_->set_value_at(i, static_cast<Real>(x[i]));
     }
     set_t(ntime);
     num_steps_++;
@@ -2,10 +2,12 @@
 #define ECELL4_ODE_ODE_SIMULATOR_NEW_HPP
 
 #include <cstring>
+#include <iostream>
 #include <vector>
 #include <numeric>
 #include <map>
 #include <memory>
+#include <functional>
 
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/matrix.hpp>
@@ -27,8 +29,12 @@ enum ODESolverType {
     RUNGE_KUTTA_CASH_KARP54 = 0,
     ROSENBROCK4_CONTROLLER = 1,
     EULER = 2,
+    BDF = 3,
 };
 
+class BDFIntegrator;
+class RosenbrockDenseOutput;
+
 class ODESimulator
     : public SimulatorBase<ODEWorld>
 {
@@ -56,11 +62,108 @@ public:
     };
     typedef std::vector<reaction_type> reaction_container_type;
 
+    /**
+     * mass_action_kernel flattens the reactions without a rate law
+     * descriptor into contiguous arrays grouped by the reaction order, and
+     * adds their fluxes into dxdt without any allocation. The other
+     * reactions are listed in generic_reactions(), or grouped by their
+     * batch in batched_reactions(), and left to the caller.
+     */
+    class mass_action_kernel
+    {
+    public:
+
+        struct batch_type
+        {
+            std::shared_ptr<const ReactionRuleDescriptorBatch> batch;
+            std::vector<std::size_t> reactions;
+        };
+
+    public:
+
+        mass_action_kernel(const reaction_container_type& reactions);
+
+        void operator()(const state_type& x, state_type& dxdt, const Real volume) const;
+
+        const std::vector<std::size_t>& generic_reactions() const
+        {
+            return generic_;
+        }
+
+        const std::vector<batch_type>& batched_reactions() const
+        {
+            return batches_;
+        }
+
+    protected:
+
+        /**
+         * the changes of species given by each reaction in the compressed
+         * row format, i.e. reaction r changes indices[j] by coefficients[j]
+         * for offsets[r] <= j < offsets[r + 1].
+         */
+        struct stoichiometry_type
+        {
+            std::vector<std::size_t> offsets;
+            index_container_type indices;
+            coefficient_container_type coefficients;
+
+            stoichiometry_type()
+                : offsets(1, 0)
+            {
+                ;
+            }
+
+            void push_back(const reaction_type& r);
+
+            inline void apply(const std::size_t r, const Real flux, state_type& dxdt) const
+            {
+                for (std::size_t j(offsets[r]); j < offsets[r + 1]; ++j)
+                {
+                    dxdt[indices[j]] += coefficients[j] * flux;
+                }
+            }
+        };
+
+    protected:
+
+        // k * V
+        coefficient_container_type k0_;
+        stoichiometry_type stoichiometry0_;
+
+        // k * x0
+        coefficient_container_type k1_;
+        index_container_type reactants1_;
+        stoichiometry_type stoichiometry1_;
+
+        // k * x0 * x1 / V
+        coefficient_container_type k2_;
+        index_container_type reactants2_;
+        stoichiometry_type stoichiometry2_;
+
+        // k * V * prod_i (x_i / V) ^ c_i
+        coefficient_container_type kn_;
+        stoichiometry_type reactantsn_;
+        stoichiometry_type stoichiometryn_;
+
+        std::vector<std::size_t> generic_;
+        std::vector<batch_type> batches_;
+    };
+
     class deriv_func
     {
     public:
         deriv_func(const reaction_container_type &reactions, const Real &volume)
-            : reactions_(reactions), volume_(volume), vinv_(1.0 / volume)
+            : reactions_(reactions), kernel_(new mass_action_kernel(reactions)),
+            volume_(volume), vinv_(1.0 / volume)
+        {
+            ;
+        }
+
+        deriv_func(
+            const reaction_container_type &reactions,
+            const std::shared_ptr<const mass_action_kernel>& kernel, const Real &volume)
+            : reactions_(reactions), kernel_(kernel), volume_(volume), vinv_(1.0 / volume)
         {
             ;
         }
@@ -68,9 +171,13 @@ public:
         void operator()(const state_type &x, state_type &dxdt, const double &t)
         {
             std::fill(dxdt.begin(), dxdt.end(), 0.0);
-            for(reaction_container_type::const_iterator i(reactions_.begin());
-                i != reactions_.end(); i++)
+            (*kernel_)(x, dxdt, volume_);
+
+            const std::vector<std::size_t>& generic(kernel_->generic_reactions());
+            for (std::vector<std::size_t>::const_iterator k(generic.begin());
+                k != generic.end(); ++k)
             {
+                const reaction_container_type::const_iterator i(reactions_.begin() + *k);
                 ReactionRuleDescriptor::state_container_type reactants_states(i->reactants.size());
                 ReactionRuleDescriptor::state_container_type products_states(i->products.size());
                 ReactionRuleDescriptor::state_container_type::size_type cnt(0);
@@ -86,255 +193,256 @@ public:
                 {
                     products_states[cnt] = x[*j];
                 }
-                double flux;
-                // Calculation! XXX
-                if (i->ratelaw.expired())
-                {
-                    std::unique_ptr<ReactionRuleDescriptor> temporary_ratelaw_obj(new ReactionRuleDescriptorMassAction(i->k, i->reactant_coefficients, i->product_coefficients));
-                    flux = temporary_ratelaw_obj->propensity(reactants_states, products_states, volume_, t);
-                }
-                else
-                {
-                    std::shared_ptr<ReactionRuleDescriptor> ratelaw = i->ratelaw.lock();
-                    assert(ratelaw->is_available());
-                    flux = ratelaw->propensity(reactants_states, products_states, volume_, t);
-                }
-                // Merge each reaction's flux into whole dxdt
-                std::size_t nth = 0;
-                for(index_container_type::const_iterator j(i->reactants.begin());
-                    j != i->reactants.end(); j++)
+                std::shared_ptr<ReactionRuleDescriptor> ratelaw = i->ratelaw.lock();
+                assert(ratelaw->is_available());
+                const double flux = ratelaw->propensity(reactants_states, products_states, volume_, t);
+                merge(*i, flux, dxdt);
+            }
+
+            const std::vector<mass_action_kernel::batch_type>& batches(kernel_->batched_reactions());
+            for (std::vector<mass_action_kernel::batch_type>::const_iterator k(batches.begin());
+                k != batches.end(); ++k)
+            {
+                evaluate_batch(*k, x, dxdt, t);
+            }
+            return;
+        }
+
+    protected:
+
+        /**
+         * evaluate the fluxes of all the reactions in the batch at once.
+         * The states are gathered into row-major matrices.
+         */
+        void evaluate_batch(
+            const mass_action_kernel::batch_type& batch, const state_type& x, state_type& dxdt,
+            const double t) const
+        {
+            const std::size_t num_reactions(batch.reactions.size());
+            const std::size_t num_reactants(batch.batch->num_reactants());
+            const std::size_t num_products(batch.batch->num_products());
+
+            std::vector<Real> reactants(num_reactions * num_reactants);
+            std::vector<Real> products(num_reactions * num_products);
+            std::vector<Real> fluxes(num_reactions);
+            for (std::size_t k(0); k < num_reactions; ++k)
+            {
+                const reaction_type& r(reactions_[batch.reactions[k]]);
+                for (std::size_t j(0); j < num_reactants; ++j)
                 {
-                    dxdt[*j] -= (flux * (double)i->reactant_coefficients[nth]);
-                    nth++;
+                    reactants[k * num_reactants + j] = x[r.reactants[j]];
                 }
-                nth = 0;
-                for(index_container_type::const_iterator j(i->products.begin()); 
-                    j != i->products.end(); j++)
+                for (std::size_t j(0); j < num_products; ++j)
                 {
-                    dxdt[*j] += (flux * (double)i->product_coefficients[nth]);
-                    nth++;
+                    products[k * num_products + j] = x[r.products[j]];
                 }
             }
-            return;
+
+            batch.batch->propensities(
+                reactants.data(), products.data(), num_reactions, volume_, t, fluxes.data());
+
+            for (std::size_t k(0); k < num_reactions; ++k)
+            {
+                merge(reactions_[batch.reactions[k]], fluxes[k], dxdt);
+            }
+        }
+
+        // Merge each reaction's flux into whole dxdt
+        static inline void merge(const reaction_type& r, const Real flux, state_type& dxdt)
+        {
+            for (std::size_t j(0); j < r.reactants.size(); ++j)
+            {
+                dxdt[r.reactants[j]] -= flux * r.reactant_coefficients[j];
+            }
+            for (std::size_t j(0); j < r.products.size(); ++j)
+            {
+                dxdt[r.products[j]] += flux * r.product_coefficients[j];
+            }
         }
+
     protected:
-        const reaction_container_type reactions_;
+        const reaction_container_type& reactions_;
+        std::shared_ptr<const mass_action_kernel> kernel_;
         const Real volume_;
         const Real vinv_;
     };
 
+    /**
+     * sparse_matrix_type is a square matrix in the compressed sparse row
+     * format, i.e. the nonzero elements of the i-th row are values[p] at
+     * the column indices[p] for offsets[i] <= p < offsets[i + 1].
+     */
+    struct sparse_matrix_type
+    {
+        typedef std::vector<std::size_t> offset_container_type;
+        typedef std::vector<Real> value_container_type;
+
+        std::size_t size;
+        offset_container_type offsets;
+        index_container_type indices;
+        value_container_type values;
+    };
+
+    /**
+     * jacobian_pattern is the sparsity pattern of the Jacobian given by
+     * reactions. It maps the partial derivative of each reaction with
+     * respect to each participant onto an element of sparse_matrix_type.
+     * A mass action depends only on its reactants, and a rate law
+     * descriptor on both its reactants and products.
+     */
+    class jacobian_pattern
+    {
+    public:
+
+        jacobian_pattern(const reaction_container_type& reactions, const std::size_t size);
+
+        const sparse_matrix_type& matrix() const
+        {
+            return matrix_;
+        }
+
+        /**
+         * the position in values of the element at the row of the
+         * i-th participant and at the column of the j-th participant of
+         * the reaction r. participants are reactants followed by products.
+         */
+        inline std::size_t slot(const std::size_t r, const std::size_t j, const std::size_t i) const
+        {
+            return slots_[slot_offsets_[r] + j * num_participants_[r] + i];
+        }
+
+    protected:
+
+        sparse_matrix_type matrix_;
+        std::vector<std::size_t> num_participants_;
+        std::vector<std::size_t> slot_offsets_;
+        std::vector<std::size_t> slots_;
+    };
+
     class jacobi_func
     {
     public:
         jacobi_func(
             const reaction_container_type &reactions, const Real& volume,
             const Real& abs_tol, const Real& rel_tol)
-            : reactions_(reactions), volume_(volume), vinv_(1.0 / volume), abs_tol_(abs_tol), rel_tol_(rel_tol)
+            : reactions_(reactions), pattern_(new jacobian_pattern(reactions, num_species(reactions))),
+            volume_(volume), vinv_(1.0 / volume), abs_tol_(abs_tol), rel_tol_(rel_tol)
         {
             ;
         }
-        void operator()(
-                const state_type& x, matrix_type& jacobi, const double &t, state_type &dfdt) const
+
+        jacobi_func(
+            const reaction_container_type &reactions,
+            const std::shared_ptr<const jacobian_pattern>& pattern, const Real& volume,
+            const Real& abs_tol, const Real& rel_tol)
+            : reactions_(reactions), pattern_(pattern),
+            volume_(volume), vinv_(1.0 / volume), abs_tol_(abs_tol), rel_tol_(rel_tol)
         {
-            //fill 0 into jacobi and dfdt
-            std::fill(dfdt.begin(), dfdt.end(), 0.0);
-            std::fill(jacobi.data().begin(), jacobi.data().end(), 0.0);
+            ;
+        }
 
-            // const Real ETA(2.2204460492503131e-16);
-            const Real SQRTETA(1.4901161193847656e-08);
-            const Real r0(1.0);
-            // Real fac(0.0);
-            // for (std::size_t k(0); k < dfdt.size(); ++k)
-            // {
-            //     const Real ewtk(atol + rtol * x[k]);
-            //     fac = std::max(fac, dfdt[k] * ewtk);
-            // }
-            // const Real r0(1000.0 * h * ETA * dfdt.size() * fac);  //XXX: h means the step interval
-            // {
-            //     const Real ewtj(atol + rtol * x[j]);
-            //     const Real dyj(std::max(SQRTETA * abs(x[j]), r0 * ewtj));
-            // }
+        const jacobian_pattern& pattern() const
+        {
+            return *pattern_;
+        }
 
-            // const Real h(1.0e-8);
-            // const Real ht(1.0e-10);
-            const Real ht(1.0e-10);
+        /**
+         * assemble the Jacobian into jacobi, which must be a copy of
+         * pattern().matrix(). The derivatives of mass actions and of
+         * descriptors with has_derivatives() are exact, and the others
+         * are approximated by finite differences.
+         */
+        void operator()(
+            const state_type& x, sparse_matrix_type& jacobi, const double &t, state_type &dfdt) const;
 
-            // calculate jacobian for each reaction and merge it.
-            for(reaction_container_type::const_iterator i(reactions_.begin());
-                i != reactions_.end(); i++)
-            {
-                // Calculate one reactions's jabobian
-                //  Prepare the state_array to pass ReactionRuleDescriptor.
-                index_container_type::size_type reactants_size(i->reactants.size());
-                index_container_type::size_type products_size(i->products.size());
-                ReactionRuleDescriptor::state_container_type reactants_states(reactants_size);
-                ReactionRuleDescriptor::state_container_type products_states(products_size);
-                ReactionRuleDescriptor::state_container_type::size_type cnt(0);
-                for(index_container_type::const_iterator j(i->reactants.begin());
-                    j != i->reactants.end(); j++, cnt++)
-                {
-                    reactants_states[cnt] = x[*j];
-                }
-                cnt = 0;
-                for(index_container_type::const_iterator j(i->products.begin());
-                    j != i->products.end(); j++, cnt++)
-                {
-                    products_states[cnt] = x[*j];
-                }
-                // Call the ReactionRuleDescriptor object
+    protected:
 
-                if (i->ratelaw.expired())
-                {
-                    std::unique_ptr<ReactionRuleDescriptor> temporary_ratelaw_obj(new ReactionRuleDescriptorMassAction(i->k, i->reactant_coefficients, i->product_coefficients));
-                    Real flux_0 = temporary_ratelaw_obj->propensity(reactants_states, products_states, volume_, t);
-                    // Differentiate by time
-                    {
-                        Real flux = temporary_ratelaw_obj->propensity(reactants_states, products_states, volume_, t + ht);
-                        Real flux_deriv = (flux - flux_0) / ht;
-                        if (flux_deriv != 0.0)
-                        {
-                            for(std::size_t k(0); k < i->reactants.size(); k++)
-                            {
-                                matrix_type::size_type row = i->reactants[k];
-                                Real coeff = i->reactant_coefficients[k];
-                                dfdt[row] -= coeff * flux_deriv;
-                            }
-                            for(std::size_t k(0); k < i->products.size(); k++)
-                            {
-                                matrix_type::size_type row = i->products[k];
-                                Real coeff = i->product_coefficients[k];
-                                dfdt[row] += coeff * flux_deriv;
-                            }
-                        }
-                    }
-                    // Differentiate by each Reactants
-                    for(std::size_t j(0); j < reactants_states.size(); j++)
-                    {
-                        const Real ewt = abs_tol_ + rel_tol_ * abs(reactants_states[j]);
-                        const Real h = std::max(SQRTETA * abs(reactants_states[j]), r0 * ewt);
-                        ReactionRuleDescriptor::state_container_type h_shift(reactants_states);
-                        h_shift[j] += h;
-                        Real flux = temporary_ratelaw_obj->propensity(h_shift, products_states, volume_, t);
-                        Real flux_deriv = (flux - flux_0) / h;
-                        matrix_type::size_type col = i->reactants[j];
-                        for(std::size_t k(0); k < i->reactants.size(); k++)
-                        {
-                            matrix_type::size_type row = i->reactants[k];
-                            Real coeff = i->reactant_coefficients[k];
-                            jacobi(row, col) -= coeff * flux_deriv;
-                        }
-                        for(std::size_t k(0); k < i->products.size(); k++)
-                        {
-                            matrix_type::size_type row = i->products[k];
-                            Real coeff = i->product_coefficients[k];
-                            jacobi(row, col) += coeff * flux_deriv;
-                        }
-                    }
-                    // Differentiate by Products
-                    for(std::size_t j(0); j < products_states.size(); j++)
-                    {
-                        const Real ewt = abs_tol_ + rel_tol_ * abs(products_states[j]);
-                        const Real h = std::max(SQRTETA * abs(products_states[j]), r0 * ewt);
-                        ReactionRuleDescriptor::state_container_type h_shift(products_states);
-                        h_shift[j] += h;
-                        Real flux = temporary_ratelaw_obj->propensity(reactants_states, h_shift, volume_, t);
-                        Real flux_deriv = (flux - flux_0) / h;
-                        matrix_type::size_type col = i->products[j];
-                        for(std::size_t k(0); k < i->reactants.size(); k++)
-                        {
-                            matrix_type::size_type row = i->reactants[k];
-                            Real coeff = i->reactant_coefficients[k];
-                            jacobi(row, col) -= coeff * flux_deriv;
-                        }
-                        for(std::size_t k(0); k < i->products.size(); k++)
-                        {
-                            matrix_type::size_type row = i->products[k];
-                            Real coeff = i->product_coefficients[k];
-                            jacobi(row, col) += coeff * flux_deriv;
-                        }
-                    }
-                }
-                else
-                {
-                    std::shared_ptr<ReactionRuleDescriptor> ratelaw = i->ratelaw.lock();
-                    assert(ratelaw->is_available());
-                    Real flux_0 = ratelaw->propensity(reactants_states, products_states, volume_, t);
-                    // Differentiate by time
-                    {
-                        Real flux = ratelaw->propensity(reactants_states, products_states, volume_, t + ht);
-                        Real flux_deriv = (flux - flux_0) / ht;
-                        if (flux_deriv != 0.0)
-                        {
-                            for(std::size_t k(0); k < i->reactants.size(); k++)
-                            {
-                                matrix_type::size_type row = i->reactants[k];
-                                Real coeff = i->reactant_coefficients[k];
-                                dfdt[row] -= coeff * flux_deriv;
-                            }
-                            for(std::size_t k(0); k < i->products.size(); k++)
-                            {
-                                matrix_type::size_type row = i->products[k];
-                                Real coeff = i->product_coefficients[k];
-                                dfdt[row] += coeff * flux_deriv;
-                            }
-                        }
-                    }
-                    // Differentiate by each Reactants
-                    for(std::size_t j(0); j < reactants_states.size(); j++)
-                    {
-                        const Real ewt = abs_tol_ + rel_tol_ * abs(reactants_states[j]);
-                        const Real h = std::max(SQRTETA * abs(reactants_states[j]), r0 * ewt);
-                        ReactionRuleDescriptor::state_container_type h_shift(reactants_states);
-                        h_shift[j] += h;
-                        Real flux = ratelaw->propensity(h_shift, products_states, volume_, t);
-                        Real flux_deriv = (flux - flux_0) / h;
-                        matrix_type::size_type col = i->reactants[j];
-                        for(std::size_t k(0); k < i->reactants.size(); k++)
-                        {
-                            matrix_type::size_type row = i->reactants[k];
-                            Real coeff = i->reactant_coefficients[k];
-                            jacobi(row, col) -= coeff * flux_deriv;
-                        }
-                        for(std::size_t k(0); k < i->products.size(); k++)
-                        {
-                            matrix_type::size_type row = i->products[k];
-                            Real coeff = i->product_coefficients[k];
-                            jacobi(row, col) += coeff * flux_deriv;
-                        }
-                    }
-                    // Differentiate by Products
-                    for(std::size_t j(0); j < products_states.size(); j++)
-                    {
-                        const Real ewt = abs_tol_ + rel_tol_ * abs(products_states[j]);
-                        const Real h = std::max(SQRTETA * abs(products_states[j]), r0 * ewt);
-                        ReactionRuleDescriptor::state_container_type h_shift(products_states);
-                        h_shift[j] += h;
-                        Real flux = ratelaw->propensity(reactants_states, h_shift, volume_, t);
-                        Real flux_deriv = (flux - flux_0) / h;
-                        matrix_type::size_type col = i->products[j];
-                        for(std::size_t k(0); k < i->reactants.size(); k++)
-                        {
-                            matrix_type::size_type row = i->reactants[k];
-                            Real coeff = i->reactant_coefficients[k];
-                            jacobi(row, col) -= coeff * flux_deriv;
-                        }
-                        for(std::size_t k(0); k < i->products.size(); k++)
-                        {
-                            matrix_type::size_type row = i->products[k];
-                            Real coeff = i->product_coefficients[k];
-                            jacobi(row, col) += coeff * flux_deriv;
-                        }
-                    }
-                }
+        static std::size_t num_species(const reaction_container_type& reactions);
+
+        /**
+         * add the Jacobian elements given by the partial derivative d of
+         * the r-th reaction with respect to its j-th participant.
+         */
+        inline void accumulate(
+            const std::size_t r, const std::size_t j, const Real d, sparse_matrix_type& jacobi) const
+        {
+            const reaction_type& reaction(reactions_[r]);
+            const std::size_t num_reactants(reaction.reactants.size());
+            for (std::size_t i(0); i < num_reactants; ++i)
+            {
+                jacobi.values[pattern_->slot(r, j, i)] -= reaction.reactant_coefficients[i] * d;
+            }
+            for (std::size_t i(0); i < reaction.products.size(); ++i)
+            {
+                jacobi.values[pattern_->slot(r, j, num_reactants + i)] += reaction.product_coefficients[i] * d;
             }
         }
+
     protected:
-        const reaction_container_type reactions_;
+        const reaction_container_type& reactions_;
+        std::shared_ptr<const jacobian_pattern> pattern_;
         const Real volume_;
         const Real vinv_;
         const Real abs_tol_, rel_tol_;
     };
 
+    /**
+     * sensitivity_func is the right-hand side of the state augmented with
+     * its forward sensitivities to the rate constants of mass actions,
+     * i.e. d/dt (dx/dk) = J (dx/dk) + df/dk. The state comes first, and the
+     * sensitivities to each rate constant follow as a block.
+     * J is cached with the state and time it was evaluated at, and is
+     * reused only at exactly the same point, e.g. when the integrator
+     * evaluates the Jacobian and the right-hand side at the same y.
+     */
+    class sensitivity_func
+    {
+    public:
+
+        sensitivity_func(
+            const reaction_container_type& reactions,
+            const std::vector<std::size_t>& parameters,
+            const deriv_func& f, const jacobi_func& jacobian, const Real& volume)
+            : reactions_(reactions), parameters_(parameters), f_(f), jacobian_(jacobian),
+            volume_(volume), jacobi_(jacobian.pattern().matrix()),
+            x_(jacobi_.size), fx_(jacobi_.size), dfdt_(jacobi_.size),
+            x_jacobi_(jacobi_.size), has_jacobi_(false), t_jacobi_(0.0)
+        {
+            ;
+        }
+
+        void operator()(const state_type& y, state_type& dydt, const double& t);
+
+        /**
+         * the Jacobian of the state alone, which is also the diagonal
+         * blocks of the sensitivities. It is cached for the state and time.
+         */
+        void jacobian(const state_type& y, sparse_matrix_type& jacobi, const double& t, state_type& dfdt)
+        {
+            std::copy(y.begin(), y.begin() + jacobi_.size, x_.begin());
+            jacobian_(x_, jacobi, t, dfdt_);
+            jacobi_.values = jacobi.values;
+            x_jacobi_ = x_;
+            has_jacobi_ = true;
+            t_jacobi_ = t;
+        }
+
+    protected:
+
+        const reaction_container_type& reactions_;
+        const std::vector<std::size_t>& parameters_;
+        deriv_func f_;
+        jacobi_func jacobian_;
+        const Real volume_;
+
+        sparse_matrix_type jacobi_;
+        state_type x_, fx_, dfdt_;
+        // the point where jacobi_ was evaluated
+        state_type x_jacobi_;
+        bool has_jacobi_;
+        Real t_jacobi_;
+    };
+
     class elasticity_func
     {
     public:
@@ -463,29 +571,35 @@ public:
 
     protected:
 
-        const reaction_container_type reactions_;
+        const reaction_container_type& reactions_;
         const Real volume_;
         const Real vinv_;
         const Real abs_tol_, rel_tol_;
     };
 
-    struct StateAndTimeBackInserter
+    typedef std::function<void (const state_type&, const Real)> step_observer_type;
+
+    /**
+     * forward every internal step after the initial time to an optional
+     * step observer. Nothing is stored otherwise.
+     */
+    struct step_observer_adapter
     {
-        typedef std::vector<state_type> state_container_type;
-        typedef std::vector<double> time_container_type;
+        const step_observer_type& observer;
+        const Real t0;
 
-        state_container_type &m_states;
-        time_container_type &m_times;
-        StateAndTimeBackInserter(
-            state_container_type &states, time_container_type &times)
-            : m_states(states), m_times(times)
+        step_observer_adapter(const step_observer_type& observer, const Real t0)
+            : observer(observer), t0(t0)
         {
             ;
         }
-        void operator()(const state_type &x, double t)
+
+        void operator()(const state_type& x, const double t) const
         {
-            m_states.push_back(x);
-            m_times.push_back(t);
+            if (observer && t > t0)
+            {
+                observer(x, t);
+            }
         }
     };
 public:
@@ -495,7 +609,8 @@ public:
         const std::shared_ptr<Model>& model,
         const ODESolverType solver_type = ROSENBROCK4_CONTROLLER)
         : base_type(world, model), dt_(std::numeric_limits<Real>::infinity()),
-          abs_tol_(1e-6), rel_tol_(1e-6), max_dt_(0.0), solver_type_(solver_type)
+          abs_tol_(1e-6), rel_tol_(1e-6), max_dt_(0.0), solver_type_(solver_type),
+          dense_output_(false), within_step_observer_(false)
     {
         initialize();
     }
@@ -504,7 +619,8 @@ public:
         const std::shared_ptr<ODEWorld>& world,
         const ODESolverType solver_type = ROSENBROCK4_CONTROLLER)
         : base_type(world), dt_(std::numeric_limits<Real>::infinity()),
-          abs_tol_(1e-6), rel_tol_(1e-6), max_dt_(0.0), solver_type_(solver_type)
+          abs_tol_(1e-6), rel_tol_(1e-6), max_dt_(0.0), solver_type_(solver_type),
+          dense_output_(false), within_step_observer_(false)
     {
         initialize();
     }
@@ -526,6 +642,7 @@ public:
         }
 
         // ode_reaction_rules_ = convert_ode_reaction_rules(model_);
+        compile();
     }
 
     void step(void)
@@ -582,6 +699,7 @@ public:
             throw std::invalid_argument("A tolerance must be positive or zero.");
         }
         abs_tol_ = abs_tol;
+        rosenbrock_.reset();
     }
 
     Real relative_tolerance() const
@@ -596,6 +714,7 @@ public:
             throw std::invalid_argument("A tolerance must be positive or zero.");
         }
         rel_tol_ = rel_tol;
+        rosenbrock_.reset();
     }
 
     Real maximum_step_interval() const
@@ -610,6 +729,98 @@ public:
             throw std::invalid_argument("A maximum step interval must be positive or zero.");
         }
         max_dt_ = max_dt;
+        rosenbrock_.reset();
+    }
+
+    /**
+     * integrate the forward sensitivities of the state with respect to the
+     * rate constants of the given reaction rules, i.e. dx/dk, with the
+     * state. The rules must be mass actions without a descriptor. The
+     * sensitivities start from zero. A Rosenbrock method needs the exact
+     * Jacobian of the augmented system, and thus ROSENBROCK4_CONTROLLER is
+     * switched to BDF with a warning, see solver_type().
+     * Give an empty list to disable it.
+     */
+    void set_sensitivity_parameters(const std::vector<std::size_t>& rules)
+    {
+        if (!rules.empty() && solver_type_ == ROSENBROCK4_CONTROLLER)
+        {
+            std::cerr << "Warning: ROSENBROCK4_CONTROLLER does not support"
+                " sensitivities. The solver is switched to BDF." << std::endl;
+            solver_type_ = BDF;
+            rosenbrock_.reset();
+        }
+        sensitivity_parameters_ = rules;
+        sensitivities_.resize(0, false);
+    }
+
+    const std::vector<std::size_t>& sensitivity_parameters() const
+    {
+        return sensitivity_parameters_;
+    }
+
+    /**
+     * return the sensitivities at the current time, i.e. the derivative of
+     * the i-th species in the world with respect to the rate constant of
+     * the j-th parameter at [i][j].
+     */
+    std::vector<std::vector<Real> > sensitivities() const;
+
+    ODESolverType solver_type() const
+    {
+        return solver_type_;
+    }
+
+    bool dense_output() const
+    {
+        return dense_output_;
+    }
+
+    /**
+     * with dense output, step(upto) does not truncate the last internal step
+     * at upto, but interpolates the state there, so that frequent observers
+     * do not limit the step size. Only ROSENBROCK4_CONTROLLER and BDF
+     * support it.
+     */
+    void set_dense_output(const bool dense_output)
+    {
+        if (dense_output
+            && solver_type_ != ROSENBROCK4_CONTROLLER && solver_type_ != BDF)
+        {
+            throw NotSupported("The solver has no dense output.");
+        }
+        dense_output_ = dense_output;
+    }
+
+    /**
+     * set a callback called at every internal step of the solver with the
+     * state, indexed as list_species() of the world, and the time. This is
+     * for sampling the trajectory between steps, e.g. into a preallocated
+     * buffer.
+     */
+    void set_step_callback(const step_observer_type& callback)
+    {
+        step_observer_ = callback;
+    }
+
+    /**
+     * initialize the observer, and fire it with the world at every internal
+     * step of the solver, e.g. to log the trajectory with a NumberObserver.
+     */
+    void set_step_observer(const std::shared_ptr<Observer>& observer);
+
+    void reset_step_observer()
+    {
+        step_observer_ = step_observer_type();
+    }
+
+    /**
+     * the step observer is fired at an internal step, and not at
+     * a reaction, which ODESimulator has none of.
+     */
+    bool check_internal_step() const
+    {
+        return within_step_observer_;
     }
 
     std::vector<Real> derivatives() const
@@ -629,7 +840,9 @@ public:
 
         state_type dxdt(n);
 
-        std::pair<deriv_func, jacobi_func> system(generate_system());
+        const reaction_container_type reactions(
+            is_compiled() ? reactions_ : convert_reactions());
+        std::pair<deriv_func, jacobi_func> system(generate_system(reactions));
         system.first(x, dxdt, world_->t());
 
         std::vector<Real> ret(dxdt.size());
@@ -652,19 +865,20 @@ public:
             }
         }
 
-        matrix_type jacobi(n, n);
         state_type dfdt(n);
 
-        std::pair<deriv_func, jacobi_func> system(generate_system());
+        const reaction_container_type reactions(
+            is_compiled() ? reactions_ : convert_reactions());
+        std::pair<deriv_func, jacobi_func> system(generate_system(reactions));
+        sparse_matrix_type jacobi(system.second.pattern().matrix());
         system.second(x, jacobi, world_->t(), dfdt);
 
-        std::vector<std::vector<Real> > ret(jacobi.size1());
-        for (unsigned i = 0; i != jacobi.size1(); i++)
+        std::vector<std::vector<Real> > ret(n, std::vector<Real>(n, 0.0));
+        for (std::size_t i(0); i < jacobi.size; ++i)
         {
-            ret[i].resize(jacobi.size2());
-            for (unsigned j = 0; j != jacobi.size2(); j++)
+            for (std::size_t p(jacobi.offsets[i]); p < jacobi.offsets[i + 1]; ++p)
             {
-                ret[i][j] = jacobi(i, j);
+                ret[i][jacobi.indices[p]] = jacobi.values[p];
             }
         }
         return ret;
@@ -704,7 +918,8 @@ public:
 
         matrix_type elas(m, n);
 
-        const reaction_container_type reactions(convert_reactions());
+        const reaction_container_type reactions(
+            is_compiled() ? reactions_ : convert_reactions());
         elasticity_func(reactions, world_->volume(), abs_tol_, rel_tol_)(x, elas, world_->t());
 
         std::vector<std::vector<Real> > ret(elas.size1());
@@ -722,7 +937,27 @@ public:
 protected:
 
     reaction_container_type convert_reactions() const;
-    std::pair<deriv_func, jacobi_func> generate_system() const;
+    std::pair<deriv_func, jacobi_func> generate_system(
+        const reaction_container_type& reactions) const;
+
+    /**
+     * The reaction network is compiled into reactions_ once, and reused
+     * by every step until the revision of the model, of the world's
+     * species or of the coefficients of a descriptor changes.
+     */
+    bool is_compiled() const;
+    void compile();
+
+    /**
+     * integrate x from t() to ntime with the solver, and additionally the
+     * sensitivities_ for integrate_sensitivities().
+     */
+    void integrate(
+        std::pair<deriv_func, jacobi_func>& system, state_type& x,
+        const Real ntime, const Real dt);
+    void integrate_sensitivities(
+        std::pair<deriv_func, jacobi_func>& system, state_type& x,
+        const Real ntime, const Real dt);
 
 protected:
 
@@ -732,6 +967,31 @@ protected:
     // Integer num_steps_;
     Real abs_tol_, rel_tol_, max_dt_;
     ODESolverType solver_type_;
+    bool dense_output_;
+
+    typedef std::vector<std::pair<std::shared_ptr<ReactionRuleDescriptor>, Integer> >
+        descriptor_revision_container_type;
+
+    std::vector<Species> species_;
+    // the revisions compiled last
+    Integer model_revision_, world_revision_;
+    descriptor_revision_container_type descriptor_revisions_;
+    reaction_container_type reactions_;
+    std::shared_ptr<const mass_action_kernel> kernel_;
+    std::shared_ptr<const jacobian_pattern> pattern_;
+    state_type x_;
+
+    // the history of the BDF method kept across steps
+    std::shared_ptr<BDFIntegrator> bdf_;
+    // the dense output stepper of rosenbrock4 kept across steps
+    std::shared_ptr<RosenbrockDenseOutput> rosenbrock_;
+
+    std::vector<std::size_t> sensitivity_parameters_;
+    // the sensitivities to each parameter in blocks indexed as species_
+    state_type sensitivities_;
+
+    step_observer_type step_observer_;
+    bool within_step_observer_;
 
     // ODENetworkModel::ode_reaction_rule_container_type ode_reaction_rules_;
 };
@@ -57,13 +57,13 @@ protected:
 public:
 
     ODEWorld(const Real3& edge_lengths = Real3(1, 1, 1))
-        : t_(0.0)
+        : t_(0.0), revision_(0)
     {
         reset(edge_lengths);
     }
 
     ODEWorld(const std::string& filename)
-        : t_(0.0)
+        : t_(0.0), revision_(0)
     {
         reset(Real3(1, 1, 1));
         this->load(filename);
@@ -96,6 +96,7 @@ public:
         index_map_.clear();
         num_molecules_.clear();
         species_.clear();
+        ++revision_;
 
         for (Real3::size_type dim(0); dim < 3; ++dim)
         {
@@ -141,6 +142,31 @@ public:
         return species_;
     }
 
+    /**
+     * the dense index API. an index is the position of a species in
+     * list_species(), and stays valid until a species is reserved or
+     * released, or the world is reset.
+     */
+    species_container_type::size_type num_species() const
+    {
+        return species_.size();
+    }
+
+    const Species& species_at(const species_container_type::size_type idx) const
+    {
+        return species_[idx];
+    }
+
+    Real get_value_at(const species_container_type::size_type idx) const
+    {
+        return num_molecules_[idx];
+    }
+
+    void set_value_at(const species_container_type::size_type idx, const Real& num)
+    {
+        num_molecules_[idx] = num;
+    }
+
     void add_molecules(const Species& sp, const Real& num)
     {
         species_map_type::const_iterator i(index_map_.find(sp));
@@ -220,6 +246,7 @@ public:
         index_map_.insert(std::make_pair(sp, num_molecules_.size()));
         species_.push_back(sp);
         num_molecules_.push_back(0);
+        ++revision_;
     }
 
     void release_species(const Species& sp)
@@ -247,6 +274,16 @@ public:
         species_.pop_back();
         num_molecules_.pop_back();
         index_map_.erase(sp);
+        ++revision_;
+    }
+
+    /**
+     * a counter incremented whenever the list of species changes, i.e.
+     * on reserve_species, release_species and reset.
+     */
+    Integer revision() const
+    {
+        return revision_;
     }
 
     void bind_to(std::shared_ptr<Model> model);
@@ -347,6 +384,7 @@ protected:
     num_molecules_container_type num_molecules_;
     species_container_type species_;
     species_map_type index_map_;
+    Integer revision_;
 
     std::weak_ptr<Model> model_;
 };
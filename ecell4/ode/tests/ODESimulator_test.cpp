@@ -12,6 +12,8 @@
 #include <ecell4/core/NetworkModel.hpp>
 #include "../ODESimulator.hpp"
 
+#include <cmath>
+
 using namespace ecell4;
 using namespace ecell4::ode;
 
@@ -71,3 +73,451 @@ BOOST_AUTO_TEST_CASE(ODESimulator_test_step2)
 
     // BOOST_ASSERT(false);
 }
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_recompile)
+{
+    const Real3 edge_lengths(1.0, 1.0, 1.0);
+
+    Species sp1("A"), sp2("B"), sp3("C");
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(edge_lengths));
+    world->set_value(sp1, 100);
+
+    ODESimulator target(world, model, RUNGE_KUTTA_CASH_KARP54);
+    target.step(1.0);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 100 * std::exp(-1.0), 1e-3);
+
+    // A new species in the world
+    world->set_value(sp3, 50);
+    target.step(2.0);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 100 * std::exp(-2.0), 1e-3);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp3), 50);
+
+    // A new reaction rule in the model
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp3, sp1, 1.0));
+    target.step(3.0);
+    BOOST_CHECK(world->get_value_exact(sp3) < 50);
+    BOOST_CHECK_CLOSE(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + world->get_value_exact(sp3), 150.0, 1e-6);
+
+    // A rule replaced by another rate constant
+    const Real value3(world->get_value_exact(sp3));
+    model->remove_reaction_rule(create_unimolecular_reaction_rule(sp3, sp1, 1.0));
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp3, sp1, 0.0));
+    target.step(4.0);
+    BOOST_CHECK_EQUAL(world->get_value_exact(sp3), value3);
+
+    // A coefficient of a descriptor modified in place
+    ReactionRule rr;
+    rr.set_k(1.0);
+    rr.add_reactant(sp2);
+    rr.add_product(sp3);
+    rr.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+        new ReactionRuleDescriptorMassAction(
+            1.0, std::vector<Real>(1, 1.0), std::vector<Real>(1, 1.0))));
+    model->add_reaction_rule(rr);
+    target.step(5.0);
+    BOOST_CHECK_CLOSE(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + world->get_value_exact(sp3), 150.0, 1e-6);
+    // The model keeps a copy of the descriptor.
+    model->reaction_rules().back().get_descriptor()->set_product_coefficient(0, 2.0);
+    target.step(6.0);
+    BOOST_CHECK(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + world->get_value_exact(sp3) > 150.0 + 1e-3);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_derivatives)
+{
+    const Real V(2.0);
+    Species sp1("A"), sp2("B"), sp3("C"), sp4("D");
+
+    ReactionRule rr1;
+    rr1.set_k(1.0);
+    rr1.add_product(sp1);
+
+    ReactionRule rr2;
+    rr2.set_k(0.5);
+    rr2.add_reactant(sp1);
+    rr2.add_reactant(sp2);
+    rr2.add_reactant(sp3);
+    rr2.add_product(sp4);
+
+    ReactionRule rr3;
+    rr3.set_k(0.2);
+    rr3.add_reactant(sp3);
+    rr3.add_product(sp4);
+    rr3.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+        new ReactionRuleDescriptorMassAction(
+            0.2, std::vector<Real>(1, 2.0), std::vector<Real>(1, 1.0))));
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(rr1);
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 0.5));
+    model->add_reaction_rule(create_binding_reaction_rule(sp1, sp2, sp3, 0.3));
+    model->add_reaction_rule(rr2);
+    model->add_reaction_rule(rr3);
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(V, 1.0, 1.0)));
+    world->set_value(sp1, 10);
+    world->set_value(sp2, 20);
+    world->set_value(sp3, 30);
+    world->set_value(sp4, 0);
+
+    ODESimulator target(world, model);
+    const std::vector<Real> dxdt(target.derivatives());
+
+    const Real flux1(1.0 * V), flux2(0.5 * 10), flux3(0.3 * 10 * 20 / V),
+        flux4(0.5 * V * (10 / V) * (20 / V) * (30 / V)),
+        flux5(0.2 * V * std::pow(30 / V, 2));
+    BOOST_CHECK_CLOSE(dxdt[0], flux1 - flux2 - flux3 - flux4, 1e-10);
+    BOOST_CHECK_CLOSE(dxdt[1], flux2 - flux3 - flux4, 1e-10);
+    BOOST_CHECK_CLOSE(dxdt[2], flux3 - flux4 - 2 * flux5, 1e-10);
+    BOOST_CHECK_CLOSE(dxdt[3], flux4 + flux5, 1e-10);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_jacobian)
+{
+    const Real V(2.0);
+    Species sp1("A"), sp2("B"), sp3("C"), sp4("D");
+
+    ReactionRule rr1;
+    rr1.set_k(0.2);
+    rr1.add_reactant(sp3);
+    rr1.add_product(sp4);
+    rr1.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+        new ReactionRuleDescriptorMassAction(
+            0.2, std::vector<Real>(1, 2.0), std::vector<Real>(1, 1.0))));
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 0.5));
+    model->add_reaction_rule(create_binding_reaction_rule(sp1, sp2, sp3, 0.3));
+    model->add_reaction_rule(rr1);
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(V, 1.0, 1.0)));
+    world->set_value(sp1, 10);
+    world->set_value(sp2, 20);
+    world->set_value(sp3, 30);
+    world->set_value(sp4, 0);
+
+    ODESimulator target(world, model);
+    const std::vector<std::vector<Real> > jacobi(target.jacobian());
+
+    BOOST_CHECK_CLOSE(jacobi[0][0], -0.5 - 0.3 * 20 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[0][1], -0.3 * 10 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[1][0], 0.5 - 0.3 * 20 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[1][1], -0.3 * 10 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[2][0], 0.3 * 20 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[2][2], -2 * 0.2 * 2 * 30 / V, 1e-10);
+    BOOST_CHECK_CLOSE(jacobi[3][2], 0.2 * 2 * 30 / V, 1e-10);
+    BOOST_CHECK_EQUAL(jacobi[0][2], 0.0);
+    BOOST_CHECK_EQUAL(jacobi[3][3], 0.0);
+
+    target.run(1.0);
+    BOOST_CHECK_CLOSE(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + 2 * world->get_value_exact(sp3) + 4 * world->get_value_exact(sp4), 90.0, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_bdf)
+{
+    Species sp1("A"), sp2("B"), sp3("C");
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 0.04));
+    {
+        ReactionRule rr;
+        rr.set_k(3e+7);
+        rr.add_reactant(sp2);
+        rr.add_reactant(sp2);
+        rr.add_product(sp2);
+        rr.add_product(sp3);
+        model->add_reaction_rule(rr);
+    }
+    {
+        ReactionRule rr;
+        rr.set_k(1e+4);
+        rr.add_reactant(sp2);
+        rr.add_reactant(sp3);
+        rr.add_product(sp1);
+        rr.add_product(sp3);
+        model->add_reaction_rule(rr);
+    }
+
+    // Robertson's stiff problem
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->set_value(sp1, 1.0);
+
+    ODESimulator target(world, model, BDF);
+    target.set_absolute_tolerance(1e-10);
+    target.set_relative_tolerance(1e-8);
+    for (unsigned int i(1); i <= 40; ++i)
+    {
+        BOOST_CHECK(!target.step(i));
+        BOOST_CHECK_EQUAL(target.t(), i);
+    }
+
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 0.7158270687, 1e-4);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp2), 9.185534764e-6, 1e-2);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp3), 0.2841637457, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_rosenbrock)
+{
+    Species sp1("A"), sp2("B"), sp3("C");
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 0.04));
+    {
+        ReactionRule rr;
+        rr.set_k(3e+7);
+        rr.add_reactant(sp2);
+        rr.add_reactant(sp2);
+        rr.add_product(sp2);
+        rr.add_product(sp3);
+        model->add_reaction_rule(rr);
+    }
+    {
+        ReactionRule rr;
+        rr.set_k(1e+4);
+        rr.add_reactant(sp2);
+        rr.add_reactant(sp3);
+        rr.add_product(sp1);
+        rr.add_product(sp3);
+        model->add_reaction_rule(rr);
+    }
+
+    // Robertson's stiff problem starting from zeros of B and C
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->set_value(sp1, 1.0);
+
+    ODESimulator target(world, model, ROSENBROCK4_CONTROLLER);
+    target.set_absolute_tolerance(1e-10);
+    target.set_relative_tolerance(1e-8);
+    target.run(40.0);
+
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 0.7158270687, 1e-4);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp2), 9.185534764e-6, 1e-2);
+    BOOST_CHECK_CLOSE(world->get_value_exact(sp3), 0.2841637457, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_step_observer)
+{
+    Species sp1("A"), sp2("B");
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    world->set_value(sp1, 100);
+
+    ODESimulator target(world, model, RUNGE_KUTTA_CASH_KARP54);
+
+    std::vector<std::string> species(1, "A");
+    std::shared_ptr<NumberObserver> obs(new NumberObserver(species));
+    target.set_step_observer(obs);
+
+    BOOST_CHECK(!target.step(1.0));
+    const NumberLogger::data_container_type data(obs->data());
+    BOOST_CHECK(data.size() > 2);
+    BOOST_CHECK_EQUAL(data.front()[0], 0.0);
+    BOOST_CHECK_EQUAL(data.back()[0], 1.0);
+    for (std::size_t i(1); i < data.size(); ++i)
+    {
+        BOOST_CHECK(data[i][0] > data[i - 1][0]);
+        BOOST_CHECK_CLOSE(data[i][1], 100 * std::exp(-data[i][0]), 1e-3);
+    }
+    // the observer is fired at internal steps, which are not reactions
+    BOOST_CHECK(!target.check_reaction());
+    BOOST_CHECK(!target.check_internal_step());
+
+    std::vector<Real> times;
+    times.reserve(100);
+    ODESimulator target2(world, model, BDF);
+    target2.set_step_callback(
+        [&times](const ODESimulator::state_type& x, const Real t) { times.push_back(t); });
+    BOOST_CHECK(!target2.step(2.0));
+    BOOST_CHECK(times.size() > 1);
+    BOOST_CHECK_EQUAL(times.back(), 2.0);
+    BOOST_CHECK_EQUAL(obs->data().size(), data.size());
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_dense_output)
+{
+    Species sp1("A"), sp2("B");
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    const ODESolverType solver_types[2] = {ROSENBROCK4_CONTROLLER, BDF};
+    for (unsigned int i(0); i < 2; ++i)
+    {
+        std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+        world->set_value(sp1, 100);
+
+        ODESimulator target(world, model, solver_types[i]);
+        target.set_relative_tolerance(1e-8);
+        target.set_dense_output(true);
+        BOOST_CHECK(target.dense_output());
+
+        std::size_t num_steps(0);
+        target.set_step_callback(
+            [&num_steps](const ODESimulator::state_type& x, const Real t) { ++num_steps; });
+
+        std::shared_ptr<FixedIntervalNumberObserver> obs(
+            new FixedIntervalNumberObserver(1e-3, std::vector<std::string>(1, "A")));
+        target.run(1.0, obs);
+
+        const NumberLogger::data_container_type data(obs->data());
+        BOOST_CHECK_EQUAL(data.size(), 1001);
+        BOOST_CHECK(num_steps < 500);
+        for (std::size_t j(0); j < data.size(); j += 50)
+        {
+            BOOST_CHECK_CLOSE(data[j][1], 100 * std::exp(-data[j][0]), 1e-4);
+        }
+        BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 100 * std::exp(-1.0), 1e-4);
+
+        // The state modified outside restarts the solver.
+        world->set_value(sp1, 100);
+        target.step(2.0);
+        BOOST_CHECK_CLOSE(world->get_value_exact(sp1), 100 * std::exp(-1.0), 1e-4);
+    }
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+    ODESimulator target(world, model, RUNGE_KUTTA_CASH_KARP54);
+    BOOST_CHECK_THROW(target.set_dense_output(true), NotSupported);
+}
+
+class MichaelisMentenBatch
+    : public ReactionRuleDescriptorBatch
+{
+public:
+
+    MichaelisMentenBatch(const std::vector<Real>& vmax, const Real km)
+        : ReactionRuleDescriptorBatch(1, 1), vmax_(vmax), km_(km), num_calls(0)
+    {
+        ;
+    }
+
+    void propensities(
+        const Real* reactants, const Real* products, const std::size_t num_reactions,
+        const Real volume, const Real t, Real* ret) const
+    {
+        ++num_calls;
+        for (std::size_t i(0); i < num_reactions; ++i)
+        {
+            ret[i] = vmax_[i] * reactants[i] / (km_ * volume + reactants[i]);
+        }
+    }
+
+    std::vector<Real> vmax_;
+    Real km_;
+    mutable std::size_t num_calls;
+};
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_batched_descriptor)
+{
+    const Real V(2.0);
+    Species sp1("A"), sp2("B"), sp3("C");
+
+    std::vector<Real> vmax(2);
+    vmax[0] = 1.0;
+    vmax[1] = 3.0;
+    std::shared_ptr<MichaelisMentenBatch> batch(new MichaelisMentenBatch(vmax, 5.0));
+    const std::vector<Real> coefficients(1, 1.0);
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    {
+        ReactionRule rr(create_unimolecular_reaction_rule(sp1, sp2, 0.0));
+        rr.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+            new ReactionRuleDescriptorBatched(batch, coefficients, coefficients)));
+        model->add_reaction_rule(rr);
+    }
+    {
+        ReactionRule rr(create_unimolecular_reaction_rule(sp2, sp3, 0.0));
+        rr.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+            new ReactionRuleDescriptorBatched(batch, coefficients, coefficients)));
+        model->add_reaction_rule(rr);
+    }
+    {
+        // the same rate law as the second batched one
+        ReactionRule rr(create_unimolecular_reaction_rule(sp3, sp1, 0.0));
+        rr.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+            new ReactionRuleDescriptorExpression(
+                "3.0 * r[0] / (5.0 * v + r[0])", coefficients, coefficients)));
+        model->add_reaction_rule(rr);
+    }
+
+    std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(V, 1.0, 1.0)));
+    world->set_value(sp1, 10);
+    world->set_value(sp2, 20);
+    world->set_value(sp3, 30);
+
+    ODESimulator target(world, model);
+    batch->num_calls = 0;
+    const std::vector<Real> dxdt(target.derivatives());
+    BOOST_CHECK_EQUAL(batch->num_calls, 1);
+
+    const Real flux1(1.0 * 10 / (5.0 * V + 10)), flux2(3.0 * 20 / (5.0 * V + 20)),
+        flux3(3.0 * 30 / (5.0 * V + 30));
+    BOOST_CHECK_CLOSE(dxdt[0], flux3 - flux1, 1e-10);
+    BOOST_CHECK_CLOSE(dxdt[1], flux1 - flux2, 1e-10);
+    BOOST_CHECK_CLOSE(dxdt[2], flux2 - flux3, 1e-10);
+
+    target.run(1.0);
+    BOOST_CHECK_CLOSE(
+        world->get_value_exact(sp1) + world->get_value_exact(sp2)
+        + world->get_value_exact(sp3), 60.0, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(ODESimulator_test_sensitivities)
+{
+    const Real k1(1.0), k2(0.5);
+    Species sp1("A"), sp2("B"), sp3("C");
+
+    const ODESolverType solver_types[3] = {RUNGE_KUTTA_CASH_KARP54, BDF, ROSENBROCK4_CONTROLLER};
+    for (unsigned int i(0); i < 3; ++i)
+    {
+        std::shared_ptr<NetworkModel> model(new NetworkModel());
+        model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, k1));
+        model->add_reaction_rule(create_unimolecular_reaction_rule(sp2, sp3, k2));
+
+        std::shared_ptr<ODEWorld> world(new ODEWorld(Real3(1, 1, 1)));
+        world->set_value(sp1, 100);
+
+        ODESimulator target(world, model, solver_types[i]);
+        target.set_absolute_tolerance(1e-10);
+        target.set_relative_tolerance(1e-10);
+        std::vector<std::size_t> parameters(2);
+        parameters[0] = 0;
+        parameters[1] = 1;
+        target.set_sensitivity_parameters(parameters);
+        // a Rosenbrock method is switched to BDF
+        BOOST_CHECK_EQUAL(
+            target.solver_type(),
+            solver_types[i] == ROSENBROCK4_CONTROLLER ? BDF : solver_types[i]);
+
+        for (unsigned int j(1); j <= 2; ++j)
+        {
+            const Real t(j);
+            target.step(t);
+            const std::vector<std::vector<Real> > S(target.sensitivities());
+            BOOST_CHECK_EQUAL(S.size(), 3);
+            BOOST_CHECK_EQUAL(S[0].size(), 2);
+
+            // A = A0 exp(-k1 t), and B = A0 k1 / (k2 - k1) (exp(-k1 t) - exp(-k2 t))
+            const Real e1(std::exp(-k1 * t)), e2(std::exp(-k2 * t));
+            BOOST_CHECK_CLOSE(S[0][0], -100 * t * e1, 1e-5);
+            BOOST_CHECK_SMALL(S[0][1], 1e-8);
+            BOOST_CHECK_CLOSE(
+                S[1][0],
+                100 * (k2 / std::pow(k2 - k1, 2) * (e1 - e2) - k1 / (k2 - k1) * t * e1), 1e-5);
+            BOOST_CHECK_CLOSE(
+                S[1][1],
+                100 * k1 * (-(e1 - e2) / std::pow(k2 - k1, 2) + t * e2 / (k2 - k1)), 1e-5);
+            // the total amount does not depend on the rate constants
+            BOOST_CHECK_SMALL(S[0][0] + S[1][0] + S[2][0], 1e-6);
+            BOOST_CHECK_SMALL(S[0][1] + S[1][1] + S[2][1], 1e-6);
+        }
+    }
+}
@@ -7,6 +7,7 @@
 #include <ecell4/core/Integer3.hpp>
 #include <ecell4/core/Real3.hpp>
 #include <ecell4/core/Barycentric.hpp>
+#include <ecell4/core/EnsembleRunner.hpp>
 #include <ecell4/core/types.hpp>
 
 #include "model.hpp"
@@ -378,6 +379,7 @@ void define_rng(py::module& m)
         .def("gaussian", &RandomNumberGenerator::gaussian,
             py::arg("sigma"), py::arg("mean") = 0.0)
         .def("binomial", &RandomNumberGenerator::binomial)
+        .def("poisson", &RandomNumberGenerator::poisson)
         .def("seed", (void (RandomNumberGenerator::*)()) &RandomNumberGenerator::seed)
         .def("seed", (void (RandomNumberGenerator::*)(Integer)) &RandomNumberGenerator::seed)
         .def("save", (void (RandomNumberGenerator::*)(const std::string&) const) &RandomNumberGenerator::save)
@@ -591,6 +593,8 @@ void define_reaction_rule_descriptor(py::module& m)
     py::class_<ReactionRuleDescriptor, PyReactionRuleDescriptor<>,
         std::shared_ptr<ReactionRuleDescriptor>>(m, "ReactionRuleDescriptor")
         .def("propensity", &ReactionRuleDescriptor::propensity)
+        .def("has_derivatives", &ReactionRuleDescriptor::has_derivatives)
+        .def("derivatives", &ReactionRuleDescriptor::derivatives)
         .def("reactant_coefficients", &ReactionRuleDescriptor::reactant_coefficients)
         .def("product_coefficients", &ReactionRuleDescriptor::product_coefficients)
         .def("set_reactant_coefficient", &ReactionRuleDescriptor::set_reactant_coefficient)
@@ -648,6 +652,77 @@ void define_reaction_rule_descriptor(py::module& m)
                 );
             }
         ));
+
+    py::class_<ReactionRuleDescriptorExpression, ReactionRuleDescriptor,
+        std::shared_ptr<ReactionRuleDescriptorExpression>>(m, "ReactionRuleDescriptorExpression")
+        .def(py::init<const std::string&>(), py::arg("expression"))
+        .def("as_string", &ReactionRuleDescriptorExpression::as_string)
+        .def(py::pickle(
+            [](const ReactionRuleDescriptorExpression& self)
+            {
+                return py::make_tuple(self.as_string(), self.reactant_coefficients(), self.product_coefficients());
+            },
+            [](py::tuple t)
+            {
+                if (t.size() != 3)
+                    throw std::runtime_error("Invalid state");
+                return ReactionRuleDescriptorExpression(
+                    t[0].cast<std::string>(),
+                    t[1].cast<ReactionRuleDescriptor::coefficient_container_type>(),
+                    t[2].cast<ReactionRuleDescriptor::coefficient_container_type>()
+                );
+            }
+        ));
+
+    py::class_<ReactionRuleDescriptorBatch,
+        std::shared_ptr<ReactionRuleDescriptorBatch>>(m, "ReactionRuleDescriptorBatch")
+        .def("num_reactants", &ReactionRuleDescriptorBatch::num_reactants)
+        .def("num_products", &ReactionRuleDescriptorBatch::num_products);
+
+    py::class_<ReactionRuleDescriptorBatchPyfunc, ReactionRuleDescriptorBatch,
+        std::shared_ptr<ReactionRuleDescriptorBatchPyfunc>>(m, "ReactionRuleDescriptorBatchPyfunc")
+        .def(py::init<ReactionRuleDescriptorBatchPyfunc::callback_t, const std::size_t, const std::size_t, const std::string&>(),
+                py::arg("pyfunc"), py::arg("num_reactants"), py::arg("num_products"), py::arg("name"))
+        .def("get", &ReactionRuleDescriptorBatchPyfunc::get)
+        .def("as_string", &ReactionRuleDescriptorBatchPyfunc::as_string)
+        .def(py::pickle(
+            [](const ReactionRuleDescriptorBatchPyfunc& self)
+            {
+                return py::make_tuple(self.get(), self.num_reactants(), self.num_products(), self.as_string());
+            },
+            [](py::tuple t)
+            {
+                if (t.size() != 4)
+                    throw std::runtime_error("Invalid state");
+                return ReactionRuleDescriptorBatchPyfunc(
+                    t[0].cast<ReactionRuleDescriptorBatchPyfunc::callback_t>(),
+                    t[1].cast<std::size_t>(),
+                    t[2].cast<std::size_t>(),
+                    t[3].cast<std::string>()
+                );
+            }
+        ));
+
+    py::class_<ReactionRuleDescriptorBatched, ReactionRuleDescriptor,
+        std::shared_ptr<ReactionRuleDescriptorBatched>>(m, "ReactionRuleDescriptorBatched")
+        .def(py::init<const std::shared_ptr<ReactionRuleDescriptorBatch>&>(), py::arg("batch"))
+        .def("batch", &ReactionRuleDescriptorBatched::batch)
+        .def(py::pickle(
+            [](const ReactionRuleDescriptorBatched& self)
+            {
+                return py::make_tuple(self.batch(), self.reactant_coefficients(), self.product_coefficients());
+            },
+            [](py::tuple t)
+            {
+                if (t.size() != 3)
+                    throw std::runtime_error("Invalid state");
+                return ReactionRuleDescriptorBatched(
+                    t[0].cast<std::shared_ptr<ReactionRuleDescriptorBatch>>(),
+                    t[1].cast<ReactionRuleDescriptor::coefficient_container_type>(),
+                    t[2].cast<ReactionRuleDescriptor::coefficient_container_type>()
+                );
+            }
+        ));
 }
 
 static inline
@@ -1442,9 +1517,25 @@ void define_simulator(py::module& m)
         .def("step", (void (Simulator::*)()) &Simulator::step)
         .def("step", (bool (Simulator::*)(const Real&)) &Simulator::step)
         .def("check_reaction", &Simulator::check_reaction)
+        .def("check_internal_step", &Simulator::check_internal_step)
         .def("next_time", &Simulator::next_time);
 }
 
+static inline
+void define_ensemble_result(py::module& m)
+{
+    py::class_<EnsembleResult>(m, "EnsembleResult")
+        .def("num_runs", &EnsembleResult::num_runs)
+        .def("num_times", &EnsembleResult::num_times)
+        .def("num_columns", &EnsembleResult::num_columns)
+        .def("targets", &EnsembleResult::targets)
+        .def("value", &EnsembleResult::value,
+            py::arg("run"), py::arg("i"), py::arg("j"))
+        .def("values", &EnsembleResult::values)
+        .def("data", &EnsembleResult::data, py::arg("run"))
+        .def("mean", &EnsembleResult::mean);
+}
+
 void setup_module(py::module& m)
 {
     define_real3(m);
@@ -1461,6 +1552,7 @@ void setup_module(py::module& m)
     define_world_interface(m);
     define_reaction_rule_descriptor(m);
     define_observers(m);
+    define_ensemble_result(m);
     define_shape(m);
     define_simulator(m);
 
@@ -22,9 +22,11 @@ void define_gillespie_factory(py::module& m)
 {
     py::class_<GillespieFactory> factory(m, "GillespieFactory");
     factory
-        .def(py::init<>())
+        .def(py::init<const GillespieSelectionMethod>(),
+            py::arg("method") = GillespieFactory::default_selection_method())
         .def("rng", &GillespieFactory::rng);
     define_factory_functions(factory);
+    define_ensemble_runner<GillespieFactory>(m);
 
     m.attr("Factory") = factory;
 }
@@ -35,10 +37,14 @@ void define_gillespie_simulator(py::module& m)
     py::class_<GillespieSimulator, Simulator, PySimulator<GillespieSimulator>,
         std::shared_ptr<GillespieSimulator>> simulator(m, "GillespieSimulator");
     simulator
-        .def(py::init<std::shared_ptr<GillespieWorld>>(), py::arg("w"))
-        .def(py::init<std::shared_ptr<GillespieWorld>, std::shared_ptr<Model>>(),
-                py::arg("w"), py::arg("m"))
+        .def(py::init<std::shared_ptr<GillespieWorld>, const GillespieSelectionMethod>(),
+                py::arg("w"),
+                py::arg("method") = GillespieSelectionMethod::DIRECT_METHOD)
+        .def(py::init<std::shared_ptr<GillespieWorld>, std::shared_ptr<Model>, const GillespieSelectionMethod>(),
+                py::arg("w"), py::arg("m"),
+                py::arg("method") = GillespieSelectionMethod::DIRECT_METHOD)
         .def("last_reactions", &GillespieSimulator::last_reactions)
+        .def("selection_method", &GillespieSimulator::selection_method)
         .def("set_t", &GillespieSimulator::set_t);
     define_simulator_functions(simulator);
 
@@ -106,6 +112,12 @@ void define_reaction_info(py::module& m)
 
 void setup_gillespie_module(py::module& m)
 {
+    py::enum_<GillespieSelectionMethod>(m, "GillespieSelectionMethod")
+        .value("DIRECT_METHOD", GillespieSelectionMethod::DIRECT_METHOD)
+        .value("NEXT_REACTION_METHOD", GillespieSelectionMethod::NEXT_REACTION_METHOD)
+        .value("SUM_TREE_METHOD", GillespieSelectionMethod::SUM_TREE_METHOD)
+        .export_values();
+
     define_gillespie_factory(m);
     define_gillespie_simulator(m);
     define_gillespie_world(m);
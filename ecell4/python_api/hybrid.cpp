@@ -0,0 +1,79 @@
+#include "python_api.hpp"
+
+#include <ecell4/hybrid/HybridFactory.hpp>
+#include <ecell4/hybrid/HybridSimulator.hpp>
+
+#include "simulator.hpp"
+#include "simulator_factory.hpp"
+
+namespace py = pybind11;
+using namespace ecell4::hybrid;
+
+namespace ecell4
+{
+
+namespace python_api
+{
+
+static inline
+void define_hybrid_factory(py::module& m)
+{
+    py::class_<HybridFactory> factory(m, "HybridFactory");
+    factory
+        .def(py::init<const Real, const Real>(),
+            py::arg("threshold_population") = HybridFactory::default_threshold_population(),
+            py::arg("dt") = HybridFactory::default_dt())
+        .def("rng", &HybridFactory::rng);
+    define_factory_functions(factory);
+    define_ensemble_runner<HybridFactory>(m);
+
+    m.attr("Factory") = factory;
+}
+
+static inline
+void define_hybrid_simulator(py::module& m)
+{
+    using world_type = HybridSimulator::world_type;
+
+    py::class_<HybridSimulator, Simulator, PySimulator<HybridSimulator>,
+        std::shared_ptr<HybridSimulator>> simulator(m, "HybridSimulator");
+    simulator
+        .def(py::init<std::shared_ptr<world_type>>(), py::arg("w"))
+        .def(py::init<std::shared_ptr<world_type>, std::shared_ptr<Model>>(),
+                py::arg("w"), py::arg("m"))
+        .def(py::init<std::shared_ptr<world_type>, std::shared_ptr<Model>,
+                std::shared_ptr<RandomNumberGenerator>>(),
+                py::arg("w"), py::arg("m"), py::arg("rng"))
+        .def("last_reactions", &HybridSimulator::last_reactions)
+        .def("set_t", &HybridSimulator::set_t)
+        .def("absolute_tolerance", &HybridSimulator::absolute_tolerance)
+        .def("set_absolute_tolerance", &HybridSimulator::set_absolute_tolerance)
+        .def("relative_tolerance", &HybridSimulator::relative_tolerance)
+        .def("set_relative_tolerance", &HybridSimulator::set_relative_tolerance)
+        .def("threshold_population", &HybridSimulator::threshold_population)
+        .def("set_threshold_population", &HybridSimulator::set_threshold_population)
+        .def("threshold_propensity", &HybridSimulator::threshold_propensity)
+        .def("set_threshold_propensity", &HybridSimulator::set_threshold_propensity)
+        .def("partition", &HybridSimulator::partition)
+        .def("set_partition", &HybridSimulator::set_partition)
+        .def("list_fast_reaction_rules", &HybridSimulator::list_fast_reaction_rules);
+    define_simulator_functions(simulator);
+
+    m.attr("Simulator") = simulator;
+}
+
+void setup_hybrid_module(py::module& m)
+{
+    py::enum_<HybridPartition>(m, "HybridPartition")
+        .value("AUTOMATIC_PARTITION", HybridPartition::AUTOMATIC_PARTITION)
+        .value("FAST_PARTITION", HybridPartition::FAST_PARTITION)
+        .value("SLOW_PARTITION", HybridPartition::SLOW_PARTITION)
+        .export_values();
+
+    define_hybrid_factory(m);
+    define_hybrid_simulator(m);
+}
+
+}
+
+}
@@ -11,8 +11,10 @@ PYBIND11_MODULE(ecell4_base, m) {
     py::module m_bd         = m.def_submodule("bd",         "A submodule of ecell4_base");
     py::module m_egfrd      = m.def_submodule("egfrd",      "A submodule of ecell4_base");
     py::module m_gillespie  = m.def_submodule("gillespie",  "A submodule of ecell4_base");
+    py::module m_tauleaping = m.def_submodule("tauleaping", "A submodule of ecell4_base");
     py::module m_meso       = m.def_submodule("meso",       "A submodule of ecell4_base");
     py::module m_ode        = m.def_submodule("ode",        "A submodule of ecell4_base");
+    py::module m_hybrid     = m.def_submodule("hybrid",     "A submodule of ecell4_base");
     py::module m_sgfrd      = m.def_submodule("sgfrd",      "A submodule of ecell4_base");
     py::module m_spatiocyte = m.def_submodule("spatiocyte", "A submodule of ecell4_base");
 
@@ -20,8 +22,13 @@ PYBIND11_MODULE(ecell4_base, m) {
     setup_bd_module(m_bd);
     setup_egfrd_module(m_egfrd);
     setup_gillespie_module(m_gillespie);
+    setup_tauleaping_module(m_tauleaping);
+    m_tauleaping.attr("World") = m_gillespie.attr("World");
     setup_meso_module(m_meso);
     setup_ode_module(m_ode);
+    setup_hybrid_module(m_hybrid);
+    m_hybrid.attr("World") = m_ode.attr("World");
+    m_hybrid.attr("ReactionInfo") = m_gillespie.attr("ReactionInfo");
     setup_sgfrd_module(m_sgfrd);
     setup_spatiocyte_module(m_spatiocyte);
 }
@@ -22,11 +22,14 @@ void define_meso_factory(py::module& m)
 {
     py::class_<MesoscopicFactory> factory(m, "MesoscopicFactory");
     factory
-        .def(py::init<const Integer3&, const Real>(),
+        .def(py::init<const Integer3&, const Real, const Integer, const Real>(),
             py::arg("matrix_sizes") = MesoscopicFactory::default_matrix_sizes(),
-            py::arg("subvolume_length") = MesoscopicFactory::default_subvolume_length())
+            py::arg("subvolume_length") = MesoscopicFactory::default_subvolume_length(),
+            py::arg("num_threads") = MesoscopicFactory::default_num_threads(),
+            py::arg("synchronization_interval") = MesoscopicFactory::default_synchronization_interval())
         .def("rng", &MesoscopicFactory::rng);
     define_factory_functions(factory);
+    define_ensemble_runner<MesoscopicFactory>(m);
 
     m.attr("Factory") = factory;
 }
@@ -37,11 +40,20 @@ void define_meso_simulator(py::module& m)
     py::class_<MesoscopicSimulator, Simulator, PySimulator<MesoscopicSimulator>,
         std::shared_ptr<MesoscopicSimulator>> simulator(m, "MesoscopicSimulator");
     simulator
-        .def(py::init<std::shared_ptr<MesoscopicWorld>>(), py::arg("w"))
-        .def(py::init<std::shared_ptr<MesoscopicWorld>, std::shared_ptr<Model>>(),
-                py::arg("w"), py::arg("m"))
+        .def(py::init<std::shared_ptr<MesoscopicWorld>, const Integer, const Real>(),
+                py::arg("w"),
+                py::arg("num_threads") = MesoscopicSimulator::default_num_threads(),
+                py::arg("synchronization_interval") = MesoscopicSimulator::default_synchronization_interval())
+        .def(py::init<std::shared_ptr<MesoscopicWorld>, std::shared_ptr<Model>, const Integer, const Real>(),
+                py::arg("w"), py::arg("m"),
+                py::arg("num_threads") = MesoscopicSimulator::default_num_threads(),
+                py::arg("synchronization_interval") = MesoscopicSimulator::default_synchronization_interval())
         .def("last_reactions", &MesoscopicSimulator::last_reactions)
-        .def("set_t", &MesoscopicSimulator::set_t);
+        .def("set_t", &MesoscopicSimulator::set_t)
+        .def("num_threads", &MesoscopicSimulator::num_threads)
+        .def("is_parallel", &MesoscopicSimulator::is_parallel)
+        .def("synchronization_interval", &MesoscopicSimulator::synchronization_interval)
+        .def("set_synchronization_interval", &MesoscopicSimulator::set_synchronization_interval);
     define_simulator_functions(simulator);
 
     m.attr("Simulator") = simulator;
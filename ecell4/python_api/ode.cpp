@@ -52,12 +52,30 @@ void define_ode_simulator(py::module& m)
         .def("set_relative_tolerance", &ODESimulator::set_relative_tolerance)
         .def("relative_tolerance", &ODESimulator::relative_tolerance)
         .def("set_absolute_tolerance", &ODESimulator::set_absolute_tolerance)
+        .def("dense_output", &ODESimulator::dense_output)
+        .def("set_dense_output", &ODESimulator::set_dense_output)
+        .def("sensitivity_parameters", &ODESimulator::sensitivity_parameters)
+        .def("solver_type", &ODESimulator::solver_type)
+        .def("set_sensitivity_parameters", &ODESimulator::set_sensitivity_parameters, py::arg("rules"),
+            R"pbdoc(
+                Integrate the sensitivities to the rate constants of the given rules.
+
+                ROSENBROCK4_CONTROLLER does not support the sensitivities, and
+                is switched to BDF with a warning. See solver_type().
+
+                Args:
+                    rules (list): Indices of mass-action reaction rules in the model.
+                        Give an empty list to disable it.
+            )pbdoc")
+        .def("sensitivities", &ODESimulator::sensitivities)
         .def("values", &ODESimulator::values)
         .def("derivatives", &ODESimulator::derivatives)
         .def("jacobian", &ODESimulator::jacobian)
         .def("fluxes", &ODESimulator::fluxes)
         .def("elasticity", &ODESimulator::elasticity)
-        .def("stoichiometry", &ODESimulator::stoichiometry);
+        .def("stoichiometry", &ODESimulator::stoichiometry)
+        .def("set_step_observer", &ODESimulator::set_step_observer, py::arg("observer"))
+        .def("reset_step_observer", &ODESimulator::reset_step_observer);
     define_simulator_functions(simulator);
 
     m.attr("Simulator") = simulator;
@@ -104,6 +122,7 @@ void setup_ode_module(py::module& m)
         .value("RUNGE_KUTTA_CASH_KARP54", ODESolverType::RUNGE_KUTTA_CASH_KARP54)
         .value("ROSENBROCK4_CONTROLLER", ODESolverType::ROSENBROCK4_CONTROLLER)
         .value("EULER", ODESolverType::EULER)
+        .value("BDF", ODESolverType::BDF)
         .export_values();
 
     define_ode_factory(m);
@@ -3,7 +3,9 @@
 
 #include <pybind11/pybind11.h>
 #include <pybind11/functional.h>
+#include <pybind11/numpy.h>
 #include <ecell4/core/ReactionRuleDescriptor.hpp>
+#include <ecell4/core/Model.hpp>
 
 namespace py = pybind11;
 
@@ -24,6 +26,18 @@ namespace python_api
         {
             PYBIND11_OVERLOAD(Real, Base, propensity, reactants, products, volume, t);
         }
+
+        bool has_derivatives() const
+        {
+            PYBIND11_OVERLOAD(bool, Base, has_derivatives,);
+        }
+
+        std::pair<state_container_type, state_container_type> derivatives(
+            const state_container_type& reactants, const state_container_type& products, Real volume, Real t) const
+        {
+            using return_type = std::pair<state_container_type, state_container_type>;
+            PYBIND11_OVERLOAD(return_type, Base, derivatives, reactants, products, volume, t);
+        }
     };
 
     class ReactionRuleDescriptorPyfunc
@@ -76,6 +90,95 @@ namespace python_api
         std::string name_;
     };
 
+    /**
+     * ReactionRuleDescriptorBatchPyfunc calls back into Python once for all
+     * the reactions in the batch. The callback receives the states as NumPy
+     * arrays of the shape (num_reactions, num_reactants) and (num_reactions,
+     * num_products), the volume and the time, and returns the propensities
+     * of all the reactions. The arrays are views only valid during the call.
+     */
+    class ReactionRuleDescriptorBatchPyfunc
+        : public ReactionRuleDescriptorBatch
+    {
+    public:
+        using base_type = ReactionRuleDescriptorBatch;
+        using callback_t = py::object;
+
+        ReactionRuleDescriptorBatchPyfunc(const callback_t& callback,
+                const std::size_t num_reactants, const std::size_t num_products, const std::string& name)
+            : base_type(num_reactants, num_products), callback_(callback), name_(name)
+        {
+        }
+
+        void propensities(const Real* reactants, const Real* products, const std::size_t num_reactions,
+                const Real volume, const Real t, Real* ret) const override
+        {
+            // an owner never freeing the memory, which makes the arrays views
+            const py::capsule owner(reactants, [](void*) {});
+            const py::array_t<Real> reactants_array(
+                {num_reactions, num_reactants()}, reactants, owner);
+            const py::array_t<Real> products_array(
+                {num_reactions, num_products()}, products, owner);
+
+            const py::array_t<Real, py::array::c_style | py::array::forcecast> result(
+                callback_(reactants_array, products_array, volume, t));
+            if (static_cast<std::size_t>(result.size()) != num_reactions)
+            {
+                throw std::runtime_error("The number of propensities differs from that of reactions.");
+            }
+            std::copy(result.data(), result.data() + num_reactions, ret);
+        }
+
+        callback_t get() const
+        {
+            return callback_;
+        }
+
+        const std::string& as_string() const
+        {
+            return name_;
+        }
+
+    private:
+        callback_t callback_;
+        std::string name_;
+    };
+
+    /**
+     * return true if the propensity of any rule is given in Python,
+     * which cannot be evaluated without the GIL.
+     */
+    static inline
+    bool has_python_descriptor(const Model& model)
+    {
+        const Model::reaction_rule_container_type& reaction_rules(model.reaction_rules());
+        for (Model::reaction_rule_container_type::const_iterator
+            i(reaction_rules.begin()); i != reaction_rules.end(); ++i)
+        {
+            if (!(*i).has_descriptor())
+            {
+                continue;
+            }
+
+            const ReactionRuleDescriptor* desc((*i).get_descriptor().get());
+            if (dynamic_cast<const ReactionRuleDescriptorPyfunc*>(desc) != nullptr
+                || dynamic_cast<const PyReactionRuleDescriptor<>*>(desc) != nullptr
+                || dynamic_cast<const PyReactionRuleDescriptor<ReactionRuleDescriptorMassAction>*>(desc) != nullptr)
+            {
+                return true;
+            }
+
+            const ReactionRuleDescriptorBatched* batched(
+                dynamic_cast<const ReactionRuleDescriptorBatched*>(desc));
+            if (batched != nullptr
+                && dynamic_cast<const ReactionRuleDescriptorBatchPyfunc*>(batched->batch().get()) != nullptr)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
 }
 
 }
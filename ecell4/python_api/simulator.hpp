@@ -57,6 +57,11 @@ public:
     {
         PYBIND11_OVERLOAD(bool, Base, check_reaction,);
     }
+
+    bool check_internal_step() const override
+    {
+        PYBIND11_OVERLOAD(bool, Base, check_internal_step,);
+    }
 };
 
 template<class Base>
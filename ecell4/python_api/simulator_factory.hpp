@@ -3,6 +3,11 @@
 
 #include <pybind11/pybind11.h>
 
+#include <ecell4/core/EnsembleRunner.hpp>
+#include <ecell4/core/exceptions.hpp>
+
+#include "reaction_rule_descriptor.hpp"
+
 namespace py = pybind11;
 
 namespace ecell4
@@ -57,6 +62,38 @@ void define_factory_functions(py::class_<Factory>& factory)
             py::arg("world"), py::arg("model"));
 }
 
+template<class Factory>
+static inline
+void define_ensemble_runner(py::module& m)
+{
+    using world_type = typename Factory::world_type;
+    using runner_type = EnsembleRunner<Factory>;
+
+    py::class_<runner_type>(m, "EnsembleRunner")
+        .def(py::init<const Factory&, const Integer>(),
+            py::arg("factory"),
+            py::arg("num_threads") = runner_type::default_num_threads())
+        .def("num_threads", &runner_type::num_threads)
+        .def("run",
+            [](const runner_type& self, const std::shared_ptr<world_type>& world,
+               const std::shared_ptr<Model>& model, const Real duration, const Real dt,
+               const Integer num_runs, const std::vector<std::string>& species,
+               const Integer seed)
+            {
+                if (has_python_descriptor(*model))
+                {
+                    throw NotSupported(
+                        "A rate law given in Python is not supported in an ensemble run.");
+                }
+
+                py::gil_scoped_release release;
+                return self.run(world, model, duration, dt, num_runs, species, seed);
+            },
+            py::arg("world"), py::arg("model"), py::arg("duration"), py::arg("dt"),
+            py::arg("num_runs"), py::arg("species") = std::vector<std::string>(),
+            py::arg("seed") = 0);
+}
+
 }
 
 }
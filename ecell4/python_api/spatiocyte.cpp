@@ -1,6 +1,7 @@
 #include "python_api.hpp"
 
 #include <ecell4/core/OffLatticeSpace.hpp>
+#include <ecell4/core/Polygon.hpp>
 #include <ecell4/spatiocyte/OffLattice.hpp>
 #include <ecell4/spatiocyte/SpatiocyteFactory.hpp>
 #include <ecell4/spatiocyte/SpatiocyteReactions.hpp>
@@ -54,9 +55,10 @@ static inline void define_spatiocyte_factory(py::module &m)
 {
     py::class_<SpatiocyteFactory> factory(m, "SpatiocyteFactory");
     factory
-        .def(py::init<const Real>(),
+        .def(py::init<const Real, const Integer>(),
              py::arg("voxel_radius") =
-                 SpatiocyteFactory::default_voxel_radius())
+                 SpatiocyteFactory::default_voxel_radius(),
+             py::arg("num_threads") = SpatiocyteFactory::default_num_threads())
         .def("rng", &SpatiocyteFactory::rng);
     define_factory_functions(factory);
 
@@ -68,12 +70,18 @@ static inline void define_spatiocyte_simulator(py::module &m)
     py::class_<SpatiocyteSimulator, Simulator, PySimulator<SpatiocyteSimulator>,
                std::shared_ptr<SpatiocyteSimulator>>
         simulator(m, "SpatiocyteSimulator");
-    simulator.def(py::init<std::shared_ptr<SpatiocyteWorld>>(), py::arg("w"))
-        .def(py::init<std::shared_ptr<SpatiocyteWorld>,
-                      std::shared_ptr<Model>>(),
-             py::arg("w"), py::arg("m"))
+    simulator
+        .def(py::init<std::shared_ptr<SpatiocyteWorld>, const Integer>(),
+             py::arg("w"),
+             py::arg("num_threads") = SpatiocyteSimulator::default_num_threads())
+        .def(py::init<std::shared_ptr<SpatiocyteWorld>, std::shared_ptr<Model>,
+                      const Integer>(),
+             py::arg("w"), py::arg("m"),
+             py::arg("num_threads") = SpatiocyteSimulator::default_num_threads())
         .def("last_reactions", &SpatiocyteSimulator::last_reactions)
-        .def("set_t", &SpatiocyteSimulator::set_t);
+        .def("set_t", &SpatiocyteSimulator::set_t)
+        .def("num_threads", &SpatiocyteSimulator::num_threads)
+        .def("is_parallel", &SpatiocyteSimulator::is_parallel);
     define_simulator_functions(simulator);
 
     m.attr("Simulator") = simulator;
@@ -160,6 +168,16 @@ static inline void define_spatiocyte_world(py::module &m)
                                               info.D, info.loc, info.dimension);
                  self.add_space(offlattice.generate_space(updated));
              })
+        .def("add_offlattice",
+             [](SpatiocyteWorld &self, const Species &species,
+                const Polygon &polygon) {
+                 const auto info = self.get_molecule_info(species);
+                 const auto updated = Species(species.serial(), info.radius,
+                                              info.D, info.loc, info.dimension);
+                 self.add_space(std::unique_ptr<OffLatticeSpace>(
+                     new OffLatticeSpace(self.voxel_radius(), updated,
+                                         polygon)));
+             })
         .def_static("calculate_voxel_volume",
                     &SpatiocyteWorld::calculate_voxel_volume)
         .def_static("calculate_hcp_lengths",
@@ -180,6 +198,10 @@ static inline void define_spatiocyte_world(py::module &m)
           &create_spatiocyte_world_cell_list_impl);
     m.def("create_spatiocyte_world_vector_impl",
           &create_spatiocyte_world_vector_impl);
+    m.def("create_spatiocyte_world_blocked_impl",
+          &create_spatiocyte_world_blocked_impl);
+    m.def("create_spatiocyte_world_sparse_impl",
+          &create_spatiocyte_world_sparse_impl);
     m.def("create_spatiocyte_world_square_offlattice_impl",
           &allocate_spatiocyte_world_square_offlattice_impl);
 
@@ -0,0 +1,67 @@
+#include "python_api.hpp"
+
+#include <ecell4/tauleaping/TauLeapingFactory.hpp>
+#include <ecell4/tauleaping/TauLeapingSimulator.hpp>
+
+#include "simulator.hpp"
+#include "simulator_factory.hpp"
+
+namespace py = pybind11;
+using namespace ecell4::tauleaping;
+
+namespace ecell4
+{
+
+namespace python_api
+{
+
+static inline
+void define_tauleaping_factory(py::module& m)
+{
+    py::class_<TauLeapingFactory> factory(m, "TauLeapingFactory");
+    factory
+        .def(py::init<const Real, const Integer>(),
+            py::arg("epsilon") = TauLeapingFactory::default_epsilon(),
+            py::arg("critical_threshold") = TauLeapingFactory::default_critical_threshold())
+        .def("rng", &TauLeapingFactory::rng);
+    define_factory_functions(factory);
+    define_ensemble_runner<TauLeapingFactory>(m);
+
+    m.attr("Factory") = factory;
+}
+
+static inline
+void define_tauleaping_simulator(py::module& m)
+{
+    using world_type = TauLeapingSimulator::world_type;
+
+    py::class_<TauLeapingSimulator, Simulator, PySimulator<TauLeapingSimulator>,
+        std::shared_ptr<TauLeapingSimulator>> simulator(m, "TauLeapingSimulator");
+    simulator
+        .def(py::init<std::shared_ptr<world_type>, const Real, const Integer>(),
+                py::arg("w"),
+                py::arg("epsilon") = TauLeapingSimulator::default_epsilon(),
+                py::arg("critical_threshold") = TauLeapingSimulator::default_critical_threshold())
+        .def(py::init<std::shared_ptr<world_type>, std::shared_ptr<Model>, const Real, const Integer>(),
+                py::arg("w"), py::arg("m"),
+                py::arg("epsilon") = TauLeapingSimulator::default_epsilon(),
+                py::arg("critical_threshold") = TauLeapingSimulator::default_critical_threshold())
+        .def("last_reactions", &TauLeapingSimulator::last_reactions)
+        .def("set_t", &TauLeapingSimulator::set_t)
+        .def("epsilon", &TauLeapingSimulator::epsilon)
+        .def("critical_threshold", &TauLeapingSimulator::critical_threshold)
+        .def("is_leaping", &TauLeapingSimulator::is_leaping);
+    define_simulator_functions(simulator);
+
+    m.attr("Simulator") = simulator;
+}
+
+void setup_tauleaping_module(py::module& m)
+{
+    define_tauleaping_factory(m);
+    define_tauleaping_simulator(m);
+}
+
+}
+
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+#include <limits>
+
+#include "DiffusionBlocks.hpp"
+
+namespace ecell4
+{
+
+namespace spatiocyte
+{
+
+DiffusionBlocks::DiffusionBlocks(const Integer num_threads,
+                                 const Integer3 &shape,
+                                 RandomNumberGenerator &rng)
+    : num_threads_(num_threads), layer_stride_(shape.col * shape.row)
+{
+    // molecules are only in the layers inside the borders, which are
+    // contiguous across a periodic boundary.
+    const Integer num_layers(shape.layer);
+    const Integer num_inner_layers(num_layers - 2);
+    const Integer num_blocks(
+        2 * std::min(num_threads_, num_inner_layers / 4));
+    if (num_blocks < 2)
+    {
+        return;
+    }
+
+    blocks_.assign(num_layers, 0);
+    for (Integer i(0); i < num_blocks; ++i)
+    {
+        const Integer begin(1 + num_inner_layers * i / num_blocks),
+            end(1 + num_inner_layers * (i + 1) / num_blocks);
+        std::fill(blocks_.begin() + begin, blocks_.begin() + end, i);
+
+        rngs_.push_back(std::shared_ptr<RandomNumberGenerator>(
+            new GSLRandomNumberGenerator(
+                rng.uniform_int(0, std::numeric_limits<int>::max()))));
+    }
+    blocks_.back() = num_blocks - 1;
+
+    pool_.reset(new ThreadPool(std::min(num_threads_, num_blocks / 2)));
+}
+
+void DiffusionBlocks::run(const function_type &f) const
+{
+    if (!pool_)
+    {
+        return;
+    }
+
+    for (std::size_t parity(0); parity < 2; ++parity)
+    {
+        pool_->run(rngs_.size() / 2, [&](const std::size_t i) {
+            f(2 * i + parity);
+        });
+    }
+}
+
+} // namespace spatiocyte
+
+} // namespace ecell4
@@ -0,0 +1,77 @@
+#ifndef ECELL4_SPATIOCYTE_DIFFUSION_BLOCKS_HPP
+#define ECELL4_SPATIOCYTE_DIFFUSION_BLOCKS_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <ecell4/core/RandomNumberGenerator.hpp>
+#include <ecell4/core/ThreadPool.hpp>
+#include <ecell4/core/VoxelSpaceBase.hpp>
+#include <ecell4/core/types.hpp>
+
+namespace ecell4
+{
+
+namespace spatiocyte
+{
+
+/**
+ * DiffusionBlocks splits a lattice into slabs of layers to move molecules
+ * in parallel. Slabs consist of at least two layers inside the borders and
+ * their number is even, so that no two slabs of the same parity reach a
+ * common voxel in a hop, even across a periodic boundary. The border layers
+ * belong to the first and last slabs, but are not counted. Each slab has
+ * its own random number generator seeded from the given one, so that a
+ * result does not depend on the scheduling of threads. Threads are kept
+ * alive between runs.
+ */
+class DiffusionBlocks
+{
+public:
+    typedef VoxelSpaceBase::coordinate_type coordinate_type;
+    typedef std::function<void(const std::size_t)> function_type;
+
+public:
+    /**
+     * @param shape the shape of the lattice including its borders
+     */
+    DiffusionBlocks(const Integer num_threads, const Integer3 &shape,
+                    RandomNumberGenerator &rng);
+
+    Integer num_threads() const { return num_threads_; }
+
+    /**
+     * return the number of slabs, which is zero if the lattice is too thin
+     * to be split.
+     */
+    std::size_t num_blocks() const { return rngs_.size(); }
+
+    std::size_t block_of(const coordinate_type &coord) const
+    {
+        return blocks_[coord / layer_stride_];
+    }
+
+    RandomNumberGenerator &rng(const std::size_t i) { return *rngs_[i]; }
+
+    /**
+     * call f for each slab, first for even ones concurrently and then for
+     * odd ones. An exception thrown in f is rethrown after all threads end.
+     */
+    void run(const function_type &f) const;
+
+protected:
+    Integer num_threads_;
+    Integer layer_stride_;
+
+    // the slab of each layer
+    std::vector<std::size_t> blocks_;
+    std::vector<std::shared_ptr<RandomNumberGenerator>> rngs_;
+    std::shared_ptr<ThreadPool> pool_;
+};
+
+} // namespace spatiocyte
+
+} // namespace ecell4
+
+#endif /* ECELL4_SPATIOCYTE_DIFFUSION_BLOCKS_HPP */
@@ -22,14 +22,8 @@ public:
     {
         constexpr Real epsilon = std::numeric_limits<Real>::epsilon();
 
-        adjoining_pairs_.clear();
-        const std::size_t size = positions_.size();
-        for (std::size_t i(0); i < size; ++i)
-            for (std::size_t j(i+1); j < size; ++j)
-                if (length(positions_[j] - positions_[i]) <= voxel_radius_ + epsilon)
-                {
-                    adjoining_pairs_.push_back(std::make_pair(i, j));
-                }
+        adjoining_pairs_ = OffLatticeSpace::find_adjoining_pairs(
+                positions_, voxel_radius_ + epsilon);
     }
 
     inline const Real& voxel_radius() const
@@ -53,6 +53,8 @@ public:
         return boost::none;
     }
 
+    bool empty() const { return container_.empty(); }
+
     const_iterator begin() const { return container_.begin(); }
     const_iterator end() const { return container_.end(); }
 
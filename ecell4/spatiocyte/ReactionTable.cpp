@@ -0,0 +1,76 @@
+#include "ReactionTable.hpp"
+#include "utils.hpp"
+
+namespace ecell4
+{
+
+namespace spatiocyte
+{
+
+ReactionTable::index_type
+ReactionTable::index(const std::shared_ptr<const VoxelPool> &pool)
+{
+    const auto itr(indices_.find(pool.get()));
+    if (itr != indices_.end())
+    {
+        return itr->second;
+    }
+
+    const index_type idx(pools_.size());
+    pools_.push_back(pool);
+    indices_.insert(std::make_pair(pool.get(), idx));
+    entries_.push_back(std::vector<entry_type>());
+    return idx;
+}
+
+const ReactionTable::entry_type &ReactionTable::get(const index_type from,
+                                                    const index_type to)
+{
+    std::vector<entry_type> &row(entries_.at(from));
+    if (row.size() <= to)
+    {
+        row.resize(pools_.size());
+    }
+
+    entry_type &entry(row[to]);
+    if (!entry.is_ready)
+    {
+        compute(from, to, entry);
+        entry.is_ready = true;
+    }
+    return entry;
+}
+
+void ReactionTable::compute(const index_type from, const index_type to,
+                            entry_type &entry) const
+{
+    const std::shared_ptr<const VoxelPool> &from_mt(pools_.at(from));
+    const std::shared_ptr<const VoxelPool> &to_mt(pools_.at(to));
+
+    const Species &speciesA(from_mt->species());
+    const Species &speciesB(to_mt->species());
+
+    entry.rules = model_->query_reaction_rules(speciesA, speciesB);
+    entry.probabilities.clear();
+
+    if (entry.rules.empty())
+    {
+        return;
+    }
+
+    const Real from_D(world_->get_molecule_info(speciesA).D);
+    const Real to_D(world_->get_molecule_info(speciesB).D);
+    const Real factor(
+        calculate_dimensional_factor(from_mt, from_D, to_mt, to_D, world_));
+
+    Real accp(0.0);
+    for (const auto &rule : entry.rules)
+    {
+        accp += rule.k() * factor;
+        entry.probabilities.push_back(accp);
+    }
+}
+
+} // namespace spatiocyte
+
+} // namespace ecell4
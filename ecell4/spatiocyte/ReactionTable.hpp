@@ -0,0 +1,87 @@
+#ifndef ECELL4_SPATIOCYTE_REACTION_TABLE_HPP
+#define ECELL4_SPATIOCYTE_REACTION_TABLE_HPP
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <ecell4/core/Model.hpp>
+#include <ecell4/core/ReactionRule.hpp>
+#include <ecell4/core/VoxelPool.hpp>
+
+#include "SpatiocyteWorld.hpp"
+
+namespace ecell4
+{
+
+namespace spatiocyte
+{
+
+/**
+ * ReactionTable caches the second order reaction rules between two voxel
+ * pools with their acceptance probabilities, which depend only on the
+ * species of the pools. Pools are numbered in order of appearance, and the
+ * table is filled lazily, so species appearing during a simulation are
+ * added on the fly.
+ */
+class ReactionTable
+{
+public:
+    typedef std::size_t index_type;
+
+    struct entry_type
+    {
+        entry_type() : is_ready(false) {}
+
+        bool is_ready;
+        std::vector<ReactionRule> rules;
+        // the cumulative acceptance probabilities of rules for alpha = 1
+        std::vector<Real> probabilities;
+    };
+
+public:
+    ReactionTable(std::shared_ptr<Model> model,
+                  std::shared_ptr<SpatiocyteWorld> world)
+        : model_(model), world_(world)
+    {
+    }
+
+    /**
+     * return the index of the pool, which is numbered if new.
+     */
+    index_type index(const std::shared_ptr<const VoxelPool> &pool);
+
+    /**
+     * return the entry for the pools indexed. The reference is valid until
+     * the next call.
+     */
+    const entry_type &get(const index_type from, const index_type to);
+
+    const entry_type &get(const std::shared_ptr<const VoxelPool> &from,
+                          const std::shared_ptr<const VoxelPool> &to)
+    {
+        const index_type i(index(from));
+        return get(i, index(to));
+    }
+
+    std::size_t size() const { return pools_.size(); }
+
+protected:
+    void compute(const index_type from, const index_type to,
+                 entry_type &entry) const;
+
+protected:
+    std::shared_ptr<Model> model_;
+    std::shared_ptr<SpatiocyteWorld> world_;
+
+    // pools are kept alive not to reuse their addresses
+    std::vector<std::shared_ptr<const VoxelPool>> pools_;
+    std::unordered_map<const VoxelPool *, index_type> indices_;
+    std::vector<std::vector<entry_type>> entries_;
+};
+
+} // namespace spatiocyte
+
+} // namespace ecell4
+
+#endif /* ECELL4_SPATIOCYTE_REACTION_TABLE_HPP */
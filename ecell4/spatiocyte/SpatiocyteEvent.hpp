@@ -1,6 +1,8 @@
 #ifndef ECELL4_SPATIOCYTE_EVENT_HPP
 #define ECELL4_SPATIOCYTE_EVENT_HPP
 
+#include "DiffusionBlocks.hpp"
+#include "ReactionTable.hpp"
 #include "SpatiocyteReactions.hpp"
 #include "SpatiocyteWorld.hpp"
 #include "utils.hpp"
@@ -50,7 +52,18 @@ struct StepEvent : SpatiocyteEvent
     StepEvent(std::shared_ptr<Model> model,
               std::shared_ptr<SpatiocyteWorld> world, const Species &species,
               const Real &t, const Real alpha = 1.0)
-        : SpatiocyteEvent(t), model_(model), world_(world), alpha_(alpha)
+        : StepEvent(model, world,
+                    std::make_shared<ReactionTable>(model, world), species, t,
+                    alpha)
+    {
+    }
+
+    StepEvent(std::shared_ptr<Model> model,
+              std::shared_ptr<SpatiocyteWorld> world,
+              std::shared_ptr<ReactionTable> table, const Species &species,
+              const Real &t, const Real alpha = 1.0)
+        : SpatiocyteEvent(t), model_(model), world_(world), table_(table),
+          alpha_(alpha)
     {
         if (const auto space_and_molecule_pool =
                 world_->find_space_and_molecule_pool(species))
@@ -62,6 +75,8 @@ struct StepEvent : SpatiocyteEvent
         {
             throw "MoleculePool is not found";
         }
+        index_ = table_->index(mpool_);
+        is_movable_in_parallel_ = false;
 
         const MoleculeInfo minfo(world_->get_molecule_info(species));
         const Real D(minfo.D);
@@ -92,81 +107,240 @@ struct StepEvent : SpatiocyteEvent
             return; // INVALID ALPHA VALUE
         }
 
-        MoleculePool::container_type voxels;
-        copy(mpool_->begin(), mpool_->end(), back_inserter(voxels));
+        if (blocks_ && is_movable_in_parallel_)
+        {
+            walk_in_blocks_(alpha);
+            return;
+        }
+
+        // sweep the pool in place instead of copying it. The space and the
+        // rng are taken once, not for each molecule.
+        const std::shared_ptr<VoxelSpaceBase> space(space_.lock());
+        const std::shared_ptr<RandomNumberGenerator> rng(world_->rng());
 
-        std::size_t idx(0);
-        for (const auto &info : voxels)
+        std::size_t idx;
+        const MoleculePool::sweep_guard sweep(*mpool_);
+        while (mpool_->next_in_sweep(idx))
         {
+            const SpatiocyteWorld::coordinate_id_pair_type info((*mpool_)[idx]);
             const Voxel voxel(space_, info.coordinate);
+            const Voxel neighbor =
+                world_->get_neighbor_randomly<Dimension>(voxel);
 
-            if (voxel.get_voxel_pool() != mpool_)
+            // same as SpatiocyteWorld::can_move, which locks the space
+            const bool is_same_space(!space_.owner_before(neighbor.space) &&
+                                     !neighbor.space.owner_before(space_));
+
+            if (is_same_space &&
+                space->can_move(info.coordinate, neighbor.coordinate))
+            {
+                if (rng->uniform(0, 1) <= alpha)
+                    space->move(info.coordinate, neighbor.coordinate,
+                                /*candidate=*/idx);
+            }
+            else
             {
-                // should skip if a voxel is not the target species.
-                // when reaction has occured before, a voxel can be changed.
-                continue;
+                attempt_reaction_(
+                    info, neighbor, alpha,
+                    is_same_space ? table_index_(*space, neighbor.coordinate)
+                                  : table_->index(neighbor.get_voxel_pool()));
             }
+        }
+    }
 
-            const Voxel neighbor =
-                world_->get_neighbor_randomly<Dimension>(voxel);
+    /**
+     * move molecules in blocks in parallel. The location of the species must
+     * not be a MoleculePool, whose voxels would be updated by moves.
+     */
+    void set_diffusion_blocks(std::shared_ptr<DiffusionBlocks> blocks)
+    {
+        blocks_ = blocks;
+        const std::shared_ptr<VoxelPool> location(mpool_->location());
+        is_movable_in_parallel_ =
+            !location || !std::dynamic_pointer_cast<MoleculePool>(location);
+    }
+
+protected:
+    typedef SpatiocyteWorld::coordinate_type coordinate_type;
+
+    /**
+     * move molecules of each block concurrently with its own generator.
+     * A molecule failing to move may react with the neighbor, but the
+     * reaction changes pools, so that the collisions are kept and reactions
+     * are attempted after all the moves in the order of blocks. A collision
+     * is skipped if the molecule or its partner has left its voxel by then.
+     */
+    void walk_in_blocks_(const Real &alpha)
+    {
+        const std::shared_ptr<VoxelSpaceBase> space(space_.lock());
+        if (Dimension == 2)
+        {
+            world_->prepare_neighbors();
+        }
+
+        DiffusionBlocks &blocks(*blocks_);
+        std::vector<std::vector<std::size_t>> indices(blocks.num_blocks());
+        for (std::size_t idx(0); idx < static_cast<std::size_t>(mpool_->size());
+             ++idx)
+        {
+            indices[blocks.block_of((*mpool_)[idx].coordinate)].push_back(idx);
+        }
 
-            if (world_->can_move(voxel, neighbor))
+        // the pools are identified by their indices in the space, which
+        // LatticeSpaceVectorImpl always gives.
+        struct collision_type
+        {
+            collision_type(
+                const SpatiocyteWorld::coordinate_id_pair_type &info,
+                const coordinate_type &neighbor, const std::size_t candidate)
+                : info(info), neighbor(neighbor), candidate(candidate),
+                  source(0), partner(0)
             {
-                if (world_->rng()->uniform(0, 1) <= alpha)
-                    world_->move(voxel, neighbor, /*candidate=*/idx);
             }
-            else
+
+            SpatiocyteWorld::coordinate_id_pair_type info;
+            coordinate_type neighbor;
+            // the index of info in mpool_ at the sweep
+            std::size_t candidate;
+            std::size_t source, partner;
+        };
+        std::vector<std::vector<collision_type>> collisions(
+            blocks.num_blocks());
+
+        blocks.run([&](const std::size_t block) {
+            RandomNumberGenerator &rng(blocks.rng(block));
+            for (const auto &idx : indices[block])
             {
-                attempt_reaction_(info, neighbor, alpha);
+                const SpatiocyteWorld::coordinate_id_pair_type info(
+                    (*mpool_)[idx]);
+                const coordinate_type neighbor(
+                    world_->get_neighbor_randomly_in_root<Dimension>(
+                        info.coordinate, rng));
+                if (neighbor == info.coordinate)
+                {
+                    continue;
+                }
+
+                if (space->can_move(info.coordinate, neighbor))
+                {
+                    if (rng.uniform(0, 1) <= alpha)
+                        space->move(info.coordinate, neighbor,
+                                    /*candidate=*/idx);
+                }
+                else
+                {
+                    collision_type collision(info, neighbor, idx);
+                    space->find_pool_index_at(info.coordinate,
+                                              collision.source);
+                    space->find_pool_index_at(neighbor, collision.partner);
+                    collisions[block].push_back(collision);
+                }
             }
+        });
 
-            ++idx;
+        for (const auto &block : collisions)
+        {
+            for (const auto &collision : block)
+            {
+                // an earlier reaction may have consumed either of them
+                std::size_t source, partner;
+                if (!space->find_pool_index_at(collision.info.coordinate,
+                                               source) ||
+                    source != collision.source ||
+                    !space->find_pool_index_at(collision.neighbor, partner) ||
+                    partner != collision.partner ||
+                    !is_same_molecule_(collision.info, collision.candidate))
+                {
+                    continue;
+                }
+                attempt_reaction_(collision.info,
+                                  Voxel(space_, collision.neighbor), alpha,
+                                  table_index_(*space, collision.neighbor));
+            }
         }
     }
 
-protected:
-    void attempt_reaction_(const SpatiocyteWorld::coordinate_id_pair_type &info,
-                           const Voxel &dst, const Real &alpha)
+    /**
+     * return true if the molecule at info.coordinate, which is of mpool_,
+     * is still info.pid, e.g. not a product of an earlier reaction placed
+     * there. The voxel is looked up at candidate first.
+     */
+    bool is_same_molecule_(const SpatiocyteWorld::coordinate_id_pair_type &info,
+                           const std::size_t candidate) const
     {
-        const Voxel voxel(space_, info.coordinate);
-        std::shared_ptr<const VoxelPool> from_mt(voxel.get_voxel_pool());
-        std::shared_ptr<const VoxelPool> to_mt(dst.get_voxel_pool());
+        if (candidate < static_cast<std::size_t>(mpool_->size()))
+        {
+            const SpatiocyteWorld::coordinate_id_pair_type &voxel(
+                (*mpool_)[candidate]);
+            if (voxel.coordinate == info.coordinate)
+            {
+                return voxel.pid == info.pid;
+            }
+        }
+        return mpool_->get_particle_id(info.coordinate) == info.pid;
+    }
+
+    /**
+     * return the index in table_ of the pool at the coordinate in the space
+     * of this event. Pools are looked up by their indices in the space,
+     * which needs neither a hash nor a lock.
+     */
+    ReactionTable::index_type table_index_(const VoxelSpaceBase &space,
+                                           const coordinate_type &coord)
+    {
+        std::size_t index;
+        if (!space.find_pool_index_at(coord, index))
+        {
+            return table_->index(space.get_voxel_pool_at(coord));
+        }
 
-        const Species &speciesA(from_mt->species());
-        const Species &speciesB(to_mt->species());
+        const ReactionTable::index_type unknown(
+            std::numeric_limits<ReactionTable::index_type>::max());
+        if (index >= table_indices_.size())
+        {
+            table_indices_.resize(index + 1, unknown);
+        }
+        if (table_indices_[index] == unknown)
+        {
+            table_indices_[index] =
+                table_->index(space.get_voxel_pool_at(coord));
+        }
+        return table_indices_[index];
+    }
 
-        const std::vector<ReactionRule> rules(
-            model_->query_reaction_rules(speciesA, speciesB));
+    void attempt_reaction_(const SpatiocyteWorld::coordinate_id_pair_type &info,
+                           const Voxel &dst, const Real &alpha,
+                           const ReactionTable::index_type to_index)
+    {
+        // the voxel at info.coordinate is always of mpool_ during a sweep
+        const ReactionTable::entry_type &entry(table_->get(index_, to_index));
 
-        if (rules.empty())
+        if (entry.rules.empty())
         {
             return;
         }
 
-        const Real from_D(world_->get_molecule_info(speciesA).D);
-        const Real to_D(world_->get_molecule_info(speciesB).D);
-        const Real factor(
-            calculate_dimensional_factor(from_mt, from_D, to_mt, to_D, world_));
+        const Voxel voxel(space_, info.coordinate);
+        const std::shared_ptr<const VoxelPool> to_mt(dst.get_voxel_pool());
+
         const Real rnd(world_->rng()->uniform(0, 1));
-        Real accp(0.0);
 
-        for (const auto &rule : rules)
+        for (std::size_t i(0); i < entry.rules.size(); ++i)
         {
-            const Real k(rule.k());
-            const Real P(k * factor * alpha);
-            accp += P;
-            if (accp > 1 && k != std::numeric_limits<Real>::infinity())
+            const ReactionRule &rule(entry.rules[i]);
+            const Real accp(entry.probabilities[i] * alpha);
+            if (accp > 1 && rule.k() != std::numeric_limits<Real>::infinity())
             {
                 std::cerr << "The total acceptance probability [" << accp
-                          << "] exceeds 1 for '" << speciesA.serial()
-                          << "' and '" << speciesB.serial() << "'."
+                          << "] exceeds 1 for '" << mpool_->species().serial()
+                          << "' and '" << to_mt->species().serial() << "'."
                           << std::endl;
             }
             if (accp >= rnd)
             {
                 ReactionInfo rinfo(apply_second_order_reaction(
                     world_, rule,
-                    ReactionInfo::Item(info.pid, from_mt->species(), voxel),
+                    ReactionInfo::Item(info.pid, mpool_->species(), voxel),
                     ReactionInfo::Item(to_mt->get_particle_id(dst.coordinate),
                                        to_mt->species(), dst)));
                 if (rinfo.has_occurred())
@@ -183,7 +357,13 @@ protected:
     std::shared_ptr<Model> model_;
     std::shared_ptr<SpatiocyteWorld> world_;
     std::weak_ptr<VoxelSpaceBase> space_;
+    std::shared_ptr<ReactionTable> table_;
     std::shared_ptr<MoleculePool> mpool_;
+    ReactionTable::index_type index_;
+    // the index in table_ of each pool numbered by the space
+    std::vector<ReactionTable::index_type> table_indices_;
+    std::shared_ptr<DiffusionBlocks> blocks_;
+    bool is_movable_in_parallel_;
 
     const Real alpha_;
 };
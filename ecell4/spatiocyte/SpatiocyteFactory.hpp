@@ -23,8 +23,10 @@ public:
     typedef SpatiocyteFactory this_type;
 
 public:
-    SpatiocyteFactory(const Real voxel_radius = default_voxel_radius())
-        : base_type(), rng_(), voxel_radius_(voxel_radius)
+    SpatiocyteFactory(const Real voxel_radius = default_voxel_radius(),
+                      const Integer num_threads = default_num_threads())
+        : base_type(), rng_(), voxel_radius_(voxel_radius),
+          num_threads_(num_threads)
     {
         ; // do nothing
     }
@@ -36,6 +38,11 @@ public:
 
     static inline const Real default_voxel_radius() { return 0.0; }
 
+    static inline const Integer default_num_threads()
+    {
+        return simulator_type::default_num_threads();
+    }
+
     this_type &rng(const std::shared_ptr<RandomNumberGenerator> &rng)
     {
         rng_ = rng;
@@ -65,9 +72,17 @@ protected:
         }
     }
 
+    virtual simulator_type *
+    create_simulator(const std::shared_ptr<world_type> &w,
+                     const std::shared_ptr<Model> &m) const
+    {
+        return new simulator_type(w, m, num_threads_);
+    }
+
 protected:
     std::shared_ptr<RandomNumberGenerator> rng_;
     Real voxel_radius_;
+    Integer num_threads_;
 };
 
 } // namespace spatiocyte
@@ -17,6 +17,18 @@ void SpatiocyteSimulator::initialize()
     species_list_.clear(); // XXX:FIXME: Messy patch
 
     scheduler_.clear();
+    reaction_table_ = std::make_shared<ReactionTable>(model_, world_);
+
+    diffusion_blocks_.reset();
+    if (num_threads_ > 1 && world_->can_move_in_parallel())
+    {
+        std::shared_ptr<DiffusionBlocks> blocks(
+            new DiffusionBlocks(num_threads_, world_->shape(), *world_->rng()));
+        if (blocks->num_blocks() > 0)
+        {
+            diffusion_blocks_ = blocks;
+        }
+    }
     update_alpha_map();
     for (const auto &species : world_->list_species())
     {
@@ -94,13 +106,19 @@ SpatiocyteSimulator::create_step_event(const Species &species, const Real &t,
 
     if (dimension == Shape::THREE)
     {
-        return std::shared_ptr<SpatiocyteEvent>(
-            new StepEvent<3>(model_, world_, species, t, alpha));
+        StepEvent<3> *event(new StepEvent<3>(model_, world_, reaction_table_,
+                                             species, t, alpha));
+        if (diffusion_blocks_)
+            event->set_diffusion_blocks(diffusion_blocks_);
+        return std::shared_ptr<SpatiocyteEvent>(event);
     }
     else if (dimension == Shape::TWO)
     {
-        return std::shared_ptr<SpatiocyteEvent>(
-            new StepEvent<2>(model_, world_, species, t, alpha));
+        StepEvent<2> *event(new StepEvent<2>(model_, world_, reaction_table_,
+                                             species, t, alpha));
+        if (diffusion_blocks_)
+            event->set_diffusion_blocks(diffusion_blocks_);
+        return std::shared_ptr<SpatiocyteEvent>(event);
     }
     else
     {
@@ -30,20 +30,35 @@ public:
 
 public:
     SpatiocyteSimulator(std::shared_ptr<SpatiocyteWorld> world,
-                        std::shared_ptr<Model> model)
-        : base_type(world, model)
+                        std::shared_ptr<Model> model,
+                        const Integer num_threads = default_num_threads())
+        : base_type(world, model), num_threads_(num_threads)
     {
         initialize();
     }
 
-    SpatiocyteSimulator(std::shared_ptr<SpatiocyteWorld> world)
-        : base_type(world)
+    SpatiocyteSimulator(std::shared_ptr<SpatiocyteWorld> world,
+                        const Integer num_threads = default_num_threads())
+        : base_type(world), num_threads_(num_threads)
     {
         initialize();
     }
 
+    static inline const Integer default_num_threads() { return 1; }
+
     virtual Real dt() const { return dt_; }
 
+    Integer num_threads() const { return num_threads_; }
+
+    /**
+     * return true if molecules are moved in parallel. The lattice is split
+     * into slabs, see DiffusionBlocks, which requires that the world consists
+     * of a LatticeSpaceVectorImpl only. Reactions of collisions are attempted
+     * after the moves in each step. The result is reproducible for a given
+     * seed of the world and number of threads.
+     */
+    bool is_parallel() const { return diffusion_blocks_ != nullptr; }
+
     void initialize();
     void finalize();
     void step();
@@ -80,6 +95,12 @@ protected:
     scheduler_type scheduler_;
     std::shared_ptr<const SpatiocyteEvent> last_event_;
     alpha_map_type alpha_map_;
+    // shared by all StepEvents, and reset at initialize()
+    std::shared_ptr<ReactionTable> reaction_table_;
+
+    Integer num_threads_;
+    // null unless the simulator runs in parallel
+    std::shared_ptr<DiffusionBlocks> diffusion_blocks_;
 
     std::vector<reaction_type> last_reactions_;
 
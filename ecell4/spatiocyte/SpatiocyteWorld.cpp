@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <fstream>
 #include <stdexcept>
 
@@ -13,7 +14,7 @@ void SpatiocyteWorld::add_space(std::unique_ptr<VoxelSpaceBase> uniq_space)
 {
     std::shared_ptr<VoxelSpaceBase> space(uniq_space.release());
 
-    for (auto i(0); i < space->size(); ++i)
+    for (coordinate_type i(0); i < space->size(); ++i)
     {
         const Voxel voxel(space, i);
         const auto position(voxel.position());
@@ -51,8 +52,19 @@ void SpatiocyteWorld::add_space(std::unique_ptr<VoxelSpaceBase> uniq_space)
         }
     }
 
+    interface_flags_.clear();
+    if (!is_root_sparse())
+    {
+        interface_flags_.assign(get_root()->size(), false);
+        for (const auto &interface : interfaces_)
+        {
+            interface_flags_[interface.first.coordinate] = true;
+        }
+    }
+
     size_ += space->size();
     spaces_.push_back(space);
+    reset_membrane_neighbors();
 }
 
 void SpatiocyteWorld::set_value(const Species &sp, const Real value)
@@ -244,7 +256,7 @@ SpatiocyteWorld::add_structure3(const Species &sp, const std::string &location,
     Integer count(0);
     for (const auto &space : spaces_)
     {
-        for (auto coord(0); coord < space->size(); ++coord)
+        for (coordinate_type coord(0); coord < space->size(); ++coord)
         {
             const Voxel voxel(space, coord);
             // should check if coord doesn't point at the boundary.
@@ -276,7 +288,7 @@ SpatiocyteWorld::add_structure2(const Species &sp, const std::string &location,
     Integer count(0);
     for (const auto &space : spaces_)
     {
-        for (auto coord(0); coord < space->size(); ++coord)
+        for (coordinate_type coord(0); coord < space->size(); ++coord)
         {
             const Voxel voxel(space, coord);
             // should check if coord doesn't point at the boundary.
@@ -380,16 +392,79 @@ boost::optional<Voxel> SpatiocyteWorld::check_neighbor(const Voxel &voxel,
     return tmp[rng()->uniform_int(0, tmp.size() - 1)];
 }
 
+void SpatiocyteWorld::build_membrane_neighbors()
+{
+    const space_type root(get_root());
+    const Integer size(root->size());
+
+    membrane_coords_.clear();
+    membrane_offsets_.assign(1, 0);
+    membrane_neighbors_.clear();
+    if (is_root_sparse())
+    {
+        // a table over the whole lattice defeats the sparse space
+        return;
+    }
+
+    // the dimension is decided once for each pool, not for each voxel
+    std::unordered_map<const VoxelPool *, bool> is_membrane;
+    std::vector<bool> flags(size);
+    for (coordinate_type coord(0); coord < size; ++coord)
+    {
+        const std::shared_ptr<VoxelPool> vp(root->get_voxel_pool_at(coord));
+        auto itr(is_membrane.find(vp.get()));
+        if (itr == is_membrane.end())
+        {
+            const bool flag(get_dimension(vp->species()) <= Shape::TWO);
+            itr = is_membrane.insert(std::make_pair(vp.get(), flag)).first;
+        }
+        flags[coord] = itr->second;
+    }
+
+    for (coordinate_type coord(0); coord < size; ++coord)
+    {
+        if (!flags[coord])
+        {
+            continue;
+        }
+
+        for (Integer idx(0); idx < root->num_neighbors(coord); ++idx)
+        {
+            const coordinate_type neighbor(root->get_neighbor(coord, idx));
+            if (flags[neighbor])
+            {
+                membrane_neighbors_.push_back(neighbor);
+            }
+        }
+        membrane_coords_.push_back(coord);
+        membrane_offsets_.push_back(membrane_neighbors_.size());
+    }
+}
+
+bool SpatiocyteWorld::find_membrane_row(const coordinate_type &coord,
+                                        std::size_t &row) const
+{
+    const std::vector<coordinate_type>::const_iterator itr(std::lower_bound(
+        membrane_coords_.begin(), membrane_coords_.end(), coord));
+    if (itr == membrane_coords_.end() || *itr != coord)
+    {
+        return false;
+    }
+    row = std::distance(membrane_coords_.begin(), itr);
+    return true;
+}
+
 template <>
 const Voxel SpatiocyteWorld::get_neighbor_randomly<3>(const Voxel &voxel)
 {
     const auto idx(rng()->uniform_int(0, num_neighbors(voxel) - 1));
     const auto neighbor = get_neighbor(voxel, idx);
 
-    if (const auto neighbors = interfaces_.find(neighbor))
+    if (is_interface(neighbor))
     {
-        const auto idx(rng()->uniform_int(0, neighbors->size() - 1));
-        return neighbors->at(idx);
+        const auto &neighbors(*interfaces_.find(neighbor));
+        const auto idx(rng()->uniform_int(0, neighbors.size() - 1));
+        return neighbors.at(idx);
     }
 
     return neighbor;
@@ -398,6 +473,33 @@ const Voxel SpatiocyteWorld::get_neighbor_randomly<3>(const Voxel &voxel)
 template <>
 const Voxel SpatiocyteWorld::get_neighbor_randomly<2>(const Voxel &voxel)
 {
+    if (is_in_root(voxel))
+    {
+        if (membrane_offsets_.empty())
+        {
+            build_membrane_neighbors();
+        }
+
+        std::size_t row;
+        if (find_membrane_row(voxel.coordinate, row) &&
+            membrane_offsets_[row + 1] > membrane_offsets_[row])
+        {
+            const std::size_t begin(membrane_offsets_[row]),
+                end(membrane_offsets_[row + 1]);
+            const Integer idx(rng()->uniform_int(0, end - begin - 1));
+            const Voxel neighbor(voxel.space, membrane_neighbors_[begin + idx]);
+
+            if (is_interface(neighbor))
+            {
+                const auto &neighbors(*interfaces_.find(neighbor));
+                const auto idx(rng()->uniform_int(0, neighbors.size() - 1));
+                return neighbors.at(idx);
+            }
+
+            return neighbor;
+        }
+    }
+
     std::vector<Voxel> neighbors;
     for (Integer idx = 0; idx < num_neighbors(voxel); ++idx)
     {
@@ -421,6 +523,33 @@ const Voxel SpatiocyteWorld::get_neighbor_randomly<2>(const Voxel &voxel)
     return neighbor;
 }
 
+template <>
+SpatiocyteWorld::coordinate_type
+SpatiocyteWorld::get_neighbor_randomly_in_root<3>(
+    const coordinate_type &coord, RandomNumberGenerator &rng) const
+{
+    const space_type &root(spaces_.front());
+    return root->get_neighbor(
+        coord, rng.uniform_int(0, root->num_neighbors(coord) - 1));
+}
+
+template <>
+SpatiocyteWorld::coordinate_type
+SpatiocyteWorld::get_neighbor_randomly_in_root<2>(
+    const coordinate_type &coord, RandomNumberGenerator &rng) const
+{
+    std::size_t row;
+    if (!find_membrane_row(coord, row) ||
+        membrane_offsets_[row + 1] == membrane_offsets_[row])
+    {
+        return coord;
+    }
+
+    const std::size_t begin(membrane_offsets_[row]),
+        end(membrane_offsets_[row + 1]);
+    return membrane_neighbors_[begin + rng.uniform_int(0, end - begin - 1)];
+}
+
 } // namespace spatiocyte
 
 } // namespace ecell4
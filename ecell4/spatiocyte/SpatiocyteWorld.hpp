@@ -1,12 +1,14 @@
 #ifndef ECELL4_LATTICE_LATTICE_WORLD_HPP
 #define ECELL4_LATTICE_LATTICE_WORLD_HPP
 
+#include <cstdint>
 #include <memory>
 #include <numeric>
 #include <sstream>
 #include <stdexcept>
 
 #include <ecell4/core/LatticeSpaceCellListImpl.hpp>
+#include <ecell4/core/LatticeSpaceSparseImpl.hpp>
 #include <ecell4/core/LatticeSpaceVectorImpl.hpp>
 #include <ecell4/core/Model.hpp>
 #include <ecell4/core/OffLatticeSpace.hpp>
@@ -40,6 +42,7 @@ class SpatiocyteWorld : public WorldInterface
 public:
     typedef LatticeSpaceVectorImpl default_root_type;
 
+    typedef VoxelSpaceBase::coordinate_type coordinate_type;
     typedef VoxelSpaceBase::coordinate_id_pair_type coordinate_id_pair_type;
 
     typedef std::shared_ptr<VoxelSpaceBase> space_type;
@@ -164,6 +167,7 @@ public:
 
         const H5::Group group(fin->openGroup("LatticeSpace"));
         get_root()->load_hdf5(group); // TODO
+        reset_membrane_neighbors();
         sidgen_.load(*fin);
         rng_->load(*fin);
 #else
@@ -746,7 +750,10 @@ public:
         ParticleID pid;
 
         if (space->add_voxel(sp, pid, voxel.coordinate))
+        {
+            reset_membrane_neighbors();
             return pid;
+        }
 
         return boost::none;
     }
@@ -777,6 +784,46 @@ public:
     template <int Dimension>
     const Voxel get_neighbor_randomly(const Voxel &voxel);
 
+    /**
+     * return true if molecules in distant voxels can be moved concurrently,
+     * i.e. the world consists only of a LatticeSpaceVectorImpl in the
+     * row-major layout, which is split into slabs of layers.
+     */
+    bool can_move_in_parallel() const
+    {
+        if (spaces_.size() != 1)
+        {
+            return false;
+        }
+        const LatticeSpaceVectorImpl *root(
+            dynamic_cast<const LatticeSpaceVectorImpl *>(
+                spaces_.front().get()));
+        return root != nullptr &&
+               root->layout() == LatticeSpaceVectorImpl::ROW_MAJOR_LAYOUT;
+    }
+
+    /**
+     * build the tables get_neighbor_randomly_in_root requires.
+     */
+    void prepare_neighbors()
+    {
+        if (membrane_offsets_.empty())
+        {
+            build_membrane_neighbors();
+        }
+    }
+
+    /**
+     * choose a neighbor of a voxel in the root space as
+     * get_neighbor_randomly does, but with the generator given and without
+     * interfaces. This may be called concurrently after prepare_neighbors().
+     * For two dimensions, return the coordinate given if no neighbor is
+     * found.
+     */
+    template <int Dimension>
+    coordinate_type get_neighbor_randomly_in_root(const coordinate_type &coord,
+                                                  RandomNumberGenerator &rng) const;
+
     const Species &draw_species(const Species &pttrn) const;
 
     std::shared_ptr<RandomNumberGenerator> rng() const { return rng_; }
@@ -847,9 +894,61 @@ public:
                                                 true);
     }
 
+    /**
+     * discard the neighbors in membranes, which are rebuilt on demand. This
+     * must be called when structures are changed other than through
+     * new_voxel_structure.
+     */
+    void reset_membrane_neighbors()
+    {
+        membrane_coords_.clear();
+        membrane_offsets_.clear();
+        membrane_neighbors_.clear();
+    }
+
 protected:
     space_type get_root() const { return spaces_.at(0); }
 
+    bool is_in_root(const Voxel &voxel) const
+    {
+        // compare the owners without locking
+        const space_type &root(spaces_.at(0));
+        return !voxel.space.owner_before(root) && !root.owner_before(voxel.space);
+    }
+
+    /**
+     * find the row of the voxel in the root space in the neighbors in
+     * membranes, or return false if it has no row.
+     */
+    bool find_membrane_row(const coordinate_type &coord,
+                           std::size_t &row) const;
+
+    bool is_interface(const Voxel &voxel) const
+    {
+        if (interfaces_.empty())
+        {
+            return false;
+        }
+        // interfaces are always in the root space
+        if (interface_flags_.empty())
+        {
+            return is_in_root(voxel) && interfaces_.find(voxel);
+        }
+        return is_in_root(voxel) && interface_flags_[voxel.coordinate];
+    }
+
+    /**
+     * return true if the root space stores only non-vacant voxels, and
+     * thus no table over the whole lattice should be built.
+     */
+    bool is_root_sparse() const
+    {
+        return dynamic_cast<const LatticeSpaceSparseImpl *>(
+                   get_root().get()) != nullptr;
+    }
+
+    void build_membrane_neighbors();
+
     Integer add_structure2(const Species &sp, const std::string &location,
                            const std::shared_ptr<const Shape> shape);
     Integer add_structure3(const Species &sp, const std::string &location,
@@ -923,6 +1022,19 @@ protected:
     OneToManyMap<Voxel> interfaces_;
     OneToManyMap<Voxel> neighbors_;
 
+    // whether each voxel in the root space is a key of interfaces_. It is
+    // empty for a sparse root space, and interfaces_ is searched instead.
+    std::vector<bool> interface_flags_;
+
+    // the neighbors of two or less dimensions of each voxel of two or less
+    // dimensions in the root space in CSR. membrane_coords_ gives the voxel
+    // of each row in ascending order, so that the memory scales with the
+    // membranes, not with the volume. They are empty for a sparse root
+    // space, whose neighbors are searched each time.
+    std::vector<coordinate_type> membrane_coords_;
+    std::vector<std::size_t> membrane_offsets_;
+    std::vector<coordinate_type> membrane_neighbors_;
+
     std::shared_ptr<RandomNumberGenerator> rng_;
     SerialIDGenerator<ParticleID> sidgen_;
 
@@ -948,6 +1060,24 @@ inline SpatiocyteWorld *create_spatiocyte_world_vector_impl(
         new LatticeSpaceVectorImpl(edge_lengths, voxel_radius), rng);
 }
 
+inline SpatiocyteWorld *create_spatiocyte_world_blocked_impl(
+    const Real3 &edge_lengths, const Real &voxel_radius,
+    const std::shared_ptr<RandomNumberGenerator> &rng)
+{
+    return new SpatiocyteWorld(
+        new LatticeSpaceVectorImpl(edge_lengths, voxel_radius, true,
+                                   LatticeSpaceVectorImpl::BLOCKED_LAYOUT),
+        rng);
+}
+
+inline SpatiocyteWorld *create_spatiocyte_world_sparse_impl(
+    const Real3 &edge_lengths, const Real &voxel_radius,
+    const std::shared_ptr<RandomNumberGenerator> &rng)
+{
+    return new SpatiocyteWorld(
+        new LatticeSpaceSparseImpl(edge_lengths, voxel_radius), rng);
+}
+
 inline SpatiocyteWorld *allocate_spatiocyte_world_square_offlattice_impl(
     const Real edge_length, const Species &species, const Real &voxel_radius,
     const std::shared_ptr<RandomNumberGenerator> &rng)
@@ -0,0 +1,117 @@
+#define BOOST_TEST_MODULE "DiffusionBlocks_test"
+
+#ifdef UNITTEST_FRAMEWORK_LIBRARY_EXIST
+#   include <boost/test/unit_test.hpp>
+#else
+#   define BOOST_TEST_NO_LIB
+#   include <boost/test/included/unit_test.hpp>
+#endif
+
+#include <atomic>
+#include <set>
+
+#include "../DiffusionBlocks.hpp"
+
+using namespace ecell4;
+using namespace ecell4::spatiocyte;
+
+/**
+ * check that no two slabs of the same parity reach a common layer in a
+ * hop, where the layers inside the borders form a ring across the
+ * periodic boundary.
+ */
+static void check_blocks(const DiffusionBlocks &blocks, const Integer3 &shape)
+{
+    const Integer stride(shape.col * shape.row);
+    const Integer num_inner_layers(shape.layer - 2);
+    const std::size_t num_blocks(blocks.num_blocks());
+    if (num_blocks == 0)
+    {
+        return;
+    }
+
+    std::vector<Integer> thickness(num_blocks, 0);
+    std::vector<std::set<Integer>> reached(num_blocks);
+    for (Integer layer(1); layer <= num_inner_layers; ++layer)
+    {
+        const std::size_t block(blocks.block_of(layer * stride));
+        BOOST_REQUIRE(block < num_blocks);
+        ++thickness[block];
+        for (Integer shift(-1); shift <= 1; ++shift)
+        {
+            reached[block].insert(
+                (layer - 1 + shift + num_inner_layers) % num_inner_layers);
+        }
+    }
+
+    for (std::size_t i(0); i < num_blocks; ++i)
+    {
+        BOOST_CHECK(thickness[i] >= 2);
+        for (std::size_t j(i + 2); j < num_blocks; j += 2)
+        {
+            for (const auto &layer : reached[i])
+            {
+                BOOST_CHECK_MESSAGE(reached[j].count(layer) == 0,
+                                    "slabs " << i << " and " << j
+                                             << " share the layer " << layer);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(DiffusionBlocks_test_wrap_around)
+{
+    GSLRandomNumberGenerator rng;
+
+    // the first and last slabs are adjacent across the periodic boundary
+    const Integer3 shape(4, 4, 26);
+    const DiffusionBlocks blocks(6, shape, rng);
+    BOOST_CHECK_EQUAL(blocks.num_blocks(), 12);
+    check_blocks(blocks, shape);
+
+    for (Integer num_layers(4); num_layers < 40; ++num_layers)
+    {
+        for (Integer num_threads(2); num_threads <= 8; ++num_threads)
+        {
+            const Integer3 shape(4, 4, num_layers);
+            const DiffusionBlocks blocks(num_threads, shape, rng);
+            BOOST_CHECK_EQUAL(blocks.num_blocks() % 2, 0);
+            BOOST_CHECK(blocks.num_blocks() <= 2 * num_threads);
+            check_blocks(blocks, shape);
+        }
+    }
+
+    // too thin to be split
+    BOOST_CHECK_EQUAL(DiffusionBlocks(4, Integer3(4, 4, 5), rng).num_blocks(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(DiffusionBlocks_test_run)
+{
+    GSLRandomNumberGenerator rng;
+    const DiffusionBlocks blocks(4, Integer3(4, 4, 34), rng);
+    BOOST_CHECK_EQUAL(blocks.num_blocks(), 8);
+
+    // the threads are reused in each run
+    for (unsigned int i(0); i < 3; ++i)
+    {
+        std::vector<std::atomic<int>> counts(blocks.num_blocks());
+        for (auto &count : counts)
+        {
+            count = 0;
+        }
+        blocks.run([&](const std::size_t block) { ++counts[block]; });
+        for (const auto &count : counts)
+        {
+            BOOST_CHECK_EQUAL(count.load(), 1);
+        }
+    }
+
+    BOOST_CHECK_THROW(
+        blocks.run([](const std::size_t block) {
+            if (block == 3)
+            {
+                throw IllegalState("an error in a block");
+            }
+        }),
+        IllegalState);
+}
@@ -10,6 +10,7 @@
 #include <boost/test/tools/floating_point_comparison.hpp>
 
 #include "../SpatiocyteSimulator.hpp"
+#include "../utils.hpp"
 #include <ecell4/core/NetworkModel.hpp>
 #include <ecell4/core/Sphere.hpp>
 
@@ -261,6 +262,118 @@ BOOST_AUTO_TEST_CASE(SpatiocyteSimulator_test_binding_reaction)
     BOOST_CHECK_EQUAL(25 - world->num_molecules(sp2), num_sp3);
 }
 
+BOOST_AUTO_TEST_CASE(SpatiocyteSimulator_test_reaction_table)
+{
+    const Real L(2.5e-8);
+    const Real3 edge_lengths(L, L, L);
+    const Real voxel_radius(2.5e-9);
+    const Real radius(1.25e-9);
+    const ecell4::Species sp1("A", radius, 1.0e-12), sp2("B", radius, 1.1e-12),
+        sp3("C", 2.5e-9, 1.2e-12);
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_species_attribute(sp1);
+    model->add_species_attribute(sp2);
+    model->add_species_attribute(sp3);
+
+    model->add_reaction_rule(
+        create_binding_reaction_rule(sp1, sp2, sp3, 1e-20));
+
+    std::shared_ptr<GSLRandomNumberGenerator> rng(
+        new GSLRandomNumberGenerator());
+    std::shared_ptr<SpatiocyteWorld> world(
+        new SpatiocyteWorld(edge_lengths, voxel_radius, rng));
+
+    BOOST_CHECK(world->add_molecules(sp1, 1));
+    BOOST_CHECK(world->add_molecules(sp2, 1));
+
+    ReactionTable table(model, world);
+    const std::shared_ptr<const VoxelPool> pool1(world->find_voxel_pool(sp1)),
+        pool2(world->find_voxel_pool(sp2));
+
+    const ReactionTable::index_type idx1(table.index(pool1)),
+        idx2(table.index(pool2));
+    BOOST_CHECK_EQUAL(table.index(pool1), idx1);
+    BOOST_CHECK(idx1 != idx2);
+    BOOST_CHECK_EQUAL(table.size(), 2);
+
+    BOOST_CHECK(table.get(idx1, idx1).rules.empty());
+
+    const ReactionTable::entry_type &entry(table.get(idx1, idx2));
+    BOOST_CHECK_EQUAL(entry.rules.size(), 1);
+    BOOST_CHECK_EQUAL(entry.probabilities.size(), 1);
+    const Real factor(calculate_dimensional_factor(
+        pool1, sp1.get_attribute_as<Real>("D"), pool2,
+        sp2.get_attribute_as<Real>("D"), world));
+    BOOST_CHECK_CLOSE(entry.probabilities[0], 1e-20 * factor, 1e-10);
+
+    // a pool not seen yet is added on the fly
+    BOOST_CHECK(world->add_molecules(sp3, 1));
+    BOOST_CHECK(table.get(pool2, world->find_voxel_pool(sp3)).rules.empty());
+    BOOST_CHECK_EQUAL(table.size(), 3);
+}
+
+static Integer run_binding_reaction(const Integer num_threads,
+                                   const bool is_sparse = false)
+{
+    const Real L(1e-7);
+    const Real3 edge_lengths(L, L, L);
+    const Real voxel_radius(2.5e-9);
+    const Real radius(1.25e-9);
+    const ecell4::Species sp1("A", radius, 1.0e-12), sp2("B", radius, 1.1e-12),
+        sp3("C", 2.5e-9, 1.2e-12);
+
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    model->add_species_attribute(sp1);
+    model->add_species_attribute(sp2);
+    model->add_species_attribute(sp3);
+
+    model->add_reaction_rule(
+        create_binding_reaction_rule(sp1, sp2, sp3, 1e-19));
+
+    std::shared_ptr<GSLRandomNumberGenerator> rng(
+        new GSLRandomNumberGenerator(1));
+    std::shared_ptr<SpatiocyteWorld> world(
+        is_sparse
+            ? create_spatiocyte_world_sparse_impl(edge_lengths, voxel_radius,
+                                                  rng)
+            : new SpatiocyteWorld(edge_lengths, voxel_radius, rng));
+
+    BOOST_CHECK(world->add_molecules(sp1, 500));
+    BOOST_CHECK(world->add_molecules(sp2, 500));
+
+    SpatiocyteSimulator sim(world, model, num_threads);
+    BOOST_CHECK_EQUAL(sim.num_threads(), num_threads);
+    BOOST_CHECK_EQUAL(sim.is_parallel(), num_threads > 1 && !is_sparse);
+
+    for (Integer i(0); i < 100; ++i)
+    {
+        sim.step();
+    }
+
+    const Integer num_sp3(world->num_molecules(sp3));
+    BOOST_CHECK_EQUAL(500 - world->num_molecules(sp1), num_sp3);
+    BOOST_CHECK_EQUAL(500 - world->num_molecules(sp2), num_sp3);
+    return num_sp3;
+}
+
+BOOST_AUTO_TEST_CASE(SpatiocyteSimulator_test_parallel)
+{
+    run_binding_reaction(1);
+
+    const Integer num_sp3(run_binding_reaction(4));
+    BOOST_CHECK(num_sp3 > 0);
+
+    // reproducible for a given seed and number of threads
+    BOOST_CHECK_EQUAL(run_binding_reaction(4), num_sp3);
+}
+
+BOOST_AUTO_TEST_CASE(SpatiocyteSimulator_test_sparse)
+{
+    // the same coordinates and random numbers as in the default space
+    BOOST_CHECK_EQUAL(run_binding_reaction(1, true), run_binding_reaction(1));
+}
+
 BOOST_AUTO_TEST_CASE(SpatiocyteSimulator_test_unbinding_reaction)
 {
     const Real L(2.5e-8);
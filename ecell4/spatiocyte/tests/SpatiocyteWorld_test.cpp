@@ -222,6 +222,37 @@ BOOST_AUTO_TEST_CASE(SpatiocyteWorld_test_structure)
 #endif
 }
 
+BOOST_AUTO_TEST_CASE(SpatiocyteWorld_test_neighbor_in_membrane)
+{
+    Species membrane("Membrane", voxel_radius, 0);
+    membrane.set_attribute("dimension", Integer(2));
+    const Species sp("A", voxel_radius, 1e-12, "Membrane");
+    model->add_species_attribute(membrane);
+    model->add_species_attribute(sp);
+
+    const std::shared_ptr<const SphericalSurface> surface(new SphericalSurface(
+        Real3(5e-7, 5e-7, 5e-7), 3e-7));
+    BOOST_CHECK(world.add_structure(membrane, surface) > 0);
+    BOOST_CHECK(world.add_molecules(sp, 10));
+
+    for (const auto &item : world.list_voxels_exact(sp))
+    {
+        for (int i(0); i < 20; ++i)
+        {
+            const Voxel neighbor(world.get_neighbor_randomly<2>(item.voxel));
+            BOOST_CHECK(world.get_dimension(
+                            neighbor.get_voxel_pool()->species()) <= Shape::TWO);
+        }
+    }
+
+    // the neighbors are rebuilt after a structure is added
+    const Voxel voxel(world.get_voxel_nearby(Real3(1e-7, 1e-7, 1e-7)));
+    BOOST_CHECK(world.new_voxel_structure(membrane, voxel));
+    BOOST_CHECK(world.new_voxel_structure(membrane, world.get_neighbor(voxel, 0)));
+    BOOST_CHECK_EQUAL(world.get_neighbor_randomly<2>(voxel).coordinate,
+                      world.get_neighbor(voxel, 0).coordinate);
+}
+
 BOOST_AUTO_TEST_CASE(SpatiocyteWorld_offlattice)
 {
     const Species membrane("M", voxel_radius, 0.0);
@@ -252,4 +283,35 @@ BOOST_AUTO_TEST_CASE(SpatiocyteWorld_offlattice)
     BOOST_CHECK(world.check_neighbor(voxel, ""));
 }
 
+BOOST_AUTO_TEST_CASE(SpatiocyteWorld_offlattice_sparse)
+{
+    const Species membrane("M", voxel_radius, 0.0);
+    model->add_species_attribute(membrane);
+
+    std::vector<Real3> positions;
+    for (auto i = 0; i < 10; ++i)
+    {
+        for (auto j = 0; j < 10; ++j)
+        {
+            positions.push_back(Real3(i * 1e-8, j * 1e-8, 0.5e-6));
+        }
+    }
+
+    std::unique_ptr<SpatiocyteWorld> sparse(
+        create_spatiocyte_world_sparse_impl(edge_lengths, voxel_radius, rng));
+    sparse->bind_to(model);
+    const OffLattice offlattice(voxel_radius, positions);
+    sparse->add_space(offlattice.generate_space(membrane));
+
+    // a voxel next to the off-lattice space in the root space moves into it
+    const Voxel voxel(sparse->get_voxel_nearby(Real3(5e-8, 5e-8, 0.5e-6)));
+    bool crossed(false);
+    for (int i(0); i < 100 && !crossed; ++i)
+    {
+        const Voxel neighbor(sparse->get_neighbor_randomly<3>(voxel));
+        crossed = (neighbor.get_voxel_pool()->species() == membrane);
+    }
+    BOOST_CHECK(crossed);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,458 @@
+#include "TauLeapingSimulator.hpp"
+
+#include <map>
+#include <limits>
+#include <cmath>
+#include <unordered_map>
+#include <gsl/gsl_sf_log.h>
+
+#include <ecell4/core/exceptions.hpp>
+
+
+namespace ecell4
+{
+
+namespace tauleaping
+{
+
+void TauLeapingSimulator::check_static_model(void) const
+{
+    if (!model_->is_static())
+    {
+        throw NotSupported(
+            "Only a NetworkModel is accepted. Use expand.");
+    }
+}
+
+void TauLeapingSimulator::initialize(void)
+{
+    check_static_model();
+    base_type::initialize();
+    initialize_leaping();
+}
+
+void TauLeapingSimulator::initialize_leaping(void)
+{
+    species_.clear();
+    requirements_.clear();
+    changes_.clear();
+    orders_.clear();
+
+    typedef std::unordered_map<Species, std::size_t> species_map_type;
+    species_map_type index_map;
+
+    requirements_.resize(events_.size());
+    changes_.resize(events_.size());
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        const ReactionRule& rr(events_[j].reaction_rule());
+        const ReactionRule::reactant_container_type& reactants(rr.reactants());
+        const ReactionRule::product_container_type& products(rr.products());
+
+        ReactionRuleDescriptor::coefficient_container_type
+            reactant_coefficients(reactants.size(), 1.0),
+            product_coefficients(products.size(), 1.0);
+        if (rr.has_descriptor())
+        {
+            reactant_coefficients = rr.get_descriptor()->reactant_coefficients();
+            product_coefficients = rr.get_descriptor()->product_coefficients();
+        }
+
+        std::map<std::size_t, Integer> consumed, change;
+        Integer order(0);
+
+        for (std::size_t k(0); k < reactants.size() + products.size(); ++k)
+        {
+            const bool is_reactant(k < reactants.size());
+            const Species& sp(
+                is_reactant ? reactants[k] : products[k - reactants.size()]);
+            const Integer coef(static_cast<Integer>(round(
+                is_reactant ? reactant_coefficients[k]
+                    : product_coefficients[k - reactants.size()])));
+
+            species_map_type::const_iterator it(index_map.find(sp));
+            if (it == index_map.end())
+            {
+                it = index_map.insert(std::make_pair(sp, species_.size())).first;
+                species_.push_back(sp);
+                orders_.push_back(std::vector<std::pair<Integer, Integer> >());
+            }
+            const std::size_t idx((*it).second);
+
+            if (is_reactant)
+            {
+                consumed[idx] += coef;
+                change[idx] -= coef;
+                order += coef;
+            }
+            else
+            {
+                change[idx] += coef;
+            }
+        }
+
+        for (std::map<std::size_t, Integer>::const_iterator
+            it(consumed.begin()); it != consumed.end(); ++it)
+        {
+            if ((*it).second > 0)
+            {
+                requirements_[j].push_back(*it);
+                orders_[(*it).first].push_back(std::make_pair(order, (*it).second));
+            }
+        }
+
+        for (std::map<std::size_t, Integer>::const_iterator
+            it(change.begin()); it != change.end(); ++it)
+        {
+            if ((*it).second != 0)
+            {
+                changes_[j].push_back(*it);
+            }
+        }
+    }
+
+    species_index_.resize(species_.size());
+    for (std::size_t i(0); i < species_.size(); ++i)
+    {
+        species_index_[i] = world_->get_species_index(species_[i]);
+    }
+
+    num_exact_steps_ = 0;
+    draw_next_leap();
+}
+
+void TauLeapingSimulator::update_state(void)
+{
+    num_molecules_.resize(species_.size());
+    for (std::size_t i(0); i < species_.size(); ++i)
+    {
+        num_molecules_[i] = world_->num_molecules_at(species_index_[i]);
+    }
+
+    leap_propensities_.resize(events_.size());
+    atot_ = 0.0;
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        leap_propensities_[j] = events_[j].propensity();
+        atot_ += leap_propensities_[j];
+    }
+}
+
+Real TauLeapingSimulator::highest_order(const std::size_t i, const Integer num) const
+{
+    // g_i in Cao et al. (2006), generalized to any multiplicity m in
+    // a reaction of the order n: (n / m) * (m + sum_{k=1}^{m-1} k / (x - k)).
+    Real ret(0.0);
+    for (std::vector<std::pair<Integer, Integer> >::const_iterator
+        it(orders_[i].begin()); it != orders_[i].end(); ++it)
+    {
+        const Integer n((*it).first), m((*it).second);
+        Real g(m);
+        for (Integer k(1); k < m; ++k)
+        {
+            g += (num > k ? k / static_cast<Real>(num - k)
+                : std::numeric_limits<Real>::infinity());
+        }
+        ret = std::max(ret, g * n / m);
+    }
+    return ret;
+}
+
+void TauLeapingSimulator::draw_next_leap(void)
+{
+    update_state();
+
+    if (atot_ == 0.0 || atot_ == std::numeric_limits<Real>::infinity())
+    {
+        leaping_ = false;
+        num_exact_steps_ = 0;
+        draw_next_reaction();
+        return;
+    }
+
+    // Classify reactions close to exhausting a reactant as critical.
+    critical_.assign(events_.size(), false);
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        if (leap_propensities_[j] <= 0.0)
+        {
+            continue;
+        }
+
+        for (stoichiometry_type::const_iterator it(requirements_[j].begin());
+            it != requirements_[j].end(); ++it)
+        {
+            if (num_molecules_[(*it).first] / (*it).second < critical_threshold_)
+            {
+                critical_[j] = true;
+                break;
+            }
+        }
+    }
+
+    // Bound the relative change of propensities by non-critical reactions.
+    std::vector<Real> mu(species_.size(), 0.0), sigma2(species_.size(), 0.0);
+    std::vector<bool> is_reactant(species_.size(), false);
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        const Real a(leap_propensities_[j]);
+        if (critical_[j] || a <= 0.0)
+        {
+            continue;
+        }
+
+        for (stoichiometry_type::const_iterator it(requirements_[j].begin());
+            it != requirements_[j].end(); ++it)
+        {
+            is_reactant[(*it).first] = true;
+        }
+
+        for (stoichiometry_type::const_iterator it(changes_[j].begin());
+            it != changes_[j].end(); ++it)
+        {
+            mu[(*it).first] += (*it).second * a;
+            sigma2[(*it).first] += (*it).second * (*it).second * a;
+        }
+    }
+
+    Real tau(std::numeric_limits<Real>::infinity());
+    for (std::size_t i(0); i < species_.size(); ++i)
+    {
+        if (!is_reactant[i])
+        {
+            continue;
+        }
+
+        const Real bound(std::max(
+            epsilon_ * num_molecules_[i] / highest_order(i, num_molecules_[i]), 1.0));
+        if (mu[i] != 0.0)
+        {
+            tau = std::min(tau, bound / std::abs(mu[i]));
+        }
+        if (sigma2[i] > 0.0)
+        {
+            tau = std::min(tau, bound * bound / sigma2[i]);
+        }
+    }
+
+    choose_leap(tau);
+}
+
+void TauLeapingSimulator::choose_leap(Real tau)
+{
+    if (tau == std::numeric_limits<Real>::infinity()
+        || tau < exact_step_factor() / atot_)
+    {
+        // Leaping does not pay. Take exact steps instead.
+        leaping_ = false;
+        num_exact_steps_ = num_exact_steps();
+        draw_next_reaction();
+        return;
+    }
+
+    Real acrit(0.0);
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        if (critical_[j])
+        {
+            acrit += leap_propensities_[j];
+        }
+    }
+
+    Real tau_critical(std::numeric_limits<Real>::infinity());
+    if (acrit > 0.0)
+    {
+        const Real rnd1(rng()->uniform(0, 1));
+        tau_critical = gsl_sf_log(1.0 / rnd1) / acrit;
+    }
+
+    leaping_ = true;
+    tau_candidate_ = tau;
+
+    if (tau < tau_critical)
+    {
+        tau_ = tau;
+        fire_critical_ = false;
+        return;
+    }
+
+    tau_ = tau_critical;
+    fire_critical_ = true;
+
+    const Real rnd2(rng()->uniform(0, acrit));
+    Real acc(0.0);
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        if (critical_[j])
+        {
+            critical_event_ = j;
+            acc += leap_propensities_[j];
+            if (acc >= rnd2)
+            {
+                break;
+            }
+        }
+    }
+}
+
+bool TauLeapingSimulator::leap(const Real tau, const bool fire_critical)
+{
+    std::vector<Integer> firings(events_.size(), 0);
+    std::vector<Integer> delta(species_.size(), 0);
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        if (critical_[j])
+        {
+            firings[j] = (fire_critical && j == critical_event_ ? 1 : 0);
+        }
+        else if (leap_propensities_[j] > 0.0)
+        {
+            firings[j] = rng()->poisson(leap_propensities_[j] * tau);
+        }
+
+        if (firings[j] == 0)
+        {
+            continue;
+        }
+
+        for (stoichiometry_type::const_iterator it(changes_[j].begin());
+            it != changes_[j].end(); ++it)
+        {
+            delta[(*it).first] += (*it).second * firings[j];
+        }
+    }
+
+    for (std::size_t i(0); i < species_.size(); ++i)
+    {
+        if (num_molecules_[i] + delta[i] < 0)
+        {
+            return false;
+        }
+    }
+
+    for (std::size_t i(0); i < species_.size(); ++i)
+    {
+        if (delta[i] > 0)
+        {
+            increment_molecules(species_[i], delta[i]);
+        }
+        else if (delta[i] < 0)
+        {
+            decrement_molecules(species_[i], -delta[i]);
+        }
+        num_molecules_[i] += delta[i];
+    }
+    update_propensities();
+
+    this->set_t(t() + tau);
+    num_steps_++;
+
+    // Each reaction fired during the leap is listed once.
+    last_reactions_.clear();
+    for (std::size_t j(0); j < events_.size(); ++j)
+    {
+        if (firings[j] > 0)
+        {
+            const ReactionRule& rr(events_[j].reaction_rule());
+            last_reactions_.push_back(
+                std::make_pair(
+                    rr, reaction_info_type(t(), rr.reactants(), rr.products())));
+        }
+    }
+    return true;
+}
+
+bool TauLeapingSimulator::take_leap(void)
+{
+    while (!leap(tau_, fire_critical_))
+    {
+        // A population would become negative. Halve the leap and retry.
+        choose_leap(tau_candidate_ * 0.5);
+        if (!leaping_)
+        {
+            // The halved leap is too short. Take exact steps instead.
+            return false;
+        }
+    }
+
+    draw_next_leap();
+    return true;
+}
+
+void TauLeapingSimulator::exact_step(void)
+{
+    base_type::step();
+    if (num_exact_steps_ > 0)
+    {
+        --num_exact_steps_;
+    }
+    if (num_exact_steps_ == 0)
+    {
+        draw_next_leap();
+    }
+}
+
+void TauLeapingSimulator::step(void)
+{
+    if (leaping_ && take_leap())
+    {
+        return;
+    }
+
+    // Either an exact step was drawn, or the leap was rejected and
+    // the next reaction has been drawn anew. Both advance the time.
+    exact_step();
+}
+
+bool TauLeapingSimulator::step(const Real& upto)
+{
+    if (upto <= t())
+    {
+        return false;
+    }
+
+    if (leaping_ && upto >= next_time() && take_leap())
+    {
+        return true;
+    }
+
+    if (!leaping_)
+    {
+        if (upto >= next_time())
+        {
+            exact_step();
+            return true;
+        }
+
+        // No reaction occurs.
+        return base_type::step(upto);
+    }
+
+    // No critical reaction occurs before upto.
+    while (t() < upto)
+    {
+        Real tau(upto - t());
+        while (!leap(tau, false))
+        {
+            tau *= 0.5;
+        }
+
+        if (t() < upto)
+        {
+            update_state();
+        }
+    }
+    this->set_t(upto);
+
+    draw_next_leap();
+    return false;
+}
+
+Real TauLeapingSimulator::dt(void) const
+{
+    return (leaping_ ? tau_ : base_type::dt());
+}
+
+} // tauleaping
+
+} // ecell4
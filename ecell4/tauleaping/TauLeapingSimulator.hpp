@@ -0,0 +1,171 @@
+#ifndef ECELL4_TAULEAPING_TAU_LEAPING_SIMULATOR_HPP
+#define ECELL4_TAULEAPING_TAU_LEAPING_SIMULATOR_HPP
+
+#include <vector>
+#include <utility>
+#include <memory>
+
+#include <ecell4/core/types.hpp>
+#include <ecell4/core/Model.hpp>
+
+#include <ecell4/gillespie/GillespieWorld.hpp>
+#include <ecell4/gillespie/GillespieSimulator.hpp>
+
+
+namespace ecell4
+{
+
+namespace tauleaping
+{
+
+/**
+ * An explicit tau-leaping simulator with the step size selection of
+ * Cao, Gillespie & Petzold (J. Chem. Phys. 124, 044109, 2006).
+ * Reactions which may exhaust one of their reactants within a few firings
+ * are treated as critical and fired one at a time. When the leap would be
+ * shorter than a few exact steps, the simulator falls back to the exact
+ * direct method of GillespieSimulator for a while.
+ * Only a static model (NetworkModel) is accepted.
+ */
+class TauLeapingSimulator
+    : public gillespie::GillespieSimulator
+{
+public:
+
+    typedef gillespie::GillespieSimulator base_type;
+    typedef gillespie::GillespieWorld world_type;
+
+protected:
+
+    typedef std::vector<std::pair<std::size_t, Integer> > stoichiometry_type;
+
+public:
+
+    TauLeapingSimulator(
+        std::shared_ptr<world_type> world,
+        std::shared_ptr<Model> model,
+        const Real epsilon = default_epsilon(),
+        const Integer critical_threshold = default_critical_threshold())
+        : base_type(world, model), epsilon_(epsilon),
+        critical_threshold_(critical_threshold)
+    {
+        // the base constructor has already initialized the propensities.
+        check_static_model();
+        initialize_leaping();
+    }
+
+    TauLeapingSimulator(
+        std::shared_ptr<world_type> world,
+        const Real epsilon = default_epsilon(),
+        const Integer critical_threshold = default_critical_threshold())
+        : base_type(world), epsilon_(epsilon),
+        critical_threshold_(critical_threshold)
+    {
+        // the base constructor has already initialized the propensities.
+        check_static_model();
+        initialize_leaping();
+    }
+
+    static inline const Real default_epsilon()
+    {
+        return 0.03;
+    }
+
+    static inline const Integer default_critical_threshold()
+    {
+        return 10;
+    }
+
+    /**
+     * the number of exact steps taken once a leap is found too short.
+     */
+    static inline const Integer num_exact_steps()
+    {
+        return 100;
+    }
+
+    /**
+     * a leap shorter than this number of expected exact steps is not taken.
+     */
+    static inline const Real exact_step_factor()
+    {
+        return 10.0;
+    }
+
+    Real epsilon() const
+    {
+        return epsilon_;
+    }
+
+    Integer critical_threshold() const
+    {
+        return critical_threshold_;
+    }
+
+    /**
+     * return true if the next step is a leap, or false if it is an exact step.
+     */
+    bool is_leaping() const
+    {
+        return leaping_;
+    }
+
+    // SimulatorTraits
+    Real dt(void) const;
+
+    void step(void);
+    bool step(const Real& upto);
+
+    /**
+     * recalculate reaction propensities and draw the next leap.
+     */
+    void initialize();
+
+protected:
+
+    void check_static_model(void) const;
+    void initialize_leaping(void);
+    void draw_next_leap(void);
+    void choose_leap(Real tau);
+    bool leap(const Real tau, const bool fire_critical);
+    bool take_leap(void);
+    void exact_step(void);
+    Real highest_order(const std::size_t i, const Integer num) const;
+    void update_state(void);
+
+protected:
+
+    Real epsilon_;
+    Integer critical_threshold_;
+
+    /**
+     * species_ is a list of the species involved in the model.
+     * requirements_ and changes_ are the numbers of molecules consumed
+     * and the net change per firing of each event, given as pairs of an
+     * index of species_ and a number.
+     * orders_ holds (order, multiplicity) for each reaction in which
+     * the species is a reactant.
+     * species_index_ is the index of each species in the world.
+     */
+    std::vector<Species> species_;
+    std::vector<world_type::species_index_type> species_index_;
+    std::vector<stoichiometry_type> requirements_, changes_;
+    std::vector<std::vector<std::pair<Integer, Integer> > > orders_;
+
+    std::vector<Integer> num_molecules_;
+    std::vector<Real> leap_propensities_;
+    std::vector<bool> critical_;
+    Real atot_;
+
+    bool leaping_;
+    Real tau_, tau_candidate_;
+    bool fire_critical_;
+    std::size_t critical_event_;
+    Integer num_exact_steps_;
+};
+
+} // tauleaping
+
+} // ecell4
+
+#endif /* ECELL4_TAULEAPING_TAU_LEAPING_SIMULATOR_HPP */
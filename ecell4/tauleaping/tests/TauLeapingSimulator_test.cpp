@@ -0,0 +1,113 @@
+#define BOOST_TEST_MODULE "TauLeapingSimulator_test"
+
+#ifdef UNITTEST_FRAMEWORK_LIBRARY_EXIST
+#   include <boost/test/unit_test.hpp>
+#else
+#   define BOOST_TEST_NO_LIB
+#   include <boost/test/included/unit_test.hpp>
+#endif
+
+#include <cmath>
+
+#include <ecell4/core/RandomNumberGenerator.hpp>
+#include <ecell4/core/Model.hpp>
+#include <ecell4/core/NetworkModel.hpp>
+#include <ecell4/core/NetfreeModel.hpp>
+
+#include <ecell4/tauleaping/TauLeapingSimulator.hpp>
+
+using namespace ecell4;
+using namespace ecell4::gillespie;
+using namespace ecell4::tauleaping;
+
+BOOST_AUTO_TEST_CASE(TauLeapingSimulator_test_decay)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+
+    const Integer N(100000);
+    world->add_molecules(sp1, N);
+
+    TauLeapingSimulator sim(world, model);
+    BOOST_CHECK(sim.is_leaping());
+
+    sim.run(1.0);
+
+    BOOST_CHECK_EQUAL(sim.t(), 1.0);
+    BOOST_CHECK_EQUAL(world->num_molecules(sp1) + world->num_molecules(sp2), N);
+    BOOST_CHECK(sim.num_steps() < N / 10);
+
+    const Real expected(N * std::exp(-1.0));
+    BOOST_CHECK(std::abs(world->num_molecules(sp1) - expected) < 0.03 * expected);
+}
+
+BOOST_AUTO_TEST_CASE(TauLeapingSimulator_test_descriptor)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+
+    ReactionRule rr(create_unimolecular_reaction_rule(sp1, sp2, 0.0));
+    ReactionRuleDescriptor::coefficient_container_type
+        reactant_coefficients(1, 2.0), product_coefficients(1, 1.0);
+    rr.set_descriptor(std::shared_ptr<ReactionRuleDescriptor>(
+        new ReactionRuleDescriptorMassAction(1e-4, reactant_coefficients, product_coefficients)));
+    model->add_reaction_rule(rr);
+
+    std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+    rng->seed(0);
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+
+    const Integer N(10000);
+    world->add_molecules(sp1, N);
+
+    TauLeapingSimulator sim(world, model);
+    sim.run(1.0);
+
+    BOOST_CHECK(world->num_molecules(sp1) < N);
+    BOOST_CHECK(world->num_molecules(sp1) >= 0);
+    BOOST_CHECK_EQUAL(world->num_molecules(sp1) + 2 * world->num_molecules(sp2), N);
+}
+
+BOOST_AUTO_TEST_CASE(TauLeapingSimulator_test_netfree_model)
+{
+    std::shared_ptr<NetfreeModel> model(new NetfreeModel());
+    model->add_reaction_rule(
+        create_unimolecular_reaction_rule(Species("X(q=a)"), Species("X(q=b)"), 1.0));
+
+    std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1)));
+    BOOST_CHECK_THROW(TauLeapingSimulator(world, model), NotSupported);
+}
+
+BOOST_AUTO_TEST_CASE(TauLeapingSimulator_test_rejected_leap)
+{
+    std::shared_ptr<NetworkModel> model(new NetworkModel());
+    Species sp1("A");
+    Species sp2("B");
+    model->add_reaction_rule(create_unimolecular_reaction_rule(sp1, sp2, 1.0));
+
+    // A large epsilon makes leaps overdraw A, and they are often halved
+    // below the exact step threshold. Every step must still advance time.
+    for (Integer seed(0); seed < 100; ++seed)
+    {
+        std::shared_ptr<RandomNumberGenerator> rng(new GSLRandomNumberGenerator());
+        rng->seed(seed);
+        std::shared_ptr<GillespieWorld> world(new GillespieWorld(Real3(1, 1, 1), rng));
+        world->add_molecules(sp1, 20);
+
+        TauLeapingSimulator sim(world, model, 1.0, 1);
+        while (world->num_molecules(sp1) > 0)
+        {
+            const Real t0(sim.t());
+            sim.step();
+            BOOST_REQUIRE(sim.t() > t0);
+        }
+        BOOST_CHECK_EQUAL(world->num_molecules(sp2), 20);
+    }
+}
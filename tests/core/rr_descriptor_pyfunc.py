@@ -12,3 +12,13 @@ class ReactionRuleDescriptorPyfuncTest(unittest.TestCase):
 
         self.assertTrue(rr.has_descriptor())
         self.assertTrue(m.reaction_rules()[0].has_descriptor())
+
+    def test_expression(self):
+        desc = ReactionRuleDescriptorExpression("0.1 * r[0] * r[1] / v")
+        self.assertAlmostEqual(desc.propensity([2.0, 3.0], [], 2.0, 0.0), 0.3)
+        self.assertEqual(desc.as_string(), "0.1 * r[0] * r[1] / v")
+
+    def test_batch(self):
+        batch = ReactionRuleDescriptorBatchPyfunc(lambda r, p, v, t: 0.1 * r[:, 0] / v, 1, 1, "test")
+        desc = ReactionRuleDescriptorBatched(batch)
+        self.assertAlmostEqual(desc.propensity([2.0], [0.0], 2.0, 0.0), 0.1)